@@ -0,0 +1,41 @@
+#include "stdafx.h"
+#include "AccumulatorState.h"
+
+namespace ReedSolomon {
+
+	size_t GetAccumulatorStateSize(size_t exponentCount, size_t accumulatorBytes) {
+		return sizeof(AccumulatorStateHeader) + (exponentCount + 7) / 8 + accumulatorBytes;
+	}
+
+	void SaveAccumulatorState(uint8_t* buffer, const AccumulatorStateHeader& header,
+		const uint8_t* added, size_t exponentCount, const void* accumulator) {
+
+		size_t bitmapBytes = (exponentCount + 7) / 8;
+		memcpy(buffer, &header, sizeof(AccumulatorStateHeader));
+		memcpy(buffer + sizeof(AccumulatorStateHeader), added, bitmapBytes);
+		memcpy(buffer + sizeof(AccumulatorStateHeader) + bitmapBytes, accumulator, (size_t)header.accumulatorBytes);
+	}
+
+	bool LoadAccumulatorState(const uint8_t* buffer, size_t length, const AccumulatorStateHeader& expected,
+		uint8_t* added, size_t exponentCount, void* accumulator) {
+
+		if (length < sizeof(AccumulatorStateHeader)) return false;
+
+		AccumulatorStateHeader header;
+		memcpy(&header, buffer, sizeof(AccumulatorStateHeader));
+		if (header.marker != expected.marker ||
+			header.version != expected.version ||
+			header.kind != expected.kind ||
+			header.nDataCodewords != expected.nDataCodewords ||
+			header.nParityCodewords != expected.nParityCodewords ||
+			header.codewordsPerSlice != expected.codewordsPerSlice ||
+			header.accumulatorBytes != expected.accumulatorBytes) return false;
+
+		if (length < GetAccumulatorStateSize(exponentCount, (size_t)header.accumulatorBytes)) return false;
+
+		size_t bitmapBytes = (exponentCount + 7) / 8;
+		memcpy(added, buffer + sizeof(AccumulatorStateHeader), bitmapBytes);
+		memcpy(accumulator, buffer + sizeof(AccumulatorStateHeader) + bitmapBytes, (size_t)header.accumulatorBytes);
+		return true;
+	}
+}
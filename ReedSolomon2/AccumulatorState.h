@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace ReedSolomon {
+
+	// The binary layout used to save and restore the accumulators of Parity and Syndrome, so that a long encode or verify can be
+	// resumed.  The layout is the header, then a bitmap with one bit per exponent already added (least significant bit first),
+	// then the raw accumulator.  Values are stored in the native (little-endian) byte order.
+	struct AccumulatorStateHeader {
+		uint32_t marker;
+		uint16_t version;
+		uint16_t kind;
+		uint64_t nDataCodewords;
+		uint64_t nParityCodewords;
+		uint64_t codewordsPerSlice;
+		uint64_t accumulatorBytes;
+	};
+
+	static const uint32_t ACCUMULATOR_STATE_MARKER = 0x53415352; // "RSAS"
+	static const uint16_t ACCUMULATOR_STATE_VERSION = 1;
+	static const uint16_t PARITY_STATE = 1;
+	static const uint16_t SYNDROME_STATE = 2;
+
+	size_t GetAccumulatorStateSize(size_t exponentCount, size_t accumulatorBytes);
+
+	void SaveAccumulatorState(uint8_t* buffer, const AccumulatorStateHeader& header,
+		const uint8_t* added, size_t exponentCount, const void* accumulator);
+
+	// Returns false, leaving added and accumulator untouched, if the state is truncated or was saved for a different geometry.
+	bool LoadAccumulatorState(const uint8_t* buffer, size_t length, const AccumulatorStateHeader& expected,
+		uint8_t* added, size_t exponentCount, void* accumulator);
+}
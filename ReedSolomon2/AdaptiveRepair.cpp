@@ -0,0 +1,115 @@
+#include "stdafx.h"
+#include "AdaptiveRepair.h"
+#include "Parity.h"
+#include "RangeRepair.h"
+#include "BufferPool.h"
+#include <stdexcept>
+
+namespace ReedSolomon {
+
+	static const int CODEWORDS_PER_BLOCK = 8;
+	static const int BYTES_PER_CODEWORD = 2;
+
+	AdaptiveRepair::AdaptiveRepair(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, int* errorLocations, int errorCount) :
+		_nDataCodewords(nDataCodewords), _nParityCodewords(nParityCodewords), _codewordsPerSlice(codewordsPerSlice),
+		_errorCount(errorCount), _xor(nullptr), _parity(nullptr), _decode(nullptr) {
+
+		if (errorCount <= 0) throw std::invalid_argument("No errors to repair");
+		if ((size_t)errorCount > nParityCodewords) throw std::invalid_argument("Too many errors");
+
+		size_t totalCodewords = nDataCodewords + nParityCodewords;
+		for (int i = 0; i < errorCount; i++) {
+			if (errorLocations[i] < 0 || (size_t)errorLocations[i] >= totalCodewords) throw std::invalid_argument("Error location out of range");
+		}
+
+		_blocksPerSlice = (codewordsPerSlice + CODEWORDS_PER_BLOCK - 1) / CODEWORDS_PER_BLOCK;
+		_strategy = ChooseStrategy(nParityCodewords, errorLocations, errorCount);
+		switch (_strategy) {
+		case ADAPTIVE_REPAIR_XOR: _xor = (__m128i*)BufferPool::Allocate(_blocksPerSlice * 16); break;
+		case ADAPTIVE_REPAIR_REENCODE: _parity = new Parity(nDataCodewords, nParityCodewords, codewordsPerSlice); break;
+		case ADAPTIVE_REPAIR_DECODE: _decode = new RangeRepair(nDataCodewords, nParityCodewords, codewordsPerSlice, errorLocations, errorCount); break;
+		}
+
+		_errorLocations = new int[errorCount];
+		for (int i = 0; i < errorCount; i++) _errorLocations[i] = errorLocations[i];
+		_isErasure = new bool[totalCodewords];
+		for (size_t i = 0; i < totalCodewords; i++) _isErasure[i] = false;
+		for (int i = 0; i < errorCount; i++) _isErasure[errorLocations[i]] = true;
+
+		Reset();
+	}
+
+	AdaptiveRepairStrategy AdaptiveRepair::ChooseStrategy(size_t nParityCodewords, const int* errorLocations, int errorCount) {
+		if (errorCount == 1) return ADAPTIVE_REPAIR_XOR;
+		for (int i = 0; i < errorCount; i++) {
+			if ((size_t)errorLocations[i] >= nParityCodewords) return ADAPTIVE_REPAIR_DECODE;
+		}
+		return ADAPTIVE_REPAIR_REENCODE;
+	}
+
+	AdaptiveRepair::~AdaptiveRepair() {
+		if (_xor != nullptr) BufferPool::Free(_xor, _blocksPerSlice * 16);
+		delete _parity;
+		delete _decode;
+		delete[] _errorLocations;
+		delete[] _isErasure;
+	}
+
+	void AdaptiveRepair::Reset() {
+		switch (_strategy) {
+		case ADAPTIVE_REPAIR_XOR: memset(_xor, 0, _blocksPerSlice * 16); break;
+		case ADAPTIVE_REPAIR_REENCODE: _parity->Reset(); break;
+		case ADAPTIVE_REPAIR_DECODE: _decode->Reset(); break;
+		}
+	}
+
+	bool AdaptiveRepair::IsNeeded(size_t exponent) const {
+		if (exponent >= _nDataCodewords + _nParityCodewords || _isErasure[exponent]) return false;
+		return _strategy != ADAPTIVE_REPAIR_REENCODE || exponent >= _nParityCodewords;
+	}
+
+	void AdaptiveRepair::AddCodewordSlice(uint16_t* data, size_t exponent) {
+		if (!IsNeeded(exponent)) return;
+
+		switch (_strategy) {
+		case ADAPTIVE_REPAIR_XOR: {
+			const __m128i* source = (const __m128i*)data;
+			size_t blocks = _codewordsPerSlice / CODEWORDS_PER_BLOCK;
+			for (size_t i = 0; i < blocks; i++) _mm_store_si128(_xor + i, _mm_xor_si128(_mm_load_si128(_xor + i), _mm_loadu_si128(source + i)));
+
+			uint16_t* destTail = (uint16_t*)(_xor + blocks);
+			const uint16_t* sourceTail = data + blocks * CODEWORDS_PER_BLOCK;
+			for (size_t i = 0; i < _codewordsPerSlice % CODEWORDS_PER_BLOCK; i++) destTail[i] ^= sourceTail[i];
+			break;
+		}
+		case ADAPTIVE_REPAIR_REENCODE: _parity->Calculate(data, exponent); break;
+		case ADAPTIVE_REPAIR_DECODE: _decode->AddCodewordSlice(data, exponent); break;
+		}
+	}
+
+	void AdaptiveRepair::GetCorrection(int errorLocationOffset, uint16_t* data) const {
+		if (errorLocationOffset < 0 || errorLocationOffset >= _errorCount) throw std::invalid_argument("Error location offset out of range");
+
+		switch (_strategy) {
+		case ADAPTIVE_REPAIR_XOR: memcpy(data, _xor, _codewordsPerSlice * BYTES_PER_CODEWORD); break;
+		case ADAPTIVE_REPAIR_REENCODE: _parity->GetParity(data, (size_t)_errorLocations[errorLocationOffset]); break;
+		case ADAPTIVE_REPAIR_DECODE: _decode->GetCorrection(errorLocationOffset, data); break;
+		}
+	}
+
+	AdaptiveRepair* AdaptiveRepair_Construct(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, int* errorLocations, int errorCount) {
+		return new AdaptiveRepair(nDataCodewords, nParityCodewords, codewordsPerSlice, errorLocations, errorCount);
+	}
+
+	void AdaptiveRepair_Destruct(AdaptiveRepair* p) { delete p; }
+
+	void AdaptiveRepair_Reset(AdaptiveRepair* p) { p->Reset(); }
+
+	int AdaptiveRepair_GetStrategy(const AdaptiveRepair* p) { return p->GetStrategy(); }
+
+	bool AdaptiveRepair_IsNeeded(const AdaptiveRepair* p, size_t exponent) { return p->IsNeeded(exponent); }
+
+	void AdaptiveRepair_AddCodewordSlice(AdaptiveRepair* p, uint16_t* data, size_t exponent) { p->AddCodewordSlice(data, exponent); }
+
+	void AdaptiveRepair_GetCorrection(const AdaptiveRepair* p, int errorLocationOffset, uint16_t* data) { p->GetCorrection(errorLocationOffset, data); }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <immintrin.h>
+
+namespace ReedSolomon {
+
+	class Parity;
+	class RangeRepair;
+
+	// How an AdaptiveRepair rebuilds its erasures
+	enum AdaptiveRepairStrategy {
+		// One erasure: syndrome 0 is the XOR of every slice, so the erased slice is the XOR of the survivors
+		ADAPTIVE_REPAIR_XOR = 0,
+		// Only parity slices are erased: they are encoded again from the data slices, and the surviving parity is not needed
+		ADAPTIVE_REPAIR_REENCODE = 1,
+		// Anything else: only as many syndromes as there are erasures, folded with the correction matrix (see RangeRepair)
+		ADAPTIVE_REPAIR_DECODE = 2
+	};
+
+	// Rebuilds a known set of erased slices with work that scales with the number of erasures rather than the parity count.
+	//
+	// Repair accumulates every syndrome of a track, although the correction reads only the first errorCount of them.  When the
+	// erasures are known before the survivors are read, as after a scrub, this chooses the cheapest path for the set.  Callers
+	// should skip reading the survivors for which IsNeeded returns false.
+	class AdaptiveRepair {
+
+	public:
+
+		AdaptiveRepair(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, int* errorLocations, int errorCount);
+		~AdaptiveRepair();
+
+		void Reset();
+
+		// The strategy for an erasure set, so callers can size the work before constructing an instance
+		static AdaptiveRepairStrategy ChooseStrategy(size_t nParityCodewords, const int* errorLocations, int errorCount);
+
+		inline AdaptiveRepairStrategy GetStrategy() const { return _strategy; }
+		inline int GetErrorCount() const { return _errorCount; }
+
+		// Whether the surviving slice with this exponent contributes to the repair
+		bool IsNeeded(size_t exponent) const;
+
+		// Adds a surviving slice.  Erasures, and slices that are not needed, are ignored.
+		void AddCodewordSlice(uint16_t* data, size_t exponent);
+
+		// Writes the rebuilt erasure at errorLocationOffset into data
+		void GetCorrection(int errorLocationOffset, uint16_t* data) const;
+
+	private:
+
+		size_t _nDataCodewords;
+		size_t _nParityCodewords;
+		size_t _codewordsPerSlice;
+		size_t _blocksPerSlice;
+
+		AdaptiveRepairStrategy _strategy;
+		int* _errorLocations;
+		int _errorCount;
+		bool* _isErasure;
+
+		__m128i* _xor;
+		Parity* _parity;
+		RangeRepair* _decode;
+	};
+
+	extern "C" {
+		__declspec(dllexport) AdaptiveRepair* AdaptiveRepair_Construct(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, int* errorLocations, int errorCount);
+		__declspec(dllexport) void AdaptiveRepair_Destruct(AdaptiveRepair* p);
+		__declspec(dllexport) void AdaptiveRepair_Reset(AdaptiveRepair* p);
+		__declspec(dllexport) int AdaptiveRepair_GetStrategy(const AdaptiveRepair* p);
+		__declspec(dllexport) bool AdaptiveRepair_IsNeeded(const AdaptiveRepair* p, size_t exponent);
+		__declspec(dllexport) void AdaptiveRepair_AddCodewordSlice(AdaptiveRepair* p, uint16_t* data, size_t exponent);
+		__declspec(dllexport) void AdaptiveRepair_GetCorrection(const AdaptiveRepair* p, int errorLocationOffset, uint16_t* data);
+	}
+}
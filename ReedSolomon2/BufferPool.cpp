@@ -0,0 +1,142 @@
+#include "stdafx.h"
+#include "BufferPool.h"
+#include <new>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace ReedSolomon {
+
+	BufferPool::SizeClass BufferPool::_classes[BufferPool::CLASS_COUNT];
+	bool BufferPool::_largePages = false;
+
+	int BufferPool::GetClass(size_t bytes) {
+		int sizeClass = 0;
+		while (GetClassSize(sizeClass) < bytes) sizeClass++;
+		return sizeClass;
+	}
+
+	void* BufferPool::Allocate(size_t bytes) {
+		int sizeClass = GetClass(bytes);
+		if (sizeClass >= CLASS_COUNT) throw std::bad_alloc();
+		size_t classSize = GetClassSize(sizeClass);
+		SizeClass& c = _classes[sizeClass];
+
+		{
+			std::lock_guard<std::mutex> lock(c.lock);
+			if (c.free != nullptr) {
+				FreeBuffer* buffer = c.free;
+				c.free = buffer->next;
+				return buffer;
+			}
+		}
+
+		if (classSize >= ARENA_SIZE) {
+			void* p = AllocateFromSystem(classSize, _largePages);
+			if (p == nullptr) throw std::bad_alloc();
+			return p;
+		}
+
+		// Carve a new arena into buffers of this class.  The first one is returned and the rest go on the free list.
+		char* arena = (char*)AllocateFromSystem(ARENA_SIZE, _largePages);
+		if (arena == nullptr) throw std::bad_alloc();
+
+		std::lock_guard<std::mutex> lock(c.lock);
+		for (size_t offset = ARENA_SIZE - classSize; offset > 0; offset -= classSize) {
+			FreeBuffer* buffer = (FreeBuffer*)(arena + offset);
+			buffer->next = c.free;
+			c.free = buffer;
+		}
+		return arena;
+	}
+
+	void BufferPool::Free(void* p, size_t bytes) {
+		if (p == nullptr) return;
+
+		SizeClass& c = _classes[GetClass(bytes)];
+		std::lock_guard<std::mutex> lock(c.lock);
+		FreeBuffer* buffer = (FreeBuffer*)p;
+		buffer->next = c.free;
+		c.free = buffer;
+	}
+
+	void BufferPool::Trim() {
+		for (int sizeClass = GetClass(ARENA_SIZE); sizeClass < CLASS_COUNT; sizeClass++) {
+			SizeClass& c = _classes[sizeClass];
+			std::lock_guard<std::mutex> lock(c.lock);
+			while (c.free != nullptr) {
+				FreeBuffer* buffer = c.free;
+				c.free = buffer->next;
+				FreeToSystem(buffer, GetClassSize(sizeClass));
+			}
+		}
+	}
+
+#ifdef _WIN32
+
+	bool BufferPool::EnableLargePages(bool enable) {
+		if (!enable) {
+			_largePages = false;
+			return true;
+		}
+
+		// Large pages require SeLockMemoryPrivilege to be held and enabled for the process
+		HANDLE token;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+
+		TOKEN_PRIVILEGES privileges;
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		bool enabled = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+			AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+			GetLastError() == ERROR_SUCCESS;
+		CloseHandle(token);
+
+		size_t largePageSize = GetLargePageMinimum();
+		if (!enabled || largePageSize == 0 || ARENA_SIZE % largePageSize != 0) return false;
+
+		_largePages = true;
+		return true;
+	}
+
+	void* BufferPool::AllocateFromSystem(size_t bytes, bool largePages) {
+		if (largePages && bytes % GetLargePageMinimum() == 0) {
+			void* p = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (p != nullptr) return p;
+		}
+		return VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+
+	void BufferPool::FreeToSystem(void* p, size_t /*bytes*/) {
+		VirtualFree(p, 0, MEM_RELEASE);
+	}
+
+#else
+
+	bool BufferPool::EnableLargePages(bool enable) {
+		_largePages = enable;
+		return true;
+	}
+
+	void* BufferPool::AllocateFromSystem(size_t bytes, bool largePages) {
+		void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) return nullptr;
+		// Transparent huge pages are only a hint; the mapping works either way
+		if (largePages) madvise(p, bytes, MADV_HUGEPAGE);
+		return p;
+	}
+
+	void BufferPool::FreeToSystem(void* p, size_t bytes) {
+		munmap(p, bytes);
+	}
+
+#endif
+
+	void* BufferPool_Allocate(size_t bytes) { return BufferPool::Allocate(bytes); }
+
+	void BufferPool_Free(void* p, size_t bytes) { BufferPool::Free(p, bytes); }
+
+	void BufferPool_Trim() { BufferPool::Trim(); }
+
+	bool BufferPool_EnableLargePages(bool enable) { return BufferPool::EnableLargePages(enable); }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+
+namespace ReedSolomon {
+
+	// Size-class pools of 64-byte aligned buffers shared by the codec classes and, through the exports, by the managed side.
+	//
+	// Each size class is a power of two.  Buffers smaller than an arena are carved out of 2 MB arenas, which are backed by large
+	// pages when they have been enabled and the process holds the privilege to use them.  Larger buffers are allocated whole.  Freed
+	// buffers go back on the free list of their class, so steady-state encode and verify loops do not allocate.
+	//
+	// Allocate does not clear the buffer: one taken from a free list holds whatever its last owner left in it, including the bytes
+	// past the requested size up to the class size.  Callers that read any part of a buffer before writing it must clear it first.
+	class BufferPool {
+
+	public:
+
+		static const size_t ALIGNMENT = 64;
+		static const size_t ARENA_SIZE = 2 * 1024 * 1024;
+
+		static void* Allocate(size_t bytes);
+		static void Free(void* p, size_t bytes);
+
+		// Returns free buffers that were allocated whole to the operating system.  Arenas are kept for the life of the process.
+		static void Trim();
+
+		// Tries to back new arenas with large pages.  Returns false if large pages are not available.
+		static bool EnableLargePages(bool enable);
+		static bool LargePagesEnabled() { return _largePages; }
+
+	private:
+
+		static const int MIN_CLASS_BITS = 6;
+		static const int CLASS_COUNT = 32;
+
+		struct FreeBuffer {
+			FreeBuffer* next;
+		};
+
+		struct SizeClass {
+			std::mutex lock;
+			FreeBuffer* free;
+		};
+
+		static int GetClass(size_t bytes);
+		static inline size_t GetClassSize(int sizeClass) { return (size_t)1 << (sizeClass + MIN_CLASS_BITS); }
+
+		static void* AllocateFromSystem(size_t bytes, bool largePages);
+		static void FreeToSystem(void* p, size_t bytes);
+
+		static SizeClass _classes[CLASS_COUNT];
+		static bool _largePages;
+	};
+
+	extern "C" {
+		__declspec(dllexport) void* BufferPool_Allocate(size_t bytes);
+		__declspec(dllexport) void BufferPool_Free(void* p, size_t bytes);
+		__declspec(dllexport) void BufferPool_Trim();
+		__declspec(dllexport) bool BufferPool_EnableLargePages(bool enable);
+	}
+}
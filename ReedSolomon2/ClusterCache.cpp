@@ -0,0 +1,202 @@
+#include "stdafx.h"
+#include "ClusterCache.h"
+#include "BufferPool.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace ReedSolomon {
+
+	struct ClusterCache::Entry {
+		int64_t key;
+		uint8_t* data;
+		size_t length;
+		// Position in the shard's clock, or SIZE_MAX once the entry has been taken out of the shard
+		size_t clockIndex;
+		uint32_t pins;
+		bool referenced;
+	};
+
+	static const size_t DETACHED = SIZE_MAX;
+
+	ClusterCache::ClusterCache(size_t capacityBytes, size_t shardCount) {
+		if (shardCount == 0) throw std::invalid_argument("shardCount");
+
+		_shardCount = shardCount;
+		_shardCapacity = capacityBytes / shardCount;
+		_shards = new Shard[shardCount];
+		for (size_t i = 0; i < shardCount; i++) {
+			_shards[i].hand = 0;
+			_shards[i].bytes = 0;
+			_shards[i].hits = 0;
+			_shards[i].misses = 0;
+			_shards[i].evictions = 0;
+		}
+	}
+
+	ClusterCache::~ClusterCache() {
+		Clear();
+		delete[] _shards;
+	}
+
+	bool ClusterCache::Put(int64_t key, const uint8_t* data, size_t length) {
+		if (length > _shardCapacity) {
+			Remove(key);
+			return false;
+		}
+
+		Shard& shard = GetShard(key);
+
+		// The copy is made before taking the lock, so a slow copy does not hold up the shard
+		Entry* entry = new Entry;
+		entry->key = key;
+		entry->data = (uint8_t*)BufferPool::Allocate(length);
+		entry->length = length;
+		entry->pins = 0;
+		entry->referenced = false;
+		memcpy(entry->data, data, length);
+
+		std::lock_guard<std::mutex> lock(shard.lock);
+
+		auto existing = shard.entries.find(key);
+		if (existing != shard.entries.end()) Detach(shard, existing->second);
+
+		if (!MakeRoom(shard, length)) {
+			Free(entry);
+			return false;
+		}
+
+		entry->clockIndex = shard.clock.size();
+		shard.clock.push_back(entry);
+		shard.entries[key] = entry;
+		shard.bytes += length;
+		return true;
+	}
+
+	bool ClusterCache::MakeRoom(Shard& shard, size_t length) {
+		// Two sweeps clear every reference bit, so a hand that has gone round twice has only found pinned entries
+		size_t steps = 2 * shard.clock.size();
+		while (shard.bytes + length > _shardCapacity) {
+			if (steps-- == 0) return false;
+
+			if (shard.hand >= shard.clock.size()) shard.hand = 0;
+			Entry* entry = shard.clock[shard.hand];
+
+			if (entry->pins != 0) {
+				shard.hand++;
+			} else if (entry->referenced) {
+				entry->referenced = false;
+				shard.hand++;
+			} else {
+				// The last entry in the clock moves into the evicted slot, so the hand stays where it is
+				Detach(shard, entry);
+				shard.evictions++;
+			}
+		}
+		return true;
+	}
+
+	ClusterCache::Entry* ClusterCache::Acquire(int64_t key) {
+		Shard& shard = GetShard(key);
+		std::lock_guard<std::mutex> lock(shard.lock);
+
+		auto found = shard.entries.find(key);
+		if (found == shard.entries.end()) {
+			shard.misses++;
+			return nullptr;
+		}
+
+		Entry* entry = found->second;
+		entry->pins++;
+		entry->referenced = true;
+		shard.hits++;
+		return entry;
+	}
+
+	void ClusterCache::Release(Entry* entry) {
+		Shard& shard = GetShard(entry->key);
+		bool free;
+		{
+			std::lock_guard<std::mutex> lock(shard.lock);
+			free = --entry->pins == 0 && entry->clockIndex == DETACHED;
+		}
+		if (free) Free(entry);
+	}
+
+	const uint8_t* ClusterCache::GetData(const Entry* entry) { return entry->data; }
+
+	size_t ClusterCache::GetLength(const Entry* entry) { return entry->length; }
+
+	void ClusterCache::Remove(int64_t key) {
+		Shard& shard = GetShard(key);
+		std::lock_guard<std::mutex> lock(shard.lock);
+
+		auto found = shard.entries.find(key);
+		if (found != shard.entries.end()) Detach(shard, found->second);
+	}
+
+	void ClusterCache::Clear() {
+		for (size_t i = 0; i < _shardCount; i++) {
+			Shard& shard = _shards[i];
+			std::lock_guard<std::mutex> lock(shard.lock);
+			while (!shard.clock.empty()) Detach(shard, shard.clock.back());
+			shard.hand = 0;
+		}
+	}
+
+	void ClusterCache::Detach(Shard& shard, Entry* entry) {
+		Entry* last = shard.clock.back();
+		shard.clock[entry->clockIndex] = last;
+		last->clockIndex = entry->clockIndex;
+		shard.clock.pop_back();
+
+		shard.entries.erase(entry->key);
+		shard.bytes -= entry->length;
+
+		entry->clockIndex = DETACHED;
+		if (entry->pins == 0) Free(entry);
+	}
+
+	void ClusterCache::Free(Entry* entry) {
+		BufferPool::Free(entry->data, entry->length);
+		delete entry;
+	}
+
+	ClusterCacheStats ClusterCache::GetStats() const {
+		ClusterCacheStats stats = {};
+		for (size_t i = 0; i < _shardCount; i++) {
+			Shard& shard = _shards[i];
+			std::lock_guard<std::mutex> lock(shard.lock);
+			stats.hits += shard.hits;
+			stats.misses += shard.misses;
+			stats.evictions += shard.evictions;
+			stats.entries += shard.entries.size();
+			stats.bytes += shard.bytes;
+		}
+		return stats;
+	}
+
+	ClusterCache* ClusterCache_Construct(size_t capacityBytes, size_t shardCount) {
+		return new ClusterCache(capacityBytes, shardCount);
+	}
+
+	void ClusterCache_Destruct(ClusterCache* p) { delete p; }
+
+	bool ClusterCache_Put(ClusterCache* p, int64_t key, const uint8_t* data, size_t length) { return p->Put(key, data, length); }
+
+	ClusterCache::Entry* ClusterCache_Acquire(ClusterCache* p, int64_t key, const uint8_t** data, size_t* length) {
+		ClusterCache::Entry* entry = p->Acquire(key);
+		if (entry != nullptr) {
+			*data = ClusterCache::GetData(entry);
+			*length = ClusterCache::GetLength(entry);
+		}
+		return entry;
+	}
+
+	void ClusterCache_Release(ClusterCache* p, ClusterCache::Entry* entry) { p->Release(entry); }
+
+	void ClusterCache_Remove(ClusterCache* p, int64_t key) { p->Remove(key); }
+
+	void ClusterCache_Clear(ClusterCache* p) { p->Clear(); }
+
+	void ClusterCache_GetStats(const ClusterCache* p, ClusterCacheStats* stats) { *stats = p->GetStats(); }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ReedSolomon {
+
+	struct ClusterCacheStats {
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		uint64_t entries;
+		uint64_t bytes;
+	};
+
+	// A byte-budgeted cache of cluster images, keyed by an arbitrary 64-bit key (the managed side uses the cluster's byte address).
+	//
+	// The keys are spread over independently locked shards, each with its own share of the budget, so lookups from several threads
+	// rarely contend.  Each shard evicts with CLOCK: a hit sets the entry's reference bit, and the hand clears reference bits until it
+	// finds an entry without one.  Acquire pins an entry and hands out its buffer, which stays valid until the matching Release even
+	// if the entry is replaced, removed or evicted in the meantime.  Pinned entries are skipped by the hand.
+	class ClusterCache {
+
+	public:
+
+		struct Entry;
+
+		ClusterCache(size_t capacityBytes, size_t shardCount);
+		~ClusterCache();
+
+		// Copies an image into the cache, replacing any entry with the same key.  An image that does not fit in a shard's budget, or
+		// that cannot be made to fit because everything else is pinned, is not cached and false is returned; the old entry is still
+		// removed, so the cache never returns an image older than the last one offered.
+		bool Put(int64_t key, const uint8_t* data, size_t length);
+
+		// Pins the entry for a key, or returns nullptr if there is none
+		Entry* Acquire(int64_t key);
+		void Release(Entry* entry);
+
+		static const uint8_t* GetData(const Entry* entry);
+		static size_t GetLength(const Entry* entry);
+
+		void Remove(int64_t key);
+		void Clear();
+
+		ClusterCacheStats GetStats() const;
+
+	private:
+
+		struct Shard {
+			std::mutex lock;
+			std::unordered_map<int64_t, Entry*> entries;
+			std::vector<Entry*> clock;
+			size_t hand;
+			size_t bytes;
+			uint64_t hits;
+			uint64_t misses;
+			uint64_t evictions;
+		};
+
+		inline Shard& GetShard(int64_t key) const {
+			return _shards[(size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ull) >> 32) % _shardCount];
+		}
+
+		// Takes an entry out of its shard and frees it, or leaves it to the last Release if it is pinned.  The shard must be locked.
+		static void Detach(Shard& shard, Entry* entry);
+		static void Free(Entry* entry);
+
+		bool MakeRoom(Shard& shard, size_t length);
+
+		size_t _shardCapacity;
+		size_t _shardCount;
+		Shard* _shards;
+	};
+
+	extern "C" {
+		__declspec(dllexport) ClusterCache* ClusterCache_Construct(size_t capacityBytes, size_t shardCount);
+		__declspec(dllexport) void ClusterCache_Destruct(ClusterCache* p);
+		__declspec(dllexport) bool ClusterCache_Put(ClusterCache* p, int64_t key, const uint8_t* data, size_t length);
+		__declspec(dllexport) ClusterCache::Entry* ClusterCache_Acquire(ClusterCache* p, int64_t key, const uint8_t** data, size_t* length);
+		__declspec(dllexport) void ClusterCache_Release(ClusterCache* p, ClusterCache::Entry* entry);
+		__declspec(dllexport) void ClusterCache_Remove(ClusterCache* p, int64_t key);
+		__declspec(dllexport) void ClusterCache_Clear(ClusterCache* p);
+		__declspec(dllexport) void ClusterCache_GetStats(const ClusterCache* p, ClusterCacheStats* stats);
+	}
+}
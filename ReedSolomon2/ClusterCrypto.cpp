@@ -0,0 +1,311 @@
+#include "stdafx.h"
+#include "ClusterCrypto.h"
+#include "Crc32c.h"
+#include <algorithm>
+#include <stdexcept>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace ReedSolomon {
+
+	// Decrypt checks and extends a checksum over this much ciphertext at a time, so the decrypt reads it from cache
+	static const size_t CHECKSUM_CHUNK_BYTES = 4096;
+
+	static bool HasAes() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 25)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) != 0;
+#endif
+	}
+
+	static const bool AES_SUPPORTED = HasAes();
+
+	// The even round keys of AES-256 come from the previous even key and the rotated, substituted last word of the odd key
+	static inline __m128i NextEvenKey(__m128i key, __m128i assist) {
+		assist = _mm_shuffle_epi32(assist, 0xFF);
+		key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+		key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+		key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+		return _mm_xor_si128(key, assist);
+	}
+
+	// The odd round keys come from the previous odd key and the substituted, unrotated last word of the even key
+	static inline __m128i NextOddKey(__m128i key, __m128i evenKey) {
+		__m128i assist = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(evenKey, 0), 0xAA);
+		key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+		key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+		key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+		return _mm_xor_si128(key, assist);
+	}
+
+	static inline __m128i EncryptBlock(const __m128i* keys, __m128i block) {
+		block = _mm_xor_si128(block, keys[0]);
+		for (size_t r = 1; r < 14; r++) block = _mm_aesenc_si128(block, keys[r]);
+		return _mm_aesenclast_si128(block, keys[14]);
+	}
+
+	ClusterCrypto::ClusterCrypto(size_t capacity) :
+		_capacity(std::max(capacity, (size_t)1)),
+		_hits(0),
+		_misses(0),
+		_evictions(0) {
+	}
+
+	ClusterCrypto::~ClusterCrypto() {
+	}
+
+	bool ClusterCrypto::IsSupported() {
+		return AES_SUPPORTED;
+	}
+
+	void ClusterCrypto::ExpandKey(const uint8_t* key, KeySchedule& schedule) {
+		__m128i* k = schedule.encrypt;
+		k[0] = _mm_loadu_si128((const __m128i*)key);
+		k[1] = _mm_loadu_si128((const __m128i*)(key + 16));
+
+		// The round constants must be immediates
+		k[2] = NextEvenKey(k[0], _mm_aeskeygenassist_si128(k[1], 0x01));
+		k[3] = NextOddKey(k[1], k[2]);
+		k[4] = NextEvenKey(k[2], _mm_aeskeygenassist_si128(k[3], 0x02));
+		k[5] = NextOddKey(k[3], k[4]);
+		k[6] = NextEvenKey(k[4], _mm_aeskeygenassist_si128(k[5], 0x04));
+		k[7] = NextOddKey(k[5], k[6]);
+		k[8] = NextEvenKey(k[6], _mm_aeskeygenassist_si128(k[7], 0x08));
+		k[9] = NextOddKey(k[7], k[8]);
+		k[10] = NextEvenKey(k[8], _mm_aeskeygenassist_si128(k[9], 0x10));
+		k[11] = NextOddKey(k[9], k[10]);
+		k[12] = NextEvenKey(k[10], _mm_aeskeygenassist_si128(k[11], 0x20));
+		k[13] = NextOddKey(k[11], k[12]);
+		k[14] = NextEvenKey(k[12], _mm_aeskeygenassist_si128(k[13], 0x40));
+
+		// The equivalent inverse cipher runs the round keys backwards, with InvMixColumns applied to all but the outer two
+		schedule.decrypt[0] = k[ROUNDS];
+		for (size_t r = 1; r < ROUNDS; r++) schedule.decrypt[r] = _mm_aesimc_si128(k[ROUNDS - r]);
+		schedule.decrypt[ROUNDS] = k[0];
+	}
+
+	void ClusterCrypto::AddKey(const uint8_t* id, size_t idLength, const uint8_t* key) {
+		if (!AES_SUPPORTED) return;
+
+		std::shared_ptr<KeySchedule> schedule = std::make_shared<KeySchedule>();
+		ExpandKey(key, *schedule);
+
+		std::string name((const char*)id, idLength);
+		std::lock_guard<std::mutex> lock(_lock);
+
+		auto found = _entries.find(name);
+		if (found != _entries.end()) {
+			found->second.schedule = schedule;
+			_recent.splice(_recent.begin(), _recent, found->second.recent);
+			return;
+		}
+
+		while (_entries.size() >= _capacity) {
+			_entries.erase(_recent.back());
+			_recent.pop_back();
+			_evictions++;
+		}
+
+		_recent.push_front(name);
+		Entry entry;
+		entry.schedule = schedule;
+		entry.recent = _recent.begin();
+		_entries.emplace(name, entry);
+	}
+
+	bool ClusterCrypto::HasKey(const uint8_t* id, size_t idLength) {
+		return Find(id, idLength) != nullptr;
+	}
+
+	std::shared_ptr<ClusterCrypto::KeySchedule> ClusterCrypto::Find(const uint8_t* id, size_t idLength) {
+		std::string name((const char*)id, idLength);
+		std::lock_guard<std::mutex> lock(_lock);
+
+		auto found = _entries.find(name);
+		if (found == _entries.end()) {
+			_misses++;
+			return nullptr;
+		}
+
+		_hits++;
+		_recent.splice(_recent.begin(), _recent, found->second.recent);
+		return found->second.schedule;
+	}
+
+	void ClusterCrypto::EncryptChain(const KeySchedule& schedule, const uint8_t* iv, const uint8_t* source, uint8_t* dest, size_t blocks) {
+		__m128i chain = _mm_loadu_si128((const __m128i*)iv);
+		for (size_t b = 0; b < blocks; b++) {
+			chain = EncryptBlock(schedule.encrypt, _mm_xor_si128(chain, _mm_loadu_si128((const __m128i*)source + b)));
+			_mm_storeu_si128((__m128i*)dest + b, chain);
+		}
+	}
+
+	void ClusterCrypto::EncryptLanes(const KeySchedule& schedule, size_t lanes, const uint8_t* const* ivs, const uint8_t* const* sources,
+		uint8_t* const* dests, size_t blocks) {
+
+		__m128i chain[MAX_LANES];
+		for (size_t l = 0; l < lanes; l++) chain[l] = _mm_loadu_si128((const __m128i*)ivs[l]);
+
+		// Each round is applied to every lane before the next, so the lanes' AES instructions overlap in the pipeline
+		for (size_t b = 0; b < blocks; b++) {
+			for (size_t l = 0; l < lanes; l++) {
+				__m128i block = _mm_xor_si128(chain[l], _mm_loadu_si128((const __m128i*)sources[l] + b));
+				chain[l] = _mm_xor_si128(block, schedule.encrypt[0]);
+			}
+			for (size_t r = 1; r < ROUNDS; r++) {
+				for (size_t l = 0; l < lanes; l++) chain[l] = _mm_aesenc_si128(chain[l], schedule.encrypt[r]);
+			}
+			for (size_t l = 0; l < lanes; l++) {
+				chain[l] = _mm_aesenclast_si128(chain[l], schedule.encrypt[ROUNDS]);
+				_mm_storeu_si128((__m128i*)dests[l] + b, chain[l]);
+			}
+		}
+	}
+
+	void ClusterCrypto::DecryptBlocks(const KeySchedule& schedule, __m128i& previous, const uint8_t* source, uint8_t* dest, size_t blocks) {
+		const __m128i* k = schedule.decrypt;
+		const __m128i* in = (const __m128i*)source;
+		__m128i* out = (__m128i*)dest;
+
+		size_t b = 0;
+		for (; b + 8 <= blocks; b += 8) {
+			// The ciphertext is loaded before anything is stored, so dest may be source
+			__m128i c0 = _mm_loadu_si128(in + b), c1 = _mm_loadu_si128(in + b + 1);
+			__m128i c2 = _mm_loadu_si128(in + b + 2), c3 = _mm_loadu_si128(in + b + 3);
+			__m128i c4 = _mm_loadu_si128(in + b + 4), c5 = _mm_loadu_si128(in + b + 5);
+			__m128i c6 = _mm_loadu_si128(in + b + 6), c7 = _mm_loadu_si128(in + b + 7);
+
+			__m128i x0 = _mm_xor_si128(c0, k[0]), x1 = _mm_xor_si128(c1, k[0]);
+			__m128i x2 = _mm_xor_si128(c2, k[0]), x3 = _mm_xor_si128(c3, k[0]);
+			__m128i x4 = _mm_xor_si128(c4, k[0]), x5 = _mm_xor_si128(c5, k[0]);
+			__m128i x6 = _mm_xor_si128(c6, k[0]), x7 = _mm_xor_si128(c7, k[0]);
+
+			for (size_t r = 1; r < ROUNDS; r++) {
+				x0 = _mm_aesdec_si128(x0, k[r]);
+				x1 = _mm_aesdec_si128(x1, k[r]);
+				x2 = _mm_aesdec_si128(x2, k[r]);
+				x3 = _mm_aesdec_si128(x3, k[r]);
+				x4 = _mm_aesdec_si128(x4, k[r]);
+				x5 = _mm_aesdec_si128(x5, k[r]);
+				x6 = _mm_aesdec_si128(x6, k[r]);
+				x7 = _mm_aesdec_si128(x7, k[r]);
+			}
+
+			_mm_storeu_si128(out + b, _mm_xor_si128(_mm_aesdeclast_si128(x0, k[ROUNDS]), previous));
+			_mm_storeu_si128(out + b + 1, _mm_xor_si128(_mm_aesdeclast_si128(x1, k[ROUNDS]), c0));
+			_mm_storeu_si128(out + b + 2, _mm_xor_si128(_mm_aesdeclast_si128(x2, k[ROUNDS]), c1));
+			_mm_storeu_si128(out + b + 3, _mm_xor_si128(_mm_aesdeclast_si128(x3, k[ROUNDS]), c2));
+			_mm_storeu_si128(out + b + 4, _mm_xor_si128(_mm_aesdeclast_si128(x4, k[ROUNDS]), c3));
+			_mm_storeu_si128(out + b + 5, _mm_xor_si128(_mm_aesdeclast_si128(x5, k[ROUNDS]), c4));
+			_mm_storeu_si128(out + b + 6, _mm_xor_si128(_mm_aesdeclast_si128(x6, k[ROUNDS]), c5));
+			_mm_storeu_si128(out + b + 7, _mm_xor_si128(_mm_aesdeclast_si128(x7, k[ROUNDS]), c6));
+			previous = c7;
+		}
+
+		for (; b < blocks; b++) {
+			__m128i c = _mm_loadu_si128(in + b);
+			__m128i x = _mm_xor_si128(c, k[0]);
+			for (size_t r = 1; r < ROUNDS; r++) x = _mm_aesdec_si128(x, k[r]);
+			_mm_storeu_si128(out + b, _mm_xor_si128(_mm_aesdeclast_si128(x, k[ROUNDS]), previous));
+			previous = c;
+		}
+	}
+
+	bool ClusterCrypto::Encrypt(const uint8_t* id, size_t idLength, const uint8_t* iv, const uint8_t* source, uint8_t* dest, size_t length) {
+		if (length % BLOCK_BYTES != 0) throw std::invalid_argument("The length must be a whole number of blocks");
+		if (!AES_SUPPORTED) return false;
+
+		std::shared_ptr<KeySchedule> schedule = Find(id, idLength);
+		if (schedule == nullptr) return false;
+
+		EncryptChain(*schedule, iv, source, dest, length / BLOCK_BYTES);
+		return true;
+	}
+
+	bool ClusterCrypto::EncryptMany(const uint8_t* id, size_t idLength, size_t count, const uint8_t* const* ivs, const uint8_t* const* sources,
+		uint8_t* const* dests, size_t length) {
+
+		if (length % BLOCK_BYTES != 0) throw std::invalid_argument("The length must be a whole number of blocks");
+		if (!AES_SUPPORTED) return false;
+
+		std::shared_ptr<KeySchedule> schedule = Find(id, idLength);
+		if (schedule == nullptr) return false;
+
+		for (size_t i = 0; i < count; i += MAX_LANES) {
+			size_t lanes = std::min(MAX_LANES, count - i);
+			if (lanes == 1) EncryptChain(*schedule, ivs[i], sources[i], dests[i], length / BLOCK_BYTES);
+			else EncryptLanes(*schedule, lanes, ivs + i, sources + i, dests + i, length / BLOCK_BYTES);
+		}
+		return true;
+	}
+
+	bool ClusterCrypto::Decrypt(const uint8_t* id, size_t idLength, const uint8_t* iv, const uint8_t* source, uint8_t* dest, size_t length,
+		uint32_t* checksum) {
+
+		if (length % BLOCK_BYTES != 0) throw std::invalid_argument("The length must be a whole number of blocks");
+		if (!AES_SUPPORTED) return false;
+
+		std::shared_ptr<KeySchedule> schedule = Find(id, idLength);
+		if (schedule == nullptr) return false;
+
+		__m128i previous = _mm_loadu_si128((const __m128i*)iv);
+		if (checksum == nullptr) {
+			DecryptBlocks(*schedule, previous, source, dest, length / BLOCK_BYTES);
+			return true;
+		}
+
+		// The checksum goes first within each chunk, since dest may be source
+		for (size_t done = 0; done < length; done += CHECKSUM_CHUNK_BYTES) {
+			size_t chunk = std::min(CHECKSUM_CHUNK_BYTES, length - done);
+			*checksum = Crc32cUpdate(*checksum, source + done, chunk);
+			DecryptBlocks(*schedule, previous, source + done, dest + done, chunk / BLOCK_BYTES);
+		}
+		return true;
+	}
+
+	ClusterCryptoStats ClusterCrypto::GetStats() const {
+		std::lock_guard<std::mutex> lock(_lock);
+
+		ClusterCryptoStats stats;
+		stats.hits = _hits;
+		stats.misses = _misses;
+		stats.evictions = _evictions;
+		stats.entries = _entries.size();
+		return stats;
+	}
+
+	ClusterCrypto* ClusterCrypto_Construct(size_t capacity) { return new ClusterCrypto(capacity); }
+
+	void ClusterCrypto_Destruct(ClusterCrypto* p) { delete p; }
+
+	bool ClusterCrypto_IsSupported() { return ClusterCrypto::IsSupported(); }
+
+	void ClusterCrypto_AddKey(ClusterCrypto* p, const uint8_t* id, size_t idLength, const uint8_t* key) { p->AddKey(id, idLength, key); }
+
+	bool ClusterCrypto_HasKey(ClusterCrypto* p, const uint8_t* id, size_t idLength) { return p->HasKey(id, idLength); }
+
+	bool ClusterCrypto_Encrypt(ClusterCrypto* p, const uint8_t* id, size_t idLength, const uint8_t* iv, const uint8_t* source, uint8_t* dest,
+		size_t length) {
+		return p->Encrypt(id, idLength, iv, source, dest, length);
+	}
+
+	bool ClusterCrypto_EncryptMany(ClusterCrypto* p, const uint8_t* id, size_t idLength, size_t count, const uint8_t* const* ivs,
+		const uint8_t* const* sources, uint8_t* const* dests, size_t length) {
+		return p->EncryptMany(id, idLength, count, ivs, sources, dests, length);
+	}
+
+	bool ClusterCrypto_Decrypt(ClusterCrypto* p, const uint8_t* id, size_t idLength, const uint8_t* iv, const uint8_t* source, uint8_t* dest,
+		size_t length, uint32_t* checksum) {
+		return p->Decrypt(id, idLength, iv, source, dest, length, checksum);
+	}
+
+	void ClusterCrypto_GetStats(const ClusterCrypto* p, ClusterCryptoStats* stats) { *stats = p->GetStats(); }
+}
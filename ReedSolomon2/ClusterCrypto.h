@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <immintrin.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ReedSolomon {
+
+	struct ClusterCryptoStats {
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		uint64_t entries;
+	};
+
+	// AES-256-CBC for cluster contents with AES-NI, and a cache of derived keys with their expanded key schedules.
+	//
+	// Keys are derived by the caller (the managed side runs ECDH through CNG) and cached under an id of the caller's choosing,
+	// which for clusters is the thumbprint of the volume key followed by the ephemeral public key stored in the cluster.  Since
+	// both ends of ECDH derive the same key, a key added when a cluster is encrypted also serves when it is read back.  The least
+	// recently used key is evicted when the cache is full.  Every call that needs a key returns false if it is not cached, so the
+	// caller derives it, adds it and tries again.
+	//
+	// CBC decryption has no chain between blocks, so it runs eight blocks at a time to keep the AES units busy.  Encryption is
+	// serial within a buffer, so EncryptMany runs up to eight buffers side by side instead.  Decrypt can also extend a CRC-32C over
+	// the ciphertext as it goes, a page at a time while the page is in cache, so a checksum-only read passes over the bytes once.
+	class ClusterCrypto {
+
+	public:
+
+		static const size_t KEY_BYTES = 32;
+		static const size_t BLOCK_BYTES = 16;
+		static const size_t MAX_LANES = 8;
+
+		ClusterCrypto(size_t capacity);
+		~ClusterCrypto();
+
+		ClusterCrypto(const ClusterCrypto&) = delete;
+		ClusterCrypto& operator=(const ClusterCrypto&) = delete;
+
+		// Whether the processor has AES-NI.  Without it every call that encrypts or decrypts returns false.
+		static bool IsSupported();
+
+		void AddKey(const uint8_t* id, size_t idLength, const uint8_t* key);
+		bool HasKey(const uint8_t* id, size_t idLength);
+
+		// The length must be a multiple of BLOCK_BYTES.  Source and dest may be the same buffer.
+		bool Encrypt(const uint8_t* id, size_t idLength, const uint8_t* iv, const uint8_t* source, uint8_t* dest, size_t length);
+
+		// Encrypts count buffers of the same length under the same key, each with its own IV
+		bool EncryptMany(const uint8_t* id, size_t idLength, size_t count, const uint8_t* const* ivs, const uint8_t* const* sources,
+			uint8_t* const* dests, size_t length);
+
+		// If checksum is not null, it is a CRC-32C as returned by Crc32c and is extended over the ciphertext
+		bool Decrypt(const uint8_t* id, size_t idLength, const uint8_t* iv, const uint8_t* source, uint8_t* dest, size_t length,
+			uint32_t* checksum);
+
+		ClusterCryptoStats GetStats() const;
+
+	private:
+
+		static const size_t ROUNDS = 14;
+
+		struct KeySchedule {
+			__m128i encrypt[ROUNDS + 1];
+			__m128i decrypt[ROUNDS + 1];
+		};
+
+		struct Entry {
+			std::shared_ptr<KeySchedule> schedule;
+			std::list<std::string>::iterator recent;
+		};
+
+		std::shared_ptr<KeySchedule> Find(const uint8_t* id, size_t idLength);
+
+		static void ExpandKey(const uint8_t* key, KeySchedule& schedule);
+		static void EncryptChain(const KeySchedule& schedule, const uint8_t* iv, const uint8_t* source, uint8_t* dest, size_t blocks);
+		static void EncryptLanes(const KeySchedule& schedule, size_t lanes, const uint8_t* const* ivs, const uint8_t* const* sources,
+			uint8_t* const* dests, size_t blocks);
+		static void DecryptBlocks(const KeySchedule& schedule, __m128i& previous, const uint8_t* source, uint8_t* dest, size_t blocks);
+
+		size_t _capacity;
+
+		mutable std::mutex _lock;
+		std::unordered_map<std::string, Entry> _entries;
+		// Most recently used first
+		std::list<std::string> _recent;
+		uint64_t _hits;
+		uint64_t _misses;
+		uint64_t _evictions;
+	};
+
+	extern "C" {
+		__declspec(dllexport) ClusterCrypto* ClusterCrypto_Construct(size_t capacity);
+		__declspec(dllexport) void ClusterCrypto_Destruct(ClusterCrypto* p);
+		__declspec(dllexport) bool ClusterCrypto_IsSupported();
+		__declspec(dllexport) void ClusterCrypto_AddKey(ClusterCrypto* p, const uint8_t* id, size_t idLength, const uint8_t* key);
+		__declspec(dllexport) bool ClusterCrypto_HasKey(ClusterCrypto* p, const uint8_t* id, size_t idLength);
+		__declspec(dllexport) bool ClusterCrypto_Encrypt(ClusterCrypto* p, const uint8_t* id, size_t idLength, const uint8_t* iv,
+			const uint8_t* source, uint8_t* dest, size_t length);
+		__declspec(dllexport) bool ClusterCrypto_EncryptMany(ClusterCrypto* p, const uint8_t* id, size_t idLength, size_t count,
+			const uint8_t* const* ivs, const uint8_t* const* sources, uint8_t* const* dests, size_t length);
+		__declspec(dllexport) bool ClusterCrypto_Decrypt(ClusterCrypto* p, const uint8_t* id, size_t idLength, const uint8_t* iv,
+			const uint8_t* source, uint8_t* dest, size_t length, uint32_t* checksum);
+		__declspec(dllexport) void ClusterCrypto_GetStats(const ClusterCrypto* p, ClusterCryptoStats* stats);
+	}
+}
@@ -0,0 +1,311 @@
+#include "stdafx.h"
+#include "CodecRing.h"
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ReedSolomon {
+
+	static const size_t SLOT_ALIGNMENT = 4096;
+
+	static inline size_t RoundUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+#ifdef _WIN32
+	static uint32_t CurrentProcessId() { return (uint32_t)::GetCurrentProcessId(); }
+	static std::string GetMappingName(const std::string& name) { return "Local\\" + name; }
+#else
+	static uint32_t CurrentProcessId() { return (uint32_t)getpid(); }
+	static std::string GetMappingName(const std::string& name) { return name.empty() || name[0] != '/' ? "/" + name : name; }
+#endif
+
+	CodecRing::CodecRing(const std::string& name, uint8_t* memory, size_t size, bool isOwner, intptr_t handle) :
+		_name(name),
+		_memory(memory),
+		_size(size),
+		_isOwner(isOwner),
+		_handle(handle) {
+	}
+
+	CodecRing* CodecRing::Create(const std::string& name, size_t slotCount, size_t slotBytes, size_t maxClients) {
+		if (slotCount == 0 || slotCount >= NO_SLOT || slotBytes == 0 || maxClients == 0 || maxClients > 0xFFFF) {
+			throw std::invalid_argument("Invalid codec ring size");
+		}
+
+		size_t slotStride = RoundUp(sizeof(CodecSlotHeader) + slotBytes, SLOT_ALIGNMENT);
+		size_t slotsOffset = RoundUp(sizeof(CodecRingHeader) + maxClients * sizeof(CodecClientQueue), SLOT_ALIGNMENT);
+		size_t size = slotsOffset + slotCount * slotStride;
+
+		std::string mappingName = GetMappingName(name);
+#ifdef _WIN32
+		HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size,
+			mappingName.c_str());
+		if (mapping == nullptr) throw std::runtime_error("Cannot create codec ring " + name);
+		if (GetLastError() == ERROR_ALREADY_EXISTS) {
+			CloseHandle(mapping);
+			throw std::runtime_error("Codec ring " + name + " is in use");
+		}
+		uint8_t* memory = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (memory == nullptr) {
+			CloseHandle(mapping);
+			throw std::runtime_error("Cannot map codec ring " + name);
+		}
+		intptr_t handle = (intptr_t)mapping;
+#else
+		shm_unlink(mappingName.c_str());
+		int fd = shm_open(mappingName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0) throw std::runtime_error("Cannot create codec ring " + name);
+		if (ftruncate(fd, (off_t)size) != 0) {
+			close(fd);
+			shm_unlink(mappingName.c_str());
+			throw std::runtime_error("Cannot size codec ring " + name);
+		}
+		void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) {
+			shm_unlink(mappingName.c_str());
+			throw std::runtime_error("Cannot map codec ring " + name);
+		}
+		uint8_t* memory = (uint8_t*)p;
+		intptr_t handle = -1;
+#endif
+
+		// The memory is zero, which is an empty queue for every client
+		CodecRingHeader* header = new (memory) CodecRingHeader();
+		header->slotCount = (uint32_t)slotCount;
+		header->maxClients = (uint32_t)maxClients;
+		header->slotBytes = slotBytes;
+		header->slotStride = slotStride;
+		header->slotsOffset = slotsOffset;
+		header->workerCount = 0;
+		header->running = 0;
+		header->freeHead = NO_SLOT;
+
+		CodecRing* ring = new CodecRing(mappingName, memory, size, true, handle);
+		for (size_t i = 0; i < maxClients; i++) new (ring->GetQueue(i)) CodecClientQueue();
+		for (size_t i = slotCount; i-- > 0;) {
+			new (ring->GetSlot(i)) CodecSlotHeader();
+			ring->PushFree((uint32_t)i);
+		}
+
+		// Clients check the magic last, so they never see a ring that is half made
+		header->version = CodecRingHeader::VERSION;
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = CodecRingHeader::MAGIC;
+		return ring;
+	}
+
+	CodecRing* CodecRing::Open(const std::string& name) {
+		std::string mappingName = GetMappingName(name);
+#ifdef _WIN32
+		HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mappingName.c_str());
+		if (mapping == nullptr) throw std::runtime_error("No codec service " + name);
+		uint8_t* memory = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+		if (memory == nullptr) {
+			CloseHandle(mapping);
+			throw std::runtime_error("Cannot map codec ring " + name);
+		}
+		MEMORY_BASIC_INFORMATION info;
+		VirtualQuery(memory, &info, sizeof(info));
+		size_t size = info.RegionSize;
+		intptr_t handle = (intptr_t)mapping;
+#else
+		int fd = shm_open(mappingName.c_str(), O_RDWR, 0);
+		if (fd < 0) throw std::runtime_error("No codec service " + name);
+		struct stat status;
+		if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(CodecRingHeader)) {
+			close(fd);
+			throw std::runtime_error("Invalid codec ring " + name);
+		}
+		size_t size = (size_t)status.st_size;
+		void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) throw std::runtime_error("Cannot map codec ring " + name);
+		uint8_t* memory = (uint8_t*)p;
+		intptr_t handle = -1;
+#endif
+
+		CodecRing* ring = new CodecRing(mappingName, memory, size, false, handle);
+		CodecRingHeader* header = ring->GetHeader();
+		bool isValid = header->magic == CodecRingHeader::MAGIC && header->version == CodecRingHeader::VERSION &&
+			header->slotsOffset + (uint64_t)header->slotCount * header->slotStride <= size;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (!isValid || header->running.load() == 0) {
+			delete ring;
+			throw std::runtime_error("Codec service " + name + " is not running");
+		}
+		return ring;
+	}
+
+	CodecRing::~CodecRing() {
+#ifdef _WIN32
+		UnmapViewOfFile(_memory);
+		CloseHandle((HANDLE)_handle);
+#else
+		munmap(_memory, _size);
+		if (_isOwner) shm_unlink(_name.c_str());
+#endif
+	}
+
+	uint32_t CodecRing::PopFree() {
+		CodecRingHeader* header = GetHeader();
+		uint64_t head = header->freeHead.load(std::memory_order_acquire);
+		while (true) {
+			uint32_t slot = (uint32_t)head;
+			if (slot == NO_SLOT) return NO_SLOT;
+			// The next link may be stale if the slot was popped and pushed meanwhile, but then the tag has moved and the exchange fails
+			uint64_t next = (head & 0xFFFFFFFF00000000ull) | GetSlot(slot)->next.load(std::memory_order_relaxed);
+			if (header->freeHead.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire)) return slot;
+		}
+	}
+
+	void CodecRing::PushFree(uint32_t slot) {
+		CodecRingHeader* header = GetHeader();
+		CodecSlotHeader* s = GetSlot(slot);
+		s->state.store(CODEC_SLOT_FREE, std::memory_order_relaxed);
+		uint64_t head = header->freeHead.load(std::memory_order_relaxed);
+		while (true) {
+			s->next.store((uint32_t)head, std::memory_order_relaxed);
+			uint64_t pushed = ((head >> 32) + 1) << 32 | slot;
+			if (header->freeHead.compare_exchange_weak(head, pushed, std::memory_order_release, std::memory_order_relaxed)) return;
+		}
+	}
+
+	size_t CodecRing::GetJobBytes(size_t nData, size_t nParity, size_t bytesPerSlice, size_t errorCount) {
+		return (nData + nParity) * bytesPerSlice + errorCount * sizeof(int32_t);
+	}
+
+	bool CodecRing::IsAttached(uint32_t client) const {
+		CodecClientQueue* queue = GetQueue(client & 0xFFFF);
+		return queue->attached.load() == CODEC_QUEUE_ATTACHED && (queue->generation.load(std::memory_order_relaxed) & 0xFFFF) == client >> 16;
+	}
+
+	bool CodecRing::Reclaim(uint32_t slot, CodecSlotState state) {
+		// The slot is marked free before it is pushed, so a worker and the search for exited clients never both push it
+		uint32_t expected = state;
+		if (!GetSlot(slot)->state.compare_exchange_strong(expected, CODEC_SLOT_FREE)) return false;
+		PushFree(slot);
+		return true;
+	}
+
+	void CodecBackoff::Wait() {
+		if (_count < 64) {
+			_count++;
+			return;
+		}
+		if (_count < 128) {
+			_count++;
+			std::this_thread::yield();
+			return;
+		}
+		unsigned shift = std::min(_count - 128, 5u);
+		if (shift < 5) _count++;
+		std::this_thread::sleep_for(std::chrono::microseconds(3 << shift));
+	}
+
+	CodecClient::CodecClient(const std::string& name) : _ring(CodecRing::Open(name)), _client(CodecRing::NO_SLOT) {
+		CodecRingHeader* header = _ring->GetHeader();
+		for (uint32_t i = 0; i < header->maxClients; i++) {
+			uint32_t detached = CODEC_QUEUE_DETACHED;
+			CodecClientQueue* queue = _ring->GetQueue(i);
+			if (queue->attached.compare_exchange_strong(detached, CODEC_QUEUE_ATTACHING)) {
+				queue->processId = CurrentProcessId();
+				_client = (queue->generation.fetch_add(1) + 1) << 16 | i;
+				queue->attached.store(CODEC_QUEUE_ATTACHED);
+				return;
+			}
+		}
+		delete _ring;
+		throw std::runtime_error("No free queue in codec service " + name);
+	}
+
+	CodecClient::~CodecClient() {
+		// Jobs still queued are run and their slots freed by the service once it sees the queue is detached
+		_ring->GetQueue(_client & 0xFFFF)->attached.store(CODEC_QUEUE_DETACHED);
+		delete _ring;
+	}
+
+	uint8_t* CodecClient::Acquire(uint32_t& slot) {
+		CodecBackoff backoff;
+		while ((slot = _ring->PopFree()) == CodecRing::NO_SLOT) backoff.Wait();
+
+		CodecSlotHeader* s = _ring->GetSlot(slot);
+		s->client = _client;
+		s->state.store(CODEC_SLOT_OWNED, std::memory_order_release);
+		return _ring->GetPayload(slot);
+	}
+
+	void CodecClient::Submit(uint32_t slot, CodecOperation operation, size_t nData, size_t nParity, size_t bytesPerSlice, size_t errorCount) {
+		if (CodecRing::GetJobBytes(nData, nParity, bytesPerSlice, errorCount) > GetSlotBytes()) {
+			throw std::invalid_argument("Codec job does not fit the slot");
+		}
+
+		CodecSlotHeader* s = _ring->GetSlot(slot);
+		s->operation = operation;
+		s->nData = (uint32_t)nData;
+		s->nParity = (uint32_t)nParity;
+		s->bytesPerSlice = (uint32_t)bytesPerSlice;
+		s->errorCount = (uint32_t)errorCount;
+		s->result = CODEC_OK;
+		s->state.store(CODEC_SLOT_SUBMITTED, std::memory_order_relaxed);
+
+		// One producer per queue, so the head is only contended by the consumer reading it
+		CodecClientQueue* queue = _ring->GetQueue(_client & 0xFFFF);
+		uint32_t head = queue->head.load(std::memory_order_relaxed);
+		CodecBackoff backoff;
+		while (head - queue->tail.load(std::memory_order_acquire) >= CodecClientQueue::CAPACITY) backoff.Wait();
+		queue->entries[head % CodecClientQueue::CAPACITY] = slot;
+		queue->head.store(head + 1, std::memory_order_release);
+	}
+
+	CodecResult CodecClient::Wait(uint32_t slot) const {
+		CodecSlotHeader* s = _ring->GetSlot(slot);
+		CodecBackoff backoff;
+		while (s->state.load(std::memory_order_acquire) != CODEC_SLOT_DONE) {
+			if (_ring->GetHeader()->running.load(std::memory_order_relaxed) == 0) throw std::runtime_error("Codec service stopped");
+			backoff.Wait();
+		}
+		return (CodecResult)s->result;
+	}
+
+	void CodecClient::Release(uint32_t slot) {
+		_ring->PushFree(slot);
+	}
+
+	CodecClient* CodecClient_Construct(const char* name) {
+		try {
+			return new CodecClient(name);
+		} catch (std::exception&) {
+			return nullptr;
+		}
+	}
+
+	void CodecClient_Destruct(CodecClient* p) { delete p; }
+
+	size_t CodecClient_GetSlotBytes(CodecClient* p) { return p->GetSlotBytes(); }
+
+	uint8_t* CodecClient_Acquire(CodecClient* p, uint32_t* slot) { return p->Acquire(*slot); }
+
+	void CodecClient_Submit(CodecClient* p, uint32_t slot, uint32_t operation, size_t nData, size_t nParity, size_t bytesPerSlice,
+		size_t errorCount) {
+		p->Submit(slot, (CodecOperation)operation, nData, nParity, bytesPerSlice, errorCount);
+	}
+
+	int32_t CodecClient_Wait(CodecClient* p, uint32_t slot) {
+		try {
+			return p->Wait(slot);
+		} catch (std::exception&) {
+			return CODEC_INVALID;
+		}
+	}
+
+	void CodecClient_Release(CodecClient* p, uint32_t slot) { p->Release(slot); }
+}
@@ -0,0 +1,217 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+
+namespace ReedSolomon {
+
+	// The operations a codec service runs for its clients.  A job covers one track: nData data slices followed by nParity parity
+	// slices, each bytesPerSlice long, laid end to end at the start of the slot, slice i having exponent nData + nParity - 1 - i.
+	enum CodecOperation : uint32_t {
+		// Writes the parity slices from the data slices
+		CODEC_ENCODE = 1,
+		// Sets the result to CODEC_DAMAGED if any syndrome of the slices is nonzero
+		CODEC_VERIFY = 2,
+		// Rebuilds the erased slices in place from the others.  The erasures follow the slices as errorCount int32 exponents.
+		CODEC_REPAIR = 3
+	};
+
+	enum CodecResult : int32_t {
+		CODEC_OK = 0,
+		CODEC_DAMAGED = 1,
+		// The job did not fit the slot, named an unknown operation or had more erasures than parity slices
+		CODEC_INVALID = -1
+	};
+
+	enum CodecSlotState : uint32_t {
+		CODEC_SLOT_FREE = 0,
+		// Acquired by a client, which is filling it
+		CODEC_SLOT_OWNED,
+		CODEC_SLOT_SUBMITTED,
+		CODEC_SLOT_RUNNING,
+		// Finished; the client reads the result and releases it
+		CODEC_SLOT_DONE
+	};
+
+	// The layout of the shared memory of a codec service.  It is made by CodecService and mapped by each CodecClient, so it holds only
+	// offsets and fixed-size atomics.
+	//
+	// The memory starts with this header, then maxClients client queues, then slotCount slots, each a header and slotBytes of
+	// payload.  Free slots are on a lock-free stack whose head carries a tag against ABA.  Each client has a queue of submitted slot
+	// indices of its own, with one producer, the client, and one consumer at a time, the worker holding the queue's consumer flag.
+	// Workers take one job from a client before moving on to the next, so clients are served in turn however many jobs each has
+	// waiting.  The payload of a slot is where the client writes its slices and reads the results, so nothing is copied.
+	struct CodecRingHeader {
+		static const uint32_t MAGIC = 0x43525352;	// "RSRC"
+		static const uint32_t VERSION = 1;
+
+		uint32_t magic;
+		uint32_t version;
+		uint32_t slotCount;
+		uint32_t maxClients;
+		uint64_t slotBytes;
+		uint64_t slotStride;
+		uint64_t slotsOffset;
+		uint32_t workerCount;
+		std::atomic<uint32_t> running;
+		// The index of the first free slot in the low 32 bits, and a tag bumped by every push in the high 32
+		std::atomic<uint64_t> freeHead;
+	};
+
+	enum CodecQueueState : uint32_t {
+		CODEC_QUEUE_DETACHED = 0,
+		CODEC_QUEUE_ATTACHED,
+		// A client is recording its process, which the service must not check until it is attached
+		CODEC_QUEUE_ATTACHING,
+		// The service is freeing the slots of a client that exited without detaching
+		CODEC_QUEUE_RECLAIMING
+	};
+
+	struct CodecClientQueue {
+		// The most jobs a client can have submitted and not yet taken
+		static const uint32_t CAPACITY = 256;
+
+		// A CodecQueueState
+		std::atomic<uint32_t> attached;
+		// Bumped by every attach, so the slots of an earlier client of the queue are known not to be the current client's
+		std::atomic<uint32_t> generation;
+		uint32_t processId;
+		std::atomic<uint64_t> completedJobs;
+		alignas(64) std::atomic<uint32_t> head;
+		alignas(64) std::atomic<uint32_t> tail;
+		std::atomic<uint32_t> consuming;
+		uint32_t entries[CAPACITY];
+	};
+
+	struct alignas(64) CodecSlotHeader {
+		std::atomic<uint32_t> state;
+		// The next free slot while on the free stack
+		std::atomic<uint32_t> next;
+		// The queue of the client that acquired the slot in the low 16 bits, and the queue's generation then in the high 16
+		uint32_t client;
+		uint32_t operation;
+		uint32_t nData;
+		uint32_t nParity;
+		uint32_t bytesPerSlice;
+		uint32_t errorCount;
+		int32_t result;
+	};
+
+	// A mapping of the shared memory of a codec service, by name.  On Windows the name is that of a file mapping, and elsewhere of a
+	// POSIX shared memory object, with a leading slash added if it has none.
+	class CodecRing {
+
+	public:
+
+		static const uint32_t NO_SLOT = 0xFFFFFFFF;
+
+		// Creates the memory for a service, replacing any left by one that exited without removing it
+		static CodecRing* Create(const std::string& name, size_t slotCount, size_t slotBytes, size_t maxClients);
+		// Maps the memory of a running service.  Throws if there is none.
+		static CodecRing* Open(const std::string& name);
+
+		~CodecRing();
+
+		CodecRing(const CodecRing&) = delete;
+		CodecRing& operator=(const CodecRing&) = delete;
+
+		inline CodecRingHeader* GetHeader() const { return (CodecRingHeader*)_memory; }
+		inline CodecClientQueue* GetQueue(size_t client) const {
+			return (CodecClientQueue*)(_memory + sizeof(CodecRingHeader) + client * sizeof(CodecClientQueue));
+		}
+		inline CodecSlotHeader* GetSlot(size_t slot) const {
+			return (CodecSlotHeader*)(_memory + GetHeader()->slotsOffset + slot * GetHeader()->slotStride);
+		}
+		inline uint8_t* GetPayload(size_t slot) const { return (uint8_t*)GetSlot(slot) + sizeof(CodecSlotHeader); }
+
+		// Pops a free slot, or returns NO_SLOT if there is none
+		uint32_t PopFree();
+		void PushFree(uint32_t slot);
+
+		// The bytes of payload a job needs
+		static size_t GetJobBytes(size_t nData, size_t nParity, size_t bytesPerSlice, size_t errorCount);
+
+		// Whether a client, as recorded in the slots it acquires, is still attached, and so will release them
+		bool IsAttached(uint32_t client) const;
+		inline bool IsOwnerAttached(uint32_t slot) const { return IsAttached(GetSlot(slot)->client); }
+
+		// Frees a slot in this state whose client has gone.  Returns false if the slot has left the state, as when another thread
+		// freed it first.
+		bool Reclaim(uint32_t slot, CodecSlotState state);
+
+	private:
+
+		CodecRing(const std::string& name, uint8_t* memory, size_t size, bool isOwner, intptr_t handle);
+
+		std::string _name;
+		uint8_t* _memory;
+		size_t _size;
+		// The creator removes the memory when it unmaps it
+		bool _isOwner;
+		intptr_t _handle;
+	};
+
+	// The client side of a codec service.  A client holds one queue for as long as it lives, so a process that mounts several volumes
+	// should have a client for each, to be served in turn with the others.
+	//
+	// A job is run by acquiring a slot, writing the slices into its payload, submitting it and waiting for it.  The results are read
+	// from the payload before the slot is released.  The calls for one slot must come from one thread at a time, but a client may
+	// have several slots in flight.
+	class CodecClient {
+
+	public:
+
+		// Attaches to the service with this name.  Throws if it is not running or has no free queue.
+		explicit CodecClient(const std::string& name);
+		~CodecClient();
+
+		CodecClient(const CodecClient&) = delete;
+		CodecClient& operator=(const CodecClient&) = delete;
+
+		inline size_t GetSlotBytes() const { return (size_t)_ring->GetHeader()->slotBytes; }
+		inline size_t GetSlotCount() const { return _ring->GetHeader()->slotCount; }
+		inline size_t GetWorkerCount() const { return _ring->GetHeader()->workerCount; }
+
+		// Waits for a free slot and returns its payload, which is 64-byte aligned
+		uint8_t* Acquire(uint32_t& slot);
+
+		// Queues the job in a slot.  Throws if the job does not fit the slot.
+		void Submit(uint32_t slot, CodecOperation operation, size_t nData, size_t nParity, size_t bytesPerSlice, size_t errorCount);
+
+		// Waits for the job in a slot to finish and returns its result.  The slot stays acquired.
+		CodecResult Wait(uint32_t slot) const;
+
+		void Release(uint32_t slot);
+
+	private:
+
+		CodecRing* _ring;
+		uint32_t _client;
+	};
+
+	// Waits for a condition set by another process, spinning briefly, then yielding, then sleeping for longer and longer up to a
+	// tenth of a millisecond, so an idle waiter costs little and a busy one reacts quickly
+	class CodecBackoff {
+
+	public:
+
+		void Wait();
+		inline void Reset() { _count = 0; }
+
+	private:
+
+		unsigned _count = 0;
+	};
+
+	extern "C" {
+		__declspec(dllexport) CodecClient* CodecClient_Construct(const char* name);
+		__declspec(dllexport) void CodecClient_Destruct(CodecClient* p);
+		__declspec(dllexport) size_t CodecClient_GetSlotBytes(CodecClient* p);
+		__declspec(dllexport) uint8_t* CodecClient_Acquire(CodecClient* p, uint32_t* slot);
+		__declspec(dllexport) void CodecClient_Submit(CodecClient* p, uint32_t slot, uint32_t operation, size_t nData, size_t nParity,
+			size_t bytesPerSlice, size_t errorCount);
+		__declspec(dllexport) int32_t CodecClient_Wait(CodecClient* p, uint32_t slot);
+		__declspec(dllexport) void CodecClient_Release(CodecClient* p, uint32_t slot);
+	}
+}
@@ -0,0 +1,302 @@
+#include "stdafx.h"
+#include "CodecService.h"
+#include "AdaptiveRepair.h"
+#include "Parity.h"
+#include "Syndrome.h"
+#include <stdexcept>
+#ifndef _WIN32
+#include <cerrno>
+#include <signal.h>
+#endif
+
+namespace ReedSolomon {
+
+	// Idle waits between searches for exited clients
+	static const unsigned RECLAIM_INTERVAL = 4096;
+
+	static bool IsProcessRunning(uint32_t processId) {
+#ifdef _WIN32
+		HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)processId);
+		if (process == nullptr) return GetLastError() != ERROR_INVALID_PARAMETER;
+		bool isRunning = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+		CloseHandle(process);
+		return isRunning;
+#else
+		return kill((pid_t)processId, 0) == 0 || errno != ESRCH;
+#endif
+	}
+
+	CodecService::CodecService(const std::string& name, size_t slotCount, size_t slotBytes, size_t maxClients, unsigned threads) :
+		_ring(CodecRing::Create(name, slotCount, slotBytes, maxClients)), _stopping(false) {
+
+		if (threads == 0) threads = std::thread::hardware_concurrency();
+		if (threads == 0) threads = 1;
+
+		CodecRingHeader* header = _ring->GetHeader();
+		header->workerCount = threads;
+		header->running.store(1);
+		for (unsigned i = 0; i < threads; i++) _workers.emplace_back(&CodecService::Work, this, (size_t)i);
+	}
+
+	CodecService::~CodecService() {
+		Stop();
+		for (auto& geometry : _codecs) {
+			for (Parity* parity : geometry.second.parities) delete parity;
+			for (Syndrome* syndrome : geometry.second.syndromes) delete syndrome;
+		}
+		delete _ring;
+	}
+
+	void CodecService::Stop() {
+		_ring->GetHeader()->running.store(0);
+		_stopping.store(true);
+		for (auto& worker : _workers) {
+			if (worker.joinable()) worker.join();
+		}
+	}
+
+	uint64_t CodecService::GetCompletedJobs(size_t client) const {
+		if (client >= GetMaxClients()) throw std::invalid_argument("Client out of range");
+		return _ring->GetQueue(client)->completedJobs.load(std::memory_order_relaxed);
+	}
+
+	size_t CodecService::GetGeometryCount() const {
+		std::lock_guard<std::mutex> lock(_codecLock);
+		return _codecs.size();
+	}
+
+	void CodecService::Work(size_t worker) {
+		// Workers start at different queues, so that with few jobs waiting they do not all contend for the first
+		size_t cursor = worker % GetMaxClients();
+		CodecBackoff backoff;
+		unsigned idle = 0;
+
+		while (!_stopping.load(std::memory_order_relaxed)) {
+			uint32_t slot;
+			if (TakeJob(cursor, slot)) {
+				RunJob(slot);
+				backoff.Reset();
+				idle = 0;
+				continue;
+			}
+
+			if (++idle % RECLAIM_INTERVAL == 0) ReclaimExitedClients();
+			backoff.Wait();
+		}
+	}
+
+	bool CodecService::TakeJob(size_t& cursor, uint32_t& slot) {
+		size_t maxClients = GetMaxClients();
+		for (size_t n = 0; n < maxClients; n++) {
+			size_t client = (cursor + n) % maxClients;
+			CodecClientQueue* queue = _ring->GetQueue(client);
+			if (queue->head.load(std::memory_order_acquire) == queue->tail.load(std::memory_order_relaxed)) continue;
+
+			uint32_t free = 0;
+			if (!queue->consuming.compare_exchange_strong(free, 1, std::memory_order_acquire)) continue;
+
+			uint32_t tail = queue->tail.load(std::memory_order_relaxed);
+			bool isTaken = queue->head.load(std::memory_order_acquire) != tail;
+			if (isTaken) {
+				slot = queue->entries[tail % CodecClientQueue::CAPACITY];
+				queue->tail.store(tail + 1, std::memory_order_release);
+			}
+			queue->consuming.store(0, std::memory_order_release);
+
+			if (isTaken) {
+				// The next search starts after this client, so each client with jobs waiting gets one in turn
+				cursor = client + 1;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void CodecService::RunJob(uint32_t slot) {
+		if (slot >= _ring->GetHeader()->slotCount) return;
+
+		CodecSlotHeader* s = _ring->GetSlot(slot);
+		uint32_t submitted = CODEC_SLOT_SUBMITTED;
+		if (!s->state.compare_exchange_strong(submitted, CODEC_SLOT_RUNNING, std::memory_order_acquire)) return;
+
+		uint32_t client = s->client;
+		size_t nData = s->nData;
+		size_t nParity = s->nParity;
+		size_t bytesPerSlice = s->bytesPerSlice;
+		size_t errorCount = s->errorCount;
+
+		CodecResult result = CODEC_INVALID;
+		if (nData > 0 && nParity > 0 && nData + nParity <= 0xFFFF && bytesPerSlice > 0 && bytesPerSlice % 16 == 0 &&
+			errorCount <= nParity && CodecRing::GetJobBytes(nData, nParity, bytesPerSlice, errorCount) <= _ring->GetHeader()->slotBytes) {
+
+			Geometry geometry(nData, nParity, bytesPerSlice / 2);
+			Parity* parity = nullptr;
+			Syndrome* syndrome = nullptr;
+			try {
+				if (s->operation == CODEC_ENCODE) parity = TakeParity(geometry);
+				if (s->operation == CODEC_VERIFY) syndrome = TakeSyndrome(geometry);
+				result = Run((CodecOperation)s->operation, nData, nParity, bytesPerSlice, errorCount, _ring->GetPayload(slot), parity, syndrome);
+			} catch (std::exception&) {
+				result = CODEC_INVALID;
+			}
+			ReturnCodecs(geometry, parity, syndrome);
+		}
+
+		s->result = result;
+		_ring->GetQueue(client & 0xFFFF)->completedJobs.fetch_add(1, std::memory_order_relaxed);
+		s->state.store(CODEC_SLOT_DONE);
+
+		// A client that detached with the job in flight will never release the slot
+		if (!_ring->IsAttached(client)) _ring->Reclaim(slot, CODEC_SLOT_DONE);
+	}
+
+	CodecResult CodecService::Run(CodecOperation operation, size_t nData, size_t nParity, size_t bytesPerSlice, size_t errorCount,
+		uint8_t* payload, Parity* parity, Syndrome* syndrome) {
+
+		size_t nSlices = nData + nParity;
+		size_t codewordsPerSlice = bytesPerSlice / 2;
+		auto slice = [&](size_t i) { return (uint16_t*)(payload + i * bytesPerSlice); };
+		auto exponent = [&](size_t i) { return nSlices - 1 - i; };
+
+		switch (operation) {
+		case CODEC_ENCODE: {
+			if (parity == nullptr) return CODEC_INVALID;
+			std::vector<uint16_t*> data(nData);
+			std::vector<size_t> exponents(nData);
+			for (size_t i = 0; i < nData; i++) {
+				data[i] = slice(i);
+				exponents[i] = exponent(i);
+			}
+			parity->Reset();
+			parity->CalculateRun(data.data(), exponents.data(), nData);
+			for (size_t i = nData; i < nSlices; i++) parity->GetParity(slice(i), exponent(i));
+			return CODEC_OK;
+		}
+
+		case CODEC_VERIFY: {
+			if (syndrome == nullptr) return CODEC_INVALID;
+			syndrome->Reset();
+			for (size_t i = 0; i < nSlices; i++) syndrome->AddCodewordSlice(slice(i), exponent(i));
+			uint32_t range[2];
+			return syndrome->GetDamagedRanges(codewordsPerSlice, range, 1) == 0 ? CODEC_OK : CODEC_DAMAGED;
+		}
+
+		case CODEC_REPAIR: {
+			if (errorCount == 0) return CODEC_OK;
+
+			// The erasures are read from the payload once, so a client rewriting them meanwhile cannot move them out of range
+			std::vector<int> errorLocations(errorCount);
+			const int32_t* errors = (const int32_t*)(payload + nSlices * bytesPerSlice);
+			std::vector<bool> isErased(nSlices);
+			for (size_t i = 0; i < errorCount; i++) {
+				int32_t e = errors[i];
+				if (e < 0 || (size_t)e >= nSlices || isErased[(size_t)e]) return CODEC_INVALID;
+				isErased[(size_t)e] = true;
+				errorLocations[i] = e;
+			}
+
+			AdaptiveRepair repair(nData, nParity, codewordsPerSlice, errorLocations.data(), (int)errorCount);
+			for (size_t i = 0; i < nSlices; i++) {
+				if (!isErased[exponent(i)] && repair.IsNeeded(exponent(i))) repair.AddCodewordSlice(slice(i), exponent(i));
+			}
+			for (size_t i = 0; i < errorCount; i++) repair.GetCorrection((int)i, slice(nSlices - 1 - (size_t)errorLocations[i]));
+			return CODEC_OK;
+		}
+
+		default:
+			return CODEC_INVALID;
+		}
+	}
+
+	void CodecService::ReclaimExitedClients() {
+		std::unique_lock<std::mutex> lock(_reclaimLock, std::try_to_lock);
+		if (!lock.owns_lock()) return;
+
+		CodecRingHeader* header = _ring->GetHeader();
+		for (size_t client = 0; client < header->maxClients; client++) {
+			CodecClientQueue* queue = _ring->GetQueue(client);
+			if (queue->attached.load() != CODEC_QUEUE_ATTACHED || IsProcessRunning(queue->processId)) continue;
+
+			uint32_t attached = CODEC_QUEUE_ATTACHED;
+			if (!queue->attached.compare_exchange_strong(attached, CODEC_QUEUE_RECLAIMING)) continue;
+
+			// The jobs it queued are dropped rather than run
+			CodecBackoff backoff;
+			uint32_t free = 0;
+			while (!queue->consuming.compare_exchange_weak(free, 1, std::memory_order_acquire)) {
+				free = 0;
+				backoff.Wait();
+			}
+			uint32_t head = queue->head.load(std::memory_order_acquire);
+			for (uint32_t tail = queue->tail.load(std::memory_order_relaxed); tail != head; tail++) {
+				uint32_t slot = queue->entries[tail % CodecClientQueue::CAPACITY];
+				if (slot < header->slotCount) _ring->Reclaim(slot, CODEC_SLOT_SUBMITTED);
+			}
+			queue->tail.store(head, std::memory_order_release);
+			queue->consuming.store(0, std::memory_order_release);
+
+			// Slots it acquired and never submitted, and finished jobs it never released
+			uint32_t generation = queue->generation.load(std::memory_order_relaxed) & 0xFFFF;
+			for (uint32_t slot = 0; slot < header->slotCount; slot++) {
+				CodecSlotHeader* s = _ring->GetSlot(slot);
+				uint32_t state = s->state.load(std::memory_order_acquire);
+				if ((state != CODEC_SLOT_OWNED && state != CODEC_SLOT_DONE) || s->client != (generation << 16 | (uint32_t)client)) continue;
+				_ring->Reclaim(slot, (CodecSlotState)state);
+			}
+
+			queue->attached.store(CODEC_QUEUE_DETACHED);
+		}
+
+		// Finished jobs whose client detached while they ran, when the worker that finished them saw the client still attached
+		for (uint32_t slot = 0; slot < header->slotCount; slot++) {
+			if (_ring->GetSlot(slot)->state.load(std::memory_order_acquire) == CODEC_SLOT_DONE && !_ring->IsOwnerAttached(slot)) {
+				_ring->Reclaim(slot, CODEC_SLOT_DONE);
+			}
+		}
+	}
+
+	Parity* CodecService::TakeParity(const Geometry& geometry) {
+		{
+			std::lock_guard<std::mutex> lock(_codecLock);
+			std::vector<Parity*>& parities = _codecs[geometry].parities;
+			if (!parities.empty()) {
+				Parity* parity = parities.back();
+				parities.pop_back();
+				return parity;
+			}
+		}
+		return new Parity(std::get<0>(geometry), std::get<1>(geometry), std::get<2>(geometry));
+	}
+
+	Syndrome* CodecService::TakeSyndrome(const Geometry& geometry) {
+		{
+			std::lock_guard<std::mutex> lock(_codecLock);
+			std::vector<Syndrome*>& syndromes = _codecs[geometry].syndromes;
+			if (!syndromes.empty()) {
+				Syndrome* syndrome = syndromes.back();
+				syndromes.pop_back();
+				return syndrome;
+			}
+		}
+		return new Syndrome(std::get<0>(geometry), std::get<1>(geometry), std::get<2>(geometry));
+	}
+
+	void CodecService::ReturnCodecs(const Geometry& geometry, Parity* parity, Syndrome* syndrome) {
+		std::lock_guard<std::mutex> lock(_codecLock);
+		Codecs& codecs = _codecs[geometry];
+		if (parity != nullptr) codecs.parities.push_back(parity);
+		if (syndrome != nullptr) codecs.syndromes.push_back(syndrome);
+	}
+
+	CodecService* CodecService_Construct(const char* name, size_t slotCount, size_t slotBytes, size_t maxClients, unsigned threads) {
+		try {
+			return new CodecService(name, slotCount, slotBytes, maxClients, threads);
+		} catch (std::exception&) {
+			return nullptr;
+		}
+	}
+
+	void CodecService_Destruct(CodecService* p) { delete p; }
+
+	void CodecService_Stop(CodecService* p) { p->Stop(); }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "CodecRing.h"
+
+namespace ReedSolomon {
+
+	class Parity;
+	class Syndrome;
+
+	// Runs the encode, verify and repair jobs of every client of a CodecRing on one pool of threads, so that a host mounting many
+	// volumes has one set of codec threads and tables instead of one per process.
+	//
+	// The thread count is the CPU budget of the whole host: however many clients submit, no more jobs run at once.  Workers visit
+	// the client queues in turn and take one job from each, so a volume with a deep queue does not starve the others.  Parity and
+	// Syndrome instances are kept per geometry and handed to whichever worker needs one, so the tables of a geometry are built once
+	// for all clients rather than once per process.
+	//
+	// A client that exits without detaching is noticed when the workers are idle, and its queued jobs and slots are freed.
+	class CodecService {
+
+	public:
+
+		// Creates the ring and starts the workers.  A thread count of 0 uses every hardware thread.
+		CodecService(const std::string& name, size_t slotCount, size_t slotBytes, size_t maxClients, unsigned threads);
+		~CodecService();
+
+		CodecService(const CodecService&) = delete;
+		CodecService& operator=(const CodecService&) = delete;
+
+		// Stops the workers after the jobs they are running.  Clients waiting on a job that has not run see the service stop.
+		void Stop();
+
+		inline size_t GetWorkerCount() const { return _workers.size(); }
+		inline size_t GetMaxClients() const { return _ring->GetHeader()->maxClients; }
+
+		// The jobs finished for a queue since the service started, for all the clients that have held it
+		uint64_t GetCompletedJobs(size_t client) const;
+
+		// The number of geometries that have codec instances
+		size_t GetGeometryCount() const;
+
+		// Runs one job on the calling thread.  Exposed so the operations can be checked without a ring.
+		static CodecResult Run(CodecOperation operation, size_t nData, size_t nParity, size_t bytesPerSlice, size_t errorCount,
+			uint8_t* payload, Parity* parity, Syndrome* syndrome);
+
+	private:
+
+		typedef std::tuple<size_t, size_t, size_t> Geometry;
+
+		struct Codecs {
+			std::vector<Parity*> parities;
+			std::vector<Syndrome*> syndromes;
+		};
+
+		void Work(size_t worker);
+		bool TakeJob(size_t& cursor, uint32_t& slot);
+		void RunJob(uint32_t slot);
+		void ReclaimExitedClients();
+
+		Parity* TakeParity(const Geometry& geometry);
+		Syndrome* TakeSyndrome(const Geometry& geometry);
+		void ReturnCodecs(const Geometry& geometry, Parity* parity, Syndrome* syndrome);
+
+		CodecRing* _ring;
+		std::vector<std::thread> _workers;
+		std::atomic<bool> _stopping;
+
+		mutable std::mutex _codecLock;
+		std::map<Geometry, Codecs> _codecs;
+		// Serializes the search for exited clients, which any idle worker may start
+		std::mutex _reclaimLock;
+	};
+
+	extern "C" {
+		// Hosts a service in the calling process, as rsprotect serve does.  Returns null if the ring cannot be created.
+		__declspec(dllexport) CodecService* CodecService_Construct(const char* name, size_t slotCount, size_t slotBytes, size_t maxClients,
+			unsigned threads);
+		__declspec(dllexport) void CodecService_Destruct(CodecService* p);
+		__declspec(dllexport) void CodecService_Stop(CodecService* p);
+	}
+}
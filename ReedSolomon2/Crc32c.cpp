@@ -0,0 +1,91 @@
+#include "stdafx.h"
+#include "Crc32c.h"
+#include <cstring>
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace ReedSolomon {
+
+	// Bytes in each of the three lanes
+	static const size_t LANE_BYTES = 256;
+
+	// The reflected polynomial
+	static const uint32_t POLYNOMIAL = 0x82F63B78;
+
+	// x^n mod P in the reflected bit order of the CRC register
+	static uint32_t PowerOfX(size_t n) {
+		uint32_t value = 0x80000000;
+		for (size_t i = 0; i < n; i++) value = (value >> 1) ^ ((value & 1) != 0 ? POLYNOMIAL : 0);
+		return value;
+	}
+
+	static bool HasCarrylessMultiply() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 1)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL) != 0;
+#endif
+	}
+
+	// The carry-less product of a register and x^(n - 33), reduced by the CRC instruction, is the register times x^n: the product
+	// comes out one place higher than the CRC instruction reads it, and the instruction multiplies by x^32 itself.
+	static const bool USE_LANES = HasCarrylessMultiply();
+	static const __m128i SHIFT_ONE_LANE = _mm_cvtsi32_si128((int)PowerOfX(8 * LANE_BYTES - 33));
+	static const __m128i SHIFT_TWO_LANES = _mm_cvtsi32_si128((int)PowerOfX(16 * LANE_BYTES - 33));
+
+	static inline uint64_t Load64(const uint8_t* p) {
+		uint64_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	static uint64_t CrcLanes(uint64_t crc, const uint8_t*& data, size_t& length) {
+		for (; length >= 3 * LANE_BYTES; length -= 3 * LANE_BYTES, data += 3 * LANE_BYTES) {
+			uint64_t crc1 = 0;
+			uint64_t crc2 = 0;
+			for (size_t i = 0; i < LANE_BYTES; i += 8) {
+				crc = _mm_crc32_u64(crc, Load64(data + i));
+				crc1 = _mm_crc32_u64(crc1, Load64(data + LANE_BYTES + i));
+				crc2 = _mm_crc32_u64(crc2, Load64(data + 2 * LANE_BYTES + i));
+			}
+
+			__m128i shifted = _mm_xor_si128(
+				_mm_clmulepi64_si128(_mm_cvtsi32_si128((int)crc), SHIFT_TWO_LANES, 0),
+				_mm_clmulepi64_si128(_mm_cvtsi32_si128((int)crc1), SHIFT_ONE_LANE, 0));
+			crc = _mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(shifted)) ^ crc2;
+		}
+		return crc;
+	}
+
+	static uint64_t Accumulate(uint64_t crc, const uint8_t* data, size_t length) {
+		if (USE_LANES) crc = CrcLanes(crc, data, length);
+		for (; length >= 8; length -= 8, data += 8) crc = _mm_crc32_u64(crc, Load64(data));
+		for (; length > 0; length--, data++) crc = _mm_crc32_u8((uint32_t)crc, *data);
+		return crc;
+	}
+
+	uint32_t Crc32c(const uint8_t* data, size_t length, size_t paddingBytes) {
+		uint64_t crc = Accumulate(0xFFFFFFFF, data, length);
+
+		for (; paddingBytes >= 8; paddingBytes -= 8) crc = _mm_crc32_u64(crc, 0);
+		for (; paddingBytes > 0; paddingBytes--) crc = _mm_crc32_u8((uint32_t)crc, 0);
+
+		return (uint32_t)crc ^ 0xFFFFFFFF;
+	}
+
+	uint32_t Crc32cUpdate(uint32_t crc, const uint8_t* data, size_t length) {
+		return (uint32_t)Accumulate(crc ^ 0xFFFFFFFF, data, length) ^ 0xFFFFFFFF;
+	}
+
+	uint32_t Crc32c_Compute(const uint8_t* data, size_t length) { return Crc32c(data, length); }
+
+	uint32_t Crc32c_Update(uint32_t crc, const uint8_t* data, size_t length) { return Crc32cUpdate(crc, data, length); }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace ReedSolomon {
+
+	// CRC-32C (Castagnoli) of a buffer followed by paddingBytes zero bytes.
+	//
+	// Long buffers are split into three lanes that run through the SSE4.2 CRC instruction side by side, which hides its latency,
+	// and the lane CRCs are shifted into place with a carry-less multiply.  Without PCLMULQDQ every byte goes through one lane.
+	uint32_t Crc32c(const uint8_t* data, size_t length, size_t paddingBytes = 0);
+
+	// Extends the CRC-32C of some bytes, as returned by Crc32c, over the bytes that follow them.  The CRC of no bytes is 0.
+	uint32_t Crc32cUpdate(uint32_t crc, const uint8_t* data, size_t length);
+
+	extern "C" {
+		__declspec(dllexport) uint32_t Crc32c_Compute(const uint8_t* data, size_t length);
+		__declspec(dllexport) uint32_t Crc32c_Update(uint32_t crc, const uint8_t* data, size_t length);
+	}
+}
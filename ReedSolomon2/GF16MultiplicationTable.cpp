@@ -2,6 +2,7 @@
 #include "GF16MultiplicationTable.h"
 #include <iostream>
 #include "GF16.h"
+#include "BufferPool.h"
 
 namespace ReedSolomon {
 
@@ -27,11 +28,19 @@ namespace ReedSolomon {
 	}
 
 	GF16MultiplicationTable::GF16MultiplicationTable() {
-		low = (__m128i*)_aligned_malloc(256 * 16, 16);
-		high = (__m128i*)_aligned_malloc(256 * 16, 64);
+		low = (__m128i*)BufferPool::Allocate(256 * 16);
+		high = (__m128i*)BufferPool::Allocate(256 * 16);
 	}
 
 	void GF16MultiplicationTable::Set(const __m128i& x) {
+		Set(x, low, high);
+	}
+
+	void GF16MultiplicationTable::Set(const __m128i& x, __m128i* table) {
+		Set(x, table, table + 256);
+	}
+
+	void GF16MultiplicationTable::Set(const __m128i& x, __m128i* low, __m128i* high) {
 
 		__declspec(align(16)) __m128i addTable[8];
 		__m128i add = x;
@@ -80,8 +89,8 @@ namespace ReedSolomon {
 	}
 
 	GF16MultiplicationTable::~GF16MultiplicationTable() {
-		_aligned_free(low);
-		_aligned_free(high);
+		BufferPool::Free(low, 256 * 16);
+		BufferPool::Free(high, 256 * 16);
 	}
 
 	int GF16MultiplicationTable::lookupIndices[256];
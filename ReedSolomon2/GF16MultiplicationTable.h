@@ -14,9 +14,15 @@ namespace ReedSolomon {
 		void MultiplyAndXor(uint16_t* source, __m128i* dest, int count);
 		void Set(const __m128i& x);
 
+		// Builds the tables for x into caller-owned memory of TABLE_BLOCKS blocks: the low byte table followed by the high byte table
+		static void Set(const __m128i& x, __m128i* table);
+
+		static const int TABLE_BLOCKS = 512;
+
 	private:
 
 		static bool staticInitialize();
+		static void Set(const __m128i& x, __m128i* low, __m128i* high);
 
 		const static uint16_t PRIMITIVE_POLYNOMIAL = 0x100B;
 		static int lookupIndices[256];
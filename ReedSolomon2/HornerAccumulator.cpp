@@ -0,0 +1,64 @@
+#include "stdafx.h"
+#include "HornerAccumulator.h"
+#include "BufferPool.h"
+#include <cstring>
+
+namespace ReedSolomon {
+
+	static const uint16_t PRIMITIVE_POLYNOMIAL = 0x100B;
+
+	// x * α for eight codewords: a shift, and the polynomial where the high bit was set
+	static inline __m128i MultiplyByAlpha(__m128i x) {
+		return _mm_xor_si128(_mm_slli_epi16(x, 1), _mm_and_si128(_mm_srai_epi16(x, 15), _mm_set1_epi16((short)PRIMITIVE_POLYNOMIAL)));
+	}
+
+	static inline uint16_t MultiplyByAlpha(uint16_t x) {
+		return (uint16_t)((x << 1) ^ ((x & 0x8000) != 0 ? PRIMITIVE_POLYNOMIAL : 0));
+	}
+
+	HornerAccumulator::HornerAccumulator(size_t nPoints, size_t codewordsPerSlice) :
+		_nPoints(nPoints), _codewordsPerSlice(codewordsPerSlice), _active(false), _exponent(0) {
+
+		_planeCodewords = (codewordsPerSlice + 7) / 8 * 8;
+		_planes = (uint16_t*)BufferPool::Allocate(_nPoints * _planeCodewords * sizeof(uint16_t));
+	}
+
+	HornerAccumulator::~HornerAccumulator() {
+		BufferPool::Free(_planes, _nPoints * _planeCodewords * sizeof(uint16_t));
+	}
+
+	bool HornerAccumulator::Add(const uint16_t* data, size_t exponent) {
+		if (!_active) {
+			for (size_t j = 0; j < _nPoints; j++) memcpy(GetPlane(j), data, _codewordsPerSlice * sizeof(uint16_t));
+			_active = true;
+			_exponent = exponent;
+			return true;
+		}
+
+		if (exponent >= _exponent || _exponent - exponent > MAX_GAP) return false;
+		size_t gap = _exponent - exponent;
+
+		size_t vectors = _codewordsPerSlice / 8;
+		for (size_t j = 0; j < _nPoints; j++) {
+			__m128i* plane = (__m128i*)GetPlane(j);
+			const __m128i* source = (const __m128i*)data;
+			size_t doublings = j * gap;
+
+			for (size_t i = 0; i < vectors; i++) {
+				__m128i x = _mm_load_si128(plane + i);
+				for (size_t k = 0; k < doublings; k++) x = MultiplyByAlpha(x);
+				_mm_store_si128(plane + i, _mm_xor_si128(x, _mm_loadu_si128(source + i)));
+			}
+
+			uint16_t* tail = GetPlane(j);
+			for (size_t i = vectors * 8; i < _codewordsPerSlice; i++) {
+				uint16_t x = tail[i];
+				for (size_t k = 0; k < doublings; k++) x = MultiplyByAlpha(x);
+				tail[i] = x ^ data[i];
+			}
+		}
+
+		_exponent = exponent;
+		return true;
+	}
+}
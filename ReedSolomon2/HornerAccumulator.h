@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <immintrin.h>
+
+namespace ReedSolomon {
+
+	// Evaluates slices added at descending exponents at the points α^0 .. α^(nPoints - 1) by Horner's rule, using only XOR and
+	// multiplication by α.  With three parity codewords or fewer that is cheaper than building a multiplication table per slice.
+	//
+	// A run starts with the first slice added.  Each later slice must have a lower exponent, at most MAX_GAP below the previous one,
+	// and plane j is multiplied by α^(j * gap) before the slice is added.  Plane j then holds the sum of data_e * α^(j * (e - E)) over
+	// the run, where E is GetExponent(), so multiplying it by α^(j * E) gives the evaluation of the run at α^j.  The owner folds the
+	// planes into its own accumulator when the run ends and then clears it.
+	class HornerAccumulator {
+
+	public:
+
+		static const size_t MAX_POINTS = 3;
+		static const size_t MAX_GAP = 8;
+
+		HornerAccumulator(size_t nPoints, size_t codewordsPerSlice);
+		~HornerAccumulator();
+
+		// Adds a slice, starting a run if there is none.  Returns false, adding nothing, if the exponent does not continue the run.
+		bool Add(const uint16_t* data, size_t exponent);
+
+		inline bool IsActive() const { return _active; }
+		inline size_t GetExponent() const { return _exponent; }
+		inline size_t GetNPoints() const { return _nPoints; }
+		inline uint16_t* GetPlane(size_t point) const { return _planes + point * _planeCodewords; }
+		inline void Clear() { _active = false; }
+
+	private:
+
+		size_t _nPoints;
+		size_t _codewordsPerSlice;
+		size_t _planeCodewords;
+
+		bool _active;
+		size_t _exponent;
+		uint16_t* _planes;
+	};
+}
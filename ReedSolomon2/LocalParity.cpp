@@ -0,0 +1,70 @@
+#include "stdafx.h"
+#include "LocalParity.h"
+#include "BufferPool.h"
+#include <stdexcept>
+
+namespace ReedSolomon {
+
+	static const int CODEWORDS_PER_BLOCK = 8;
+	static const int BYTES_PER_CODEWORD = 2;
+
+	static void XorInto(__m128i* dest, const uint16_t* data, size_t codewords) {
+		size_t blocks = codewords / CODEWORDS_PER_BLOCK;
+		const __m128i* source = (const __m128i*)data;
+		for (size_t i = 0; i < blocks; i++) {
+			__m128i value = _mm_loadu_si128(source + i);
+			_mm_store_si128(dest + i, _mm_xor_si128(_mm_load_si128(dest + i), value));
+		}
+
+		uint16_t* destTail = (uint16_t*)(dest + blocks);
+		const uint16_t* sourceTail = data + blocks * CODEWORDS_PER_BLOCK;
+		for (size_t i = 0; i < codewords % CODEWORDS_PER_BLOCK; i++) destTail[i] ^= sourceTail[i];
+	}
+
+	LocalParity::LocalParity(size_t nDataCodewords, size_t nGroups, size_t codewordsPerSlice) :
+		_nDataCodewords(nDataCodewords), _nGroups(nGroups), _codewordsPerSlice(codewordsPerSlice) {
+
+		if (nGroups == 0 || nGroups > nDataCodewords) throw std::invalid_argument("Invalid number of local groups");
+
+		_codewordsPerGroup = (nDataCodewords + nGroups - 1) / nGroups;
+		_blocksPerSlice = (codewordsPerSlice + CODEWORDS_PER_BLOCK - 1) / CODEWORDS_PER_BLOCK;
+		_parity = (__m128i*)BufferPool::Allocate(_blocksPerSlice * 16 * _nGroups);
+		Reset();
+	}
+
+	LocalParity::~LocalParity() {
+		BufferPool::Free(_parity, _blocksPerSlice * 16 * _nGroups);
+	}
+
+	void LocalParity::Reset() {
+		memset(_parity, 0, _blocksPerSlice * 16 * _nGroups);
+	}
+
+	void LocalParity::Calculate(uint16_t* data, size_t dataIndex) {
+		XorInto(_parity + _blocksPerSlice * GetGroup(dataIndex), data, _codewordsPerSlice);
+	}
+
+	void LocalParity::AddParity(uint16_t* data, size_t group) {
+		XorInto(_parity + _blocksPerSlice * group, data, _codewordsPerSlice);
+	}
+
+	void LocalParity::GetParity(uint16_t* data, size_t group) const {
+		memcpy(data, _parity + _blocksPerSlice * group, _codewordsPerSlice * BYTES_PER_CODEWORD);
+	}
+
+	LocalParity* LocalParity_Construct(size_t nDataCodewords, size_t nGroups, size_t codewordsPerSlice) {
+		return new LocalParity(nDataCodewords, nGroups, codewordsPerSlice);
+	}
+
+	void LocalParity_Destruct(LocalParity* p) { delete p; }
+
+	void LocalParity_Reset(LocalParity* p) { p->Reset(); }
+
+	void LocalParity_Calculate(LocalParity* p, uint16_t* data, size_t dataIndex) { p->Calculate(data, dataIndex); }
+
+	void LocalParity_AddParity(LocalParity* p, uint16_t* data, size_t group) { p->AddParity(data, group); }
+
+	void LocalParity_GetParity(LocalParity* p, uint16_t* data, size_t group) { p->GetParity(data, group); }
+
+	size_t LocalParity_GetGroup(LocalParity* p, size_t dataIndex) { return p->GetGroup(dataIndex); }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <immintrin.h>
+
+namespace ReedSolomon {
+
+	// XOR parity over local groups of data slices, used alongside the global Reed-Solomon parity for locally repairable codes.
+	//
+	// The data slices are split into nGroups contiguous groups.  Since the parity is a plain XOR, the same accumulator repairs a
+	// single lost slice in a group: add the surviving slices of the group and the group's parity, and the result is the lost slice.
+	class LocalParity {
+
+	public:
+
+		LocalParity(size_t nDataCodewords, size_t nGroups, size_t codewordsPerSlice);
+		~LocalParity();
+
+		void Reset();
+
+		inline size_t GetNDataCodewords() const { return _nDataCodewords; }
+		inline size_t GetNGroups() const { return _nGroups; }
+		inline size_t GetCodewordsPerSlice() const { return _codewordsPerSlice; }
+		inline size_t GetGroup(size_t dataIndex) const { return dataIndex / _codewordsPerGroup; }
+
+		void Calculate(uint16_t* data, size_t dataIndex);
+		void AddParity(uint16_t* data, size_t group);
+		void GetParity(uint16_t* data, size_t group) const;
+
+	private:
+
+		size_t _nDataCodewords;
+		size_t _nGroups;
+		size_t _codewordsPerGroup;
+		size_t _codewordsPerSlice;
+		size_t _blocksPerSlice;
+
+		__m128i* _parity;
+	};
+
+	extern "C" {
+		__declspec(dllexport) LocalParity* LocalParity_Construct(size_t nDataCodewords, size_t nGroups, size_t codewordsPerSlice);
+		__declspec(dllexport) void LocalParity_Destruct(LocalParity* p);
+		__declspec(dllexport) void LocalParity_Reset(LocalParity* p);
+		__declspec(dllexport) void LocalParity_Calculate(LocalParity* p, uint16_t* data, size_t dataIndex);
+		__declspec(dllexport) void LocalParity_AddParity(LocalParity* p, uint16_t* data, size_t group);
+		__declspec(dllexport) void LocalParity_GetParity(LocalParity* p, uint16_t* data, size_t group);
+		__declspec(dllexport) size_t LocalParity_GetGroup(LocalParity* p, size_t dataIndex);
+	}
+}
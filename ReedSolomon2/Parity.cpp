@@ -1,6 +1,11 @@
 #include "stdafx.h"
 #include "Parity.h"
 #include "GF16.h"
+#include "BufferPool.h"
+#include "Xor.h"
+#include "ZeroSpans.h"
+#include "SquareMatrix.h"
+#include <vector>
 
 namespace ReedSolomon {
 
@@ -9,7 +14,7 @@ namespace ReedSolomon {
 		_codewordsPerSlice(codewordsPerSlice), _multiplicationTable() {
 
 		_parityBlocksPerVector = (_nParityCodewords + 7) / 8;
-		_parityVectors = (uint16_t*)_aligned_malloc(_parityBlocksPerVector * 16 * nDataCodewords, 64);
+		_parityVectors = (uint16_t*)BufferPool::Allocate(_parityBlocksPerVector * 16 * nDataCodewords);
 
 		uint16_t* generator = _generator.GetCoefficients();
 
@@ -38,40 +43,246 @@ namespace ReedSolomon {
 		}
 		else {
 			uint16_t* currentVector = _parityVectors;
-			for (size_t j = 0; j < nDataCodewords; j++) {
+			for (size_t j = 0; j < nDataCodewords; j++, currentVector += codewordsPerVector) {
 				currentVector[0] = 1;
 				for (size_t i = 1; i < codewordsPerVector; i++) currentVector[i] = 0;
 			}
-			currentVector += codewordsPerVector;
 		}
 
-		_parity = (__m128i*)_aligned_malloc(_parityBlocksPerVector * 16 * _codewordsPerSlice, 64);
+		_parity = (__m128i*)BufferPool::Allocate(_parityBlocksPerVector * 16 * _codewordsPerSlice);
+		_calculated = new uint8_t[(nDataCodewords + 7) / 8];
+
+		_runKernel = nullptr;
+		_runLength = 1;
+		_runTables = nullptr;
+		ParityTuning tuning;
+		if (ParityTuner::Find(nDataCodewords, nParityCodewords, codewordsPerSlice, tuning)) SetTuning(tuning);
+		else SelectRunKernel(0);
+
+		_spans = new size_t[2 * GetMaxNonZeroSpans(_codewordsPerSlice)];
+		_constantVector = (__m128i*)BufferPool::Allocate(_parityBlocksPerVector * 16);
+
+		_horner = nullptr;
+		if (_nParityCodewords <= HornerAccumulator::MAX_POINTS) {
+			_horner = new HornerAccumulator(_nParityCodewords, _codewordsPerSlice);
+
+			// The parity polynomial takes the same values at the roots α^j as the data polynomial
+			SquareMatrix vandermonde((int)_nParityCodewords);
+			for (int j = 0; j < (int)_nParityCodewords; j++) {
+				for (int i = 0; i < (int)_nParityCodewords; i++) vandermonde[j][i] = GF16::Power(2, j * i);
+			}
+			vandermonde.Invert();
+			for (size_t i = 0; i < _nParityCodewords; i++) {
+				for (size_t j = 0; j < _nParityCodewords; j++) _hornerInverse[i * _nParityCodewords + j] = vandermonde[(int)i][(int)j];
+			}
+		}
 		Reset();
 	}
 
 	Parity::~Parity() {
-		_aligned_free(_parityVectors);
-		_aligned_free(_parity);
+		BufferPool::Free(_parityVectors, _parityBlocksPerVector * 16 * _nDataCodewords);
+		BufferPool::Free(_parity, _parityBlocksPerVector * 16 * _codewordsPerSlice);
+		delete[] _calculated;
+		BufferPool::Free(_runTables, GetRunTablesSize());
+		delete[] _spans;
+		BufferPool::Free(_constantVector, _parityBlocksPerVector * 16);
+		delete _horner;
+	}
+
+	void Parity::SetTuning(const ParityTuning& tuning) {
+		if (tuning.runLength > 0) {
+			SelectRunKernel((size_t)tuning.runLength);
+		} else {
+			BufferPool::Free(_runTables, GetRunTablesSize());
+			_runKernel = nullptr;
+			_runLength = 1;
+			_runTables = nullptr;
+		}
+	}
+
+	void Parity::SelectRunKernel(size_t runLength) {
+		BufferPool::Free(_runTables, GetRunTablesSize());
+		_runLength = runLength;
+		_runKernel = GetGeometryRunKernel(_nParityCodewords, _codewordsPerSlice, _runLength);
+		_runTables = _runKernel != nullptr ? (__m128i*)BufferPool::Allocate(GetRunTablesSize()) : nullptr;
 	}
 
 	void Parity::Reset() {
 		memset(_parity, 0, _parityBlocksPerVector * 16 * _codewordsPerSlice);
+		memset(_calculated, 0, (_nDataCodewords + 7) / 8);
+		if (_horner != nullptr) _horner->Clear();
 	}
 
 	void Parity::Calculate(uint16_t* data, size_t exponent) {
 		size_t exponentIndex = exponent - _nParityCodewords;
+		if (_horner == nullptr || !AddHorner(data, exponent)) {
+			Accumulate(data, (__m128i*)(_parityVectors + _parityBlocksPerVector * 8 * exponentIndex));
+		}
+		SetCalculated(exponentIndex);
+	}
+
+	bool Parity::AddHorner(uint16_t* data, size_t exponent) {
+		// A zero slice adds nothing; the next slice's gap steps over it
+		if (IsZeroSlice(data, _codewordsPerSlice)) return true;
+		if (_horner->Add(data, exponent)) return true;
+
+		// A slice above the run goes through the tables; one too far below it ends the run and starts another
+		if (exponent > _horner->GetExponent()) return false;
+		FlushHorner();
+		return _horner->Add(data, exponent);
+	}
+
+	void Parity::FlushHorner() const {
+		if (_horner == nullptr || !_horner->IsActive()) return;
+
+		// Parity codeword i gains the sum over j of inverse[i][j] * α^(j * E) * plane j
+		size_t exponent = _horner->GetExponent();
+		for (size_t j = 0; j < _nParityCodewords; j++) {
+			uint16_t scale = GF16::Power(2, (int)((j * exponent) % GF16::MAX_VALUE));
+			__m128i weights = _mm_setzero_si128();
+			for (size_t i = 0; i < _nParityCodewords; i++) {
+				((uint16_t*)&weights)[i] = GF16::Multiply(_hornerInverse[i * _nParityCodewords + j], scale);
+			}
+			Accumulate(_horner->GetPlane(j), &weights);
+		}
+		_horner->Clear();
+	}
+
+	void Parity::CalculateConstant(uint16_t* data, const size_t* exponents, size_t count) {
+		if (count == 0) return;
+
+		memset(_constantVector, 0, _parityBlocksPerVector * 16);
+		for (size_t i = 0; i < count; i++) {
+			size_t exponentIndex = exponents[i] - _nParityCodewords;
+			XorBlocks(_constantVector, (__m128i*)(_parityVectors + _parityBlocksPerVector * 8 * exponentIndex), _parityBlocksPerVector);
+			SetCalculated(exponentIndex);
+		}
+		Accumulate(data, _constantVector);
+	}
+
+	bool Parity::CalculateBatch(Parity* const* parities, uint16_t* const* data, size_t count, size_t exponent) {
+		if (count == 0) return true;
+
+		Parity& first = *parities[0];
+		for (size_t k = 1; k < count; k++) {
+			if (parities[k]->_nDataCodewords != first._nDataCodewords || parities[k]->_nParityCodewords != first._nParityCodewords ||
+				parities[k]->_codewordsPerSlice != first._codewordsPerSlice) return false;
+		}
+
+		// Without tables there is nothing to share
+		if (first._horner != nullptr) {
+			for (size_t k = 0; k < count; k++) parities[k]->Calculate(data[k], exponent);
+			return true;
+		}
+
+		// Each instance holds the spans of its own slice
+		std::vector<size_t> nSpans(count);
+		for (size_t k = 0; k < count; k++) nSpans[k] = FindNonZeroSpans(data[k], first._codewordsPerSlice, parities[k]->_spans);
+
+		size_t exponentIndex = exponent - first._nParityCodewords;
+		const __m128i* parityBlock = (__m128i*)(first._parityVectors + first._parityBlocksPerVector * 8 * exponentIndex);
+		size_t offset = 0;
+		for (size_t i = 0; i < first._parityBlocksPerVector; i++, parityBlock++, offset += first._codewordsPerSlice) {
+			first._multiplicationTable.Set(*parityBlock);
+			for (size_t k = 0; k < count; k++) {
+				const size_t* spans = parities[k]->_spans;
+				for (size_t j = 0; j < nSpans[k]; j++) {
+					first._multiplicationTable.MultiplyAndXor(data[k] + spans[2 * j], parities[k]->_parity + offset + spans[2 * j],
+						(int)(spans[2 * j + 1] - spans[2 * j]));
+				}
+			}
+		}
+
+		for (size_t k = 0; k < count; k++) parities[k]->SetCalculated(exponentIndex);
+		return true;
+	}
+
+	void Parity::Accumulate(uint16_t* data, const __m128i* parityBlock) const {
+		size_t nSpans = FindNonZeroSpans(data, _codewordsPerSlice, _spans);
+		if (nSpans == 0) return;
 
-		__m128i* parityBlock = (__m128i*)(_parityVectors + _parityBlocksPerVector * 8 * exponentIndex);
 		__m128i* dest = _parity;
-		for (size_t i = 0; i < _parityBlocksPerVector; i++) {
+		for (size_t i = 0; i < _parityBlocksPerVector; i++, parityBlock++, dest += _codewordsPerSlice) {
 			_multiplicationTable.Set(*parityBlock);
-			_multiplicationTable.MultiplyAndXor(data, dest, _codewordsPerSlice);
-			parityBlock++;
-			dest += _codewordsPerSlice;
+			for (size_t j = 0; j < nSpans; j++) {
+				size_t start = _spans[2 * j];
+				_multiplicationTable.MultiplyAndXor(data + start, dest + start, (int)(_spans[2 * j + 1] - start));
+			}
 		}
 	}
 
+	void Parity::CalculateRun(uint16_t* const* data, const size_t* exponents, size_t count) {
+		size_t i = 0;
+
+		if (_runKernel != nullptr) {
+			// Slices that are entirely zero add nothing, so they are only marked and the rest are gathered into runs
+			uint16_t* runData[PARITY_RUN_TABLES];
+			size_t runExponents[PARITY_RUN_TABLES];
+			size_t runCount = 0;
+
+			for (; i < count; i++) {
+				if (IsZeroSlice(data[i], _codewordsPerSlice)) {
+					SetCalculated(exponents[i] - _nParityCodewords);
+					continue;
+				}
+				runData[runCount] = data[i];
+				runExponents[runCount] = exponents[i];
+				if (++runCount < _runLength) continue;
+
+				__m128i* table = _runTables;
+				for (size_t d = 0; d < _runLength; d++) {
+					size_t exponentIndex = runExponents[d] - _nParityCodewords;
+					__m128i* parityBlock = (__m128i*)(_parityVectors + _parityBlocksPerVector * 8 * exponentIndex);
+					for (size_t b = 0; b < _parityBlocksPerVector; b++, parityBlock++, table += GF16MultiplicationTable::TABLE_BLOCKS) {
+						GF16MultiplicationTable::Set(*parityBlock, table);
+					}
+					SetCalculated(exponentIndex);
+				}
+				_runKernel(_runTables, runData, _parity, _codewordsPerSlice);
+				runCount = 0;
+			}
+
+			for (size_t d = 0; d < runCount; d++) Calculate(runData[d], runExponents[d]);
+			return;
+		}
+
+		for (; i < count; i++) Calculate(data[i], exponents[i]);
+	}
+
+	bool Parity::IsCalculated(size_t exponent) const {
+		size_t exponentIndex = exponent - _nParityCodewords;
+		return (_calculated[exponentIndex / 8] & (1 << (exponentIndex % 8))) != 0;
+	}
+
+	AccumulatorStateHeader Parity::GetStateHeader() const {
+		AccumulatorStateHeader header;
+		header.marker = ACCUMULATOR_STATE_MARKER;
+		header.version = ACCUMULATOR_STATE_VERSION;
+		header.kind = PARITY_STATE;
+		header.nDataCodewords = _nDataCodewords;
+		header.nParityCodewords = _nParityCodewords;
+		header.codewordsPerSlice = _codewordsPerSlice;
+		header.accumulatorBytes = _parityBlocksPerVector * 16 * _codewordsPerSlice;
+		return header;
+	}
+
+	size_t Parity::GetStateSize() const {
+		return GetAccumulatorStateSize(_nDataCodewords, _parityBlocksPerVector * 16 * _codewordsPerSlice);
+	}
+
+	void Parity::SaveState(uint8_t* buffer) const {
+		FlushHorner();
+		SaveAccumulatorState(buffer, GetStateHeader(), _calculated, _nDataCodewords, _parity);
+	}
+
+	bool Parity::LoadState(const uint8_t* buffer, size_t length) {
+		if (!LoadAccumulatorState(buffer, length, GetStateHeader(), _calculated, _nDataCodewords, _parity)) return false;
+		if (_horner != nullptr) _horner->Clear();
+		return true;
+	}
+
 	void Parity::GetParity(uint16_t* data, size_t exponent) const {
+		FlushHorner();
 
 		size_t parityBlock = exponent / 8;
 		uint16_t* p = (uint16_t*)(_parity + _codewordsPerSlice * parityBlock) + exponent % 8;
@@ -82,6 +293,22 @@ namespace ReedSolomon {
 	}
 
 
+	bool Parity::Merge(const Parity& other) {
+		if (other._nDataCodewords != _nDataCodewords || other._nParityCodewords != _nParityCodewords ||
+			other._codewordsPerSlice != _codewordsPerSlice) return false;
+
+		size_t bitmapBytes = (_nDataCodewords + 7) / 8;
+		for (size_t i = 0; i < bitmapBytes; i++) {
+			if ((_calculated[i] & other._calculated[i]) != 0) return false;
+		}
+
+		FlushHorner();
+		other.FlushHorner();
+		XorBlocks(_parity, other._parity, _parityBlocksPerVector * _codewordsPerSlice);
+		for (size_t i = 0; i < bitmapBytes; i++) _calculated[i] |= other._calculated[i];
+		return true;
+	}
+
 	Parity* Parity_Construct(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice) {
 		return new Parity(nDataCodewords, nParityCodewords, codewordsPerSlice);
 	}
@@ -94,6 +321,16 @@ namespace ReedSolomon {
 
 	void Parity_GetParity(Parity* p, uint16_t* data, size_t parityIndex) { p->GetParity(data, parityIndex); }
 
+	void Parity_CalculateRun(Parity* p, uint16_t** data, size_t* exponents, size_t count) { p->CalculateRun(data, exponents, count); }
+
+	size_t Parity_GetRunLength(Parity* p) { return p->GetRunLength(); }
+
+	bool Parity_CalculateBatch(Parity** parities, uint16_t** data, size_t count, size_t exponent) {
+		return Parity::CalculateBatch(parities, data, count, exponent);
+	}
+
+	void Parity_CalculateConstant(Parity* p, uint16_t* data, size_t* exponents, size_t count) { p->CalculateConstant(data, exponents, count); }
+
 	size_t Parity_GetNParityCodewords(Parity* p) { return p->GetNParityCodewords(); }
 
 	size_t Parity_GetNDataCodewords(Parity* p) { return p->GetNDataCodewords(); }
@@ -101,4 +338,14 @@ namespace ReedSolomon {
 	size_t Parity_GetCodewordsPerSlice(Parity* p) { return p->GetCodewordsPerSlice(); }
 
 	char* Parity_GetFirstParityBlock(Parity* p) { return (char*)p->GetFirstParityBlock(); }
+
+	bool Parity_IsCalculated(Parity* p, size_t exponent) { return p->IsCalculated(exponent); }
+
+	size_t Parity_GetStateSize(Parity* p) { return p->GetStateSize(); }
+
+	void Parity_SaveState(Parity* p, uint8_t* buffer) { p->SaveState(buffer); }
+
+	bool Parity_LoadState(Parity* p, const uint8_t* buffer, size_t length) { return p->LoadState(buffer, length); }
+
+	bool Parity_Merge(Parity* p, const Parity* other) { return p->Merge(*other); }
 }
\ No newline at end of file
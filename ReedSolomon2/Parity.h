@@ -3,9 +3,16 @@
 #include "Generator.h"
 #include <immintrin.h>
 #include "GF16MultiplicationTable.h"
+#include "AccumulatorState.h"
+#include "ParityJit.h"
+#include "ParityTuner.h"
+#include "HornerAccumulator.h"
 
 namespace ReedSolomon {
 
+	// With three parity codewords or fewer, slices added in descending exponent order are evaluated at the roots of the generator
+	// by a HornerAccumulator, with no multiplication tables, and the run is converted to parity in one table pass per root when it
+	// ends.  The const accessors fold a pending run in first, so an instance must not be shared between threads without a lock.
 	class Parity {
 
 	public:
@@ -21,21 +28,73 @@ namespace ReedSolomon {
 		inline __m128i* GetFirstParityBlock() const { return (__m128i*)_parityVectors; }
 		inline size_t GetCodewordsPerSlice() const { return _codewordsPerSlice; }
 
+		// Adds a data slice.  Chunks of the slice that are all zero are skipped.
 		void Calculate(uint16_t* data, size_t exponent);
 		void GetParity(uint16_t* data, size_t exponent) const;
 
+		// Adds several data slices.  When the geometry has a generated or specialized kernel the slices are processed a run at a
+		// time with the accumulators held in registers; the remainder, and geometries without one, go through Calculate.
+		void CalculateRun(uint16_t* const* data, const size_t* exponents, size_t count);
+
+		// Adds the same data slice at several exponents, as for a run of clusters known to hold the same contents.
+		// The parity vectors of the exponents are summed first, so the slice is multiplied once whatever the count.
+		void CalculateConstant(uint16_t* data, const size_t* exponents, size_t count);
+
+		// Adds data slice data[i] to parities[i] at the same exponent for each of count instances with the same geometry, such as
+		// the same cluster of several tracks.  Each multiplication table is built once and applied to every slice while it is hot.
+		// Returns false, leaving every instance unchanged, if the geometries differ.
+		static bool CalculateBatch(Parity* const* parities, uint16_t* const* data, size_t count, size_t exponent);
+
+		// Chooses the encode kernel.  The constructor applies the ParityTuner entry for the geometry, if there is one, and otherwise
+		// uses the longest run the kernel for the geometry supports.
+		void SetTuning(const ParityTuning& tuning);
+		inline size_t GetRunLength() const { return _runKernel != nullptr ? _runLength : 0; }
+
+		// Whether the data slice with this exponent has been added since the last reset
+		bool IsCalculated(size_t exponent) const;
+
+		// Save and restore the accumulated parity and the set of exponents added, in the AccumulatorState layout
+		size_t GetStateSize() const;
+		void SaveState(uint8_t* buffer) const;
+		bool LoadState(const uint8_t* buffer, size_t length);
+
+		// Adds the parity accumulated by another instance with the same geometry over a disjoint set of data slices.  Returns false,
+		// leaving this instance unchanged, if the geometry differs or a slice was added to both.
+		bool Merge(const Parity& other);
+
 	private:
 
+		AccumulatorStateHeader GetStateHeader() const;
+		void SelectRunKernel(size_t runLength);
+		void Accumulate(uint16_t* data, const __m128i* parityBlock) const;
+		bool AddHorner(uint16_t* data, size_t exponent);
+		void FlushHorner() const;
+		inline void SetCalculated(size_t exponentIndex) { _calculated[exponentIndex / 8] |= (uint8_t)(1 << (exponentIndex % 8)); }
+		inline size_t GetRunTablesSize() const { return _runLength * _parityBlocksPerVector * GF16MultiplicationTable::TABLE_BLOCKS * 16; }
+
 		size_t _nParityCodewords;
 		size_t _parityBlocksPerVector;
 		size_t _nDataCodewords;
 		size_t _codewordsPerSlice;
 
 		Generator _generator;
-		GF16MultiplicationTable _multiplicationTable;
+		mutable GF16MultiplicationTable _multiplicationTable;
+
+		// The Horner path, or null with more than HornerAccumulator::MAX_POINTS parity codewords.  _hornerInverse is the inverse
+		// of the Vandermonde matrix of the generator roots, which maps their evaluations to the parity codewords.
+		HornerAccumulator* _horner;
+		uint16_t _hornerInverse[HornerAccumulator::MAX_POINTS * HornerAccumulator::MAX_POINTS];
+
+		ParityRunKernel _runKernel;
+		size_t _runLength;
+		__m128i* _runTables;
+
+		size_t* _spans;
+		__m128i* _constantVector;
 
 		uint16_t* _parityVectors;
 		__m128i* _parity;
+		uint8_t* _calculated;
 	};
 
 	extern "C" {
@@ -44,9 +103,18 @@ namespace ReedSolomon {
 		__declspec(dllexport) void Parity_Reset(Parity* p);
 		__declspec(dllexport) void Parity_Calculate(Parity* p, uint16_t* data, size_t codewordIndex);
 		__declspec(dllexport) void Parity_GetParity(Parity* p, uint16_t* data, size_t parityIndex);
+		__declspec(dllexport) void Parity_CalculateRun(Parity* p, uint16_t** data, size_t* exponents, size_t count);
+		__declspec(dllexport) size_t Parity_GetRunLength(Parity* p);
+		__declspec(dllexport) bool Parity_CalculateBatch(Parity** parities, uint16_t** data, size_t count, size_t exponent);
+		__declspec(dllexport) void Parity_CalculateConstant(Parity* p, uint16_t* data, size_t* exponents, size_t count);
 		__declspec(dllexport) size_t Parity_GetNParityCodewords(Parity* p);
 		__declspec(dllexport) size_t Parity_GetNDataCodewords(Parity* p);
 		__declspec(dllexport) size_t Parity_GetCodewordsPerSlice(Parity* p);
 		__declspec(dllexport) char* Parity_GetFirstParityBlock(Parity* p);
+		__declspec(dllexport) bool Parity_IsCalculated(Parity* p, size_t exponent);
+		__declspec(dllexport) size_t Parity_GetStateSize(Parity* p);
+		__declspec(dllexport) void Parity_SaveState(Parity* p, uint8_t* buffer);
+		__declspec(dllexport) bool Parity_LoadState(Parity* p, const uint8_t* buffer, size_t length);
+		__declspec(dllexport) bool Parity_Merge(Parity* p, const Parity* other);
 	}
 }
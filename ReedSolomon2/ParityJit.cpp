@@ -0,0 +1,367 @@
+#include "stdafx.h"
+#include "ParityJit.h"
+#include <climits>
+#include <initializer_list>
+#include <vector>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace ReedSolomon {
+
+#if defined(_M_X64) || defined(__x86_64__)
+
+	enum Register { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+	// Just the instructions the kernels need, with their operands encoded by hand
+	class Assembler {
+
+	public:
+
+		inline size_t GetPosition() const { return _code.size(); }
+		inline const std::vector<uint8_t>& GetCode() const { return _code; }
+
+		void Push(int r) { Rex(false, 0, 0, r); Byte(0x50 | (r & 7)); }
+		void Pop(int r) { Rex(false, 0, 0, r); Byte(0x58 | (r & 7)); }
+		void Ret() { Byte(0xC3); }
+
+		void Mov(int dest, int source) { Rex(true, source, 0, dest); Byte(0x89); Byte(0xC0 | (source & 7) << 3 | (dest & 7)); }
+		void MovImmediate32(int dest, uint32_t value) { Rex(false, 0, 0, dest); Byte(0xB8 | (dest & 7)); Int32((int32_t)value); }
+		void Load(int dest, int base, int32_t displacement) { Rex(true, dest, 0, base); Byte(0x8B); Memory(dest, base, -1, displacement); }
+
+		// movzx r32, byte [base + displacement]
+		void LoadByte(int dest, int base, int32_t displacement) {
+			Rex(false, dest, 0, base);
+			Byte(0x0F);
+			Byte(0xB6);
+			Memory(dest, base, -1, displacement);
+		}
+
+		void ShiftLeft32(int r, uint8_t count) { Rex(false, 0, 0, r); Byte(0xC1); Byte(0xE0 | (r & 7)); Byte(count); }
+		void Add(int r, int32_t value) { Arithmetic(0, r, value); }
+		void Sub(int r, int32_t value) { Arithmetic(5, r, value); }
+		void Dec(int r) { Rex(true, 0, 0, r); Byte(0xFF); Byte(0xC8 | (r & 7)); }
+
+		void LoadAligned(int xmm, int base, int32_t displacement) { Sse(0x66, 0x6F, xmm, base, -1, displacement); }
+		void StoreAligned(int xmm, int base, int32_t displacement) { Sse(0x66, 0x7F, xmm, base, -1, displacement); }
+		void LoadUnaligned(int xmm, int base, int32_t displacement) { Sse(0xF3, 0x6F, xmm, base, -1, displacement); }
+		void StoreUnaligned(int xmm, int base, int32_t displacement) { Sse(0xF3, 0x7F, xmm, base, -1, displacement); }
+		void Xor(int xmm, int base, int index, int32_t displacement) { Sse(0x66, 0xEF, xmm, base, index, displacement); }
+
+		// Jumps back with a 32-bit offset
+		void JumpIfNotZero(size_t target) { Patch(Jump(0x85), target); }
+
+	private:
+
+		void Byte(uint8_t b) { _code.push_back(b); }
+
+		void Int32(int32_t value) {
+			for (int i = 0; i < 4; i++) Byte((uint8_t)((uint32_t)value >> (8 * i)));
+		}
+
+		void Rex(bool wide, int reg, int index, int base) {
+			uint8_t rex = (uint8_t)(0x40 | (wide ? 8 : 0) | (reg >> 3) << 2 | (index >> 3) << 1 | (base >> 3));
+			if (rex != 0x40) Byte(rex);
+		}
+
+		// ModRM, and SIB and displacement as needed, for [base + index + displacement], index -1 for none
+		void Memory(int reg, int base, int index, int32_t displacement) {
+			bool sib = index >= 0 || (base & 7) == RSP;
+			int mod = displacement == 0 && (base & 7) != RBP ? 0 : displacement >= -128 && displacement <= 127 ? 1 : 2;
+			Byte((uint8_t)(mod << 6 | (reg & 7) << 3 | (sib ? 4 : base & 7)));
+			if (sib) Byte((uint8_t)(((index >= 0 ? index : RSP) & 7) << 3 | (base & 7)));
+			if (mod == 1) Byte((uint8_t)displacement);
+			else if (mod == 2) Int32(displacement);
+		}
+
+		void Arithmetic(int operation, int r, int32_t value) {
+			Rex(true, 0, 0, r);
+			bool small = value >= -128 && value <= 127;
+			Byte(small ? 0x83 : 0x81);
+			Byte((uint8_t)(0xC0 | operation << 3 | (r & 7)));
+			if (small) Byte((uint8_t)value);
+			else Int32(value);
+		}
+
+		void Sse(uint8_t prefix, uint8_t opcode, int xmm, int base, int index, int32_t displacement) {
+			Byte(prefix);
+			Rex(false, xmm, index >= 0 ? index : 0, base);
+			Byte(0x0F);
+			Byte(opcode);
+			Memory(xmm, base, index, displacement);
+		}
+
+		size_t Jump(uint8_t condition) {
+			Byte(0x0F);
+			Byte(condition);
+			Int32(0);
+			return _code.size();
+		}
+
+		void Patch(size_t jump, size_t target) {
+			int32_t offset = (int32_t)((int64_t)target - (int64_t)jump);
+			for (int i = 0; i < 4; i++) _code[jump - 4 + i] = (uint8_t)((uint32_t)offset >> (8 * i));
+		}
+
+		std::vector<uint8_t> _code;
+	};
+
+	// Copies code into memory of its own and makes it executable, or returns nullptr if the process is not allowed to
+	static void* MapCode(const std::vector<uint8_t>& code) {
+#ifdef _WIN32
+		void* p = VirtualAlloc(nullptr, code.size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		if (p == nullptr) return nullptr;
+		memcpy(p, code.data(), code.size());
+		DWORD previous;
+		if (!VirtualProtect(p, code.size(), PAGE_EXECUTE_READ, &previous)) {
+			VirtualFree(p, 0, MEM_RELEASE);
+			return nullptr;
+		}
+		FlushInstructionCache(GetCurrentProcess(), p, code.size());
+		return p;
+#else
+		void* p = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) return nullptr;
+		memcpy(p, code.data(), code.size());
+		if (mprotect(p, code.size(), PROT_READ | PROT_EXEC) != 0) {
+			munmap(p, code.size());
+			return nullptr;
+		}
+		return p;
+#endif
+	}
+
+#ifdef _WIN32
+	// The unwind data of a generated function, so that Windows can walk the stack through it when an exception is raised or a
+	// debugger stops in it.  Each operation of the prolog is recorded with the position just after its instruction.
+	class UnwindInfo {
+
+	public:
+
+		void Push(size_t position, int r) { Add(position, UWOP_PUSH_NONVOL, r, {}); }
+
+		void Allocate(size_t position, uint32_t bytes) {
+			if (bytes <= 128) Add(position, UWOP_ALLOC_SMALL, (int)(bytes - 8) / 8, {});
+			else Add(position, UWOP_ALLOC_LARGE, 0, { (uint16_t)(bytes / 8) });
+		}
+
+		void SaveXmm(size_t position, int xmm, uint32_t offset) { Add(position, UWOP_SAVE_XMM128, xmm, { (uint16_t)(offset / 16) }); }
+
+		// An UNWIND_INFO for a prolog of this size.  The codes are listed last operation first, as the unwinder undoes them.
+		std::vector<uint8_t> Get(size_t prologSize) const {
+			std::vector<uint16_t> slots;
+			for (auto code = _codes.rbegin(); code != _codes.rend(); ++code) slots.insert(slots.end(), code->begin(), code->end());
+
+			// The array is padded to an even length, and the padding is not counted
+			std::vector<uint8_t> info = { 1, (uint8_t)prologSize, (uint8_t)slots.size(), 0 };
+			if (slots.size() % 2 != 0) slots.push_back(0);
+			for (uint16_t slot : slots) {
+				info.push_back((uint8_t)slot);
+				info.push_back((uint8_t)(slot >> 8));
+			}
+			return info;
+		}
+
+	private:
+
+		enum Operation { UWOP_PUSH_NONVOL = 0, UWOP_ALLOC_LARGE = 1, UWOP_ALLOC_SMALL = 2, UWOP_SAVE_XMM128 = 8 };
+
+		void Add(size_t position, Operation operation, int info, std::initializer_list<uint16_t> operands) {
+			std::vector<uint16_t> code = { (uint16_t)(position | operation << 8 | info << 12) };
+			code.insert(code.end(), operands);
+			_codes.push_back(code);
+		}
+
+		std::vector<std::vector<uint16_t>> _codes;
+	};
+
+	// Maps a function whose prolog is described by unwind, with its function table entry and unwind data after the code in the
+	// same memory, and registers the table.  Returns nullptr if either step fails.
+	static void* MapFunction(const std::vector<uint8_t>& code, const std::vector<uint8_t>& unwind) {
+		size_t tableOffset = (code.size() + 3) / 4 * 4;
+		size_t unwindOffset = tableOffset + sizeof(RUNTIME_FUNCTION);
+
+		std::vector<uint8_t> image(code);
+		image.resize(unwindOffset);
+		RUNTIME_FUNCTION function;
+		function.BeginAddress = 0;
+		function.EndAddress = (DWORD)code.size();
+		function.UnwindData = (DWORD)unwindOffset;
+		memcpy(image.data() + tableOffset, &function, sizeof(function));
+		image.insert(image.end(), unwind.begin(), unwind.end());
+
+		uint8_t* p = (uint8_t*)MapCode(image);
+		if (p == nullptr) return nullptr;
+		if (!RtlAddFunctionTable((PRUNTIME_FUNCTION)(p + tableOffset), 1, (DWORD64)p)) {
+			VirtualFree(p, 0, MEM_RELEASE);
+			return nullptr;
+		}
+		return p;
+	}
+#endif
+
+	bool ParityJit::IsSupported() {
+		// Runs a function that returns straight away, so a host that maps the memory but won't execute it fails here once
+		static const bool supported = [] {
+			Assembler a;
+			a.Ret();
+			void* p = MapCode(a.GetCode());
+			if (p == nullptr) return false;
+			((void(*)())p)();
+			return true;
+		}();
+		return supported;
+	}
+
+	ParityRunKernel ParityJit::Generate(size_t blocks, size_t codewordsPerSlice, size_t runLength) {
+		const int32_t tableBytes = GF16MultiplicationTable::TABLE_BLOCKS * 16;
+		const int32_t highOffset = tableBytes / 2;
+		const int32_t stride = (int32_t)(codewordsPerSlice * 16);
+
+		// The slice pointers and the loop state are kept in registers that neither convention passes arguments in
+		const int tables = R10;
+		const int parity = R11;
+		const int count = RBX;
+		const int low = RAX;
+		const int high = RCX;
+		const int slices[PARITY_RUN_TABLES] = { R12, R13, R14, R15 };
+
+		const int saved[5] = { RBX, R12, R13, R14, R15 };
+
+		Assembler a;
+#ifdef _WIN32
+		UnwindInfo unwind;
+#endif
+		for (int r : saved) {
+			a.Push(r);
+#ifdef _WIN32
+			unwind.Push(a.GetPosition(), r);
+#endif
+		}
+
+#ifdef _WIN32
+		// xmm6 to xmm15 belong to the caller
+		int savedXmm = blocks > 6 ? (int)blocks - 6 : 0;
+		if (savedXmm > 0) {
+			a.Sub(RSP, 16 * savedXmm);
+			unwind.Allocate(a.GetPosition(), 16 * savedXmm);
+		}
+		for (int i = 0; i < savedXmm; i++) {
+			a.StoreUnaligned(6 + i, RSP, 16 * i);
+			unwind.SaveXmm(a.GetPosition(), 6 + i, 16 * i);
+		}
+		size_t prologSize = a.GetPosition();
+		const int arguments[4] = { RCX, RDX, R8, R9 };
+#else
+		const int arguments[4] = { RDI, RSI, RDX, RCX };
+#endif
+		a.Mov(tables, arguments[0]);
+		for (size_t d = 0; d < runLength; d++) a.Load(slices[d], arguments[1], (int32_t)(8 * d));
+		a.Mov(parity, arguments[2]);
+
+		// Two codewords per iteration when both sets of accumulators fit in registers, for more independent work per loop
+		size_t perIteration = 2 * blocks <= MAX_BLOCKS ? 2 : 1;
+		size_t iterations = codewordsPerSlice / perIteration;
+
+		// Accumulates perIteration codewords, the second in the registers after the first
+		auto body = [&](size_t codewords) {
+			const int indexes[2][2] = { { low, high }, { RDX, R8 } };
+			for (size_t k = 0; k < codewords; k++) {
+				for (size_t b = 0; b < blocks; b++) a.LoadAligned((int)(k * blocks + b), parity, (int32_t)(b * stride + 16 * k));
+			}
+			for (size_t d = 0; d < runLength; d++) {
+				for (size_t k = 0; k < codewords; k++) {
+					a.LoadByte(indexes[k][0], slices[d], (int32_t)(2 * k));
+					a.LoadByte(indexes[k][1], slices[d], (int32_t)(2 * k + 1));
+					a.ShiftLeft32(indexes[k][0], 4);
+					a.ShiftLeft32(indexes[k][1], 4);
+				}
+				for (size_t b = 0; b < blocks; b++) {
+					int32_t table = (int32_t)((d * blocks + b) * tableBytes);
+					for (size_t k = 0; k < codewords; k++) {
+						a.Xor((int)(k * blocks + b), tables, indexes[k][0], table);
+						a.Xor((int)(k * blocks + b), tables, indexes[k][1], table + highOffset);
+					}
+				}
+			}
+			for (size_t k = 0; k < codewords; k++) {
+				for (size_t b = 0; b < blocks; b++) a.StoreAligned((int)(k * blocks + b), parity, (int32_t)(b * stride + 16 * k));
+			}
+			for (size_t d = 0; d < runLength; d++) a.Add(slices[d], (int32_t)(2 * codewords));
+			a.Add(parity, (int32_t)(16 * codewords));
+		};
+
+		// The codeword count is fixed along with the stride, so the count argument is not read
+		if (iterations > 0) {
+			a.MovImmediate32(count, (uint32_t)iterations);
+			size_t loop = a.GetPosition();
+			body(perIteration);
+			a.Dec(count);
+			a.JumpIfNotZero(loop);
+		}
+		if (codewordsPerSlice % perIteration != 0) body(1);
+
+#ifdef _WIN32
+		for (int i = 0; i < savedXmm; i++) a.LoadUnaligned(6 + i, RSP, 16 * i);
+		if (savedXmm > 0) a.Add(RSP, 16 * savedXmm);
+#endif
+		for (int i = 4; i >= 0; i--) a.Pop(saved[i]);
+		a.Ret();
+
+#ifdef _WIN32
+		return (ParityRunKernel)MapFunction(a.GetCode(), unwind.Get(prologSize));
+#else
+		return (ParityRunKernel)MapCode(a.GetCode());
+#endif
+	}
+
+#else
+
+	bool ParityJit::IsSupported() { return false; }
+
+	ParityRunKernel ParityJit::Generate(size_t blocks, size_t codewordsPerSlice, size_t runLength) { return nullptr; }
+
+#endif
+
+	std::atomic<bool> ParityJit::_enabled(true);
+	std::mutex ParityJit::_lock;
+	std::map<std::tuple<size_t, size_t, size_t>, void*> ParityJit::_kernels;
+
+	void ParityJit::SetEnabled(bool enabled) { _enabled = enabled; }
+
+	bool ParityJit::IsEnabled() { return _enabled; }
+
+	ParityRunKernel ParityJit::GetKernel(size_t nParityCodewords, size_t codewordsPerSlice, size_t& runLength) {
+		size_t blocks = (nParityCodewords + 7) / 8;
+		if (!_enabled || blocks == 0 || blocks > MAX_BLOCKS || codewordsPerSlice == 0) return nullptr;
+
+		// Every offset into the accumulator has to fit in a 32-bit displacement
+		if ((blocks - 1) * codewordsPerSlice * 16 > (size_t)INT32_MAX) return nullptr;
+		if (!IsSupported()) return nullptr;
+
+		size_t maxRunLength = (size_t)GetMaxParityRunLength((int)nParityCodewords);
+		if (runLength == 0 || runLength > maxRunLength) runLength = maxRunLength;
+
+		std::lock_guard<std::mutex> lock(_lock);
+		auto key = std::make_tuple(blocks, codewordsPerSlice, runLength);
+		auto found = _kernels.find(key);
+		if (found != _kernels.end()) return (ParityRunKernel)found->second;
+
+		ParityRunKernel kernel = Generate(blocks, codewordsPerSlice, runLength);
+		if (kernel != nullptr) _kernels[key] = (void*)kernel;
+		return kernel;
+	}
+
+	size_t ParityJit::GetKernelCount() {
+		std::lock_guard<std::mutex> lock(_lock);
+		return _kernels.size();
+	}
+
+	bool ParityJit_IsSupported() { return ParityJit::IsSupported(); }
+
+	void ParityJit_SetEnabled(bool enabled) { ParityJit::SetEnabled(enabled); }
+
+	bool ParityJit_IsEnabled() { return ParityJit::IsEnabled(); }
+
+	size_t ParityJit_GetKernelCount() { return ParityJit::GetKernelCount(); }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include "ParityKernel.h"
+
+namespace ReedSolomon {
+
+	// Generates x86-64 run kernels specialized to one geometry, for parity counts that have no template kernel as well as those
+	// that do.
+	//
+	// A generated kernel does what ParityKernel does, with the codewords per slice fixed as well as the parity count and run
+	// length: the accumulator blocks live in xmm registers, the slice and block loops are fully unrolled, and every table and
+	// accumulator offset is a constant in the instruction.  Kernels are generated the first time a geometry asks for one and kept
+	// for the life of the process.  Without x86-64, or where the process may not map executable memory, GetKernel returns nullptr
+	// and the template or generic kernels are used.  On Windows each kernel is registered with unwind data for its prolog, so
+	// exceptions and debuggers can walk the stack through it.
+	class ParityJit {
+
+	public:
+
+		// The most accumulator blocks a kernel holds in registers, leaving none spare, so up to 128 parity codewords
+		static const size_t MAX_BLOCKS = 16;
+
+		// Whether this process can run generated code
+		static bool IsSupported();
+
+		// Generation can be turned off, to compare against the other kernels.  Kernels already handed out stay valid.
+		static void SetEnabled(bool enabled);
+		static bool IsEnabled();
+
+		// The kernel for this geometry and run length, generated now if it has not been, or nullptr if generation is off or
+		// unavailable.  runLength is rounded down as for GetParityRunKernel.
+		static ParityRunKernel GetKernel(size_t nParityCodewords, size_t codewordsPerSlice, size_t& runLength);
+
+		// The number of kernels generated so far
+		static size_t GetKernelCount();
+
+	private:
+
+		static ParityRunKernel Generate(size_t blocks, size_t codewordsPerSlice, size_t runLength);
+
+		static std::atomic<bool> _enabled;
+		static std::mutex _lock;
+		// Keyed by blocks, codewords per slice and run length
+		static std::map<std::tuple<size_t, size_t, size_t>, void*> _kernels;
+	};
+
+	// The run kernel for a geometry: a generated one if possible, otherwise the template kernel for the parity count, or nullptr
+	// for the generic path.  runLength is as for GetParityRunKernel.
+	inline ParityRunKernel GetGeometryRunKernel(size_t nParityCodewords, size_t codewordsPerSlice, size_t& runLength) {
+		size_t generatedLength = runLength;
+		ParityRunKernel kernel = ParityJit::GetKernel(nParityCodewords, codewordsPerSlice, generatedLength);
+		if (kernel != nullptr) {
+			runLength = generatedLength;
+			return kernel;
+		}
+		return GetParityRunKernel(nParityCodewords, runLength);
+	}
+
+	extern "C" {
+		__declspec(dllexport) bool ParityJit_IsSupported();
+		__declspec(dllexport) void ParityJit_SetEnabled(bool enabled);
+		__declspec(dllexport) bool ParityJit_IsEnabled();
+		__declspec(dllexport) size_t ParityJit_GetKernelCount();
+	}
+}
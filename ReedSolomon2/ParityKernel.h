@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <immintrin.h>
+#include "GF16MultiplicationTable.h"
+
+namespace ReedSolomon {
+
+	// Encode kernels for a run of data slices with a parity count fixed at compile time.
+	//
+	// The generic path in Parity::Calculate streams the accumulator through memory once per parity block of every data slice.
+	// These kernels walk the codewords once per run instead: all accumulator blocks of a codeword are loaded into registers, every
+	// slice of the run is multiplied into them, and they are stored back.  tables holds one GF16MultiplicationTable layout per
+	// (slice, parity block), slice-major, so every lookup is a constant offset from one base pointer.  The run is kept short enough
+	// for the tables to stay in L1.
+	typedef void(*ParityRunKernel)(const __m128i* tables, uint16_t* const* data, __m128i* parity, size_t codewordsPerSlice);
+
+	static const int PARITY_RUN_TABLES = 4;
+
+	// Operations on the BLOCKS accumulator blocks of one codeword, unrolled
+	template <int BLOCKS>
+	struct ParityBlockStep {
+		static inline void Load(__m128i* accumulator, const __m128i* parity, size_t stride) {
+			ParityBlockStep<BLOCKS - 1>::Load(accumulator, parity, stride);
+			accumulator[BLOCKS - 1] = _mm_load_si128(parity + (BLOCKS - 1) * stride);
+		}
+
+		static inline void Store(const __m128i* accumulator, __m128i* parity, size_t stride) {
+			ParityBlockStep<BLOCKS - 1>::Store(accumulator, parity, stride);
+			_mm_store_si128(parity + (BLOCKS - 1) * stride, accumulator[BLOCKS - 1]);
+		}
+
+		static inline void Accumulate(__m128i* accumulator, const __m128i* low, const __m128i* high) {
+			ParityBlockStep<BLOCKS - 1>::Accumulate(accumulator, low, high);
+			__m128i product = _mm_xor_si128(_mm_load_si128(low + (BLOCKS - 1) * GF16MultiplicationTable::TABLE_BLOCKS),
+				_mm_load_si128(high + (BLOCKS - 1) * GF16MultiplicationTable::TABLE_BLOCKS));
+			accumulator[BLOCKS - 1] = _mm_xor_si128(accumulator[BLOCKS - 1], product);
+		}
+	};
+
+	template <>
+	struct ParityBlockStep<0> {
+		static inline void Load(__m128i*, const __m128i*, size_t) {}
+		static inline void Store(const __m128i*, __m128i*, size_t) {}
+		static inline void Accumulate(__m128i*, const __m128i*, const __m128i*) {}
+	};
+
+	// Multiplies codeword c of the first SLICES slices into the accumulator blocks.  The recursion unrolls the slices and the
+	// blocks completely, so the table offsets are constants and the accumulators stay in registers.
+	template <int BLOCKS, int SLICES>
+	struct ParityRunStep {
+		static inline void Accumulate(__m128i* accumulator, const __m128i* tables, const uint16_t* const* data, size_t c) {
+			ParityRunStep<BLOCKS, SLICES - 1>::Accumulate(accumulator, tables, data, c);
+
+			uint16_t codeword = data[SLICES - 1][c];
+			const __m128i* table = tables + (SLICES - 1) * BLOCKS * GF16MultiplicationTable::TABLE_BLOCKS;
+			const __m128i* low = table + (codeword & 0xff);
+			const __m128i* high = table + 256 + (codeword >> 8);
+			ParityBlockStep<BLOCKS>::Accumulate(accumulator, low, high);
+		}
+	};
+
+	template <int BLOCKS>
+	struct ParityRunStep<BLOCKS, 0> {
+		static inline void Accumulate(__m128i*, const __m128i*, const uint16_t* const*, size_t) {}
+	};
+
+	// The longest run whose tables fit in PARITY_RUN_TABLES table sets
+	constexpr int GetMaxParityRunLength(int nParity) {
+		return (nParity + 7) / 8 < PARITY_RUN_TABLES ? PARITY_RUN_TABLES / ((nParity + 7) / 8) : 1;
+	}
+
+	template <int NPARITY, int RUN_LENGTH = GetMaxParityRunLength(NPARITY)>
+	struct ParityKernel {
+
+		static const int BLOCKS = (NPARITY + 7) / 8;
+
+		static void CalculateRun(const __m128i* tables, uint16_t* const* data, __m128i* parity, size_t codewordsPerSlice) {
+			const uint16_t* slices[RUN_LENGTH];
+			for (int d = 0; d < RUN_LENGTH; d++) slices[d] = data[d];
+
+			for (size_t c = 0; c < codewordsPerSlice; c++) {
+				__m128i accumulator[BLOCKS];
+				ParityBlockStep<BLOCKS>::Load(accumulator, parity + c, codewordsPerSlice);
+				ParityRunStep<BLOCKS, RUN_LENGTH>::Accumulate(accumulator, tables, slices, c);
+				ParityBlockStep<BLOCKS>::Store(accumulator, parity + c, codewordsPerSlice);
+			}
+		}
+	};
+
+	// Rounds runLength down to a run length with a kernel, 0 meaning the longest, and returns that kernel
+	template <int NPARITY>
+	inline ParityRunKernel SelectParityRunKernel(size_t& runLength) {
+		const size_t maxRunLength = GetMaxParityRunLength(NPARITY);
+		if (runLength == 0 || runLength > maxRunLength) runLength = maxRunLength;
+		if (runLength >= 4) {
+			runLength = 4;
+			return &ParityKernel<NPARITY, 4>::CalculateRun;
+		}
+		if (runLength >= 2) {
+			runLength = 2;
+			return &ParityKernel<NPARITY, 2>::CalculateRun;
+		}
+		return &ParityKernel<NPARITY, 1>::CalculateRun;
+	}
+
+	// Returns the specialized kernel for this parity count, or nullptr if there is none and the generic path has to be used.
+	// runLength is the number of slices wanted per call, or 0 for the longest, and is set to the number the kernel takes.
+	inline ParityRunKernel GetParityRunKernel(size_t nParityCodewords, size_t& runLength) {
+		switch (nParityCodewords) {
+		case 4: return SelectParityRunKernel<4>(runLength);
+		case 8: return SelectParityRunKernel<8>(runLength);
+		case 16: return SelectParityRunKernel<16>(runLength);
+		case 32: return SelectParityRunKernel<32>(runLength);
+		default: runLength = 1; return nullptr;
+		}
+	}
+}
@@ -0,0 +1,231 @@
+#include "stdafx.h"
+#include "ParityTuner.h"
+#include "Parity.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace ReedSolomon {
+
+	// Each variant is timed for at least this long
+	static const double MIN_MEASURE_SECONDS = 0.02;
+
+	// The timing uses at most this many distinct data slices; the cost per slice does not depend on how many there are
+	static const size_t MAX_MEASURE_SLICES = 16;
+
+	// A thread count is chosen if it is within this fraction of the best throughput, so the smallest adequate count wins
+	static const double THREAD_TOLERANCE = 0.95;
+
+	static const char PROFILE_HEADER[] = "# ReedSolomon parity tuning: cpu, data, parity, codewords per slice, run length, threads";
+
+	std::mutex ParityTuner::_lock;
+	std::vector<ParityTuner::Entry> ParityTuner::_entries;
+
+	const std::string& ParityTuner::GetCpuModel() {
+		static const std::string model = [] {
+			unsigned int registers[12] = {};
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0x80000000);
+			if ((unsigned int)info[0] >= 0x80000004) {
+				for (int i = 0; i < 3; i++) __cpuid((int*)registers + 4 * i, 0x80000002 + i);
+			}
+#else
+			if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004) {
+				for (unsigned int i = 0; i < 3; i++) {
+					__get_cpuid(0x80000002 + i, registers + 4 * i, registers + 4 * i + 1, registers + 4 * i + 2, registers + 4 * i + 3);
+				}
+			}
+#endif
+			std::string brand((const char*)registers, strnlen((const char*)registers, sizeof(registers)));
+			size_t first = brand.find_first_not_of(' ');
+			size_t last = brand.find_last_not_of(' ');
+			return first == std::string::npos ? std::string("unknown") : brand.substr(first, last - first + 1);
+		}();
+		return model;
+	}
+
+	bool ParityTuner::LoadProfile(const char* path) {
+		std::ifstream file(path);
+		if (!file) return false;
+
+		std::string line;
+		while (std::getline(file, line)) {
+			size_t tab = line.find('\t');
+			if (line.empty() || line[0] == '#' || tab == std::string::npos) continue;
+
+			Entry entry;
+			entry.cpuModel = line.substr(0, tab);
+			std::istringstream fields(line.substr(tab + 1));
+			if (!(fields >> entry.nDataCodewords >> entry.nParityCodewords >> entry.codewordsPerSlice >> entry.tuning.runLength >>
+				entry.tuning.threads)) continue;
+			if (entry.tuning.runLength < 0 || entry.tuning.threads < 1) continue;
+			Add(entry);
+		}
+		return true;
+	}
+
+	bool ParityTuner::SaveProfile(const char* path) {
+		std::ofstream file(path, std::ios::trunc);
+		if (!file) return false;
+
+		file << PROFILE_HEADER << '\n';
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			for (auto& entry : _entries) {
+				file << entry.cpuModel << '\t' << entry.nDataCodewords << '\t' << entry.nParityCodewords << '\t' <<
+					entry.codewordsPerSlice << '\t' << entry.tuning.runLength << '\t' << entry.tuning.threads << '\n';
+			}
+		}
+
+		file.close();
+		return !file.fail();
+	}
+
+	void ParityTuner::Add(const Entry& entry) {
+		std::lock_guard<std::mutex> lock(_lock);
+		for (auto& e : _entries) {
+			if (e.cpuModel == entry.cpuModel && e.nDataCodewords == entry.nDataCodewords && e.nParityCodewords == entry.nParityCodewords &&
+				e.codewordsPerSlice == entry.codewordsPerSlice) {
+				e.tuning = entry.tuning;
+				return;
+			}
+		}
+		_entries.push_back(entry);
+	}
+
+	bool ParityTuner::Find(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, ParityTuning& tuning) {
+		const std::string& cpuModel = GetCpuModel();
+		std::lock_guard<std::mutex> lock(_lock);
+		for (auto& e : _entries) {
+			if (e.cpuModel == cpuModel && e.nDataCodewords == nDataCodewords && e.nParityCodewords == nParityCodewords &&
+				e.codewordsPerSlice == codewordsPerSlice) {
+				tuning = e.tuning;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ParityTuner::Tune(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, ParityTuning& tuning) {
+		if (Find(nDataCodewords, nParityCodewords, codewordsPerSlice, tuning)) return false;
+
+		tuning = Measure(nDataCodewords, nParityCodewords, codewordsPerSlice);
+
+		Entry entry;
+		entry.cpuModel = GetCpuModel();
+		entry.nDataCodewords = nDataCodewords;
+		entry.nParityCodewords = nParityCodewords;
+		entry.codewordsPerSlice = codewordsPerSlice;
+		entry.tuning = tuning;
+		Add(entry);
+		return true;
+	}
+
+	ParityTuning ParityTuner::Measure(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice) {
+		typedef std::chrono::steady_clock Clock;
+
+		size_t nSlices = std::min(nDataCodewords, MAX_MEASURE_SLICES);
+		std::vector<uint16_t> data(nSlices * codewordsPerSlice);
+		std::mt19937 random(1);
+		for (auto& codeword : data) codeword = (uint16_t)random();
+
+		std::vector<uint16_t*> slices(nSlices);
+		std::vector<size_t> exponents(nSlices);
+		for (size_t i = 0; i < nSlices; i++) {
+			slices[i] = data.data() + i * codewordsPerSlice;
+			exponents[i] = nParityCodewords + i;
+		}
+
+		// Run lengths with a kernel of their own, after the generic path
+		std::vector<int32_t> candidates(1, 0);
+		for (size_t runLength = 1; runLength <= PARITY_RUN_TABLES; runLength *= 2) {
+			size_t actual = runLength;
+			if (GetGeometryRunKernel(nParityCodewords, codewordsPerSlice, actual) != nullptr && actual == runLength) candidates.push_back((int32_t)runLength);
+		}
+
+		ParityTuning best = { 0, 1 };
+		double bestSeconds = 0;
+		size_t repetitions = 1;
+
+		for (int32_t runLength : candidates) {
+			Parity parity(nDataCodewords, nParityCodewords, codewordsPerSlice);
+			ParityTuning tuning = { runLength, 1 };
+			parity.SetTuning(tuning);
+
+			size_t count = 0;
+			Clock::time_point start = Clock::now();
+			double seconds;
+			do {
+				parity.Reset();
+				parity.CalculateRun(slices.data(), exponents.data(), nSlices);
+				count++;
+				seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			} while (seconds < MIN_MEASURE_SECONDS);
+
+			if (bestSeconds == 0 || seconds / count < bestSeconds) {
+				best = tuning;
+				bestSeconds = seconds / count;
+				repetitions = count;
+			}
+		}
+
+		// Time the best kernel on an independent accumulator per thread, doubling the thread count up to the hardware threads
+		unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<unsigned> threadCounts;
+		for (unsigned threads = 1; threads < hardwareThreads; threads *= 2) threadCounts.push_back(threads);
+		threadCounts.push_back(hardwareThreads);
+
+		double bestThroughput = 0;
+		std::vector<double> throughputs;
+		for (unsigned threads : threadCounts) {
+			auto run = [&] {
+				Parity parity(nDataCodewords, nParityCodewords, codewordsPerSlice);
+				parity.SetTuning(best);
+				for (size_t i = 0; i < repetitions; i++) {
+					parity.Reset();
+					parity.CalculateRun(slices.data(), exponents.data(), nSlices);
+				}
+			};
+
+			Clock::time_point start = Clock::now();
+			std::vector<std::thread> workers;
+			for (unsigned i = 1; i < threads; i++) workers.emplace_back(run);
+			run();
+			for (auto& worker : workers) worker.join();
+			double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+			throughputs.push_back(threads * repetitions / seconds);
+			bestThroughput = std::max(bestThroughput, throughputs.back());
+		}
+
+		for (size_t i = 0; i < threadCounts.size(); i++) {
+			if (throughputs[i] >= THREAD_TOLERANCE * bestThroughput) {
+				best.threads = (int32_t)threadCounts[i];
+				break;
+			}
+		}
+		return best;
+	}
+
+	bool ParityTuner_LoadProfile(const char* path) { return ParityTuner::LoadProfile(path); }
+
+	bool ParityTuner_SaveProfile(const char* path) { return ParityTuner::SaveProfile(path); }
+
+	bool ParityTuner_Find(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, ParityTuning* tuning) {
+		return ParityTuner::Find(nDataCodewords, nParityCodewords, codewordsPerSlice, *tuning);
+	}
+
+	bool ParityTuner_Tune(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, ParityTuning* tuning) {
+		return ParityTuner::Tune(nDataCodewords, nParityCodewords, codewordsPerSlice, *tuning);
+	}
+}
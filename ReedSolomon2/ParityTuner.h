@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ReedSolomon {
+
+	// The encode configuration chosen for one geometry on one CPU
+	struct ParityTuning {
+		// Slices per call of the register-blocked kernel, or 0 for the generic table path
+		int32_t runLength;
+		// Encoding threads past which the throughput stops improving
+		int32_t threads;
+	};
+
+	// Picks the fastest encode configuration for a geometry by timing the variants on this machine, and keeps the results in a
+	// profile so that the timing only happens once per CPU model and geometry.
+	//
+	// Parity looks up the tuning for its geometry when it is constructed, so loading the profile, or tuning, before the codec objects
+	// are created is all a caller has to do.  The profile is a text file with one tab-separated line per CPU model and geometry.
+	// Entries for other CPU models are kept, so one profile can be shared between machines.
+	class ParityTuner {
+
+	public:
+
+		// Adds the entries of a profile to the ones already known.  Returns false if the file cannot be read.
+		static bool LoadProfile(const char* path);
+
+		// Writes every known entry to a profile.  Returns false if the file cannot be written.
+		static bool SaveProfile(const char* path);
+
+		// The tuning for this geometry on this CPU, if it is known
+		static bool Find(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, ParityTuning& tuning);
+
+		// The tuning for this geometry on this CPU, timing the variants first if it is not known.  Returns true if it was timed.
+		static bool Tune(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, ParityTuning& tuning);
+
+		static const std::string& GetCpuModel();
+
+	private:
+
+		struct Entry {
+			std::string cpuModel;
+			size_t nDataCodewords;
+			size_t nParityCodewords;
+			size_t codewordsPerSlice;
+			ParityTuning tuning;
+		};
+
+		static ParityTuning Measure(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice);
+		static void Add(const Entry& entry);
+
+		static std::mutex _lock;
+		static std::vector<Entry> _entries;
+	};
+
+	extern "C" {
+		__declspec(dllexport) bool ParityTuner_LoadProfile(const char* path);
+		__declspec(dllexport) bool ParityTuner_SaveProfile(const char* path);
+		__declspec(dllexport) bool ParityTuner_Find(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, ParityTuning* tuning);
+		__declspec(dllexport) bool ParityTuner_Tune(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice, ParityTuning* tuning);
+	}
+}
@@ -0,0 +1,105 @@
+#include "stdafx.h"
+#include "RangeRepair.h"
+#include "Repair.h"
+#include "SquareMatrix.h"
+#include "GF16.h"
+#include "BufferPool.h"
+#include <stdexcept>
+
+namespace ReedSolomon {
+
+	static const int CODEWORDS_PER_SEGMENT = 8;
+	static const int BYTES_PER_CODEWORD = 2;
+
+	RangeRepair::RangeRepair(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerRange, int* errorLocations, int errorCount) :
+		_nParityCodewords(nParityCodewords), _nDataCodewords(nDataCodewords), _codewordsPerRange(codewordsPerRange),
+		_errorCount(errorCount), _multiplicationTable() {
+
+		if (errorCount <= 0) throw std::invalid_argument("No errors to repair");
+		if ((size_t)errorCount > nParityCodewords) throw std::invalid_argument("Too many errors");
+
+		size_t totalCodewords = nDataCodewords + nParityCodewords;
+
+		_isErasure = new bool[totalCodewords];
+		for (size_t i = 0; i < totalCodewords; i++) _isErasure[i] = false;
+		for (int i = 0; i < errorCount; i++) {
+			if (errorLocations[i] < 0 || (size_t)errorLocations[i] >= totalCodewords) {
+				delete[] _isErasure;
+				throw std::invalid_argument("Error location out of range");
+			}
+			_isErasure[errorLocations[i]] = true;
+		}
+
+		SquareMatrix correctionMatrix(errorCount);
+		Repair::CreateCorrectionMatrix(correctionMatrix, errorLocations, errorCount);
+
+		// The erasure values are correctionMatrix * S, where S[j] is the sum over the surviving slices of a^(j * exponent) * slice.
+		// Folding the matrix into the syndrome vectors gives one coefficient per (surviving slice, erasure) pair.
+		_segmentsPerVector = (errorCount + CODEWORDS_PER_SEGMENT - 1) / CODEWORDS_PER_SEGMENT;
+		size_t codewordsPerVector = _segmentsPerVector * CODEWORDS_PER_SEGMENT;
+		_vectors = (uint16_t*)BufferPool::Allocate(codewordsPerVector * sizeof(uint16_t) * totalCodewords);
+
+		uint16_t* currentVector = _vectors;
+		for (size_t exponent = 0; exponent < totalCodewords; exponent++, currentVector += codewordsPerVector) {
+			for (size_t i = 0; i < codewordsPerVector; i++) currentVector[i] = 0;
+			if (_isErasure[exponent]) continue;
+
+			for (int j = 0; j < errorCount; j++) {
+				uint16_t syndromeCoefficient = GF16::Exp((int)((j * exponent) % GF16::MAX_VALUE));
+				for (int m = 0; m < errorCount; m++) {
+					currentVector[m] = GF16::Add(currentVector[m], GF16::Multiply(correctionMatrix[m][j], syndromeCoefficient));
+				}
+			}
+		}
+
+		_reconstruction = (__m128i*)BufferPool::Allocate(codewordsPerVector * BYTES_PER_CODEWORD * _codewordsPerRange);
+		Reset();
+	}
+
+	RangeRepair::~RangeRepair() {
+		delete[] _isErasure;
+		size_t codewordsPerVector = _segmentsPerVector * CODEWORDS_PER_SEGMENT;
+		BufferPool::Free(_vectors, codewordsPerVector * sizeof(uint16_t) * (_nDataCodewords + _nParityCodewords));
+		BufferPool::Free(_reconstruction, codewordsPerVector * BYTES_PER_CODEWORD * _codewordsPerRange);
+	}
+
+	void RangeRepair::Reset() {
+		memset(_reconstruction, 0, BYTES_PER_CODEWORD * CODEWORDS_PER_SEGMENT * _segmentsPerVector * _codewordsPerRange);
+	}
+
+	void RangeRepair::AddCodewordSlice(uint16_t* data, size_t exponent) {
+		if (_isErasure[exponent]) return;
+
+		__m128i* vectorSegment = (__m128i*)_vectors + _segmentsPerVector * exponent;
+		__m128i* dest = _reconstruction;
+
+		for (size_t i = 0; i < _segmentsPerVector; i++, vectorSegment++) {
+			_multiplicationTable.Set(*vectorSegment);
+			_multiplicationTable.MultiplyAndXor(data, dest, _codewordsPerRange);
+			dest += _codewordsPerRange;
+		}
+	}
+
+	void RangeRepair::GetCorrection(int errorLocationOffset, uint16_t* data) const {
+
+		size_t segment = errorLocationOffset / CODEWORDS_PER_SEGMENT;
+		size_t segmentOffset = errorLocationOffset % CODEWORDS_PER_SEGMENT;
+
+		uint16_t* p = (uint16_t*)(_reconstruction + segment * _codewordsPerRange) + segmentOffset;
+		for (size_t i = 0; i < _codewordsPerRange; i++, data++, p += CODEWORDS_PER_SEGMENT) {
+			*data = *p;
+		}
+	}
+
+	RangeRepair* RangeRepair_Construct(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerRange, int* errorLocations, int errorCount) {
+		return new RangeRepair(nDataCodewords, nParityCodewords, codewordsPerRange, errorLocations, errorCount);
+	}
+
+	void RangeRepair_Destruct(RangeRepair* p) { delete p; }
+
+	void RangeRepair_Reset(RangeRepair* p) { p->Reset(); }
+
+	void RangeRepair_AddCodewordSlice(RangeRepair* p, uint16_t* data, size_t exponent) { p->AddCodewordSlice(data, exponent); }
+
+	void RangeRepair_GetCorrection(const RangeRepair* p, int errorLocationOffset, uint16_t* data) { p->GetCorrection(errorLocationOffset, data); }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <immintrin.h>
+#include "GF16MultiplicationTable.h"
+
+namespace ReedSolomon {
+
+	// Reconstructs a range of codewords of one or more erased slices directly from the same range of the surviving slices.
+	//
+	// The decode is linear, so each erased codeword is a fixed combination of the surviving codewords at the same offset.  The
+	// coefficients are derived once for the erasure set, after which any range can be rebuilt without reading the rest of the track.
+	// Slices that the caller does not want to read may be listed as erasures too, so only nData slices need to be added.
+	class RangeRepair {
+
+	public:
+
+		RangeRepair(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerRange, int* errorLocations, int errorCount);
+		~RangeRepair();
+
+		void Reset();
+
+		// Adds the range of a surviving slice.  Slices listed as erasures are ignored.
+		void AddCodewordSlice(uint16_t* data, size_t exponent);
+
+		// Writes the reconstructed range of the erasure at errorLocationOffset into data.
+		void GetCorrection(int errorLocationOffset, uint16_t* data) const;
+
+		inline size_t GetNParityCodewords() const { return _nParityCodewords; }
+		inline size_t GetCodewordsPerRange() const { return _codewordsPerRange; }
+		inline int GetErrorCount() const { return _errorCount; }
+
+	private:
+
+		size_t _nParityCodewords;
+		size_t _nDataCodewords;
+		size_t _codewordsPerRange;
+
+		size_t _segmentsPerVector;
+
+		int _errorCount;
+		bool* _isErasure;
+
+		GF16MultiplicationTable _multiplicationTable;
+
+		uint16_t* _vectors;
+
+		__m128i* _reconstruction;
+	};
+
+	extern "C" {
+		__declspec(dllexport) RangeRepair* RangeRepair_Construct(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerRange, int* errorLocations, int errorCount);
+		__declspec(dllexport) void RangeRepair_Destruct(RangeRepair* p);
+		__declspec(dllexport) void RangeRepair_Reset(RangeRepair* p);
+		__declspec(dllexport) void RangeRepair_AddCodewordSlice(RangeRepair* p, uint16_t* data, size_t exponent);
+		__declspec(dllexport) void RangeRepair_GetCorrection(const RangeRepair* p, int errorLocationOffset, uint16_t* data);
+	}
+}
@@ -16,14 +16,17 @@ namespace ReedSolomon {
 		errorOrders = new int[errorCount];
 		for (int i = 0; i < errorCount; i++) errorOrders[i] = errorLocations[i];
 
-		// Create the correction matrix
+		CreateCorrectionMatrix(_correctionMatrix, errorOrders, errorCount);
+	}
+
+	void Repair::CreateCorrectionMatrix(SquareMatrix& matrix, int* errorLocations, int errorCount) {
 		for (int r = 0; r < errorCount; r++) {
 			for (int c = 0; c < errorCount; c++) {
-				_correctionMatrix[r][c] = GF16::Power(2, r * errorOrders[c]);
+				matrix[r][c] = GF16::Power(2, r * errorLocations[c]);
 			}
 		}
 
-		_correctionMatrix.Invert();
+		matrix.Invert();
 	}
 
 	Repair::~Repair() {
@@ -31,8 +34,24 @@ namespace ReedSolomon {
 	}
 
 	void Repair::Correction(int errorLocationOffset, uint16_t* data) const {
-		for (int i = 0; i < _rss.GetCodewordsPerSlice(); i++) {
-//			data[i] = 0;
+		CorrectRange(errorLocationOffset, data, 0, _rss.GetCodewordsPerSlice());
+	}
+
+	void Repair::CorrectRanges(int errorLocationOffset, uint16_t* data, const uint32_t* ranges, size_t rangeCount) const {
+		for (size_t i = 0; i < rangeCount; i++) {
+			size_t end = ranges[2 * i + 1] < _rss.GetCodewordsPerSlice() ? ranges[2 * i + 1] : _rss.GetCodewordsPerSlice();
+			if (ranges[2 * i] < end) CorrectRange(errorLocationOffset, data, ranges[2 * i], end);
+		}
+	}
+
+	void Repair::CorrectRange(int errorLocationOffset, uint16_t* data, size_t start, size_t end) const {
+		// A single error is syndrome 0, the XOR of every codeword, so it needs no multiplication
+		if (errorCount == 1) {
+			for (size_t i = start; i < end; i++) data[i] ^= _rss.GetSyndrome(i, 0);
+			return;
+		}
+
+		for (size_t i = start; i < end; i++) {
 			for (int j = 0; j < errorCount; j++) {
 				data[i] = GF16::Add(data[i], GF16::Multiply(_rss.GetSyndrome(i, j), _correctionMatrix[errorLocationOffset][j]));
 			}
@@ -51,6 +70,10 @@ namespace ReedSolomon {
 		rsr->Correction(errorLocationOffset, data);
 	}
 
+	void Repair_CorrectRanges(Repair* rsr, int errorLocationOffset, uint16_t* data, const uint32_t* ranges, size_t rangeCount) {
+		rsr->CorrectRanges(errorLocationOffset, data, ranges, rangeCount);
+	}
+
 	int Repair_GetNCodeWords(Repair* rsr) {
 		return rsr->GetNCodeWords();
 	}
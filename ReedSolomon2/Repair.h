@@ -15,8 +15,18 @@ namespace ReedSolomon {
 
 		void Correction(int errorLocationOffset, uint16_t* data) const;
 
+		// Corrects only the [start, end) codeword pairs of ranges, as Syndrome::GetDamagedRanges writes them.  If the damaged
+		// slice itself was added to the syndrome, data holds it as read and is corrected in place, and the codewords outside the
+		// ranges are already right.
+		void CorrectRanges(int errorLocationOffset, uint16_t* data, const uint32_t* ranges, size_t rangeCount) const;
+
+		// Builds the inverted matrix that maps the first errorCount syndromes onto the error values.
+		static void CreateCorrectionMatrix(SquareMatrix& matrix, int* errorLocations, int errorCount);
+
 	private:
 
+		void CorrectRange(int errorLocationOffset, uint16_t* data, size_t start, size_t end) const;
+
 		const Syndrome& _rss;
 		int _nCodeWords;
 		SquareMatrix _correctionMatrix;
@@ -28,6 +38,7 @@ namespace ReedSolomon {
 		__declspec(dllexport) Repair* Repair_Construct(const Syndrome* rss, int nCodeWords, int* errorLocations, int errorCount);
 		__declspec(dllexport) void Repair_Destruct(Repair* rsr);
 		__declspec(dllexport) void Repair_Correction(Repair* rsr, int errorLocationOffset, uint16_t* data);
+		__declspec(dllexport) void Repair_CorrectRanges(Repair* rsr, int errorLocationOffset, uint16_t* data, const uint32_t* ranges, size_t rangeCount);
 		__declspec(dllexport) int Repair_GetNCodeWords(Repair* rsr);
 	}
 }
\ No newline at end of file
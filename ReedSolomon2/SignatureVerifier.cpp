@@ -0,0 +1,548 @@
+#include "stdafx.h"
+#include "SignatureVerifier.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace ReedSolomon {
+
+	// Field elements modulo p = 2^521 - 1 are 18 limbs of 29 bits, so a product of two limbs fits in 58 bits and a whole column
+	// of a product, with the part above 2^522 folded back in (2^522 = 2 mod p), still fits in 64 bits.  Every operation returns
+	// its result with each limb below 2^29; only comparisons need the fully reduced value.
+	static const int LIMBS = 18;
+	static const int LIMB_BITS = 29;
+	static const uint64_t LIMB_MASK = (1ull << LIMB_BITS) - 1;
+
+	// Integers for scalars, and for moving values in and out, are 17 little-endian 32-bit words
+	static const int WORDS = 17;
+
+	// Scalars are taken 4 bits at a time; the order is below 2^521
+	static const int WINDOW_BITS = 4;
+	static const int WINDOWS = (521 + WINDOW_BITS - 1) / WINDOW_BITS;
+	static const int WINDOW_POINTS = (1 << WINDOW_BITS) - 1;
+
+	// Verifications a thread takes from the batch at a time
+	static const size_t VERIFY_CHUNK = 16;
+
+	namespace {
+
+		struct Fe {
+			uint64_t v[LIMBS];
+		};
+
+		struct Big {
+			uint32_t w[WORDS];
+		};
+
+		struct Affine {
+			Fe x;
+			Fe y;
+		};
+
+		struct Jacobian {
+			Fe x;
+			Fe y;
+			Fe z;
+			bool infinity;
+		};
+
+		const uint8_t ORDER_BYTES[SignatureVerifier::COORDINATE_BYTES] = {
+			0x01, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+			0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfa, 0x51, 0x86, 0x87, 0x83, 0xbf, 0x2f, 0x96, 0x6b, 0x7f, 0xcc,
+			0x01, 0x48, 0xf7, 0x09, 0xa5, 0xd0, 0x3b, 0xb5, 0xc9, 0xb8, 0x89, 0x9c, 0x47, 0xae, 0xbb, 0x6f, 0xb7, 0x1e, 0x91, 0x38, 0x64, 0x09
+		};
+
+		const uint8_t B_BYTES[SignatureVerifier::COORDINATE_BYTES] = {
+			0x00, 0x51, 0x95, 0x3e, 0xb9, 0x61, 0x8e, 0x1c, 0x9a, 0x1f, 0x92, 0x9a, 0x21, 0xa0, 0xb6, 0x85, 0x40, 0xee, 0xa2, 0xda, 0x72, 0x5b,
+			0x99, 0xb3, 0x15, 0xf3, 0xb8, 0xb4, 0x89, 0x91, 0x8e, 0xf1, 0x09, 0xe1, 0x56, 0x19, 0x39, 0x51, 0xec, 0x7e, 0x93, 0x7b, 0x16, 0x52,
+			0xc0, 0xbd, 0x3b, 0xb1, 0xbf, 0x07, 0x35, 0x73, 0xdf, 0x88, 0x3d, 0x2c, 0x34, 0xf1, 0xef, 0x45, 0x1f, 0xd4, 0x6b, 0x50, 0x3f, 0x00
+		};
+
+		const uint8_t GX_BYTES[SignatureVerifier::COORDINATE_BYTES] = {
+			0x00, 0xc6, 0x85, 0x8e, 0x06, 0xb7, 0x04, 0x04, 0xe9, 0xcd, 0x9e, 0x3e, 0xcb, 0x66, 0x23, 0x95, 0xb4, 0x42, 0x9c, 0x64, 0x81, 0x39,
+			0x05, 0x3f, 0xb5, 0x21, 0xf8, 0x28, 0xaf, 0x60, 0x6b, 0x4d, 0x3d, 0xba, 0xa1, 0x4b, 0x5e, 0x77, 0xef, 0xe7, 0x59, 0x28, 0xfe, 0x1d,
+			0xc1, 0x27, 0xa2, 0xff, 0xa8, 0xde, 0x33, 0x48, 0xb3, 0xc1, 0x85, 0x6a, 0x42, 0x9b, 0xf9, 0x7e, 0x7e, 0x31, 0xc2, 0xe5, 0xbd, 0x66
+		};
+
+		const uint8_t GY_BYTES[SignatureVerifier::COORDINATE_BYTES] = {
+			0x01, 0x18, 0x39, 0x29, 0x6a, 0x78, 0x9a, 0x3b, 0xc0, 0x04, 0x5c, 0x8a, 0x5f, 0xb4, 0x2c, 0x7d, 0x1b, 0xd9, 0x98, 0xf5, 0x44, 0x49,
+			0x57, 0x9b, 0x44, 0x68, 0x17, 0xaf, 0xbd, 0x17, 0x27, 0x3e, 0x66, 0x2c, 0x97, 0xee, 0x72, 0x99, 0x5e, 0xf4, 0x26, 0x40, 0xc5, 0x50,
+			0xb9, 0x01, 0x3f, 0xad, 0x07, 0x61, 0x35, 0x3c, 0x70, 0x86, 0xa2, 0x72, 0xc2, 0x40, 0x88, 0xbe, 0x94, 0x76, 0x9f, 0xd1, 0x66, 0x50
+		};
+	}
+
+	// Integers
+
+	static Big BigFromBytes(const uint8_t* bytes, size_t length) {
+		Big r = {};
+		for (size_t i = 0; i < length; i++) {
+			size_t bit = 8 * (length - 1 - i);
+			r.w[bit / 32] |= (uint32_t)bytes[i] << (bit % 32);
+		}
+		return r;
+	}
+
+	static int Compare(const Big& a, const Big& b) {
+		for (int i = WORDS - 1; i >= 0; i--) {
+			if (a.w[i] != b.w[i]) return a.w[i] < b.w[i] ? -1 : 1;
+		}
+		return 0;
+	}
+
+	static bool IsZero(const Big& a) {
+		for (int i = 0; i < WORDS; i++) {
+			if (a.w[i] != 0) return false;
+		}
+		return true;
+	}
+
+	// a - b, which must not be negative
+	static Big Subtract(const Big& a, const Big& b) {
+		Big r;
+		int64_t borrow = 0;
+		for (int i = 0; i < WORDS; i++) {
+			int64_t x = (int64_t)a.w[i] - b.w[i] - borrow;
+			borrow = x < 0 ? 1 : 0;
+			r.w[i] = (uint32_t)x;
+		}
+		return r;
+	}
+
+	// Arithmetic modulo the order n of the curve, in Montgomery form with R = 2^544
+	struct Order {
+		Big n;
+		Big rSquared;
+		uint32_t nPrime;
+
+		Order() {
+			n = BigFromBytes(ORDER_BYTES, sizeof(ORDER_BYTES));
+
+			// -1/n mod 2^32 by Newton's iteration, which doubles the correct bits each step
+			uint32_t inverse = n.w[0];
+			for (int i = 0; i < 5; i++) inverse *= 2 - n.w[0] * inverse;
+			nPrime = 0 - inverse;
+
+			// R^2 mod n by doubling 1, 2 * 544 times; n is below 2^521, so doubling never overflows
+			rSquared = Big();
+			rSquared.w[0] = 1;
+			for (int i = 0; i < 2 * 32 * WORDS; i++) {
+				uint32_t carry = 0;
+				for (int j = 0; j < WORDS; j++) {
+					uint32_t next = rSquared.w[j] >> 31;
+					rSquared.w[j] = (rSquared.w[j] << 1) | carry;
+					carry = next;
+				}
+				if (Compare(rSquared, n) >= 0) rSquared = Subtract(rSquared, n);
+			}
+		}
+
+		// a * b / R mod n, for a and b below n
+		Big Multiply(const Big& a, const Big& b) const {
+			uint32_t t[WORDS + 2] = {};
+			for (int i = 0; i < WORDS; i++) {
+				uint64_t carry = 0;
+				for (int j = 0; j < WORDS; j++) {
+					uint64_t x = (uint64_t)t[j] + (uint64_t)a.w[j] * b.w[i] + carry;
+					t[j] = (uint32_t)x;
+					carry = x >> 32;
+				}
+				uint64_t x = (uint64_t)t[WORDS] + carry;
+				t[WORDS] = (uint32_t)x;
+				t[WORDS + 1] = (uint32_t)(x >> 32);
+
+				uint32_t m = t[0] * nPrime;
+				x = (uint64_t)t[0] + (uint64_t)m * n.w[0];
+				carry = x >> 32;
+				for (int j = 1; j < WORDS; j++) {
+					x = (uint64_t)t[j] + (uint64_t)m * n.w[j] + carry;
+					t[j - 1] = (uint32_t)x;
+					carry = x >> 32;
+				}
+				x = (uint64_t)t[WORDS] + carry;
+				t[WORDS - 1] = (uint32_t)x;
+				t[WORDS] = t[WORDS + 1] + (uint32_t)(x >> 32);
+			}
+
+			Big r;
+			memcpy(r.w, t, sizeof(r.w));
+			if (t[WORDS] != 0 || Compare(r, n) >= 0) r = Subtract(r, n);
+			return r;
+		}
+
+		// 1/a * R mod n, for a in [1, n), by Fermat: a^(n-2)
+		Big InvertToMontgomery(const Big& a) const {
+			Big exponent = n;
+			exponent.w[0] -= 2;
+
+			Big aR = Multiply(a, rSquared);
+			Big one = {};
+			one.w[0] = 1;
+			Big r = Multiply(one, rSquared);
+			for (int bit = 32 * WORDS - 1; bit >= 0; bit--) {
+				r = Multiply(r, r);
+				if ((exponent.w[bit / 32] >> (bit % 32)) & 1) r = Multiply(r, aR);
+			}
+			return r;
+		}
+	};
+
+	static const Order& GetOrder() {
+		static const Order order;
+		return order;
+	}
+
+	// Field elements
+
+	static void Carry(Fe& a) {
+		uint64_t carry;
+		do {
+			carry = 0;
+			for (int i = 0; i < LIMBS; i++) {
+				a.v[i] += carry;
+				carry = a.v[i] >> LIMB_BITS;
+				a.v[i] &= LIMB_MASK;
+			}
+			a.v[0] += 2 * carry;
+		} while (carry != 0);
+	}
+
+	// Fully reduces a carried element, to below p
+	static void Reduce(Fe& a) {
+		for (;;) {
+			uint64_t top = a.v[LIMBS - 1] >> (LIMB_BITS - 1);
+			if (top == 0) break;
+			a.v[LIMBS - 1] &= LIMB_MASK >> 1;
+			a.v[0] += top;
+			Carry(a);
+		}
+
+		bool isP = a.v[LIMBS - 1] == (LIMB_MASK >> 1);
+		for (int i = 0; i < LIMBS - 1 && isP; i++) isP = a.v[i] == LIMB_MASK;
+		if (isP) memset(a.v, 0, sizeof(a.v));
+	}
+
+	static bool IsZero(const Fe& a) {
+		Fe r = a;
+		Reduce(r);
+		for (int i = 0; i < LIMBS; i++) {
+			if (r.v[i] != 0) return false;
+		}
+		return true;
+	}
+
+	// An integer below 2^522
+	static Fe FeFromBig(const Big& a) {
+		Fe r;
+		for (int i = 0; i < LIMBS; i++) {
+			int bit = LIMB_BITS * i;
+			uint64_t x = a.w[bit / 32];
+			if (bit / 32 + 1 < WORDS) x |= (uint64_t)a.w[bit / 32 + 1] << 32;
+			r.v[i] = (x >> (bit % 32)) & LIMB_MASK;
+		}
+		return r;
+	}
+
+	static Big BigFromFe(const Fe& a) {
+		Fe reduced = a;
+		Reduce(reduced);
+
+		Big r = {};
+		for (int i = 0; i < LIMBS; i++) {
+			int bit = LIMB_BITS * i;
+			uint64_t x = reduced.v[i] << (bit % 32);
+			r.w[bit / 32] |= (uint32_t)x;
+			if (bit / 32 + 1 < WORDS) r.w[bit / 32 + 1] |= (uint32_t)(x >> 32);
+		}
+		return r;
+	}
+
+	static Fe Add(const Fe& a, const Fe& b) {
+		Fe r;
+		for (int i = 0; i < LIMBS; i++) r.v[i] = a.v[i] + b.v[i];
+		Carry(r);
+		return r;
+	}
+
+	static Fe Subtract(const Fe& a, const Fe& b) {
+		// 4p, limb by limb, is above every carried limb of b
+		Fe r;
+		for (int i = 0; i < LIMBS - 1; i++) r.v[i] = a.v[i] + (LIMB_MASK << 2) - b.v[i];
+		r.v[LIMBS - 1] = a.v[LIMBS - 1] + ((LIMB_MASK >> 1) << 2) - b.v[LIMBS - 1];
+		Carry(r);
+		return r;
+	}
+
+	static Fe MultiplySmall(const Fe& a, uint64_t k) {
+		Fe r;
+		for (int i = 0; i < LIMBS; i++) r.v[i] = a.v[i] * k;
+		Carry(r);
+		return r;
+	}
+
+	static Fe Multiply(const Fe& a, const Fe& b) {
+		uint64_t t[2 * LIMBS - 1] = {};
+		for (int i = 0; i < LIMBS; i++) {
+			for (int j = 0; j < LIMBS; j++) t[i + j] += a.v[i] * b.v[j];
+		}
+		for (int k = 2 * LIMBS - 2; k >= LIMBS; k--) t[k - LIMBS] += 2 * t[k];
+
+		Fe r;
+		memcpy(r.v, t, sizeof(r.v));
+		Carry(r);
+		return r;
+	}
+
+	// A dedicated squaring takes half the products, but its triangular loop vectorizes worse and is slower
+	static Fe Square(const Fe& a) {
+		return Multiply(a, a);
+	}
+
+	// 1/a by Fermat: a^(p-2), where p - 2 = (2^519 - 1) * 4 + 1
+	static Fe Invert(const Fe& a) {
+		Fe r = a;
+		for (int i = 1; i < 519; i++) r = Multiply(Square(r), a);
+		r = Square(Square(r));
+		return Multiply(r, a);
+	}
+
+	// Points, on y^2 = x^3 - 3x + b
+
+	static void Double(Jacobian& r, const Jacobian& p) {
+		if (p.infinity) {
+			r.infinity = true;
+			return;
+		}
+
+		Fe delta = Square(p.z);
+		Fe gamma = Square(p.y);
+		Fe beta = Multiply(p.x, gamma);
+		Fe alpha = MultiplySmall(Multiply(Subtract(p.x, delta), Add(p.x, delta)), 3);
+
+		Fe x = Subtract(Square(alpha), MultiplySmall(beta, 8));
+		Fe z = Subtract(Subtract(Square(Add(p.y, p.z)), gamma), delta);
+		Fe y = Subtract(Multiply(alpha, Subtract(MultiplySmall(beta, 4), x)), MultiplySmall(Square(gamma), 8));
+
+		r.x = x;
+		r.y = y;
+		r.z = z;
+		r.infinity = false;
+	}
+
+	static void AddAffine(Jacobian& r, const Jacobian& p, const Affine& q) {
+		if (p.infinity) {
+			r.x = q.x;
+			r.y = q.y;
+			r.z = Fe();
+			r.z.v[0] = 1;
+			r.infinity = false;
+			return;
+		}
+
+		Fe z1z1 = Square(p.z);
+		Fe u2 = Multiply(q.x, z1z1);
+		Fe s2 = Multiply(q.y, Multiply(p.z, z1z1));
+		Fe h = Subtract(u2, p.x);
+		Fe s = Subtract(s2, p.y);
+
+		if (IsZero(h)) {
+			if (IsZero(s)) {
+				Double(r, p);
+			} else {
+				r.infinity = true;
+			}
+			return;
+		}
+
+		Fe hh = Square(h);
+		Fe i = MultiplySmall(hh, 4);
+		Fe j = Multiply(h, i);
+		Fe s2x = MultiplySmall(s, 2);
+		Fe v = Multiply(p.x, i);
+
+		Fe x = Subtract(Subtract(Square(s2x), j), MultiplySmall(v, 2));
+		Fe y = Subtract(Multiply(s2x, Subtract(v, x)), MultiplySmall(Multiply(p.y, j), 2));
+		Fe z = Subtract(Subtract(Square(Add(p.z, h)), z1z1), hh);
+
+		r.x = x;
+		r.y = y;
+		r.z = z;
+		r.infinity = false;
+	}
+
+	static Affine ToAffine(const Jacobian& p) {
+		Fe zInverse = Invert(p.z);
+		Fe zInverse2 = Square(zInverse);
+
+		Affine r;
+		r.x = Multiply(p.x, zInverse2);
+		r.y = Multiply(p.y, Multiply(zInverse2, zInverse));
+		return r;
+	}
+
+	// Entry j - 1 of window i is j * 16^i * p, for j in [1, 16)
+	static void BuildTable(const Affine& p, std::vector<Affine>& table) {
+		table.resize((size_t)WINDOWS * WINDOW_POINTS);
+
+		Affine base = p;
+		Jacobian multiples[WINDOW_POINTS + 1];
+		Fe products[WINDOW_POINTS];
+		for (int window = 0; window < WINDOWS; window++) {
+			Affine* entries = &table[(size_t)window * WINDOW_POINTS];
+			entries[0] = base;
+
+			multiples[0].infinity = true;
+			AddAffine(multiples[0], multiples[0], base);
+			for (int j = 1; j <= WINDOW_POINTS; j++) AddAffine(multiples[j], multiples[j - 1], base);
+
+			// The multiples after the first, and the base of the next window, share one inversion
+			products[0] = multiples[1].z;
+			for (int j = 1; j < WINDOW_POINTS; j++) products[j] = Multiply(products[j - 1], multiples[j + 1].z);
+			Fe inverse = Invert(products[WINDOW_POINTS - 1]);
+			for (int j = WINDOW_POINTS - 1; j >= 0; j--) {
+				Fe zInverse = j > 0 ? Multiply(inverse, products[j - 1]) : inverse;
+				if (j > 0) inverse = Multiply(inverse, multiples[j + 1].z);
+
+				Fe zInverse2 = Square(zInverse);
+				Affine a;
+				a.x = Multiply(multiples[j + 1].x, zInverse2);
+				a.y = Multiply(multiples[j + 1].y, Multiply(zInverse2, zInverse));
+				if (j + 1 < WINDOW_POINTS) entries[j + 1] = a;
+				else base = a;
+			}
+		}
+	}
+
+	static bool IsOnCurve(const Fe& x, const Fe& y) {
+		Fe b = FeFromBig(BigFromBytes(B_BYTES, sizeof(B_BYTES)));
+		Fe right = Add(Subtract(Multiply(Square(x), x), MultiplySmall(x, 3)), b);
+		return IsZero(Subtract(Square(y), right));
+	}
+
+	static const std::vector<Affine>& GetGeneratorTable() {
+		static const std::vector<Affine> table = [] {
+			Affine g;
+			g.x = FeFromBig(BigFromBytes(GX_BYTES, sizeof(GX_BYTES)));
+			g.y = FeFromBig(BigFromBytes(GY_BYTES, sizeof(GY_BYTES)));
+
+			std::vector<Affine> t;
+			BuildTable(g, t);
+			return t;
+		}();
+		return table;
+	}
+
+	static inline int Nibble(const Big& a, int window) {
+		return (a.w[window / 8] >> (WINDOW_BITS * (window % 8))) & WINDOW_POINTS;
+	}
+
+	struct SignatureVerifier::Table {
+		std::vector<Affine> points;
+	};
+
+	SignatureVerifier::SignatureVerifier() {
+		GetOrder();
+		GetGeneratorTable();
+	}
+
+	SignatureVerifier::~SignatureVerifier() {
+	}
+
+	size_t SignatureVerifier::AddKey(const uint8_t* x, const uint8_t* y) {
+		Big p = {};
+		for (int i = 0; i < WORDS - 1; i++) p.w[i] = 0xFFFFFFFF;
+		p.w[WORDS - 1] = 0x1FF;
+
+		Big bx = BigFromBytes(x, COORDINATE_BYTES);
+		Big by = BigFromBytes(y, COORDINATE_BYTES);
+		if (Compare(bx, p) >= 0 || Compare(by, p) >= 0) throw std::invalid_argument("The key is not on the curve");
+
+		Affine key;
+		key.x = FeFromBig(bx);
+		key.y = FeFromBig(by);
+		if (!IsOnCurve(key.x, key.y)) throw std::invalid_argument("The key is not on the curve");
+
+		std::unique_ptr<Table> table(new Table());
+		BuildTable(key, table->points);
+		_keys.push_back(std::move(table));
+		return _keys.size() - 1;
+	}
+
+	bool SignatureVerifier::Verify(size_t key, const uint8_t* digest, size_t digestLength, const uint8_t* signature) const {
+		if (key >= _keys.size()) throw std::invalid_argument("There is no such key");
+		if (digestLength > MAX_DIGEST_BYTES) throw std::invalid_argument("The digest is too long");
+
+		const Order& order = GetOrder();
+		Big r = BigFromBytes(signature, COORDINATE_BYTES);
+		Big s = BigFromBytes(signature + COORDINATE_BYTES, COORDINATE_BYTES);
+		if (IsZero(r) || IsZero(s) || Compare(r, order.n) >= 0 || Compare(s, order.n) >= 0) return false;
+
+		// The digest is shorter than the order, so it is used whole, and is already below n
+		Big e = BigFromBytes(digest, digestLength);
+
+		Big w = order.InvertToMontgomery(s);
+		Big u1 = order.Multiply(e, w);
+		Big u2 = order.Multiply(r, w);
+
+		const Affine* generator = GetGeneratorTable().data();
+		const Affine* keyTable = _keys[key]->points.data();
+
+		Jacobian sum;
+		sum.infinity = true;
+		for (int window = 0; window < WINDOWS; window++) {
+			int d1 = Nibble(u1, window);
+			if (d1 != 0) AddAffine(sum, sum, generator[window * WINDOW_POINTS + d1 - 1]);
+			int d2 = Nibble(u2, window);
+			if (d2 != 0) AddAffine(sum, sum, keyTable[window * WINDOW_POINTS + d2 - 1]);
+		}
+		if (sum.infinity) return false;
+
+		// x is below p, which is below 2n
+		Big x = BigFromFe(ToAffine(sum).x);
+		if (Compare(x, order.n) >= 0) x = Subtract(x, order.n);
+		return Compare(x, r) == 0;
+	}
+
+	void SignatureVerifier::VerifyMany(size_t count, const uint32_t* keys, const uint8_t* const* digests, size_t digestLength,
+		const uint8_t* const* signatures, uint8_t* results, size_t threads) const {
+
+		for (size_t i = 0; i < count; i++) {
+			if (keys[i] >= _keys.size()) throw std::invalid_argument("There is no such key");
+		}
+		if (digestLength > MAX_DIGEST_BYTES) throw std::invalid_argument("The digest is too long");
+
+		if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::min(threads, (count + VERIFY_CHUNK - 1) / VERIFY_CHUNK);
+
+		std::atomic<size_t> next(0);
+		auto work = [&] {
+			for (;;) {
+				size_t first = next.fetch_add(VERIFY_CHUNK);
+				if (first >= count) return;
+				size_t last = std::min(count, first + VERIFY_CHUNK);
+				for (size_t i = first; i < last; i++) results[i] = Verify(keys[i], digests[i], digestLength, signatures[i]) ? 1 : 0;
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (size_t t = 1; t < threads; t++) workers.emplace_back(work);
+		work();
+		for (auto& worker : workers) worker.join();
+	}
+
+	SignatureVerifier* SignatureVerifier_Construct() { return new SignatureVerifier(); }
+
+	void SignatureVerifier_Destruct(SignatureVerifier* p) { delete p; }
+
+	size_t SignatureVerifier_AddKey(SignatureVerifier* p, const uint8_t* x, const uint8_t* y) { return p->AddKey(x, y); }
+
+	bool SignatureVerifier_Verify(const SignatureVerifier* p, size_t key, const uint8_t* digest, size_t digestLength, const uint8_t* signature) {
+		return p->Verify(key, digest, digestLength, signature);
+	}
+
+	void SignatureVerifier_VerifyMany(const SignatureVerifier* p, size_t count, const uint32_t* keys, const uint8_t* const* digests,
+		size_t digestLength, const uint8_t* const* signatures, uint8_t* results, size_t threads) {
+		p->VerifyMany(count, keys, digests, digestLength, signatures, results, threads);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace ReedSolomon {
+
+	// Verifies ECDSA signatures on the NIST P-521 curve, as CNG makes them for cluster hashes, in batches and across threads.
+	//
+	// A volume is signed by only a few keys, so each key is added once, when the volume is mounted, and gets a table of its
+	// multiples in 4-bit windows: entry j of window i is j * 16^i times the key.  The generator has the same table, built once
+	// per process.  A verify then costs two additions per window of the two scalars and no doublings, a fraction of a general
+	// double-and-add.  The tables take about 560 KB per key.
+	//
+	// Signatures are the 132 bytes of r and s, big-endian, as CNG writes them.  The digest is the hash of the signed data, which
+	// for clusters is the SHA-256 of the cluster hash; it may be up to 65 bytes long.
+	class SignatureVerifier {
+
+	public:
+
+		static const size_t COORDINATE_BYTES = 66;
+		static const size_t SIGNATURE_BYTES = 2 * COORDINATE_BYTES;
+		static const size_t MAX_DIGEST_BYTES = 65;
+
+		SignatureVerifier();
+		~SignatureVerifier();
+
+		SignatureVerifier(const SignatureVerifier&) = delete;
+		SignatureVerifier& operator=(const SignatureVerifier&) = delete;
+
+		// Builds the tables for a public key, given by its big-endian coordinates, and returns the index that verifies with it.
+		// Throws if the point is not on the curve.
+		size_t AddKey(const uint8_t* x, const uint8_t* y);
+
+		inline size_t GetKeyCount() const { return _keys.size(); }
+
+		bool Verify(size_t key, const uint8_t* digest, size_t digestLength, const uint8_t* signature) const;
+
+		// Verifies count signatures, each with its own key, digest and signature, and sets results[i] to 1 if signature i is valid
+		// and 0 if not.  The work is shared by the given number of threads, or by one per core if threads is 0.
+		void VerifyMany(size_t count, const uint32_t* keys, const uint8_t* const* digests, size_t digestLength,
+			const uint8_t* const* signatures, uint8_t* results, size_t threads) const;
+
+	private:
+
+		struct Table;
+
+		// Keys are only added before verification starts, so the tables are read without a lock
+		std::vector<std::unique_ptr<Table>> _keys;
+	};
+
+	extern "C" {
+		__declspec(dllexport) SignatureVerifier* SignatureVerifier_Construct();
+		__declspec(dllexport) void SignatureVerifier_Destruct(SignatureVerifier* p);
+		__declspec(dllexport) size_t SignatureVerifier_AddKey(SignatureVerifier* p, const uint8_t* x, const uint8_t* y);
+		__declspec(dllexport) bool SignatureVerifier_Verify(const SignatureVerifier* p, size_t key, const uint8_t* digest, size_t digestLength,
+			const uint8_t* signature);
+		__declspec(dllexport) void SignatureVerifier_VerifyMany(const SignatureVerifier* p, size_t count, const uint32_t* keys,
+			const uint8_t* const* digests, size_t digestLength, const uint8_t* const* signatures, uint8_t* results, size_t threads);
+	}
+}
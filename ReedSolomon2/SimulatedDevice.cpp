@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "SimulatedDevice.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace ReedSolomon {
+
+	SimulatedDevice::SimulatedDevice(uint64_t sizeBytes, uint32_t blockSize) :
+		_size(sizeBytes),
+		_blockSize(blockSize),
+		_chunks((size_t)((sizeBytes + CHUNK_SIZE - 1) / CHUNK_SIZE), nullptr),
+		_timing(),
+		_faults(),
+		_stats() {
+		if (blockSize == 0) throw std::invalid_argument("blockSize");
+		_blockFlags.resize((size_t)((sizeBytes + blockSize - 1) / blockSize));
+	}
+
+	SimulatedDevice::~SimulatedDevice() {
+		for (auto chunk : _chunks) delete[] chunk;
+	}
+
+	void SimulatedDevice::SetTiming(const SimulatedTiming& timing) {
+		std::lock_guard<std::mutex> lock(_lock);
+		_timing = timing;
+	}
+
+	void SimulatedDevice::SetFaults(const SimulatedFaults& faults) {
+		std::lock_guard<std::mutex> lock(_lock);
+		_faults = faults;
+		_random.seed(faults.seed);
+	}
+
+	bool SimulatedDevice::Read(uint64_t offset, uint8_t* data, size_t length) {
+		if (offset > _size || length > _size - offset) throw std::invalid_argument("The range is not on the device");
+		if (length == 0) return true;
+
+		bool readable = true;
+		double seconds;
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+
+			size_t slowBlocks = 0;
+			size_t first = (size_t)(offset / _blockSize);
+			size_t last = (size_t)((offset + length - 1) / _blockSize);
+			for (size_t block = first; block <= last; block++) {
+				uint8_t& flags = _blockFlags[block];
+				if (Draw(_faults.lossPerRead)) {
+					flags |= BLOCK_LOST;
+					_stats.losses++;
+				}
+				if (Draw(_faults.slowPerRead) && (flags & BLOCK_SLOW) == 0) {
+					flags |= BLOCK_SLOW;
+					_stats.slowBlocks++;
+				}
+				if (Draw(_faults.bitRotPerRead)) {
+					uint64_t start = (uint64_t)block * _blockSize;
+					uint64_t bits = (std::min(_size, start + _blockSize) - start) * 8;
+					uint64_t bit = start * 8 + _random() % bits;
+					GetChunk(bit / 8, true)[(bit / 8) % CHUNK_SIZE] ^= (uint8_t)(1 << (bit % 8));
+					_stats.bitRots++;
+				}
+				if ((flags & BLOCK_SLOW) != 0) slowBlocks++;
+				if ((flags & BLOCK_LOST) != 0) readable = false;
+			}
+
+			Copy(offset, data, length, false);
+
+			// Lost blocks read as zeros
+			if (!readable) {
+				for (size_t block = first; block <= last; block++) {
+					if ((_blockFlags[block] & BLOCK_LOST) == 0) continue;
+					uint64_t start = std::max(offset, (uint64_t)block * _blockSize);
+					uint64_t end = std::min(offset + length, (uint64_t)(block + 1) * _blockSize);
+					memset(data + (start - offset), 0, (size_t)(end - start));
+				}
+				_stats.failedReads++;
+			}
+
+			seconds = _timing.latencySeconds + slowBlocks * _timing.slowBlockSeconds;
+			if (_timing.bytesPerSecond > 0) seconds += length / _timing.bytesPerSecond;
+			_stats.reads++;
+			_stats.bytesRead += length;
+			_stats.simulatedSeconds += seconds;
+		}
+
+		Wait(seconds);
+		return readable;
+	}
+
+	size_t SimulatedDevice::Write(uint64_t offset, const uint8_t* data, size_t length) {
+		if (offset > _size || length > _size - offset) throw std::invalid_argument("The range is not on the device");
+		if (length == 0) return 0;
+
+		size_t written = length;
+		double seconds;
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+
+			if (Draw(_faults.tornPerWrite)) {
+				size_t sectors = (length + SECTOR_SIZE - 1) / SECTOR_SIZE;
+				written = (size_t)(_random() % sectors) * SECTOR_SIZE;
+				_stats.tornWrites++;
+			}
+
+			if (written > 0) {
+				Copy(offset, const_cast<uint8_t*>(data), written, true);
+
+				size_t first = (size_t)(offset / _blockSize);
+				size_t last = (size_t)((offset + written - 1) / _blockSize);
+				for (size_t block = first; block <= last; block++) _blockFlags[block] &= ~BLOCK_LOST;
+			}
+
+			seconds = _timing.latencySeconds;
+			if (_timing.bytesPerSecond > 0) seconds += length / _timing.bytesPerSecond;
+			_stats.writes++;
+			_stats.bytesWritten += written;
+			_stats.simulatedSeconds += seconds;
+		}
+
+		Wait(seconds);
+		return written;
+	}
+
+	void SimulatedDevice::InjectBitRot(uint64_t bitOffset) {
+		if (bitOffset / 8 >= _size) throw std::invalid_argument("The bit is not on the device");
+		std::lock_guard<std::mutex> lock(_lock);
+		GetChunk(bitOffset / 8, true)[(bitOffset / 8) % CHUNK_SIZE] ^= (uint8_t)(1 << (bitOffset % 8));
+		_stats.bitRots++;
+	}
+
+	void SimulatedDevice::InjectLoss(uint64_t offset, uint64_t length) {
+		if (offset > _size || length > _size - offset) throw std::invalid_argument("The range is not on the device");
+		if (length == 0) return;
+		std::lock_guard<std::mutex> lock(_lock);
+		for (uint64_t block = offset / _blockSize; block <= (offset + length - 1) / _blockSize; block++) {
+			_blockFlags[(size_t)block] |= BLOCK_LOST;
+			_stats.losses++;
+		}
+	}
+
+	void SimulatedDevice::InjectSlow(uint64_t offset, uint64_t length) {
+		if (offset > _size || length > _size - offset) throw std::invalid_argument("The range is not on the device");
+		if (length == 0) return;
+		std::lock_guard<std::mutex> lock(_lock);
+		for (uint64_t block = offset / _blockSize; block <= (offset + length - 1) / _blockSize; block++) {
+			_blockFlags[(size_t)block] |= BLOCK_SLOW;
+			_stats.slowBlocks++;
+		}
+	}
+
+	SimulatedDeviceStats SimulatedDevice::GetStats() const {
+		std::lock_guard<std::mutex> lock(_lock);
+		return _stats;
+	}
+
+	void SimulatedDevice::ResetStats() {
+		std::lock_guard<std::mutex> lock(_lock);
+		_stats = SimulatedDeviceStats();
+	}
+
+	uint8_t* SimulatedDevice::GetChunk(uint64_t offset, bool allocate) {
+		uint8_t*& chunk = _chunks[(size_t)(offset / CHUNK_SIZE)];
+		if (chunk == nullptr && allocate) chunk = new uint8_t[CHUNK_SIZE]();
+		return chunk;
+	}
+
+	void SimulatedDevice::Copy(uint64_t offset, uint8_t* data, size_t length, bool toDevice) {
+		while (length > 0) {
+			size_t position = (size_t)(offset % CHUNK_SIZE);
+			size_t count = std::min(length, CHUNK_SIZE - position);
+			uint8_t* chunk = GetChunk(offset, toDevice);
+
+			if (toDevice) {
+				memcpy(chunk + position, data, count);
+			} else if (chunk != nullptr) {
+				memcpy(data, chunk + position, count);
+			} else {
+				memset(data, 0, count);
+			}
+
+			offset += count;
+			data += count;
+			length -= count;
+		}
+	}
+
+	void SimulatedDevice::Wait(double seconds) const {
+		if (_timing.sleep && seconds > 0) std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	}
+
+	bool SimulatedDevice::Draw(double probability) {
+		if (probability <= 0) return false;
+		return std::uniform_real_distribution<double>(0, 1)(_random) < probability;
+	}
+
+	SimulatedDevice* SimulatedDevice_Construct(uint64_t sizeBytes, uint32_t blockSize) { return new SimulatedDevice(sizeBytes, blockSize); }
+
+	void SimulatedDevice_Destruct(SimulatedDevice* p) { delete p; }
+
+	void SimulatedDevice_SetTiming(SimulatedDevice* p, const SimulatedTiming* timing) { p->SetTiming(*timing); }
+
+	void SimulatedDevice_SetFaults(SimulatedDevice* p, const SimulatedFaults* faults) { p->SetFaults(*faults); }
+
+	bool SimulatedDevice_Read(SimulatedDevice* p, uint64_t offset, uint8_t* data, size_t length) { return p->Read(offset, data, length); }
+
+	size_t SimulatedDevice_Write(SimulatedDevice* p, uint64_t offset, const uint8_t* data, size_t length) {
+		return p->Write(offset, data, length);
+	}
+
+	void SimulatedDevice_InjectBitRot(SimulatedDevice* p, uint64_t bitOffset) { p->InjectBitRot(bitOffset); }
+
+	void SimulatedDevice_InjectLoss(SimulatedDevice* p, uint64_t offset, uint64_t length) { p->InjectLoss(offset, length); }
+
+	void SimulatedDevice_InjectSlow(SimulatedDevice* p, uint64_t offset, uint64_t length) { p->InjectSlow(offset, length); }
+
+	void SimulatedDevice_GetStats(const SimulatedDevice* p, SimulatedDeviceStats* stats) { *stats = p->GetStats(); }
+
+	void SimulatedDevice_ResetStats(SimulatedDevice* p) { p->ResetStats(); }
+}
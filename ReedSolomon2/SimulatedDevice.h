@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <random>
+#include <vector>
+
+namespace ReedSolomon {
+
+	// The cost model of a SimulatedDevice.  Every request costs the latency plus its length over the bandwidth, plus the extra
+	// latency of each slow block it reads.
+	struct SimulatedTiming {
+		double latencySeconds;
+		// Zero for no transfer cost
+		double bytesPerSecond;
+		double slowBlockSeconds;
+		// Whether requests wait out their cost, or only add it to the simulated time
+		bool sleep;
+	};
+
+	// Fault rates, as the probability per block read or per write.  A fault is persistent: a rotten bit stays flipped, a lost
+	// block fails every read until it is written again, and a slow block stays slow.
+	struct SimulatedFaults {
+		uint64_t seed;
+		// A block read flips a random bit of the stored block first
+		double bitRotPerRead;
+		// A block read finds the block lost
+		double lossPerRead;
+		// A block read finds the block slow
+		double slowPerRead;
+		// A write stops at a random sector, leaving the rest of the range as it was
+		double tornPerWrite;
+	};
+
+	struct SimulatedDeviceStats {
+		uint64_t reads;
+		uint64_t writes;
+		uint64_t bytesRead;
+		uint64_t bytesWritten;
+		uint64_t failedReads;
+		uint64_t bitRots;
+		uint64_t losses;
+		uint64_t slowBlocks;
+		uint64_t tornWrites;
+		double simulatedSeconds;
+	};
+
+	// An in-memory block device with a cost model and fault injection, for exercising verify and repair at scale without real
+	// hardware.  Storage is sparse: memory is allocated a chunk at a time on the first write to it, and unwritten space reads as
+	// zeros.  Faults come from the rates of SetFaults, drawn from a seeded generator so runs are repeatable, or from the Inject
+	// calls.  Requests from several threads are safe; the simulated time is the sum over all requests, as for a device that serves
+	// one request at a time.
+	class SimulatedDevice {
+
+	public:
+
+		// Torn writes stop at a multiple of this many bytes
+		static const size_t SECTOR_SIZE = 512;
+
+		SimulatedDevice(uint64_t sizeBytes, uint32_t blockSize);
+		~SimulatedDevice();
+
+		SimulatedDevice(const SimulatedDevice&) = delete;
+		SimulatedDevice& operator=(const SimulatedDevice&) = delete;
+
+		inline uint64_t GetSize() const { return _size; }
+		inline uint32_t GetBlockSize() const { return _blockSize; }
+
+		void SetTiming(const SimulatedTiming& timing);
+		void SetFaults(const SimulatedFaults& faults);
+
+		// Reads a range.  Returns false if a block in it is lost, in which case the lost blocks read as zeros and the rest are read.
+		bool Read(uint64_t offset, uint8_t* data, size_t length);
+
+		// Writes a range and returns the number of bytes written, which is less than length after a torn write.  Writing a lost
+		// block makes it readable again.
+		size_t Write(uint64_t offset, const uint8_t* data, size_t length);
+
+		void InjectBitRot(uint64_t bitOffset);
+		void InjectLoss(uint64_t offset, uint64_t length);
+		void InjectSlow(uint64_t offset, uint64_t length);
+
+		SimulatedDeviceStats GetStats() const;
+		void ResetStats();
+
+	private:
+
+		static const size_t CHUNK_SIZE = 1024 * 1024;
+
+		static const uint8_t BLOCK_LOST = 0x01;
+		static const uint8_t BLOCK_SLOW = 0x02;
+
+		// Returns the chunk holding offset, allocating it if allocate is set, or nullptr.  The lock must be held.
+		uint8_t* GetChunk(uint64_t offset, bool allocate);
+
+		void Copy(uint64_t offset, uint8_t* data, size_t length, bool toDevice);
+		void Wait(double seconds) const;
+
+		bool Draw(double probability);
+
+		uint64_t _size;
+		uint32_t _blockSize;
+
+		mutable std::mutex _lock;
+		std::vector<uint8_t*> _chunks;
+		std::vector<uint8_t> _blockFlags;
+
+		SimulatedTiming _timing;
+		SimulatedFaults _faults;
+		std::mt19937_64 _random;
+		SimulatedDeviceStats _stats;
+	};
+
+	extern "C" {
+		__declspec(dllexport) SimulatedDevice* SimulatedDevice_Construct(uint64_t sizeBytes, uint32_t blockSize);
+		__declspec(dllexport) void SimulatedDevice_Destruct(SimulatedDevice* p);
+		__declspec(dllexport) void SimulatedDevice_SetTiming(SimulatedDevice* p, const SimulatedTiming* timing);
+		__declspec(dllexport) void SimulatedDevice_SetFaults(SimulatedDevice* p, const SimulatedFaults* faults);
+		__declspec(dllexport) bool SimulatedDevice_Read(SimulatedDevice* p, uint64_t offset, uint8_t* data, size_t length);
+		__declspec(dllexport) size_t SimulatedDevice_Write(SimulatedDevice* p, uint64_t offset, const uint8_t* data, size_t length);
+		__declspec(dllexport) void SimulatedDevice_InjectBitRot(SimulatedDevice* p, uint64_t bitOffset);
+		__declspec(dllexport) void SimulatedDevice_InjectLoss(SimulatedDevice* p, uint64_t offset, uint64_t length);
+		__declspec(dllexport) void SimulatedDevice_InjectSlow(SimulatedDevice* p, uint64_t offset, uint64_t length);
+		__declspec(dllexport) void SimulatedDevice_GetStats(const SimulatedDevice* p, SimulatedDeviceStats* stats);
+		__declspec(dllexport) void SimulatedDevice_ResetStats(SimulatedDevice* p);
+	}
+}
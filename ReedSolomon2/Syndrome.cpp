@@ -1,13 +1,15 @@
 #include "stdafx.h"
 #include "Syndrome.h"
 #include "GF16.h"
+#include "BufferPool.h"
+#include "Xor.h"
+#include "ZeroSpans.h"
 #include <iostream>
 #include <iomanip>
 
 namespace ReedSolomon {
 
 	static const int CODEWORDS_PER_SEGMENT = 8;
-	static const int SEGMENT_ALIGNMENT = 64;
 	static const int BYTES_PER_CODEWORD = 2;
 
 	Syndrome::Syndrome(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice) :
@@ -17,9 +19,10 @@ namespace ReedSolomon {
 		size_t totalCodewords = nDataCodewords + nParityCodewords;
 
 		_segmentsPerVector = (_nParityCodewords + CODEWORDS_PER_SEGMENT - 1) / CODEWORDS_PER_SEGMENT;
-		_vectors = (uint16_t*)_aligned_malloc(
-			_segmentsPerVector * CODEWORDS_PER_SEGMENT * sizeof(uint16_t) * totalCodewords, SEGMENT_ALIGNMENT);
-
+		size_t vectorBytes = _segmentsPerVector * CODEWORDS_PER_SEGMENT * sizeof(uint16_t) * totalCodewords;
+		_vectors = (uint16_t*)BufferPool::Allocate(vectorBytes);
+		// The lanes past the parity count are multiplied in with the rest and scanned by GetDamagedRanges, so they must be zero
+		memset(_vectors, 0, vectorBytes);
 
 		for (size_t i = 0; i < nParityCodewords; i++) _vectors[i] = 1;
 
@@ -32,17 +35,27 @@ namespace ReedSolomon {
 			for (size_t i = 0; i < nParityCodewords; i++) currentSyndromeVector[i] = GF16::Multiply(lastSyndromeVector[i], GF16::Exp(i));
 		}
 
-		_syndrome = (__m128i*)_aligned_malloc(_segmentsPerVector * CODEWORDS_PER_SEGMENT * sizeof(uint16_t) * _codewordsPerSlice, SEGMENT_ALIGNMENT);
+		_syndrome = (__m128i*)BufferPool::Allocate(_segmentsPerVector * CODEWORDS_PER_SEGMENT * sizeof(uint16_t) * _codewordsPerSlice);
+		_added = new uint8_t[(totalCodewords + 7) / 8];
+		_horner = _nParityCodewords <= HornerAccumulator::MAX_POINTS ? new HornerAccumulator(_nParityCodewords, _codewordsPerSlice) : nullptr;
+
+		size_t runLength = 1;
+		_runKernel = _horner == nullptr ? GetGeometryRunKernel(_nParityCodewords, _codewordsPerSlice, runLength) : nullptr;
+		_runTables = _runKernel != nullptr ? (__m128i*)BufferPool::Allocate(GetRunTablesSize()) : nullptr;
 		Reset();
 	}
 
 
 	Syndrome::~Syndrome() {
-		_aligned_free(_vectors);
-		_aligned_free(_syndrome);
+		BufferPool::Free(_vectors, _segmentsPerVector * CODEWORDS_PER_SEGMENT * sizeof(uint16_t) * (_nDataCodewords + _nParityCodewords));
+		BufferPool::Free(_syndrome, _segmentsPerVector * CODEWORDS_PER_SEGMENT * sizeof(uint16_t) * _codewordsPerSlice);
+		delete[] _added;
+		delete _horner;
+		BufferPool::Free(_runTables, GetRunTablesSize());
 	}
 
 	uint16_t Syndrome::GetSyndrome(size_t codewordOffset, size_t exponent) const {
+		FlushHorner();
 
 		size_t segment = exponent / CODEWORDS_PER_SEGMENT;
 		size_t segmentOffset = exponent % CODEWORDS_PER_SEGMENT;
@@ -52,35 +65,193 @@ namespace ReedSolomon {
 
 	void Syndrome::Reset() {
 		memset(_syndrome, 0, BYTES_PER_CODEWORD * CODEWORDS_PER_SEGMENT * _segmentsPerVector * _codewordsPerSlice);
+		memset(_added, 0, (_nDataCodewords + _nParityCodewords + 7) / 8);
+		if (_horner != nullptr) _horner->Clear();
 	}
 
 	void Syndrome::AddCodewordSlice(uint16_t* data, size_t exponent) {
+		if (_horner != nullptr && AddHorner(data, exponent)) {
+			_added[exponent / 8] |= (uint8_t)(1 << (exponent % 8));
+			return;
+		}
+
 		__m128i* vectorSegment = (__m128i*)_vectors + _segmentsPerVector * exponent;
 		__m128i* dest = _syndrome;
 
+		if (_runKernel != nullptr) {
+			for (size_t i = 0; i < _segmentsPerVector; i++) {
+				GF16MultiplicationTable::Set(vectorSegment[i], _runTables + i * GF16MultiplicationTable::TABLE_BLOCKS);
+			}
+			_runKernel(_runTables, &data, _syndrome, _codewordsPerSlice);
+			_added[exponent / 8] |= (uint8_t)(1 << (exponent % 8));
+			return;
+		}
+
 		for (size_t i = 0; i < _segmentsPerVector; i++, vectorSegment++) {
 			_multiplicationTable.Set(*vectorSegment);
-
-			uint16_t p1 = *((uint16_t*)dest);
-			uint16_t p2 = *((uint16_t*)(dest + 1));
-
 			_multiplicationTable.MultiplyAndXor(data, dest, _codewordsPerSlice);
 			dest += _codewordsPerSlice;
 		}
+
+		_added[exponent / 8] |= (uint8_t)(1 << (exponent % 8));
+	}
+
+	bool Syndrome::AddCodewordSliceBatch(Syndrome* const* syndromes, uint16_t* const* data, size_t count, size_t exponent) {
+		if (count == 0) return true;
+
+		Syndrome& first = *syndromes[0];
+		for (size_t k = 1; k < count; k++) {
+			if (syndromes[k]->_nDataCodewords != first._nDataCodewords || syndromes[k]->_nParityCodewords != first._nParityCodewords ||
+				syndromes[k]->_codewordsPerSlice != first._codewordsPerSlice) return false;
+		}
+
+		// Without tables there is nothing to share
+		if (first._horner != nullptr) {
+			for (size_t k = 0; k < count; k++) syndromes[k]->AddCodewordSlice(data[k], exponent);
+			return true;
+		}
+
+		__m128i* vectorSegment = (__m128i*)first._vectors + first._segmentsPerVector * exponent;
+		size_t offset = 0;
+		for (size_t i = 0; i < first._segmentsPerVector; i++, vectorSegment++, offset += first._codewordsPerSlice) {
+			first._multiplicationTable.Set(*vectorSegment);
+			for (size_t k = 0; k < count; k++) {
+				first._multiplicationTable.MultiplyAndXor(data[k], syndromes[k]->_syndrome + offset, (int)first._codewordsPerSlice);
+			}
+		}
+
+		for (size_t k = 0; k < count; k++) syndromes[k]->_added[exponent / 8] |= (uint8_t)(1 << (exponent % 8));
+		return true;
+	}
+
+	bool Syndrome::AddHorner(uint16_t* data, size_t exponent) {
+		if (IsZeroSlice(data, _codewordsPerSlice)) return true;
+		if (_horner->Add(data, exponent)) return true;
+
+		if (exponent > _horner->GetExponent()) return false;
+		FlushHorner();
+		return _horner->Add(data, exponent);
+	}
+
+	void Syndrome::FlushHorner() const {
+		if (_horner == nullptr || !_horner->IsActive()) return;
+
+		// Syndrome j gains α^(j * E) * plane j
+		size_t exponent = _horner->GetExponent();
+		for (size_t j = 0; j < _nParityCodewords; j++) {
+			__m128i weights = _mm_setzero_si128();
+			((uint16_t*)&weights)[j] = GF16::Power(2, (int)((j * exponent) % GF16::MAX_VALUE));
+			_multiplicationTable.Set(weights);
+			_multiplicationTable.MultiplyAndXor(_horner->GetPlane(j), _syndrome, (int)_codewordsPerSlice);
+		}
+		_horner->Clear();
+	}
+
+	size_t Syndrome::GetDamagedRanges(size_t granularity, uint32_t* ranges, size_t maxRanges) const {
+		FlushHorner();
+		if (granularity == 0) granularity = 1;
+
+		size_t nRanges = 0;
+		size_t end = 0;
+		for (size_t chunk = 0; chunk < _codewordsPerSlice; chunk += ZERO_SPAN_CODEWORDS) {
+			size_t length = _codewordsPerSlice - chunk < ZERO_SPAN_CODEWORDS ? _codewordsPerSlice - chunk : ZERO_SPAN_CODEWORDS;
+			if (end >= chunk + length) continue;
+
+			// Each codeword offset holds its syndromes in one vector per segment, so the whole chunk is ORed together first and
+			// clean chunks, nearly all of them, are passed over without looking at any offset
+			__m128i any = _mm_setzero_si128();
+			for (size_t s = 0; s < _segmentsPerVector; s++) {
+				const __m128i* p = _syndrome + s * _codewordsPerSlice + chunk;
+				for (size_t i = 0; i < length; i++) any = _mm_or_si128(any, _mm_load_si128(p + i));
+			}
+			if (_mm_testz_si128(any, any)) continue;
+
+			for (size_t offset = chunk < end ? end : chunk; offset < chunk + length; offset++) {
+				__m128i x = _mm_setzero_si128();
+				for (size_t s = 0; s < _segmentsPerVector; s++) x = _mm_or_si128(x, _mm_load_si128(_syndrome + s * _codewordsPerSlice + offset));
+				if (_mm_testz_si128(x, x)) continue;
+
+				size_t blockStart = offset / granularity * granularity;
+				size_t blockEnd = blockStart + granularity < _codewordsPerSlice ? blockStart + granularity : _codewordsPerSlice;
+				if (nRanges > 0 && blockStart <= end) {
+					end = blockEnd;
+				} else {
+					if (nRanges > 0 && nRanges <= maxRanges) ranges[2 * nRanges - 1] = (uint32_t)end;
+					if (nRanges < maxRanges) ranges[2 * nRanges] = (uint32_t)blockStart;
+					nRanges++;
+					end = blockEnd;
+				}
+
+				// The rest of the block is in the range already
+				offset = blockEnd - 1;
+			}
+		}
+		if (nRanges > 0 && nRanges <= maxRanges) ranges[2 * nRanges - 1] = (uint32_t)end;
+
+		return nRanges;
+	}
+
+	bool Syndrome::IsAdded(size_t exponent) const {
+		return (_added[exponent / 8] & (1 << (exponent % 8))) != 0;
+	}
+
+	AccumulatorStateHeader Syndrome::GetStateHeader() const {
+		AccumulatorStateHeader header;
+		header.marker = ACCUMULATOR_STATE_MARKER;
+		header.version = ACCUMULATOR_STATE_VERSION;
+		header.kind = SYNDROME_STATE;
+		header.nDataCodewords = _nDataCodewords;
+		header.nParityCodewords = _nParityCodewords;
+		header.codewordsPerSlice = _codewordsPerSlice;
+		header.accumulatorBytes = BYTES_PER_CODEWORD * CODEWORDS_PER_SEGMENT * _segmentsPerVector * _codewordsPerSlice;
+		return header;
+	}
+
+	size_t Syndrome::GetStateSize() const {
+		return GetAccumulatorStateSize(_nDataCodewords + _nParityCodewords,
+			BYTES_PER_CODEWORD * CODEWORDS_PER_SEGMENT * _segmentsPerVector * _codewordsPerSlice);
+	}
+
+	void Syndrome::SaveState(uint8_t* buffer) const {
+		FlushHorner();
+		SaveAccumulatorState(buffer, GetStateHeader(), _added, _nDataCodewords + _nParityCodewords, _syndrome);
+	}
+
+	bool Syndrome::LoadState(const uint8_t* buffer, size_t length) {
+		if (!LoadAccumulatorState(buffer, length, GetStateHeader(), _added, _nDataCodewords + _nParityCodewords, _syndrome)) return false;
+		if (_horner != nullptr) _horner->Clear();
+		return true;
 	}
 
 	void Syndrome::GetSyndromeSlice(uint16_t* data, size_t exponent) const {
+		FlushHorner();
 
 		size_t segment = exponent / CODEWORDS_PER_SEGMENT;
 		size_t segmentOffset = exponent % CODEWORDS_PER_SEGMENT;
 
-		uint16_t* p = (uint16_t*)(_syndrome + _codewordsPerSlice) + segmentOffset;
+		uint16_t* p = (uint16_t*)(_syndrome + segment * _codewordsPerSlice) + segmentOffset;
 		uint16_t* dest = (uint16_t*)data;
 		for (size_t i = 0; i < _codewordsPerSlice; i++, dest++, p += CODEWORDS_PER_SEGMENT) {
 			*dest = *p;
 		}
 	}
 
+	bool Syndrome::Merge(const Syndrome& other) {
+		if (other._nDataCodewords != _nDataCodewords || other._nParityCodewords != _nParityCodewords ||
+			other._codewordsPerSlice != _codewordsPerSlice) return false;
+
+		size_t bitmapBytes = (_nDataCodewords + _nParityCodewords + 7) / 8;
+		for (size_t i = 0; i < bitmapBytes; i++) {
+			if ((_added[i] & other._added[i]) != 0) return false;
+		}
+
+		FlushHorner();
+		other.FlushHorner();
+		XorBlocks(_syndrome, other._syndrome, _segmentsPerVector * _codewordsPerSlice);
+		for (size_t i = 0; i < bitmapBytes; i++) _added[i] |= other._added[i];
+		return true;
+	}
+
 	Syndrome* Syndrome_Construct(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice) {
 		return new Syndrome(nDataCodewords, nParityCodewords, codewordsPerSlice);
 	}
@@ -89,5 +260,25 @@ namespace ReedSolomon {
 
 	void Syndrome_AddCodewordSlice(Syndrome* p, uint16_t* data, size_t exponent) { p->AddCodewordSlice(data, exponent); }
 
+	bool Syndrome_AddCodewordSliceBatch(Syndrome** syndromes, uint16_t** data, size_t count, size_t exponent) {
+		return Syndrome::AddCodewordSliceBatch(syndromes, data, count, exponent);
+	}
+
 	void Syndrome_GetSyndromeSlice(const Syndrome* p, uint16_t* data, size_t exponent) { p->GetSyndromeSlice(data, exponent); }
+
+	size_t Syndrome_GetDamagedRanges(const Syndrome* p, size_t granularity, uint32_t* ranges, size_t maxRanges) {
+		return p->GetDamagedRanges(granularity, ranges, maxRanges);
+	}
+
+	size_t Syndrome_GetMaxDamagedRanges(const Syndrome* p, size_t granularity) { return p->GetMaxDamagedRanges(granularity); }
+
+	bool Syndrome_IsAdded(const Syndrome* p, size_t exponent) { return p->IsAdded(exponent); }
+
+	size_t Syndrome_GetStateSize(const Syndrome* p) { return p->GetStateSize(); }
+
+	void Syndrome_SaveState(const Syndrome* p, uint8_t* buffer) { p->SaveState(buffer); }
+
+	bool Syndrome_LoadState(Syndrome* p, const uint8_t* buffer, size_t length) { return p->LoadState(buffer, length); }
+
+	bool Syndrome_Merge(Syndrome* p, const Syndrome* other) { return p->Merge(*other); }
 }
\ No newline at end of file
@@ -4,9 +4,15 @@
 #include <immintrin.h>
 #include "GF16MultiplicationTable.h"
 #include "Parity.h"
+#include "ParityJit.h"
+#include "AccumulatorState.h"
+#include "HornerAccumulator.h"
 
 namespace ReedSolomon {
 
+	// With three parity codewords or fewer, slices added in descending exponent order go through a HornerAccumulator, with no
+	// multiplication tables, as in Parity.  The const accessors fold a pending run in first.  With more, a slice goes through the
+	// run kernel for the geometry, if it has one, in a single pass over the syndromes.
 	class Syndrome {
 
 	public:
@@ -18,6 +24,10 @@ namespace ReedSolomon {
 
 		void AddCodewordSlice(uint16_t* data, size_t exponent);
 
+		// Adds slice data[i] to syndromes[i] at the same exponent for each of count instances with the same geometry, building each
+		// multiplication table once for all of them.  Returns false, leaving every instance unchanged, if the geometries differ.
+		static bool AddCodewordSliceBatch(Syndrome* const* syndromes, uint16_t* const* data, size_t count, size_t exponent);
+
 		void GetSyndromeSlice(uint16_t* data, size_t exponent) const;
 
 		inline size_t GetNParityCodewords() const { return _nParityCodewords; }
@@ -25,25 +35,67 @@ namespace ReedSolomon {
 
 		uint16_t GetSyndrome(size_t codeword, size_t exponent) const;
 
+		// Writes the [start, end) codeword ranges in which any syndrome is nonzero, widened to whole multiples of granularity
+		// codewords and merged where they touch, as pairs into ranges.  Returns the number of ranges found, of which at most
+		// maxRanges are written; GetMaxDamagedRanges gives the most there can be.
+		size_t GetDamagedRanges(size_t granularity, uint32_t* ranges, size_t maxRanges) const;
+		inline size_t GetMaxDamagedRanges(size_t granularity) const {
+			if (granularity == 0) granularity = 1;
+			return ((_codewordsPerSlice + granularity - 1) / granularity + 1) / 2;
+		}
+
+		// Whether the slice with this exponent has been added since the last reset
+		bool IsAdded(size_t exponent) const;
+
+		// Save and restore the accumulated syndromes and the set of exponents added, in the AccumulatorState layout
+		size_t GetStateSize() const;
+		void SaveState(uint8_t* buffer) const;
+		bool LoadState(const uint8_t* buffer, size_t length);
+
+		// Adds the syndromes accumulated by another instance with the same geometry over a disjoint set of slices.  Returns false,
+		// leaving this instance unchanged, if the geometry differs or a slice was added to both.
+		bool Merge(const Syndrome& other);
+
 	private:
 
+		AccumulatorStateHeader GetStateHeader() const;
+		bool AddHorner(uint16_t* data, size_t exponent);
+		void FlushHorner() const;
+		inline size_t GetRunTablesSize() const { return _segmentsPerVector * GF16MultiplicationTable::TABLE_BLOCKS * 16; }
+
 		size_t _nParityCodewords;
 		size_t _nDataCodewords;
 		size_t _codewordsPerSlice;
 
 		size_t _segmentsPerVector;
 
-		GF16MultiplicationTable _multiplicationTable;
+		mutable GF16MultiplicationTable _multiplicationTable;
+
+		// The Horner path, or null with more than HornerAccumulator::MAX_POINTS parity codewords
+		HornerAccumulator* _horner;
+
+		// A run kernel of one slice and its tables, or null for the table path
+		ParityRunKernel _runKernel;
+		__m128i* _runTables;
 
 		uint16_t* _vectors;
 
 		__m128i* _syndrome;
+		uint8_t* _added;
 	};
 
 	extern "C" {
 		__declspec(dllexport) Syndrome* Syndrome_Construct(size_t nDataCodewords, size_t nParityCodewords, size_t codewordsPerSlice);
 		__declspec(dllexport) void Syndrome_Destruct(Syndrome* p);
 		__declspec(dllexport) void Syndrome_AddCodewordSlice(Syndrome* p, uint16_t* data, size_t exponent);
+		__declspec(dllexport) bool Syndrome_AddCodewordSliceBatch(Syndrome** syndromes, uint16_t** data, size_t count, size_t exponent);
 		__declspec(dllexport) void Syndrome_GetSyndromeSlice(const Syndrome* p, uint16_t* data, size_t exponent);
+		__declspec(dllexport) size_t Syndrome_GetDamagedRanges(const Syndrome* p, size_t granularity, uint32_t* ranges, size_t maxRanges);
+		__declspec(dllexport) size_t Syndrome_GetMaxDamagedRanges(const Syndrome* p, size_t granularity);
+		__declspec(dllexport) bool Syndrome_IsAdded(const Syndrome* p, size_t exponent);
+		__declspec(dllexport) size_t Syndrome_GetStateSize(const Syndrome* p);
+		__declspec(dllexport) void Syndrome_SaveState(const Syndrome* p, uint8_t* buffer);
+		__declspec(dllexport) bool Syndrome_LoadState(Syndrome* p, const uint8_t* buffer, size_t length);
+		__declspec(dllexport) bool Syndrome_Merge(Syndrome* p, const Syndrome* other);
 	}
 }
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+#include "TrackStateIndex.h"
+#include "BufferPool.h"
+#include <stdexcept>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace ReedSolomon {
+
+	static inline int LowestBit(uint64_t x) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, x);
+		return (int)index;
+#else
+		return __builtin_ctzll(x);
+#endif
+	}
+
+	TrackStateIndex::TrackStateIndex(size_t trackCount, size_t dataClusterCount, size_t clusterCount, const int* clusterTracks) :
+		_trackCount(trackCount), _dataClusterCount(dataClusterCount), _clusterCount(clusterCount) {
+
+		if (dataClusterCount > clusterCount) throw std::invalid_argument("More data clusters than clusters");
+		for (size_t i = 0; i < clusterCount; i++) {
+			if (clusterTracks[i] < -1 || clusterTracks[i] >= (int)trackCount) throw std::invalid_argument("Track out of range");
+		}
+
+		_bitmapBlocks = (trackCount + 127) / 128;
+
+		_clusterTracks = new int[clusterCount];
+		memcpy(_clusterTracks, clusterTracks, clusterCount * sizeof(int));
+
+		_dirtyData = new uint32_t[trackCount];
+		_usedData = new uint32_t[trackCount];
+		_unwrittenParity = new uint32_t[trackCount];
+
+		_used = (__m128i*)BufferPool::Allocate(_bitmapBlocks * sizeof(__m128i));
+		_stale = (__m128i*)BufferPool::Allocate(_bitmapBlocks * sizeof(__m128i));
+
+		Load(nullptr);
+	}
+
+	TrackStateIndex::~TrackStateIndex() {
+		delete[] _clusterTracks;
+		delete[] _dirtyData;
+		delete[] _usedData;
+		delete[] _unwrittenParity;
+		BufferPool::Free(_used, _bitmapBlocks * sizeof(__m128i));
+		BufferPool::Free(_stale, _bitmapBlocks * sizeof(__m128i));
+	}
+
+	void TrackStateIndex::Load(const uint8_t* states) {
+		memset(_dirtyData, 0, _trackCount * sizeof(uint32_t));
+		memset(_usedData, 0, _trackCount * sizeof(uint32_t));
+		memset(_unwrittenParity, 0, _trackCount * sizeof(uint32_t));
+		memset(_used, 0, _bitmapBlocks * sizeof(__m128i));
+		memset(_stale, 0, _bitmapBlocks * sizeof(__m128i));
+
+		if (states == nullptr) return;
+
+		for (size_t i = 0; i < _clusterCount; i++) Add(i, states[i], 1);
+		for (size_t i = 0; i < _trackCount; i++) UpdateBits(i);
+	}
+
+	void TrackStateIndex::Update(size_t cluster, uint8_t oldState, uint8_t newState) {
+		if (cluster >= _clusterCount) throw std::invalid_argument("Cluster out of range");
+		if (_clusterTracks[cluster] < 0 || oldState == newState) return;
+
+		Add(cluster, oldState, -1);
+		Add(cluster, newState, 1);
+		UpdateBits(_clusterTracks[cluster]);
+	}
+
+	void TrackStateIndex::Add(size_t cluster, uint8_t state, int delta) {
+		int track = _clusterTracks[cluster];
+		if (track < 0) return;
+
+		if (cluster < _dataClusterCount) {
+			if (IsDirty(state)) _dirtyData[track] += delta;
+			if ((state & STATE_USED) != 0) _usedData[track] += delta;
+		} else {
+			if ((state & STATE_UNWRITTEN) != 0) _unwrittenParity[track] += delta;
+		}
+	}
+
+	void TrackStateIndex::UpdateBits(size_t track) {
+		uint64_t mask = (uint64_t)1 << (track % 64);
+		uint64_t& used = ((uint64_t*)_used)[track / 64];
+		uint64_t& stale = ((uint64_t*)_stale)[track / 64];
+
+		bool isUsed = _usedData[track] != 0;
+		bool isStale = isUsed && (_dirtyData[track] != 0 || _unwrittenParity[track] != 0);
+
+		used = isUsed ? (used | mask) : (used & ~mask);
+		stale = isStale ? (stale | mask) : (stale & ~mask);
+	}
+
+	size_t TrackStateIndex::Scan(const __m128i* bitmap, int* tracks, size_t capacity) const {
+		__m128i zero = _mm_setzero_si128();
+		size_t count = 0;
+
+		for (size_t block = 0; block < _bitmapBlocks; block++) {
+			__m128i bits = _mm_load_si128(bitmap + block);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(bits, zero)) == 0xFFFF) continue;
+
+			const uint64_t* words = (const uint64_t*)(bitmap + block);
+			for (int w = 0; w < 2; w++) {
+				uint64_t word = words[w];
+				while (word != 0) {
+					if (count < capacity) tracks[count] = (int)(block * 128 + w * 64 + LowestBit(word));
+					count++;
+					word &= word - 1;
+				}
+			}
+		}
+		return count;
+	}
+
+	TrackStateIndex* TrackStateIndex_Construct(size_t trackCount, size_t dataClusterCount, size_t clusterCount, const int* clusterTracks) {
+		try {
+			return new TrackStateIndex(trackCount, dataClusterCount, clusterCount, clusterTracks);
+		} catch (std::exception&) {
+			return nullptr;
+		}
+	}
+
+	void TrackStateIndex_Destruct(TrackStateIndex* p) { delete p; }
+
+	void TrackStateIndex_Load(TrackStateIndex* p, const uint8_t* states) { p->Load(states); }
+
+	bool TrackStateIndex_Update(TrackStateIndex* p, size_t cluster, uint8_t oldState, uint8_t newState) {
+		try {
+			p->Update(cluster, oldState, newState);
+			return true;
+		} catch (std::exception&) {
+			return false;
+		}
+	}
+
+	bool TrackStateIndex_IsUsed(const TrackStateIndex* p, size_t track) { return p->IsUsed(track); }
+
+	bool TrackStateIndex_IsDataModified(const TrackStateIndex* p, size_t track) { return p->IsDataModified(track); }
+
+	bool TrackStateIndex_IsParityWritten(const TrackStateIndex* p, size_t track) { return p->IsParityWritten(track); }
+
+	bool TrackStateIndex_IsUpToDate(const TrackStateIndex* p, size_t track) { return p->IsUpToDate(track); }
+
+	size_t TrackStateIndex_GetUsedTracks(const TrackStateIndex* p, int* tracks, size_t capacity) { return p->GetUsedTracks(tracks, capacity); }
+
+	size_t TrackStateIndex_GetStaleTracks(const TrackStateIndex* p, int* tracks, size_t capacity) { return p->GetStaleTracks(tracks, capacity); }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <immintrin.h>
+
+namespace ReedSolomon {
+
+	// Per-track summary of the cluster state table, kept up to date one state change at a time.
+	//
+	// Each track keeps a count of its dirty data clusters, used data clusters and unwritten parity clusters, so the questions the
+	// parity updater asks of a track are answered without reading its clusters.  Two bitmaps with one bit per track mark the used
+	// tracks and the stale tracks (used, but with modified data or unwritten parity), and are scanned 128 bits at a time.
+	//
+	// The state values are the flags of SRFS.Model.ClusterState.  Clusters below dataClusterCount are data clusters and the rest are
+	// parity clusters.  clusterTracks gives the track of each cluster, or -1 for clusters that belong to no track.
+	class TrackStateIndex {
+
+	public:
+
+		static const uint8_t STATE_SYSTEM = 0x04;
+		static const uint8_t STATE_UNWRITTEN = 0x08;
+		static const uint8_t STATE_MODIFIED = 0x10;
+		static const uint8_t STATE_USED = 0x20;
+
+		TrackStateIndex(size_t trackCount, size_t dataClusterCount, size_t clusterCount, const int* clusterTracks);
+		~TrackStateIndex();
+
+		// Rebuilds the index from the whole state table
+		void Load(const uint8_t* states);
+
+		void Update(size_t cluster, uint8_t oldState, uint8_t newState);
+
+		inline size_t GetTrackCount() const { return _trackCount; }
+
+		inline bool IsUsed(size_t track) const { return _usedData[track] != 0; }
+		inline bool IsDataModified(size_t track) const { return _dirtyData[track] != 0; }
+		inline bool IsParityWritten(size_t track) const { return _unwrittenParity[track] == 0; }
+		inline bool IsUpToDate(size_t track) const { return !TestBit(_stale, track); }
+
+		// Writes the numbers of the used or stale tracks, in order, into tracks and returns how many there are.  At most capacity
+		// are written.
+		size_t GetUsedTracks(int* tracks, size_t capacity) const { return Scan(_used, tracks, capacity); }
+		size_t GetStaleTracks(int* tracks, size_t capacity) const { return Scan(_stale, tracks, capacity); }
+
+	private:
+
+		// Unwritten data clusters are not dirty, since the parity treats them as slices of zeros
+		static inline bool IsDirty(uint8_t state) {
+			return (state & STATE_SYSTEM) == 0 && (state & STATE_MODIFIED) != 0;
+		}
+
+		static inline bool TestBit(const __m128i* bitmap, size_t track) {
+			return (((const uint64_t*)bitmap)[track / 64] >> (track % 64) & 1) != 0;
+		}
+
+		void Add(size_t cluster, uint8_t state, int delta);
+		void UpdateBits(size_t track);
+		size_t Scan(const __m128i* bitmap, int* tracks, size_t capacity) const;
+
+		size_t _trackCount;
+		size_t _dataClusterCount;
+		size_t _clusterCount;
+		size_t _bitmapBlocks;
+
+		int* _clusterTracks;
+
+		uint32_t* _dirtyData;
+		uint32_t* _usedData;
+		uint32_t* _unwrittenParity;
+
+		__m128i* _used;
+		__m128i* _stale;
+	};
+
+	// The exports report invalid arguments by their result rather than by throwing, since an exception cannot cross into the managed
+	// caller: Construct returns null and Update returns false.
+	extern "C" {
+		__declspec(dllexport) TrackStateIndex* TrackStateIndex_Construct(size_t trackCount, size_t dataClusterCount, size_t clusterCount, const int* clusterTracks);
+		__declspec(dllexport) void TrackStateIndex_Destruct(TrackStateIndex* p);
+		__declspec(dllexport) void TrackStateIndex_Load(TrackStateIndex* p, const uint8_t* states);
+		__declspec(dllexport) bool TrackStateIndex_Update(TrackStateIndex* p, size_t cluster, uint8_t oldState, uint8_t newState);
+		__declspec(dllexport) bool TrackStateIndex_IsUsed(const TrackStateIndex* p, size_t track);
+		__declspec(dllexport) bool TrackStateIndex_IsDataModified(const TrackStateIndex* p, size_t track);
+		__declspec(dllexport) bool TrackStateIndex_IsParityWritten(const TrackStateIndex* p, size_t track);
+		__declspec(dllexport) bool TrackStateIndex_IsUpToDate(const TrackStateIndex* p, size_t track);
+		__declspec(dllexport) size_t TrackStateIndex_GetUsedTracks(const TrackStateIndex* p, int* tracks, size_t capacity);
+		__declspec(dllexport) size_t TrackStateIndex_GetStaleTracks(const TrackStateIndex* p, int* tracks, size_t capacity);
+	}
+}
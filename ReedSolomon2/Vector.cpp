@@ -1,30 +1,32 @@
 #include "stdafx.h"
 #include "Vector.h"
 #include "GF16.h"
+#include "BufferPool.h"
 #include <iostream>
 
 namespace ReedSolomon {
 
 	Vector::Vector(int length) {
-		elements = new uint16_t[length];
+		elements = (uint16_t*)BufferPool::Allocate(length * sizeof(uint16_t));
 		this->length = length;
 		memset(elements, 0, length * sizeof(uint16_t));
 	}
 
 	Vector::Vector(const Vector& v) {
-		elements = new uint16_t[v.length];
+		elements = (uint16_t*)BufferPool::Allocate(v.length * sizeof(uint16_t));
 		length = v.length;
 		memcpy(elements, v.elements, length * sizeof(uint16_t));
 	}
 
 	Vector::~Vector() {
-		delete[] elements;
+		BufferPool::Free(elements, length * sizeof(uint16_t));
 	}
 
 	void Vector::operator=(const Vector& v) {
 		if (length != v.length) {
-			delete[] elements;
-			elements = new uint16_t[v.length];
+			BufferPool::Free(elements, length * sizeof(uint16_t));
+			elements = (uint16_t*)BufferPool::Allocate(v.length * sizeof(uint16_t));
+			length = v.length;
 		}
 		memcpy(elements, v.elements, length * sizeof(uint16_t));
 	}
@@ -0,0 +1,136 @@
+#include "stdafx.h"
+#include "WriteBackBuffer.h"
+#include "BufferPool.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace ReedSolomon {
+
+	WriteBackBuffer::WriteBackBuffer(size_t capacityBytes) :
+		_capacityBytes(capacityBytes),
+		_pendingBytes(0),
+		_coalescedWrites(0) {
+	}
+
+	WriteBackBuffer::~WriteBackBuffer() {
+		for (auto& e : _entries) BufferPool::Free(e.second.data, e.second.length);
+	}
+
+	bool WriteBackBuffer::Put(int64_t offset, int32_t track, const uint8_t* data, size_t length) {
+		std::lock_guard<std::mutex> lock(_lock);
+
+		auto found = _entries.find(offset);
+		if (found != _entries.end()) {
+			Entry& entry = found->second;
+			if (entry.length != length) {
+				BufferPool::Free(entry.data, entry.length);
+				_pendingBytes -= entry.length;
+				entry.data = (uint8_t*)BufferPool::Allocate(length);
+				entry.length = length;
+				_pendingBytes += length;
+			}
+			entry.track = track;
+			memcpy(entry.data, data, length);
+			_coalescedWrites++;
+		} else {
+			Entry entry;
+			entry.track = track;
+			entry.data = (uint8_t*)BufferPool::Allocate(length);
+			entry.length = length;
+			memcpy(entry.data, data, length);
+			_entries.emplace(offset, entry);
+			_pendingBytes += length;
+		}
+
+		if (track >= 0) _dirtyTracks.insert(track);
+		return _pendingBytes > _capacityBytes;
+	}
+
+	bool WriteBackBuffer::Read(int64_t offset, uint8_t* data, size_t length) const {
+		std::lock_guard<std::mutex> lock(_lock);
+
+		auto found = _entries.find(offset);
+		if (found == _entries.end() || found->second.length != length) return false;
+		memcpy(data, found->second.data, length);
+		return true;
+	}
+
+	void WriteBackBuffer::Remove(int64_t offset) {
+		std::lock_guard<std::mutex> lock(_lock);
+
+		auto found = _entries.find(offset);
+		if (found == _entries.end()) return;
+		BufferPool::Free(found->second.data, found->second.length);
+		_pendingBytes -= found->second.length;
+		_entries.erase(found);
+	}
+
+	size_t WriteBackBuffer::GetFlushOrder(int64_t* offsets, size_t capacity) const {
+		std::vector<std::pair<int32_t, int64_t>> order;
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			order.reserve(_entries.size());
+			for (auto& e : _entries) order.emplace_back(e.second.track, e.first);
+		}
+		std::sort(order.begin(), order.end());
+
+		size_t count = std::min(order.size(), capacity);
+		for (size_t i = 0; i < count; i++) offsets[i] = order[i].second;
+		return count;
+	}
+
+	size_t WriteBackBuffer::TakeDirtyTracks(int32_t* tracks, size_t capacity) {
+		std::lock_guard<std::mutex> lock(_lock);
+
+		size_t count = 0;
+		auto i = _dirtyTracks.begin();
+		for (; i != _dirtyTracks.end() && count < capacity; ++i) tracks[count++] = *i;
+		_dirtyTracks.erase(_dirtyTracks.begin(), i);
+		return count;
+	}
+
+	size_t WriteBackBuffer::GetPendingCount() const {
+		std::lock_guard<std::mutex> lock(_lock);
+		return _entries.size();
+	}
+
+	size_t WriteBackBuffer::GetPendingBytes() const {
+		std::lock_guard<std::mutex> lock(_lock);
+		return _pendingBytes;
+	}
+
+	uint64_t WriteBackBuffer::GetCoalescedWrites() const {
+		std::lock_guard<std::mutex> lock(_lock);
+		return _coalescedWrites;
+	}
+
+	WriteBackBuffer* WriteBackBuffer_Construct(size_t capacityBytes) { return new WriteBackBuffer(capacityBytes); }
+
+	void WriteBackBuffer_Destruct(WriteBackBuffer* p) { delete p; }
+
+	bool WriteBackBuffer_Put(WriteBackBuffer* p, int64_t offset, int32_t track, const uint8_t* data, size_t length) {
+		return p->Put(offset, track, data, length);
+	}
+
+	bool WriteBackBuffer_Read(const WriteBackBuffer* p, int64_t offset, uint8_t* data, size_t length) {
+		return p->Read(offset, data, length);
+	}
+
+	void WriteBackBuffer_Remove(WriteBackBuffer* p, int64_t offset) { p->Remove(offset); }
+
+	size_t WriteBackBuffer_GetFlushOrder(const WriteBackBuffer* p, int64_t* offsets, size_t capacity) {
+		return p->GetFlushOrder(offsets, capacity);
+	}
+
+	size_t WriteBackBuffer_TakeDirtyTracks(WriteBackBuffer* p, int32_t* tracks, size_t capacity) {
+		return p->TakeDirtyTracks(tracks, capacity);
+	}
+
+	size_t WriteBackBuffer_GetPendingCount(const WriteBackBuffer* p) { return p->GetPendingCount(); }
+
+	size_t WriteBackBuffer_GetPendingBytes(const WriteBackBuffer* p) { return p->GetPendingBytes(); }
+
+	uint64_t WriteBackBuffer_GetCoalescedWrites(const WriteBackBuffer* p) { return p->GetCoalescedWrites(); }
+}
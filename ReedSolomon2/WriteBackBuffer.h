@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+namespace ReedSolomon {
+
+	// Unsealed cluster images waiting to be written, keyed by device offset.
+	//
+	// A cluster written several times between flushes keeps only its last image, so the caller seals and writes it once.  The flush
+	// order groups the pending images by track and sorts each group by device offset, so a flush touches one track at a time and
+	// writes it front to back.  Images with track -1 (clusters that belong to no track) come first.
+	//
+	// The tracks of every image put since the last TakeDirtyTracks are remembered separately from the pending images, so a caller
+	// that flushes several times within one window still refreshes the parity of each track once.
+	class WriteBackBuffer {
+
+	public:
+
+		WriteBackBuffer(size_t capacityBytes);
+		~WriteBackBuffer();
+
+		// Copies an image in, replacing the pending image at the same offset.  Returns true if the pending images are over budget
+		// and should be flushed.
+		bool Put(int64_t offset, int32_t track, const uint8_t* data, size_t length);
+
+		// Copies the pending image at an offset.  Returns false if there is none or if its length differs.
+		bool Read(int64_t offset, uint8_t* data, size_t length) const;
+
+		void Remove(int64_t offset);
+
+		// Writes the offsets of the pending images, in flush order, and returns how many there are.  At most capacity are written.
+		size_t GetFlushOrder(int64_t* offsets, size_t capacity) const;
+
+		// Writes the tracks put since the last call, in order, and forgets them.  At most capacity are written.
+		size_t TakeDirtyTracks(int32_t* tracks, size_t capacity);
+
+		size_t GetPendingCount() const;
+		size_t GetPendingBytes() const;
+
+		// The number of puts that replaced a pending image instead of adding one
+		uint64_t GetCoalescedWrites() const;
+
+	private:
+
+		struct Entry {
+			int32_t track;
+			uint8_t* data;
+			size_t length;
+		};
+
+		mutable std::mutex _lock;
+		std::unordered_map<int64_t, Entry> _entries;
+		std::set<int32_t> _dirtyTracks;
+		size_t _capacityBytes;
+		size_t _pendingBytes;
+		uint64_t _coalescedWrites;
+	};
+
+	extern "C" {
+		__declspec(dllexport) WriteBackBuffer* WriteBackBuffer_Construct(size_t capacityBytes);
+		__declspec(dllexport) void WriteBackBuffer_Destruct(WriteBackBuffer* p);
+		__declspec(dllexport) bool WriteBackBuffer_Put(WriteBackBuffer* p, int64_t offset, int32_t track, const uint8_t* data, size_t length);
+		__declspec(dllexport) bool WriteBackBuffer_Read(const WriteBackBuffer* p, int64_t offset, uint8_t* data, size_t length);
+		__declspec(dllexport) void WriteBackBuffer_Remove(WriteBackBuffer* p, int64_t offset);
+		__declspec(dllexport) size_t WriteBackBuffer_GetFlushOrder(const WriteBackBuffer* p, int64_t* offsets, size_t capacity);
+		__declspec(dllexport) size_t WriteBackBuffer_TakeDirtyTracks(WriteBackBuffer* p, int32_t* tracks, size_t capacity);
+		__declspec(dllexport) size_t WriteBackBuffer_GetPendingCount(const WriteBackBuffer* p);
+		__declspec(dllexport) size_t WriteBackBuffer_GetPendingBytes(const WriteBackBuffer* p);
+		__declspec(dllexport) uint64_t WriteBackBuffer_GetCoalescedWrites(const WriteBackBuffer* p);
+	}
+}
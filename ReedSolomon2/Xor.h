@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <immintrin.h>
+
+namespace ReedSolomon {
+
+	// dest ^= source over aligned blocks of 16 bytes
+	inline void XorBlocks(__m128i* dest, const __m128i* source, size_t blocks) {
+		size_t i = 0;
+		for (; i + 4 <= blocks; i += 4) {
+			__m128i a = _mm_xor_si128(_mm_load_si128(dest + i), _mm_load_si128(source + i));
+			__m128i b = _mm_xor_si128(_mm_load_si128(dest + i + 1), _mm_load_si128(source + i + 1));
+			__m128i c = _mm_xor_si128(_mm_load_si128(dest + i + 2), _mm_load_si128(source + i + 2));
+			__m128i d = _mm_xor_si128(_mm_load_si128(dest + i + 3), _mm_load_si128(source + i + 3));
+			_mm_store_si128(dest + i, a);
+			_mm_store_si128(dest + i + 1, b);
+			_mm_store_si128(dest + i + 2, c);
+			_mm_store_si128(dest + i + 3, d);
+		}
+		for (; i < blocks; i++) _mm_store_si128(dest + i, _mm_xor_si128(_mm_load_si128(dest + i), _mm_load_si128(source + i)));
+	}
+}
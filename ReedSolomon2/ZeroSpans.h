@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <immintrin.h>
+
+namespace ReedSolomon {
+
+	// Zero runs are detected a chunk of 64 codewords (128 bytes) at a time
+	static const size_t ZERO_SPAN_CODEWORDS = 64;
+
+	// The most spans FindNonZeroSpans can return for a slice of count codewords
+	inline size_t GetMaxNonZeroSpans(size_t count) {
+		return (count + ZERO_SPAN_CODEWORDS - 1) / ZERO_SPAN_CODEWORDS / 2 + 1;
+	}
+
+	inline bool IsZeroChunk(const uint16_t* data, size_t count) {
+		if (count == ZERO_SPAN_CODEWORDS) {
+			const __m128i* p = (const __m128i*)data;
+			__m128i a = _mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1));
+			__m128i b = _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3));
+			__m128i c = _mm_or_si128(_mm_loadu_si128(p + 4), _mm_loadu_si128(p + 5));
+			__m128i d = _mm_or_si128(_mm_loadu_si128(p + 6), _mm_loadu_si128(p + 7));
+			__m128i x = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128())) == 0xFFFF;
+		}
+		for (size_t i = 0; i < count; i++) if (data[i] != 0) return false;
+		return true;
+	}
+
+	inline bool IsZeroSlice(const uint16_t* data, size_t count) {
+		for (size_t start = 0; start < count; start += ZERO_SPAN_CODEWORDS) {
+			if (!IsZeroChunk(data + start, count - start < ZERO_SPAN_CODEWORDS ? count - start : ZERO_SPAN_CODEWORDS)) return false;
+		}
+		return true;
+	}
+
+	// Splits a slice into the spans of chunks that hold a non-zero codeword.  Writes [start, end) codeword pairs into spans, which
+	// must have room for GetMaxNonZeroSpans(count) pairs, and returns the number of spans.
+	inline size_t FindNonZeroSpans(const uint16_t* data, size_t count, size_t* spans) {
+		size_t nSpans = 0;
+		bool inSpan = false;
+		for (size_t start = 0; start < count; start += ZERO_SPAN_CODEWORDS) {
+			size_t length = count - start < ZERO_SPAN_CODEWORDS ? count - start : ZERO_SPAN_CODEWORDS;
+			bool isZero = IsZeroChunk(data + start, length);
+			if (!isZero && !inSpan) spans[2 * nSpans] = start;
+			if (isZero && inSpan) spans[2 * nSpans++ + 1] = start;
+			inSpan = !isZero;
+		}
+		if (inSpan) spans[2 * nSpans++ + 1] = count;
+		return nSpans;
+	}
+}
@@ -5,12 +5,24 @@
 
 #pragma once
 
+#ifdef _WIN32
+
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 // Windows Header Files:
 #include <windows.h>
 
+#else
+
+// Other platforms build the codec as a static library for the command-line tool.  The exports become plain extern "C" functions
+// and __m128i is 16-byte aligned without being asked.
+#define __declspec(x)
+#include <cstdlib>
+#include <cstring>
+
+#endif
+
 
 
 // TODO: reference additional headers your program requires here
@@ -0,0 +1,399 @@
+#include "stdafx.h"
+#include "Protect.h"
+#include "Parallel.h"
+#include "Progress.h"
+#include "Crc32c.h"
+#include "Parity.h"
+#include "Syndrome.h"
+#include "AdaptiveRepair.h"
+#include "SimulatedDevice.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+// bench: measures scrub, degraded read and repair throughput against a SimulatedDevice that injects faults.
+//
+// The device holds stripes of data blocks followed by their parity blocks.  Every block has a CRC-32C kept in memory, as the cluster
+// checksums are kept on a real volume, so damage is found by checksum and repaired as erasures.  The phases are:
+//
+//   write     fill the data blocks with random bytes, encode each stripe and write it (torn writes happen here)
+//   scrub     read every block and check its checksum, and the syndromes of stripes without damage
+//   degraded  read every data block, rebuilding the damaged ones from their stripe without writing them back
+//   repair    rebuild the damaged blocks found by the scrub and write them back
+//   verify    scrub again, without new faults
+//
+// The device model is a comma-separated list of name=value settings:
+//
+//   rot, loss, slow   probability per block read of a flipped bit, a lost block and a slow block
+//   torn              probability per write that it stops at a random sector
+//   latency           seconds per request
+//   bandwidth         bytes per second, with an optional k, M or G suffix
+//   slowtime          extra seconds per slow block read
+//   seed              the seed of the fault generator
+//   sleep             wait out the modeled time instead of only adding it up
+
+namespace ReedSolomonProtect {
+
+	static const uint64_t DEFAULT_BENCH_BLOCK_SIZE = 64 * 1024;
+
+	struct DeviceModel {
+		ReedSolomon::SimulatedTiming timing = { 0.0001, 500.0 * 1024 * 1024, 0.01, false };
+		ReedSolomon::SimulatedFaults faults = { 1, 0.001, 0.001, 0.0001, 0 };
+	};
+
+	static double ParseRate(const std::string& name, const std::string& text) {
+		char* end;
+		double value = strtod(text.c_str(), &end);
+		switch (*end) {
+		case 'k': case 'K': value *= 1024; end++; break;
+		case 'm': case 'M': value *= 1024 * 1024; end++; break;
+		case 'g': case 'G': value *= 1024 * 1024 * 1024; end++; break;
+		}
+		if (text.empty() || *end != '\0' || value < 0) throw std::invalid_argument("Invalid value for " + name + ": " + text);
+		return value;
+	}
+
+	static DeviceModel ParseDeviceModel(const std::string& text) {
+		DeviceModel model;
+		size_t start = 0;
+		while (start < text.size()) {
+			size_t comma = text.find(',', start);
+			if (comma == std::string::npos) comma = text.size();
+			std::string setting = text.substr(start, comma - start);
+			start = comma + 1;
+			if (setting.empty()) continue;
+
+			size_t equals = setting.find('=');
+			std::string name = setting.substr(0, equals);
+			std::string value = equals == std::string::npos ? std::string() : setting.substr(equals + 1);
+
+			if (name == "sleep" && equals == std::string::npos) model.timing.sleep = true;
+			else if (name == "rot") model.faults.bitRotPerRead = ParseRate(name, value);
+			else if (name == "loss") model.faults.lossPerRead = ParseRate(name, value);
+			else if (name == "slow") model.faults.slowPerRead = ParseRate(name, value);
+			else if (name == "torn") model.faults.tornPerWrite = ParseRate(name, value);
+			else if (name == "latency") model.timing.latencySeconds = ParseRate(name, value);
+			else if (name == "bandwidth") model.timing.bytesPerSecond = ParseRate(name, value);
+			else if (name == "slowtime") model.timing.slowBlockSeconds = ParseRate(name, value);
+			else if (name == "seed") model.faults.seed = (uint64_t)ParseRate(name, value);
+			else throw std::invalid_argument("Unknown device model setting " + setting);
+		}
+		return model;
+	}
+
+	class BenchStripes {
+
+	public:
+
+		BenchStripes(uint64_t blockSize, uint32_t nData, uint32_t nParity, uint32_t stripeCount) :
+			_blockSize(blockSize), _nData(nData), _nParity(nParity), _stripeCount(stripeCount),
+			_checksums((size_t)stripeCount * (nData + nParity)),
+			_device(stripeCount * (nData + nParity) * blockSize, (uint32_t)blockSize) {
+		}
+
+		inline uint32_t GetNData() const { return _nData; }
+		inline uint32_t GetNParity() const { return _nParity; }
+		inline uint32_t GetNBlocks() const { return _nData + _nParity; }
+		inline uint64_t GetBlockSize() const { return _blockSize; }
+		inline uint32_t GetStripeCount() const { return _stripeCount; }
+		inline ReedSolomon::SimulatedDevice& GetDevice() { return _device; }
+
+		// Data blocks take the exponents above the parity in descending order, as the tracks of a volume do
+		inline size_t GetExponent(uint32_t block) const { return block < _nData ? _nParity + _nData - 1 - block : block - _nData; }
+
+		inline uint64_t GetOffset(uint32_t stripe, uint32_t block) const { return ((uint64_t)stripe * GetNBlocks() + block) * _blockSize; }
+
+		inline uint32_t& GetChecksum(uint32_t stripe, uint32_t block) { return _checksums[(size_t)stripe * GetNBlocks() + block]; }
+
+		// Reads a block and returns whether it is intact
+		bool ReadBlock(uint32_t stripe, uint32_t block, uint8_t* data) {
+			bool readable = _device.Read(GetOffset(stripe, block), data, (size_t)_blockSize);
+			return readable && ReedSolomon::Crc32c(data, (size_t)_blockSize) == GetChecksum(stripe, block);
+		}
+
+		void WriteBlock(uint32_t stripe, uint32_t block, const uint8_t* data) {
+			_device.Write(GetOffset(stripe, block), data, (size_t)_blockSize);
+		}
+
+	private:
+
+		uint64_t _blockSize;
+		uint32_t _nData;
+		uint32_t _nParity;
+		uint32_t _stripeCount;
+		std::vector<uint32_t> _checksums;
+		ReedSolomon::SimulatedDevice _device;
+	};
+
+	struct BenchState {
+		BenchState(BenchStripes& stripes) :
+			parity(stripes.GetNData(), stripes.GetNParity(), (size_t)stripes.GetBlockSize() / 2),
+			syndrome(stripes.GetNData(), stripes.GetNParity(), (size_t)stripes.GetBlockSize() / 2),
+			blocks((size_t)(stripes.GetNBlocks() * stripes.GetBlockSize())) {
+		}
+
+		ReedSolomon::Parity parity;
+		ReedSolomon::Syndrome syndrome;
+		std::vector<uint8_t> blocks;
+		std::vector<uint32_t> damaged;
+	};
+
+	struct PhaseResult {
+		std::atomic<uint64_t> damagedBlocks;
+		std::atomic<uint32_t> damagedStripes;
+		std::atomic<uint32_t> unrepairable;
+		std::atomic<uint32_t> inconsistent;
+		std::atomic<uint64_t> repairedBlocks;
+
+		PhaseResult() : damagedBlocks(0), damagedStripes(0), unrepairable(0), inconsistent(0), repairedBlocks(0) {}
+	};
+
+	static inline uint8_t* GetBlock(BenchState& state, const BenchStripes& stripes, uint32_t block) {
+		return state.blocks.data() + block * stripes.GetBlockSize();
+	}
+
+	// Rebuilds the damaged blocks of a stripe in state.blocks.  The blocks below readFrom are already there, with the damaged ones
+	// listed in state.damaged.  The others are read only if the repair strategy for the damage needs them, and any that fail are
+	// added to the damage.  Returns false if there are more damaged blocks than parity blocks.
+	static bool Rebuild(BenchState& state, BenchStripes& stripes, uint32_t stripe, uint32_t readFrom, Progress& progress) {
+		std::vector<bool> read(stripes.GetNBlocks(), false);
+		for (uint32_t block = 0; block < readFrom; block++) read[block] = true;
+		for (auto block : state.damaged) read[block] = true;
+
+		while (true) {
+			if (state.damaged.size() > stripes.GetNParity()) return false;
+
+			std::sort(state.damaged.begin(), state.damaged.end());
+			std::vector<int> errorLocations;
+			for (auto block : state.damaged) errorLocations.push_back((int)stripes.GetExponent(block));
+			ReedSolomon::AdaptiveRepair repair(stripes.GetNData(), stripes.GetNParity(), (size_t)stripes.GetBlockSize() / 2,
+				errorLocations.data(), (int)errorLocations.size());
+
+			// A survivor that turns out to be damaged changes the strategy, so the repair starts again with it as an erasure
+			bool complete = true;
+			for (uint32_t block = 0; block < stripes.GetNBlocks() && complete; block++) {
+				if (!repair.IsNeeded(stripes.GetExponent(block))) continue;
+
+				uint8_t* data = GetBlock(state, stripes, block);
+				if (!read[block]) {
+					read[block] = true;
+					progress.Add(stripes.GetBlockSize());
+					if (!stripes.ReadBlock(stripe, block, data)) {
+						state.damaged.push_back(block);
+						complete = false;
+						continue;
+					}
+				}
+				repair.AddCodewordSlice((uint16_t*)data, stripes.GetExponent(block));
+			}
+			if (!complete) continue;
+
+			for (size_t i = 0; i < state.damaged.size(); i++) {
+				uint32_t block = state.damaged[i];
+				uint8_t* data = GetBlock(state, stripes, block);
+				repair.GetCorrection((int)i, (uint16_t*)data);
+				if (ReedSolomon::Crc32c(data, (size_t)stripes.GetBlockSize()) != stripes.GetChecksum(stripe, block)) {
+					throw std::runtime_error("A rebuilt block does not match its checksum");
+				}
+			}
+			return true;
+		}
+	}
+
+	static void Print(bool quiet, const char* format, ...) {
+		if (quiet) return;
+		va_list arguments;
+		va_start(arguments, format);
+		vprintf(format, arguments);
+		va_end(arguments);
+	}
+
+	static void ReportDevice(const char* phase, ReedSolomon::SimulatedDevice& device, bool quiet) {
+		ReedSolomon::SimulatedDeviceStats stats = device.GetStats();
+		uint64_t bytes = stats.bytesRead + stats.bytesWritten;
+		double rate = stats.simulatedSeconds > 0 ? bytes / (1024.0 * 1024.0) / stats.simulatedSeconds : 0;
+		Print(quiet, "%-8s device time %.2f s (%.1f MB/s); new faults: %llu rotten bits, %llu lost blocks, %llu slow blocks, %llu torn writes\n",
+			phase, stats.simulatedSeconds, rate, (unsigned long long)stats.bitRots, (unsigned long long)stats.losses,
+			(unsigned long long)stats.slowBlocks, (unsigned long long)stats.tornWrites);
+		device.ResetStats();
+	}
+
+	static void ReportDamage(const char* phase, const PhaseResult& result, bool quiet) {
+		Print(quiet, "%-8s %llu damaged blocks in %u stripes, %u unrepairable, %u inconsistent, %llu rebuilt\n", phase,
+			(unsigned long long)result.damagedBlocks.load(), result.damagedStripes.load(), result.unrepairable.load(),
+			result.inconsistent.load(), (unsigned long long)result.repairedBlocks.load());
+	}
+
+	// Reads every block of every stripe, records the damaged blocks of each and checks the syndromes of the undamaged ones
+	static void Scrub(const char* phase, BenchStripes& stripes, const std::vector<uint32_t>& all, unsigned threads, bool quiet,
+		std::vector<std::vector<uint32_t>>& damage, PhaseResult& result) {
+
+		Progress progress(phase, all.size() * stripes.GetNBlocks() * stripes.GetBlockSize(), quiet);
+		size_t slice = (size_t)stripes.GetBlockSize() / 2;
+
+		ForEachStripe(all, threads,
+			[&] { return std::unique_ptr<BenchState>(new BenchState(stripes)); },
+			[&](BenchState& state, uint32_t stripe) {
+				std::vector<uint32_t>& damaged = damage[stripe];
+				damaged.clear();
+				state.syndrome.Reset();
+
+				for (uint32_t block = 0; block < stripes.GetNBlocks(); block++) {
+					uint8_t* data = GetBlock(state, stripes, block);
+					if (stripes.ReadBlock(stripe, block, data)) {
+						state.syndrome.AddCodewordSlice((uint16_t*)data, stripes.GetExponent(block));
+					} else {
+						damaged.push_back(block);
+					}
+					progress.Add(stripes.GetBlockSize());
+				}
+
+				if (!damaged.empty()) {
+					result.damagedBlocks += damaged.size();
+					result.damagedStripes++;
+					if (damaged.size() > stripes.GetNParity()) result.unrepairable++;
+					return;
+				}
+
+				uint16_t* values = (uint16_t*)state.blocks.data();
+				for (uint32_t j = 0; j < stripes.GetNParity(); j++) {
+					state.syndrome.GetSyndromeSlice(values, j);
+					if (std::any_of(values, values + slice, [](uint16_t v) { return v != 0; })) {
+						result.inconsistent++;
+						break;
+					}
+				}
+			});
+
+		progress.Finish();
+		ReportDamage(phase, result, quiet);
+		ReportDevice(phase, stripes.GetDevice(), quiet);
+	}
+
+	ProtectResult Bench(const ProtectOptions& options) {
+		DeviceModel model = ParseDeviceModel(options.deviceModel);
+
+		uint64_t blockSize = options.blockSize != 0 ? options.blockSize : DEFAULT_BENCH_BLOCK_SIZE;
+		if (blockSize % 64 != 0) throw std::invalid_argument("The block size must be a multiple of 64 bytes");
+
+		uint32_t nData = options.benchDataBlocks;
+		uint32_t nParity = options.parityCount;
+		if (nParity == 0) nParity = (uint32_t)std::max(1.0, std::ceil(nData * options.redundancy / 100));
+		if (nData == 0 || nData + nParity > 65535) throw std::invalid_argument("A stripe holds 1 to 65535 blocks");
+
+		uint64_t stripeBytes = nData * blockSize;
+		uint32_t stripeCount = (uint32_t)std::max((uint64_t)1, (options.benchBytes + stripeBytes - 1) / stripeBytes);
+
+		BenchStripes stripes(blockSize, nData, nParity, stripeCount);
+		stripes.GetDevice().SetTiming(model.timing);
+		stripes.GetDevice().SetFaults(model.faults);
+
+		unsigned threads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+		std::vector<uint32_t> all(stripeCount);
+		for (uint32_t s = 0; s < stripeCount; s++) all[s] = s;
+
+		Print(options.quiet, "Simulating %u stripes of %u data and %u parity blocks of %llu bytes\n", stripeCount, nData, nParity,
+			(unsigned long long)blockSize);
+
+		{
+			Progress progress("write", stripeCount * stripeBytes, options.quiet);
+			ForEachStripe(all, threads,
+				[&] { return std::unique_ptr<BenchState>(new BenchState(stripes)); },
+				[&](BenchState& state, uint32_t stripe) {
+					std::mt19937_64 random(model.faults.seed ^ ((uint64_t)stripe << 32));
+					state.parity.Reset();
+
+					for (uint32_t block = 0; block < stripes.GetNBlocks(); block++) {
+						uint8_t* data = GetBlock(state, stripes, block);
+						if (block < nData) {
+							uint64_t* words = (uint64_t*)data;
+							for (size_t i = 0; i < blockSize / 8; i++) words[i] = random();
+							state.parity.Calculate((uint16_t*)data, stripes.GetExponent(block));
+							progress.Add(blockSize);
+						} else {
+							state.parity.GetParity((uint16_t*)data, stripes.GetExponent(block));
+						}
+						stripes.GetChecksum(stripe, block) = ReedSolomon::Crc32c(data, (size_t)blockSize);
+						stripes.WriteBlock(stripe, block, data);
+					}
+				});
+			progress.Finish();
+			ReportDevice("write", stripes.GetDevice(), options.quiet);
+		}
+
+		std::vector<std::vector<uint32_t>> damage(stripeCount);
+		PhaseResult scrub;
+		Scrub("scrub", stripes, all, threads, options.quiet, damage, scrub);
+
+		{
+			PhaseResult result;
+			Progress progress("degraded", stripeCount * stripeBytes, options.quiet);
+			ForEachStripe(all, threads,
+				[&] { return std::unique_ptr<BenchState>(new BenchState(stripes)); },
+				[&](BenchState& state, uint32_t stripe) {
+					state.damaged.clear();
+					for (uint32_t block = 0; block < nData; block++) {
+						if (!stripes.ReadBlock(stripe, block, GetBlock(state, stripes, block))) state.damaged.push_back(block);
+					}
+					progress.Add(stripeBytes);
+					if (state.damaged.empty()) return;
+
+					result.damagedStripes++;
+					result.damagedBlocks += state.damaged.size();
+					if (Rebuild(state, stripes, stripe, nData, progress)) {
+						result.repairedBlocks += state.damaged.size();
+					} else {
+						result.unrepairable++;
+					}
+				});
+			progress.Finish();
+			ReportDamage("degraded", result, options.quiet);
+			ReportDevice("degraded", stripes.GetDevice(), options.quiet);
+		}
+
+		{
+			std::vector<uint32_t> damagedStripes;
+			for (uint32_t s = 0; s < stripeCount; s++) if (!damage[s].empty()) damagedStripes.push_back(s);
+
+			PhaseResult result;
+			Progress progress("repair", damagedStripes.size() * stripes.GetNBlocks() * blockSize, options.quiet);
+			ForEachStripe(damagedStripes, threads,
+				[&] { return std::unique_ptr<BenchState>(new BenchState(stripes)); },
+				[&](BenchState& state, uint32_t stripe) {
+					// Blocks the scrub found damaged are not read again, and the survivors only as the repair needs them
+					state.damaged = damage[stripe];
+					bool repaired = Rebuild(state, stripes, stripe, 0, progress);
+
+					result.damagedStripes++;
+					result.damagedBlocks += state.damaged.size();
+					if (!repaired) {
+						result.unrepairable++;
+						return;
+					}
+					for (auto block : state.damaged) stripes.WriteBlock(stripe, block, GetBlock(state, stripes, block));
+					result.repairedBlocks += state.damaged.size();
+				});
+			progress.Finish();
+			ReportDamage("repair", result, options.quiet);
+			ReportDevice("repair", stripes.GetDevice(), options.quiet);
+		}
+
+		// The final scrub checks the repair, so it injects no new faults
+		ReedSolomon::SimulatedFaults noFaults = { model.faults.seed, 0, 0, 0, 0 };
+		stripes.GetDevice().SetFaults(noFaults);
+
+		PhaseResult verify;
+		Scrub("verify", stripes, all, threads, options.quiet, damage, verify);
+
+		if (verify.unrepairable > 0 || verify.inconsistent > 0) return PROTECT_UNREPAIRABLE;
+		return verify.damagedBlocks > 0 ? PROTECT_DAMAGED : PROTECT_OK;
+	}
+}
@@ -0,0 +1,94 @@
+#include "stdafx.h"
+#include "MappedFile.h"
+#include <stdexcept>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ReedSolomonProtect {
+
+	static std::runtime_error FileError(const std::string& operation, const std::string& path) {
+		return std::runtime_error(operation + " " + path + ": " + strerror(errno));
+	}
+
+	MappedFile::MappedFile(const std::string& path, bool writable) : _path(path), _fd(-1), _exists(false), _size(0), _data(nullptr) {
+		_fd = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+		if (_fd < 0) {
+			if (errno == ENOENT) return;
+			throw FileError("Cannot open", path);
+		}
+
+		_exists = true;
+		Map();
+	}
+
+	MappedFile::~MappedFile() {
+		Unmap();
+		if (_fd >= 0) close(_fd);
+	}
+
+	void MappedFile::Map() {
+		struct stat status;
+		if (fstat(_fd, &status) != 0) throw FileError("Cannot stat", _path);
+		_size = (uint64_t)status.st_size;
+		if (_size == 0) return;
+
+		void* p = mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+		if (p == MAP_FAILED) throw FileError("Cannot map", _path);
+		_data = (uint8_t*)p;
+	}
+
+	void MappedFile::Unmap() {
+		if (_data != nullptr) munmap(_data, _size);
+		_data = nullptr;
+		_size = 0;
+	}
+
+	const uint8_t* MappedFile::GetSegment(uint64_t offset, size_t length, uint64_t validBytes, uint8_t* buffer) const {
+		uint64_t end = offset + length;
+		if (offset >= validBytes) {
+			memset(buffer, 0, length);
+			return buffer;
+		}
+
+		uint64_t validEnd = end < validBytes ? end : validBytes;
+		if (validEnd > _size) return nullptr;
+		if (end <= validBytes) return _data + offset;
+
+		size_t copied = offset < validEnd ? (size_t)(validEnd - offset) : 0;
+		if (copied > 0) memcpy(buffer, _data + offset, copied);
+		memset(buffer + copied, 0, length - copied);
+		return buffer;
+	}
+
+	void MappedFile::Write(uint64_t offset, const uint8_t* data, size_t length) {
+		while (length > 0) {
+			ssize_t written = pwrite(_fd, data, length, (off_t)offset);
+			if (written < 0) {
+				if (errno == EINTR) continue;
+				throw FileError("Cannot write", _path);
+			}
+			data += written;
+			offset += written;
+			length -= written;
+		}
+	}
+
+	void MappedFile::Resize(uint64_t size) {
+		if (_fd < 0) {
+			_fd = open(_path.c_str(), O_RDWR | O_CREAT, 0644);
+			if (_fd < 0) throw FileError("Cannot create", _path);
+			_exists = true;
+		}
+
+		Unmap();
+		if (ftruncate(_fd, (off_t)size) != 0) throw FileError("Cannot resize", _path);
+		Map();
+	}
+
+	void MappedFile::Flush() {
+		if (_fd >= 0 && fsync(_fd) != 0) throw FileError("Cannot flush", _path);
+	}
+}
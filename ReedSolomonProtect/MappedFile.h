@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace ReedSolomonProtect {
+
+	// A read-only memory mapping of a whole file, with positioned writes through a separate descriptor for repairs.  A file that does
+	// not exist maps as empty.
+	class MappedFile {
+
+	public:
+
+		explicit MappedFile(const std::string& path, bool writable = false);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		inline const std::string& GetPath() const { return _path; }
+		inline bool Exists() const { return _exists; }
+		inline uint64_t GetSize() const { return _size; }
+
+		// Returns length bytes at offset, which must be within the file
+		inline const uint8_t* GetData(uint64_t offset) const { return _data + offset; }
+
+		// Returns a segment of the file as if it were validBytes long and padded with zeros to length.  The mapping is returned
+		// directly when possible; otherwise the segment is assembled in buffer.  Returns nullptr if the file is shorter than validBytes.
+		const uint8_t* GetSegment(uint64_t offset, size_t length, uint64_t validBytes, uint8_t* buffer) const;
+
+		void Write(uint64_t offset, const uint8_t* data, size_t length);
+
+		// Creates the file if it is missing, sets its size and maps it again
+		void Resize(uint64_t size);
+
+		void Flush();
+
+	private:
+
+		void Map();
+		void Unmap();
+
+		std::string _path;
+		int _fd;
+		bool _exists;
+		uint64_t _size;
+		uint8_t* _data;
+	};
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ReedSolomonProtect {
+
+	// Runs work for every stripe on up to threads threads.  Each thread makes its own state with makeState.  The first exception
+	// stops the remaining stripes and is rethrown.
+	template <typename MakeState, typename Work>
+	void ForEachStripe(const std::vector<uint32_t>& stripes, unsigned threads, MakeState makeState, Work work) {
+		std::atomic<size_t> next(0);
+		std::exception_ptr error;
+		std::mutex errorLock;
+
+		auto run = [&] {
+			try {
+				auto state = makeState();
+				for (size_t i = next++; i < stripes.size(); i = next++) work(*state, stripes[i]);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(errorLock);
+				if (!error) error = std::current_exception();
+				next = stripes.size();
+			}
+		};
+
+		size_t threadCount = std::min((size_t)threads, stripes.size());
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < threadCount; i++) workers.emplace_back(run);
+		run();
+		for (auto& worker : workers) worker.join();
+
+		if (error) std::rethrow_exception(error);
+	}
+}
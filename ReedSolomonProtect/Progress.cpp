@@ -0,0 +1,49 @@
+#include "stdafx.h"
+#include "Progress.h"
+#include <cstdio>
+#include <unistd.h>
+
+namespace ReedSolomonProtect {
+
+	static const double MEGABYTE = 1024.0 * 1024.0;
+
+	Progress::Progress(const std::string& operation, uint64_t totalBytes, bool quiet) :
+		_operation(operation), _totalBytes(totalBytes), _quiet(quiet), _completed(0), _start(std::chrono::steady_clock::now()), _done(false) {
+
+		if (_quiet || !isatty(STDERR_FILENO)) return;
+		_reporter = std::thread([this] {
+			std::unique_lock<std::mutex> lock(_lock);
+			while (!_finished.wait_for(lock, std::chrono::milliseconds(500), [this] { return _done; })) Report(false);
+		});
+	}
+
+	Progress::~Progress() {
+		if (_reporter.joinable()) Finish();
+	}
+
+	void Progress::Finish() {
+		if (_reporter.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				_done = true;
+			}
+			_finished.notify_all();
+			_reporter.join();
+		}
+		if (!_quiet) Report(true);
+	}
+
+	void Progress::Report(bool final) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+		uint64_t completed = _completed.load(std::memory_order_relaxed);
+		double rate = seconds > 0 ? completed / MEGABYTE / seconds : 0;
+
+		if (final) {
+			fprintf(stderr, "\r%-8s %.1f MB in %.2f s (%.1f MB/s)          \n", _operation.c_str(), completed / MEGABYTE, seconds, rate);
+		} else {
+			double percent = _totalBytes > 0 ? 100.0 * completed / _totalBytes : 100.0;
+			fprintf(stderr, "\r%-8s %5.1f%%  %.1f MB/s", _operation.c_str(), percent, rate);
+		}
+		fflush(stderr);
+	}
+}
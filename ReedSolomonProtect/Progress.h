@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ReedSolomonProtect {
+
+	// Prints the completion and throughput of an operation to stderr twice a second while it runs, if stderr is a terminal, and a
+	// summary when it finishes
+	class Progress {
+
+	public:
+
+		Progress(const std::string& operation, uint64_t totalBytes, bool quiet);
+		~Progress();
+
+		inline void Add(uint64_t bytes) { _completed.fetch_add(bytes, std::memory_order_relaxed); }
+
+		void Finish();
+
+	private:
+
+		void Report(bool final);
+
+		std::string _operation;
+		uint64_t _totalBytes;
+		bool _quiet;
+		std::atomic<uint64_t> _completed;
+		std::chrono::steady_clock::time_point _start;
+
+		std::mutex _lock;
+		std::condition_variable _finished;
+		bool _done;
+		std::thread _reporter;
+	};
+}
@@ -0,0 +1,473 @@
+#include "stdafx.h"
+#include "Protect.h"
+#include "ProtectIndex.h"
+#include "MappedFile.h"
+#include "Progress.h"
+#include "Parallel.h"
+#include "Crc32c.h"
+#include "Parity.h"
+#include "ParityTuner.h"
+#include "Syndrome.h"
+#include "AdaptiveRepair.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <sys/stat.h>
+
+namespace ReedSolomonProtect {
+
+	// Segments are the unit of work for the threads.  Below 8 KB the multiplication tables, which are rebuilt for every segment,
+	// cost as much as the segment itself.
+	static const uint64_t MIN_SEGMENT_BYTES = 8 * 1024;
+	static const uint64_t MAX_SEGMENT_BYTES = 64 * 1024;
+	static const uint64_t SEGMENTS_PER_BLOCK = 16;
+
+	// Each parity block costs a pass over all the data, so the default block size keeps the block count moderate
+	static const uint64_t MIN_BLOCK_SIZE = 4 * 1024;
+	static const uint64_t TARGET_BLOCK_COUNT = 2048;
+
+	// Data slices handed to Parity::CalculateRun at once
+	static const size_t ENCODE_BATCH = 16;
+
+	typedef std::vector<std::unique_ptr<MappedFile>> MappedFiles;
+
+	// The data and parity blocks of a stripe that failed their checksums, and whether the syndromes of an undamaged stripe are not zero
+	struct StripeDamage {
+		std::vector<uint32_t> blocks;
+		bool inconsistent = false;
+	};
+
+	static unsigned GetThreadCount(const ProtectOptions& options) {
+		if (options.threads != 0) return options.threads;
+		unsigned threads = std::thread::hardware_concurrency();
+		return threads != 0 ? threads : 1;
+	}
+
+	// The encoder tuning profile is kept in the user's cache directory, or nowhere if there is no home directory
+	static std::string GetProfileDirectory() {
+		const char* cache = getenv("XDG_CACHE_HOME");
+		if (cache != nullptr && cache[0] != '\0') return std::string(cache) + "/rsprotect";
+		const char* home = getenv("HOME");
+		if (home != nullptr && home[0] != '\0') return std::string(home) + "/.cache/rsprotect";
+		return std::string();
+	}
+
+	// Looks up the encoder tuning for the geometry of index, timing the encoder and saving the result the first time a geometry
+	// is seen on this CPU
+	static ReedSolomon::ParityTuning TuneEncoder(const ProtectIndex& index, bool quiet) {
+		std::string directory = GetProfileDirectory();
+		std::string path = directory + "/profile";
+		if (!directory.empty()) ReedSolomon::ParityTuner::LoadProfile(path.c_str());
+
+		ReedSolomon::ParityTuning tuning;
+		if (ReedSolomon::ParityTuner::Tune(index.GetNData(), index.GetNParity(), (size_t)index.GetSegmentBytes() / 2, tuning)) {
+			if (!quiet && tuning.runLength == 0) {
+				fprintf(stderr, "Tuned the encoder for this geometry: table kernel, %d threads\n", tuning.threads);
+			} else if (!quiet) {
+				fprintf(stderr, "Tuned the encoder for this geometry: register kernel, runs of %d, %d threads\n", tuning.runLength, tuning.threads);
+			}
+			if (!directory.empty()) {
+				for (size_t slash = directory.find('/', 1); slash != std::string::npos; slash = directory.find('/', slash + 1)) {
+					mkdir(directory.substr(0, slash).c_str(), 0755);
+				}
+				mkdir(directory.c_str(), 0755);
+				ReedSolomon::ParityTuner::SaveProfile(path.c_str());
+			}
+		}
+		return tuning;
+	}
+
+	static std::vector<uint32_t> AllStripes(const ProtectIndex& index) {
+		std::vector<uint32_t> stripes(index.GetSegmentsPerBlock());
+		for (uint32_t i = 0; i < stripes.size(); i++) stripes[i] = i;
+		return stripes;
+	}
+
+	static uint64_t CountBlocks(const std::vector<uint64_t>& sizes, uint64_t blockSize) {
+		uint64_t blocks = 0;
+		for (auto size : sizes) blocks += (size + blockSize - 1) / blockSize;
+		return blocks;
+	}
+
+	static uint64_t ChooseBlockSize(const std::vector<uint64_t>& sizes) {
+		uint64_t blockSize = MIN_BLOCK_SIZE;
+		while (CountBlocks(sizes, blockSize) > TARGET_BLOCK_COUNT) blockSize *= 2;
+		return blockSize;
+	}
+
+	// Splits a block into up to SEGMENTS_PER_BLOCK equal segments of whole 64-byte units and at least MIN_SEGMENT_BYTES, and into
+	// more if they would still be larger than MAX_SEGMENT_BYTES
+	static uint64_t ChooseSegmentBytes(uint64_t blockSize) {
+		uint64_t units = blockSize / 64;
+		uint64_t count = 1;
+		for (uint64_t k = 2; k <= units && blockSize / k >= MIN_SEGMENT_BYTES; k++) {
+			if (units % k != 0) continue;
+			if (k > SEGMENTS_PER_BLOCK && blockSize / count <= MAX_SEGMENT_BYTES) break;
+			count = k;
+		}
+		return blockSize / count;
+	}
+
+	static inline size_t GetExponent(const ProtectIndex& index, uint32_t block) {
+		return block < index.GetNData() ? index.GetDataExponent(block) : block - index.GetNData();
+	}
+
+	static uint64_t GetParityFileSize(const ProtectIndex& index) {
+		return index.GetDataOffset() + index.GetNParity() * index.GetBlockSize();
+	}
+
+	static MappedFiles OpenFiles(const ProtectIndex& index, bool writable) {
+		MappedFiles files;
+		for (auto& file : index.GetFiles()) files.emplace_back(new MappedFile(file.name, writable));
+		return files;
+	}
+
+	static std::vector<uint32_t> GetBlockFiles(const ProtectIndex& index) {
+		std::vector<uint32_t> blockFiles(index.GetNData());
+		auto& files = index.GetFiles();
+		for (uint32_t f = 0; f < files.size(); f++) {
+			for (uint32_t b = 0; b < files[f].blockCount; b++) blockFiles[files[f].firstBlock + b] = f;
+		}
+		return blockFiles;
+	}
+
+	static inline uint64_t GetFileOffset(const ProtectIndex& index, const ProtectedFile& file, uint32_t block, uint32_t segment) {
+		return (block - file.firstBlock) * index.GetBlockSize() + segment * index.GetSegmentBytes();
+	}
+
+	// Returns a segment of a data or parity block, or nullptr if it is missing
+	static const uint8_t* GetSegment(const ProtectIndex& index, const MappedFiles& files, const std::vector<uint32_t>& blockFiles,
+		const MappedFile& parity, uint32_t block, uint32_t segment, uint8_t* buffer) {
+
+		if (block < index.GetNData()) {
+			uint32_t f = blockFiles[block];
+			const ProtectedFile& file = index.GetFiles()[f];
+			return files[f]->GetSegment(GetFileOffset(index, file, block, segment), (size_t)index.GetSegmentBytes(), file.size, buffer);
+		}
+
+		uint32_t exponent = block - index.GetNData();
+		return parity.GetSegment(index.GetParityOffset(exponent, segment), (size_t)index.GetSegmentBytes(), GetParityFileSize(index), buffer);
+	}
+
+	static void Print(bool quiet, const char* format, ...) {
+		if (quiet) return;
+		va_list arguments;
+		va_start(arguments, format);
+		vprintf(format, arguments);
+		va_end(arguments);
+	}
+
+	static std::string DescribeBlock(const ProtectIndex& index, const std::vector<uint32_t>& blockFiles, uint32_t block) {
+		char description[64];
+		if (block < index.GetNData()) {
+			const ProtectedFile& file = index.GetFiles()[blockFiles[block]];
+			snprintf(description, sizeof(description), "block %u of ", block - file.firstBlock);
+			return description + file.name;
+		}
+		snprintf(description, sizeof(description), "parity block %u", block - index.GetNData());
+		return description;
+	}
+
+	ProtectResult Create(const std::string& parityPath, const std::vector<std::string>& names, const ProtectOptions& options) {
+		MappedFiles files;
+		std::vector<uint64_t> sizes;
+		for (auto& name : names) {
+			files.emplace_back(new MappedFile(name));
+			if (!files.back()->Exists()) throw std::runtime_error(name + " does not exist");
+			sizes.push_back(files.back()->GetSize());
+		}
+
+		uint64_t blockSize = options.blockSize != 0 ? options.blockSize : ChooseBlockSize(sizes);
+		if (blockSize % 64 != 0) throw std::invalid_argument("The block size must be a multiple of 64 bytes");
+		uint64_t segmentBytes = ChooseSegmentBytes(blockSize);
+
+		uint32_t nParity = options.parityCount;
+		if (nParity == 0) {
+			double blocks = (double)CountBlocks(sizes, blockSize);
+			nParity = (uint32_t)std::max(1.0, std::ceil(blocks * options.redundancy / 100));
+		}
+
+		ProtectIndex index(blockSize, segmentBytes, names, sizes, nParity);
+		std::vector<uint32_t> blockFiles = GetBlockFiles(index);
+		ReedSolomon::ParityTuning tuning = TuneEncoder(index, options.quiet);
+
+		MappedFile parity(parityPath, true);
+		parity.Resize(0);
+		parity.Resize(GetParityFileSize(index));
+
+		struct EncodeState {
+			EncodeState(const ProtectIndex& index) :
+				parity(index.GetNData(), index.GetNParity(), (size_t)index.GetSegmentBytes() / 2),
+				buffers(ENCODE_BATCH * index.GetSegmentBytes()), output((size_t)index.GetSegmentBytes()) {
+			}
+
+			ReedSolomon::Parity parity;
+			std::vector<uint8_t> buffers;
+			std::vector<uint8_t> output;
+		};
+
+		size_t segment = (size_t)segmentBytes;
+		Progress progress("create", index.GetNData() * blockSize, options.quiet);
+
+		ForEachStripe(AllStripes(index), options.threads != 0 ? options.threads : (unsigned)tuning.threads,
+			[&] { return std::unique_ptr<EncodeState>(new EncodeState(index)); },
+			[&](EncodeState& state, uint32_t s) {
+				state.parity.Reset();
+
+				uint16_t* slices[ENCODE_BATCH];
+				size_t exponents[ENCODE_BATCH];
+				size_t count = 0;
+
+				for (uint32_t block = 0; block < index.GetNData(); block++) {
+					const uint8_t* data = GetSegment(index, files, blockFiles, parity, block, s, state.buffers.data() + count * segment);
+					if (data == nullptr) throw std::runtime_error(index.GetFiles()[blockFiles[block]].name + " changed while it was being read");
+
+					index.SetChecksum(block, s, ReedSolomon::Crc32c(data, segment));
+					slices[count] = (uint16_t*)data;
+					exponents[count] = index.GetDataExponent(block);
+					if (++count == ENCODE_BATCH) {
+						state.parity.CalculateRun(slices, exponents, count);
+						progress.Add(count * segment);
+						count = 0;
+					}
+				}
+				state.parity.CalculateRun(slices, exponents, count);
+				progress.Add(count * segment);
+
+				for (uint32_t e = 0; e < index.GetNParity(); e++) {
+					state.parity.GetParity((uint16_t*)state.output.data(), e);
+					index.SetChecksum(index.GetNData() + e, s, ReedSolomon::Crc32c(state.output.data(), segment));
+					parity.Write(index.GetParityOffset(e, s), state.output.data(), segment);
+				}
+			});
+
+		progress.Finish();
+
+		index.Save(parity);
+		parity.Flush();
+
+		if (!options.quiet) {
+			printf("Protected %zu files: %u data blocks of %llu bytes and %u parity blocks\n", names.size(), index.GetNData(),
+				(unsigned long long)blockSize, index.GetNParity());
+		}
+		return PROTECT_OK;
+	}
+
+	// Checks every segment against its checksum and, for stripes without damage, checks that the syndromes are zero
+	static std::vector<StripeDamage> Scan(const ProtectIndex& index, const MappedFiles& files, const MappedFile& parity,
+		const ProtectOptions& options, const char* operation) {
+
+		std::vector<uint32_t> blockFiles = GetBlockFiles(index);
+		std::vector<StripeDamage> damage(index.GetSegmentsPerBlock());
+		uint32_t nBlocks = index.GetNData() + index.GetNParity();
+		size_t segment = (size_t)index.GetSegmentBytes();
+
+		struct ScanState {
+			ScanState(const ProtectIndex& index) :
+				syndrome(index.GetNData(), index.GetNParity(), (size_t)index.GetSegmentBytes() / 2), buffer((size_t)index.GetSegmentBytes()) {
+			}
+
+			ReedSolomon::Syndrome syndrome;
+			std::vector<uint8_t> buffer;
+		};
+
+		Progress progress(operation, nBlocks * index.GetBlockSize(), options.quiet);
+
+		ForEachStripe(AllStripes(index), GetThreadCount(options),
+			[&] { return std::unique_ptr<ScanState>(new ScanState(index)); },
+			[&](ScanState& state, uint32_t s) {
+				state.syndrome.Reset();
+
+				for (uint32_t block = 0; block < nBlocks; block++) {
+					const uint8_t* data = GetSegment(index, files, blockFiles, parity, block, s, state.buffer.data());
+					if (data == nullptr || ReedSolomon::Crc32c(data, segment) != index.GetChecksum(block, s)) {
+						damage[s].blocks.push_back(block);
+					} else {
+						state.syndrome.AddCodewordSlice((uint16_t*)data, GetExponent(index, block));
+					}
+					progress.Add(segment);
+				}
+
+				if (!damage[s].blocks.empty()) return;
+
+				uint16_t* values = (uint16_t*)state.buffer.data();
+				for (uint32_t j = 0; j < index.GetNParity() && !damage[s].inconsistent; j++) {
+					state.syndrome.GetSyndromeSlice(values, j);
+					for (size_t i = 0; i < segment / 2; i++) {
+						if (values[i] != 0) {
+							damage[s].inconsistent = true;
+							break;
+						}
+					}
+				}
+			});
+
+		progress.Finish();
+		return damage;
+	}
+
+	// Prints what is damaged, unless quiet, and returns whether everything is intact, repairable or not
+	static ProtectResult Report(const ProtectIndex& index, const MappedFiles& files, const std::vector<StripeDamage>& damage, bool quiet) {
+		std::vector<uint32_t> blockFiles = GetBlockFiles(index);
+		std::set<uint32_t> damagedBlocks;
+		uint32_t unrepairable = 0;
+		uint32_t inconsistent = 0;
+
+		for (auto& stripe : damage) {
+			damagedBlocks.insert(stripe.blocks.begin(), stripe.blocks.end());
+			if (stripe.blocks.size() > index.GetNParity()) unrepairable++;
+			if (stripe.inconsistent) inconsistent++;
+		}
+
+		bool sizeMismatch = false;
+		auto& protectedFiles = index.GetFiles();
+		for (uint32_t f = 0; f < protectedFiles.size(); f++) {
+			uint32_t damagedCount = 0;
+			for (uint32_t b = 0; b < protectedFiles[f].blockCount; b++) damagedCount += (uint32_t)damagedBlocks.count(protectedFiles[f].firstBlock + b);
+
+			if (!files[f]->Exists()) {
+				Print(quiet, "%s: missing\n", protectedFiles[f].name.c_str());
+				sizeMismatch = true;
+			} else if (files[f]->GetSize() != protectedFiles[f].size) {
+				Print(quiet, "%s: size is %llu, expected %llu; %u of %u blocks damaged\n", protectedFiles[f].name.c_str(),
+					(unsigned long long)files[f]->GetSize(), (unsigned long long)protectedFiles[f].size, damagedCount, protectedFiles[f].blockCount);
+				sizeMismatch = true;
+			} else if (damagedCount > 0) {
+				Print(quiet, "%s: %u of %u blocks damaged\n", protectedFiles[f].name.c_str(), damagedCount, protectedFiles[f].blockCount);
+			}
+		}
+
+		uint32_t damagedParity = (uint32_t)std::count_if(damagedBlocks.begin(), damagedBlocks.end(), [&](uint32_t b) { return b >= index.GetNData(); });
+		if (damagedParity > 0) Print(quiet, "%u of %u parity blocks damaged\n", damagedParity, index.GetNParity());
+
+		if (inconsistent > 0) {
+			Print(quiet, "%u stripes pass their checksums but do not match the parity; the parity file is out of date\n", inconsistent);
+			return PROTECT_UNREPAIRABLE;
+		}
+		if (unrepairable > 0) {
+			Print(quiet, "%u stripes have more damaged blocks than the %u parity blocks can repair\n", unrepairable, index.GetNParity());
+			return PROTECT_UNREPAIRABLE;
+		}
+		if (damagedBlocks.empty() && !sizeMismatch) {
+			Print(quiet, "All %zu files are intact\n", protectedFiles.size());
+			return PROTECT_OK;
+		}
+
+		Print(quiet, "%zu damaged blocks can be repaired\n", damagedBlocks.size());
+		return PROTECT_DAMAGED;
+	}
+
+	ProtectResult Verify(const std::string& parityPath, const ProtectOptions& options) {
+		ProtectIndex index = ProtectIndex::Load(parityPath);
+		MappedFiles files = OpenFiles(index, false);
+		MappedFile parity(parityPath);
+
+		std::vector<StripeDamage> damage = Scan(index, files, parity, options, "verify");
+		return Report(index, files, damage, options.quiet);
+	}
+
+	ProtectResult Repair(const std::string& parityPath, const ProtectOptions& options) {
+		ProtectIndex index = ProtectIndex::Load(parityPath);
+		MappedFiles files = OpenFiles(index, true);
+		MappedFile parity(parityPath, true);
+
+		std::vector<StripeDamage> damage = Scan(index, files, parity, options, "scan");
+		ProtectResult result = Report(index, files, damage, options.quiet);
+		if (result != PROTECT_DAMAGED) return result;
+
+		// Nothing is written until the scan has shown that every stripe can be repaired.  Missing and truncated files are then
+		// given their protected size, and the new bytes are rebuilt with the rest of the damage.
+		auto& protectedFiles = index.GetFiles();
+		for (uint32_t f = 0; f < protectedFiles.size(); f++) {
+			if (!files[f]->Exists() || files[f]->GetSize() != protectedFiles[f].size) files[f]->Resize(protectedFiles[f].size);
+		}
+		if (parity.GetSize() < GetParityFileSize(index)) parity.Resize(GetParityFileSize(index));
+
+		std::vector<uint32_t> blockFiles = GetBlockFiles(index);
+		uint32_t nBlocks = index.GetNData() + index.GetNParity();
+		size_t segment = (size_t)index.GetSegmentBytes();
+
+		auto getErrorLocations = [&](uint32_t s) {
+			std::vector<int> errorLocations;
+			for (auto block : damage[s].blocks) errorLocations.push_back((int)GetExponent(index, block));
+			return errorLocations;
+		};
+
+		// Only the survivors the repair strategy needs are read: all of them for one erasure or a decode, the data alone when
+		// only parity is damaged
+		std::vector<uint32_t> damagedStripes;
+		uint64_t repairBytes = 0;
+		for (uint32_t s = 0; s < damage.size(); s++) {
+			if (damage[s].blocks.empty()) continue;
+			damagedStripes.push_back(s);
+
+			std::vector<int> errorLocations = getErrorLocations(s);
+			auto strategy = ReedSolomon::AdaptiveRepair::ChooseStrategy(index.GetNParity(), errorLocations.data(), (int)errorLocations.size());
+			uint32_t needed = strategy == ReedSolomon::ADAPTIVE_REPAIR_REENCODE ? index.GetNData() : nBlocks - (uint32_t)errorLocations.size();
+			repairBytes += needed * index.GetSegmentBytes();
+		}
+
+		struct RepairState {
+			RepairState(const ProtectIndex& index) : buffer((size_t)index.GetSegmentBytes()) {
+			}
+
+			std::vector<uint8_t> buffer;
+		};
+
+		Progress progress("repair", repairBytes, options.quiet);
+		std::atomic<uint32_t> repairedSegments(0);
+
+		ForEachStripe(damagedStripes, GetThreadCount(options),
+			[&] { return std::unique_ptr<RepairState>(new RepairState(index)); },
+			[&](RepairState& state, uint32_t s) {
+				const std::vector<uint32_t>& damaged = damage[s].blocks;
+				std::vector<int> errorLocations = getErrorLocations(s);
+				ReedSolomon::AdaptiveRepair repair(index.GetNData(), index.GetNParity(), segment / 2, errorLocations.data(), (int)errorLocations.size());
+
+				for (uint32_t block = 0; block < nBlocks; block++) {
+					size_t exponent = GetExponent(index, block);
+					if (!repair.IsNeeded(exponent)) continue;
+
+					const uint8_t* data = GetSegment(index, files, blockFiles, parity, block, s, state.buffer.data());
+					if (data == nullptr) throw std::runtime_error(DescribeBlock(index, blockFiles, block) + " changed during the repair");
+					repair.AddCodewordSlice((uint16_t*)data, exponent);
+					progress.Add(segment);
+				}
+
+				for (size_t i = 0; i < damaged.size(); i++) {
+					uint32_t block = damaged[i];
+					repair.GetCorrection((int)i, (uint16_t*)state.buffer.data());
+					if (ReedSolomon::Crc32c(state.buffer.data(), segment) != index.GetChecksum(block, s)) {
+						throw std::runtime_error(DescribeBlock(index, blockFiles, block) + " does not match its checksum after repair");
+					}
+
+					if (block < index.GetNData()) {
+						uint32_t f = blockFiles[block];
+						const ProtectedFile& file = protectedFiles[f];
+						uint64_t offset = GetFileOffset(index, file, block, s);
+						if (offset < file.size) files[f]->Write(offset, state.buffer.data(), (size_t)std::min((uint64_t)segment, file.size - offset));
+					} else {
+						parity.Write(index.GetParityOffset(block - index.GetNData(), s), state.buffer.data(), segment);
+					}
+					repairedSegments++;
+				}
+			});
+
+		progress.Finish();
+
+		for (auto& file : files) file->Flush();
+		parity.Flush();
+
+		Print(options.quiet, "Repaired %u damaged segments\n", repairedSegments.load());
+		return PROTECT_OK;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ReedSolomonProtect {
+
+	struct ProtectOptions {
+		// Zero picks a block size that keeps the block count manageable
+		uint64_t blockSize = 0;
+		// Parity blocks as a percentage of data blocks, unless parityCount is set
+		double redundancy = 10;
+		uint32_t parityCount = 0;
+		// Zero uses every hardware thread
+		unsigned threads = 0;
+		bool quiet = false;
+
+		// bench: the data to simulate, the data blocks per stripe and the device model (see Bench.cpp)
+		uint64_t benchBytes = 256 * 1024 * 1024;
+		uint32_t benchDataBlocks = 32;
+		std::string deviceModel;
+
+		// serve and ringbench: the slots of the codec ring, the payload bytes of each and the clients it takes (see RingBench.cpp).
+		// Zero slots or slot bytes picks a size for the command.
+		uint32_t ringSlots = 0;
+		uint64_t ringSlotBytes = 0;
+		uint32_t ringClients = 4;
+	};
+
+	// Exit codes of the commands
+	enum ProtectResult {
+		PROTECT_OK = 0,
+		PROTECT_DAMAGED = 1,
+		PROTECT_UNREPAIRABLE = 2
+	};
+
+	ProtectResult Create(const std::string& parityPath, const std::vector<std::string>& files, const ProtectOptions& options);
+	ProtectResult Verify(const std::string& parityPath, const ProtectOptions& options);
+	ProtectResult Repair(const std::string& parityPath, const ProtectOptions& options);
+	ProtectResult Bench(const ProtectOptions& options);
+	ProtectResult Serve(const std::string& name, const ProtectOptions& options);
+	ProtectResult RingBench(const ProtectOptions& options);
+}
@@ -0,0 +1,161 @@
+#include "stdafx.h"
+#include "ProtectIndex.h"
+#include "Crc32c.h"
+#include "MappedFile.h"
+#include <stdexcept>
+
+namespace ReedSolomonProtect {
+
+	static const char MAGIC[8] = { 'R', 'S', 'P', 'R', 'O', 'T', 'E', 'C' };
+
+	// Fixed part of the metadata: magic, version, file count, block size, segment size, nData, nParity
+	static const size_t FIXED_HEADER_SIZE = 8 + 4 + 4 + 8 + 8 + 4 + 4;
+
+	class MetadataWriter {
+
+	public:
+
+		template <typename T>
+		void Put(T value) {
+			const uint8_t* p = (const uint8_t*)&value;
+			bytes.insert(bytes.end(), p, p + sizeof(T));
+		}
+
+		void Put(const void* data, size_t length) {
+			const uint8_t* p = (const uint8_t*)data;
+			bytes.insert(bytes.end(), p, p + length);
+		}
+
+		std::vector<uint8_t> bytes;
+	};
+
+	class MetadataReader {
+
+	public:
+
+		MetadataReader(const uint8_t* data, size_t length) : _data(data), _length(length), _offset(0) {}
+
+		template <typename T>
+		T Get() {
+			T value;
+			Get(&value, sizeof(T));
+			return value;
+		}
+
+		void Get(void* data, size_t length) {
+			if (_length - _offset < length) throw std::runtime_error("Parity file metadata is truncated");
+			memcpy(data, _data + _offset, length);
+			_offset += length;
+		}
+
+		inline size_t GetOffset() const { return _offset; }
+
+	private:
+
+		const uint8_t* _data;
+		size_t _length;
+		size_t _offset;
+	};
+
+	ProtectIndex::ProtectIndex(uint64_t blockSize, uint64_t segmentBytes, const std::vector<std::string>& names,
+		const std::vector<uint64_t>& sizes, uint32_t nParity) : _blockSize(blockSize), _segmentBytes(segmentBytes), _nData(0), _nParity(nParity) {
+
+		uint64_t nData = 0;
+		for (size_t i = 0; i < names.size(); i++) {
+			ProtectedFile file;
+			file.name = names[i];
+			file.size = sizes[i];
+			file.firstBlock = (uint32_t)nData;
+			file.blockCount = (uint32_t)((sizes[i] + blockSize - 1) / blockSize);
+			nData += file.blockCount;
+			_files.push_back(file);
+		}
+
+		if (nData == 0) throw std::invalid_argument("There is no data to protect");
+		if (nData + nParity > 0xFFFF) throw std::invalid_argument("Too many blocks; use a larger block size");
+		_nData = (uint32_t)nData;
+		_checksums.assign((size_t)(_nData + _nParity) * GetSegmentsPerBlock(), 0);
+	}
+
+	size_t ProtectIndex::GetMetadataSize() const {
+		size_t size = FIXED_HEADER_SIZE;
+		for (auto& file : _files) size += 8 + 4 + file.name.size();
+		size += _checksums.size() * sizeof(uint32_t);
+		return size + sizeof(uint32_t);
+	}
+
+	uint64_t ProtectIndex::GetDataOffset() const {
+		return (GetMetadataSize() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	}
+
+	void ProtectIndex::Save(MappedFile& file) const {
+		MetadataWriter writer;
+		writer.Put(MAGIC, sizeof(MAGIC));
+		writer.Put(VERSION);
+		writer.Put((uint32_t)_files.size());
+		writer.Put(_blockSize);
+		writer.Put(_segmentBytes);
+		writer.Put(_nData);
+		writer.Put(_nParity);
+		for (auto& file : _files) {
+			writer.Put(file.size);
+			writer.Put((uint32_t)file.name.size());
+			writer.Put(file.name.data(), file.name.size());
+		}
+		writer.Put(_checksums.data(), _checksums.size() * sizeof(uint32_t));
+		writer.Put(ReedSolomon::Crc32c(writer.bytes.data(), writer.bytes.size()));
+
+		file.Write(0, writer.bytes.data(), writer.bytes.size());
+	}
+
+	ProtectIndex ProtectIndex::Load(const std::string& path) {
+		MappedFile file(path);
+		if (!file.Exists()) throw std::runtime_error("Parity file " + path + " does not exist");
+		if (file.GetSize() < FIXED_HEADER_SIZE) throw std::runtime_error(path + " is not a parity file");
+
+		const uint8_t* data = file.GetData(0);
+		size_t available = (size_t)file.GetSize();
+		MetadataReader reader(data, available);
+
+		char magic[sizeof(MAGIC)];
+		reader.Get(magic, sizeof(magic));
+		if (memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) throw std::runtime_error(path + " is not a parity file");
+		if (reader.Get<uint32_t>() != VERSION) throw std::runtime_error(path + " has an unsupported version");
+
+		ProtectIndex index;
+		uint32_t fileCount = reader.Get<uint32_t>();
+		index._blockSize = reader.Get<uint64_t>();
+		index._segmentBytes = reader.Get<uint64_t>();
+		index._nData = reader.Get<uint32_t>();
+		index._nParity = reader.Get<uint32_t>();
+		if (index._segmentBytes == 0 || index._segmentBytes % 2 != 0 || index._blockSize % index._segmentBytes != 0 ||
+			(uint64_t)index._nData + index._nParity > 0xFFFF) {
+			throw std::runtime_error("Parity file metadata is damaged");
+		}
+
+		uint32_t nData = 0;
+		for (uint32_t i = 0; i < fileCount; i++) {
+			ProtectedFile protectedFile;
+			protectedFile.size = reader.Get<uint64_t>();
+			uint32_t nameLength = reader.Get<uint32_t>();
+			if (nameLength > available) throw std::runtime_error("Parity file metadata is damaged");
+			protectedFile.name.resize(nameLength);
+			reader.Get(&protectedFile.name[0], nameLength);
+			protectedFile.firstBlock = nData;
+			protectedFile.blockCount = (uint32_t)((protectedFile.size + index._blockSize - 1) / index._blockSize);
+			nData += protectedFile.blockCount;
+			index._files.push_back(protectedFile);
+		}
+		if (nData != index._nData) throw std::runtime_error("Parity file metadata is damaged");
+
+		uint64_t checksumCount = (uint64_t)(index._nData + index._nParity) * index.GetSegmentsPerBlock();
+		if (checksumCount * sizeof(uint32_t) > available) throw std::runtime_error("Parity file metadata is damaged");
+		index._checksums.resize((size_t)checksumCount);
+		reader.Get(index._checksums.data(), index._checksums.size() * sizeof(uint32_t));
+
+		uint32_t expected = ReedSolomon::Crc32c(data, reader.GetOffset());
+		if (reader.Get<uint32_t>() != expected) throw std::runtime_error("Parity file metadata is damaged");
+
+		return index;
+	}
+}
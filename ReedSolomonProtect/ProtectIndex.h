@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ReedSolomonProtect {
+
+	class MappedFile;
+
+	struct ProtectedFile {
+		std::string name;
+		uint64_t size;
+		uint32_t firstBlock;
+		uint32_t blockCount;
+	};
+
+	// The metadata at the start of a parity file.
+	//
+	// Every protected file is padded to whole blocks, and each block is one data slice of the code: data block i has exponent
+	// nData + nParity - 1 - i and parity block e has exponent e, as in the tracks of the file system.  Blocks are divided into
+	// segments, which are encoded independently and each carry a CRC-32C so that damage can be located and repaired segment by
+	// segment.  The parity blocks follow the metadata, starting at GetDataOffset().
+	class ProtectIndex {
+
+	public:
+
+		static const uint32_t VERSION = 1;
+		static const uint64_t ALIGNMENT = 4096;
+
+		ProtectIndex(uint64_t blockSize, uint64_t segmentBytes, const std::vector<std::string>& names, const std::vector<uint64_t>& sizes,
+			uint32_t nParity);
+
+		// Reads and checks the metadata of an existing parity file
+		static ProtectIndex Load(const std::string& path);
+
+		void Save(MappedFile& file) const;
+
+		inline uint64_t GetBlockSize() const { return _blockSize; }
+		inline uint64_t GetSegmentBytes() const { return _segmentBytes; }
+		inline uint32_t GetSegmentsPerBlock() const { return (uint32_t)(_blockSize / _segmentBytes); }
+		inline uint32_t GetNData() const { return _nData; }
+		inline uint32_t GetNParity() const { return _nParity; }
+		inline const std::vector<ProtectedFile>& GetFiles() const { return _files; }
+
+		inline size_t GetDataExponent(uint32_t block) const { return _nData + _nParity - 1 - block; }
+		inline uint64_t GetParityOffset(uint32_t exponent, uint32_t segment) const {
+			return GetDataOffset() + exponent * _blockSize + segment * _segmentBytes;
+		}
+
+		// Checksums are indexed by block, data blocks first and then parity blocks by exponent
+		inline uint32_t GetChecksum(uint32_t block, uint32_t segment) const { return _checksums[(size_t)block * GetSegmentsPerBlock() + segment]; }
+		inline void SetChecksum(uint32_t block, uint32_t segment, uint32_t crc) { _checksums[(size_t)block * GetSegmentsPerBlock() + segment] = crc; }
+
+		uint64_t GetDataOffset() const;
+
+	private:
+
+		ProtectIndex() {}
+
+		size_t GetMetadataSize() const;
+
+		uint64_t _blockSize;
+		uint64_t _segmentBytes;
+		uint32_t _nData;
+		uint32_t _nParity;
+		std::vector<ProtectedFile> _files;
+		std::vector<uint32_t> _checksums;
+	};
+}
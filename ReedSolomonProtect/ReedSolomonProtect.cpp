@@ -0,0 +1,114 @@
+// rsprotect: protects a set of files with a Reed-Solomon parity file, and verifies and repairs them with it.  bench measures the
+// same operations against a simulated device.  serve runs a codec service shared by the volumes of the host, and ringbench measures
+// one against several client processes.
+//
+
+#include "stdafx.h"
+#include "Protect.h"
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include <getopt.h>
+
+using namespace ReedSolomonProtect;
+
+static void Usage() {
+	fprintf(stderr,
+		"usage: rsprotect create [options] PARITYFILE FILE...\n"
+		"       rsprotect verify [options] PARITYFILE\n"
+		"       rsprotect repair [options] PARITYFILE\n"
+		"       rsprotect bench [options]\n"
+		"       rsprotect serve [options] NAME\n"
+		"       rsprotect ringbench [options]\n"
+		"\n"
+		"Files are recorded by the paths given to create, and are found relative to the working directory.\n"
+		"\n"
+		"options:\n"
+		"  -b BYTES    block size for create (default: chosen from the total size)\n"
+		"  -r PERCENT  parity blocks as a percentage of data blocks for create (default: 10)\n"
+		"  -p COUNT    number of parity blocks for create, instead of -r\n"
+		"  -t THREADS  worker threads (default: the tuned count for create, all hardware threads otherwise)\n"
+		"  -q          no progress or summary output\n"
+		"  -s BYTES    data to simulate for bench (default: 256M)\n"
+		"  -d COUNT    data blocks per stripe for bench (default: 32)\n"
+		"  -f MODEL    device model for bench, as name=value settings separated by commas:\n"
+		"              rot, loss and slow per block read, torn per write, latency, bandwidth, slowtime, seed, sleep\n"
+		"  -n SLOTS    job slots of the codec ring for serve and ringbench (default: 64, or 2 per client for ringbench)\n"
+		"  -m BYTES    payload bytes of each slot (default: 4M, or one stripe for ringbench)\n"
+		"  -c COUNT    clients of the codec ring for serve, and client processes for ringbench (default: 4)\n"
+		"\n"
+		"bench encodes stripes onto a simulated device that injects the faults of the model, then times scrub, degraded read\n"
+		"and repair against it.\n"
+		"\n"
+		"serve runs encode, verify and repair jobs for the clients of the shared memory ring NAME on -t threads until it is\n"
+		"interrupted.  ringbench runs a service against -c client processes, checks their results and reports how evenly\n"
+		"they were served; -s is divided between the clients, and -d, -p and -b set the stripes.\n"
+		"\n"
+		"The first create for a geometry times the encoder variants and keeps the fastest in ~/.cache/rsprotect/profile.\n"
+		"\n"
+		"verify and repair exit with 0 if the files are intact or were repaired, 1 if they are damaged but repairable,\n"
+		"and 2 if they cannot be repaired or there was an error.\n");
+}
+
+static uint64_t ParseSize(const char* text) {
+	char* end;
+	uint64_t value = strtoull(text, &end, 10);
+	switch (*end) {
+	case 'k': case 'K': value <<= 10; end++; break;
+	case 'm': case 'M': value <<= 20; end++; break;
+	case 'g': case 'G': value <<= 30; end++; break;
+	}
+	if (*end != '\0' || value == 0) throw std::invalid_argument(std::string("Invalid size ") + text);
+	return value;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		Usage();
+		return PROTECT_UNREPAIRABLE;
+	}
+
+	std::string command = argv[1];
+	ProtectOptions options;
+
+	try {
+		optind = 2;
+		int option;
+		while ((option = getopt(argc, argv, "b:r:p:t:qs:d:f:n:m:c:")) != -1) {
+			switch (option) {
+			case 'b': options.blockSize = ParseSize(optarg); break;
+			case 'r': options.redundancy = atof(optarg); break;
+			case 'p': options.parityCount = (uint32_t)ParseSize(optarg); break;
+			case 't': options.threads = (unsigned)ParseSize(optarg); break;
+			case 'q': options.quiet = true; break;
+			case 's': options.benchBytes = ParseSize(optarg); break;
+			case 'd': options.benchDataBlocks = (uint32_t)ParseSize(optarg); break;
+			case 'f': options.deviceModel = optarg; break;
+			case 'n': options.ringSlots = (uint32_t)ParseSize(optarg); break;
+			case 'm': options.ringSlotBytes = ParseSize(optarg); break;
+			case 'c': options.ringClients = (uint32_t)ParseSize(optarg); break;
+			default:
+				Usage();
+				return PROTECT_UNREPAIRABLE;
+			}
+		}
+
+		std::vector<std::string> arguments(argv + optind, argv + argc);
+
+		if (command == "create" && arguments.size() >= 2) {
+			return Create(arguments[0], std::vector<std::string>(arguments.begin() + 1, arguments.end()), options);
+		}
+		if (command == "verify" && arguments.size() == 1) return Verify(arguments[0], options);
+		if (command == "repair" && arguments.size() == 1) return Repair(arguments[0], options);
+		if (command == "bench" && arguments.empty()) return Bench(options);
+		if (command == "serve" && arguments.size() == 1) return Serve(arguments[0], options);
+		if (command == "ringbench" && arguments.empty()) return RingBench(options);
+
+		Usage();
+		return PROTECT_UNREPAIRABLE;
+	} catch (std::exception& e) {
+		fprintf(stderr, "rsprotect: %s\n", e.what());
+		return PROTECT_UNREPAIRABLE;
+	}
+}
@@ -0,0 +1,269 @@
+#include "stdafx.h"
+#include "Protect.h"
+#include "CodecRing.h"
+#include "CodecService.h"
+#include "Parity.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// serve: runs a codec service that the volumes mounted on the host submit their encode, verify and repair jobs to, so they share
+// one pool of threads and one set of tables.  It runs until interrupted.
+//
+// ringbench: measures a codec service against several client processes.  The service runs in this process and each client is a
+// forked process that, for each stripe of random data, runs these jobs through the ring:
+//
+//   encode   the parity of the stripe, compared with a local encode for every 16th stripe
+//   verify   the encoded stripe, which must be intact
+//   repair   the stripe with 1 to nParity slices overwritten, which must come back as they were
+//   damage   a verify of the stripe with one byte changed, which must find it
+//
+// The throughput of each client shows whether the service shares its threads fairly between them.
+
+namespace ReedSolomonProtect {
+
+	static const uint64_t DEFAULT_RING_SLICE_BYTES = 64 * 1024;
+	static const uint64_t DEFAULT_SERVE_SLOT_BYTES = 4 * 1024 * 1024;
+	static const uint32_t DEFAULT_SERVE_SLOTS = 64;
+	// Every this many stripes a client checks the service's parity against its own
+	static const uint32_t RING_CHECK_INTERVAL = 16;
+	// How long a client waits for the service to start
+	static const int RING_ATTACH_SECONDS = 10;
+
+	static volatile std::sig_atomic_t _interrupted = 0;
+
+	static void Interrupt(int) { _interrupted = 1; }
+
+	ProtectResult Serve(const std::string& name, const ProtectOptions& options) {
+		size_t slots = options.ringSlots != 0 ? options.ringSlots : DEFAULT_SERVE_SLOTS;
+		size_t slotBytes = (size_t)(options.ringSlotBytes != 0 ? options.ringSlotBytes : DEFAULT_SERVE_SLOT_BYTES);
+
+		std::signal(SIGINT, Interrupt);
+		std::signal(SIGTERM, Interrupt);
+
+		ReedSolomon::CodecService service(name, slots, slotBytes, options.ringClients, options.threads);
+		if (!options.quiet) {
+			printf("Serving %s: %zu workers, %zu slots of %zu bytes, %zu clients\n", name.c_str(), service.GetWorkerCount(), slots, slotBytes,
+				service.GetMaxClients());
+			fflush(stdout);
+		}
+
+		while (_interrupted == 0) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		service.Stop();
+
+		if (!options.quiet) {
+			uint64_t jobs = 0;
+			for (size_t i = 0; i < service.GetMaxClients(); i++) jobs += service.GetCompletedJobs(i);
+			printf("Stopped %s after %llu jobs in %zu geometries\n", name.c_str(), (unsigned long long)jobs, service.GetGeometryCount());
+		}
+		return PROTECT_OK;
+	}
+
+	struct RingGeometry {
+		uint32_t nData;
+		uint32_t nParity;
+		size_t bytesPerSlice;
+
+		inline size_t GetSliceCount() const { return nData + nParity; }
+		inline uint64_t GetStripeBytes() const { return (uint64_t)nData * bytesPerSlice; }
+	};
+
+	// What a client process writes to its pipe when it finishes
+	struct RingClientReport {
+		uint64_t stripes;
+		double seconds;
+		uint32_t mismatches;
+		uint32_t failed;
+	};
+
+	static std::unique_ptr<ReedSolomon::CodecClient> AttachClient(const std::string& name) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(RING_ATTACH_SECONDS);
+		while (true) {
+			try {
+				return std::unique_ptr<ReedSolomon::CodecClient>(new ReedSolomon::CodecClient(name));
+			} catch (std::runtime_error&) {
+				if (std::chrono::steady_clock::now() >= deadline) throw;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	}
+
+	static RingClientReport RunClient(const std::string& name, const RingGeometry& geometry, uint64_t stripes, uint32_t client) {
+		RingClientReport report = {};
+		std::unique_ptr<ReedSolomon::CodecClient> codec = AttachClient(name);
+
+		size_t nSlices = geometry.GetSliceCount();
+		size_t bytes = geometry.bytesPerSlice;
+		ReedSolomon::Parity parity(geometry.nData, geometry.nParity, bytes / 2);
+		std::vector<uint8_t> reference(nSlices * bytes);
+		std::vector<uint8_t> expected(bytes);
+		std::mt19937_64 random(0x5eed0000ull + client);
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t stripe = 0; stripe < stripes; stripe++) {
+			uint32_t slot;
+			uint8_t* payload = codec->Acquire(slot);
+			auto slice = [&](size_t i) { return payload + i * bytes; };
+
+			uint64_t* words = (uint64_t*)payload;
+			for (size_t i = 0; i < geometry.GetStripeBytes() / 8; i++) words[i] = random();
+
+			codec->Submit(slot, ReedSolomon::CODEC_ENCODE, geometry.nData, geometry.nParity, bytes, 0);
+			if (codec->Wait(slot) != ReedSolomon::CODEC_OK) report.mismatches++;
+
+			if (stripe % RING_CHECK_INTERVAL == 0) {
+				std::vector<uint16_t*> data(geometry.nData);
+				std::vector<size_t> exponents(geometry.nData);
+				for (size_t i = 0; i < geometry.nData; i++) {
+					data[i] = (uint16_t*)slice(i);
+					exponents[i] = nSlices - 1 - i;
+				}
+				parity.Reset();
+				parity.CalculateRun(data.data(), exponents.data(), geometry.nData);
+				for (size_t i = geometry.nData; i < nSlices; i++) {
+					parity.GetParity((uint16_t*)expected.data(), nSlices - 1 - i);
+					if (memcmp(expected.data(), slice(i), bytes) != 0) report.mismatches++;
+				}
+			}
+
+			codec->Submit(slot, ReedSolomon::CODEC_VERIFY, geometry.nData, geometry.nParity, bytes, 0);
+			if (codec->Wait(slot) != ReedSolomon::CODEC_OK) report.mismatches++;
+
+			// Overwrite a different number of slices each time, so every strategy of AdaptiveRepair is run
+			memcpy(reference.data(), payload, reference.size());
+			size_t errorCount = 1 + (size_t)(stripe % geometry.nParity);
+			std::vector<int32_t> errors;
+			while (errors.size() < errorCount) {
+				int32_t e = (int32_t)(random() % nSlices);
+				if (std::find(errors.begin(), errors.end(), e) != errors.end()) continue;
+				errors.push_back(e);
+				memset(slice(nSlices - 1 - (size_t)e), 0xA5, bytes);
+			}
+			memcpy(payload + nSlices * bytes, errors.data(), errors.size() * sizeof(int32_t));
+			codec->Submit(slot, ReedSolomon::CODEC_REPAIR, geometry.nData, geometry.nParity, bytes, errorCount);
+			if (codec->Wait(slot) != ReedSolomon::CODEC_OK || memcmp(reference.data(), payload, reference.size()) != 0) report.mismatches++;
+
+			payload[(size_t)(random() % (nSlices * bytes))] ^= 1;
+			codec->Submit(slot, ReedSolomon::CODEC_VERIFY, geometry.nData, geometry.nParity, bytes, 0);
+			if (codec->Wait(slot) != ReedSolomon::CODEC_DAMAGED) report.mismatches++;
+
+			codec->Release(slot);
+			report.stripes++;
+		}
+		report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return report;
+	}
+
+	ProtectResult RingBench(const ProtectOptions& options) {
+		RingGeometry geometry;
+		geometry.nData = options.benchDataBlocks;
+		geometry.nParity = options.parityCount;
+		if (geometry.nParity == 0) geometry.nParity = (uint32_t)std::max(1.0, std::ceil(geometry.nData * options.redundancy / 100));
+		if (geometry.nData == 0 || geometry.GetSliceCount() > 65535) throw std::invalid_argument("A stripe holds 1 to 65535 blocks");
+		geometry.bytesPerSlice = (size_t)(options.blockSize != 0 ? options.blockSize : DEFAULT_RING_SLICE_BYTES);
+		if (geometry.bytesPerSlice % 64 != 0) throw std::invalid_argument("The block size must be a multiple of 64 bytes");
+
+		uint32_t clients = options.ringClients;
+		if (clients == 0) throw std::invalid_argument("ringbench needs at least one client");
+		size_t jobBytes = ReedSolomon::CodecRing::GetJobBytes(geometry.nData, geometry.nParity, geometry.bytesPerSlice, geometry.nParity);
+		size_t slots = options.ringSlots != 0 ? options.ringSlots : 2 * (size_t)clients;
+		size_t slotBytes = (size_t)(options.ringSlotBytes != 0 ? options.ringSlotBytes : jobBytes);
+		if (slotBytes < jobBytes) throw std::invalid_argument("A stripe does not fit the slot size");
+
+		uint64_t stripeBytes = geometry.GetStripeBytes();
+		uint64_t stripes = std::max((uint64_t)1, (options.benchBytes / clients + stripeBytes - 1) / stripeBytes);
+		std::string name = "rsprotect-ringbench-" + std::to_string((long long)getpid());
+
+		// The clients are forked before the service starts its threads, and wait for it to come up
+		std::vector<pid_t> processes;
+		std::vector<int> pipes;
+		for (uint32_t c = 0; c < clients; c++) {
+			int fds[2];
+			if (pipe(fds) != 0) throw std::runtime_error("Cannot create a pipe");
+			fflush(stdout);
+			pid_t process = fork();
+			if (process < 0) throw std::runtime_error("Cannot start a client process");
+			if (process == 0) {
+				close(fds[0]);
+				RingClientReport report = {};
+				try {
+					report = RunClient(name, geometry, stripes, c);
+				} catch (std::exception& e) {
+					fprintf(stderr, "rsprotect: client %u: %s\n", c, e.what());
+					report.failed = 1;
+				}
+				ssize_t written = write(fds[1], &report, sizeof(report));
+				_exit(written == (ssize_t)sizeof(report) ? 0 : 1);
+			}
+			close(fds[1]);
+			processes.push_back(process);
+			pipes.push_back(fds[0]);
+		}
+
+		std::vector<RingClientReport> reports(clients);
+		size_t workers;
+		uint64_t jobs = 0;
+		size_t geometries;
+		{
+			ReedSolomon::CodecService service(name, slots, slotBytes, clients, options.threads);
+			workers = service.GetWorkerCount();
+			if (!options.quiet) {
+				printf("Running %u clients of %llu stripes of %u data and %u parity blocks of %zu bytes on %zu workers\n", clients,
+					(unsigned long long)stripes, geometry.nData, geometry.nParity, geometry.bytesPerSlice, workers);
+				fflush(stdout);
+			}
+
+			for (uint32_t c = 0; c < clients; c++) {
+				if (read(pipes[c], &reports[c], sizeof(RingClientReport)) != (ssize_t)sizeof(RingClientReport)) reports[c].failed = 1;
+				close(pipes[c]);
+				int status;
+				waitpid(processes[c], &status, 0);
+				if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) reports[c].failed = 1;
+			}
+			for (size_t i = 0; i < clients; i++) jobs += service.GetCompletedJobs(i);
+			geometries = service.GetGeometryCount();
+		}
+
+		uint32_t mismatches = 0;
+		uint32_t failed = 0;
+		double seconds = 0;
+		double slowest = 0;
+		double fastest = 0;
+		for (uint32_t c = 0; c < clients; c++) {
+			const RingClientReport& report = reports[c];
+			mismatches += report.mismatches;
+			failed += report.failed;
+			seconds = std::max(seconds, report.seconds);
+			double rate = report.seconds > 0 ? report.stripes * stripeBytes / report.seconds : 0;
+			slowest = c == 0 ? rate : std::min(slowest, rate);
+			fastest = std::max(fastest, rate);
+			if (!options.quiet) {
+				printf("client %u: %llu stripes in %.2f s, %.1f MB/s\n", c, (unsigned long long)report.stripes, report.seconds,
+					rate / (1024 * 1024));
+			}
+		}
+
+		if (!options.quiet) {
+			double total = seconds > 0 ? clients * stripes * stripeBytes / seconds : 0;
+			printf("ring: %llu jobs in %zu geometries, %.1f MB/s of stripes, slowest client at %.0f%% of the fastest\n",
+				(unsigned long long)jobs, geometries, total / (1024 * 1024), fastest > 0 ? 100 * slowest / fastest : 0);
+		}
+
+		if (failed > 0 || mismatches > 0) {
+			fprintf(stderr, "rsprotect: %u clients failed and %u jobs gave wrong results\n", failed, mismatches);
+			return PROTECT_UNREPAIRABLE;
+		}
+		return PROTECT_OK;
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// The codec headers mark their exports with __declspec, which only means something to the Windows DLL build
+#define __declspec(x)
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
@@ -0,0 +1,162 @@
+﻿using System;
+using System.IO;
+using System.Runtime.InteropServices;
+
+namespace SRFS.IO {
+
+    /// <summary>
+    /// The cost model of a <see cref="SimulatedIO"/>.  Every request costs the latency plus its length over the bandwidth, plus
+    /// the extra latency of each slow block it reads.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SimulatedTiming {
+        public double LatencySeconds;
+        /// <summary>Zero for no transfer cost.</summary>
+        public double BytesPerSecond;
+        public double SlowBlockSeconds;
+        /// <summary>Whether requests wait out their cost, or only add it to the simulated time.</summary>
+        [MarshalAs(UnmanagedType.I1)]
+        public bool Sleep;
+    }
+
+    /// <summary>
+    /// Fault rates, as the probability per block read or per write.  Faults are persistent until the block is written again.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SimulatedFaults {
+        public ulong Seed;
+        public double BitRotPerRead;
+        public double LossPerRead;
+        public double SlowPerRead;
+        public double TornPerWrite;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SimulatedStats {
+        public ulong Reads;
+        public ulong Writes;
+        public ulong BytesRead;
+        public ulong BytesWritten;
+        public ulong FailedReads;
+        public ulong BitRots;
+        public ulong Losses;
+        public ulong SlowBlocks;
+        public ulong TornWrites;
+        public double SimulatedSeconds;
+    }
+
+    /// <summary>
+    /// A sparse, in-memory block device that injects bit rot, lost and slow blocks, and torn writes, for exercising verify and
+    /// repair without real hardware.  Reading a lost block throws an <see cref="IOException"/>.  A torn write is silent, as it is
+    /// on a real device.
+    /// </summary>
+    public unsafe class SimulatedIO : IBlockIO {
+
+        public SimulatedIO(long size, int blockSize) {
+            if (size < 0) throw new ArgumentOutOfRangeException(nameof(size));
+            if (blockSize <= 0) throw new ArgumentOutOfRangeException(nameof(blockSize));
+            _rsp = SimulatedDevice_Construct((ulong)size, (uint)blockSize);
+            _size = size;
+            _blockSize = blockSize;
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                SimulatedDevice_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~SimulatedIO() {
+            Dispose(false);
+        }
+
+        /// <inheritdoc />
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        /// <inheritdoc />
+        public int BlockSizeBytes => _blockSize;
+
+        /// <inheritdoc />
+        public long SizeBytes => _size;
+
+        /// <inheritdoc />
+        public void Read(long position, byte[] buffer, int offset, long bytesToRead) {
+            if (bytesToRead < 0 || offset < 0 || offset + bytesToRead > buffer.Length) throw new ArgumentOutOfRangeException(nameof(bytesToRead));
+
+            bool readable;
+            fixed (byte* p = buffer) readable = SimulatedDevice_Read(_rsp, (ulong)position, p + offset, (uint)bytesToRead);
+            if (!readable) throw new IOException($"Lost block in {bytesToRead} bytes at {position}");
+        }
+
+        /// <inheritdoc />
+        public void Write(long position, byte[] buffer, int offset, long bytesToWrite) {
+            if (bytesToWrite < 0 || offset < 0 || offset + bytesToWrite > buffer.Length) throw new ArgumentOutOfRangeException(nameof(bytesToWrite));
+
+            fixed (byte* p = buffer) SimulatedDevice_Write(_rsp, (ulong)position, p + offset, (uint)bytesToWrite);
+        }
+
+        public void SetTiming(SimulatedTiming timing) => SimulatedDevice_SetTiming(_rsp, ref timing);
+
+        public void SetFaults(SimulatedFaults faults) => SimulatedDevice_SetFaults(_rsp, ref faults);
+
+        public void InjectBitRot(long bitOffset) => SimulatedDevice_InjectBitRot(_rsp, (ulong)bitOffset);
+
+        public void InjectLoss(long position, long length) => SimulatedDevice_InjectLoss(_rsp, (ulong)position, (ulong)length);
+
+        public void InjectSlow(long position, long length) => SimulatedDevice_InjectSlow(_rsp, (ulong)position, (ulong)length);
+
+        public SimulatedStats Stats {
+            get {
+                SimulatedStats stats;
+                SimulatedDevice_GetStats(_rsp, out stats);
+                return stats;
+            }
+        }
+
+        public void ResetStats() => SimulatedDevice_ResetStats(_rsp);
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+        private long _size;
+        private int _blockSize;
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr SimulatedDevice_Construct(ulong sizeBytes, uint blockSize);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void SimulatedDevice_Destruct(IntPtr device);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void SimulatedDevice_SetTiming(IntPtr device, ref SimulatedTiming timing);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void SimulatedDevice_SetFaults(IntPtr device, ref SimulatedFaults faults);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool SimulatedDevice_Read(IntPtr device, ulong offset, byte* data, uint length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint SimulatedDevice_Write(IntPtr device, ulong offset, byte* data, uint length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void SimulatedDevice_InjectBitRot(IntPtr device, ulong bitOffset);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void SimulatedDevice_InjectLoss(IntPtr device, ulong offset, ulong length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void SimulatedDevice_InjectSlow(IntPtr device, ulong offset, ulong length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void SimulatedDevice_GetStats(IntPtr device, out SimulatedStats stats);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void SimulatedDevice_ResetStats(IntPtr device);
+    }
+}
@@ -0,0 +1,112 @@
+﻿using SRFS.Model.Clusters;
+using SRFS.Model.Data;
+using SRFS.Model.Exceptions;
+using SRFS.ReedSolomon;
+using System;
+using System.Collections.Generic;
+using System.Security.Cryptography;
+
+namespace SRFS.Model {
+
+    /// <summary>
+    /// Verifies cluster signatures natively instead of through CNG.  The tables for each signing key of the volume are built once,
+    /// when the verifier is created for a mount, and a <see cref="SignatureBatch"/> verifies the signatures of many clusters
+    /// across all cores at once.
+    /// </summary>
+    public class ClusterSignatureVerifier : IDisposable {
+
+        public ClusterSignatureVerifier(IDictionary<KeyThumbprint, PublicKey> signatureKeys) {
+            if (signatureKeys == null) throw new ArgumentNullException(nameof(signatureKeys));
+
+            _verifier = new SignatureVerifier();
+            foreach (var pair in signatureKeys) {
+                // An ECC public blob is the magic, the coordinate length, then the coordinates
+                byte[] blob = pair.Value.Bytes;
+                if (BitConverter.ToInt32(blob, sizeof(int)) != SignatureVerifier.CoordinateLength) throw new NotSupportedException();
+
+                byte[] x = new byte[SignatureVerifier.CoordinateLength];
+                byte[] y = new byte[SignatureVerifier.CoordinateLength];
+                Buffer.BlockCopy(blob, BlobHeaderLength, x, 0, x.Length);
+                Buffer.BlockCopy(blob, BlobHeaderLength + x.Length, y, 0, y.Length);
+                _keys.Add(pair.Key, _verifier.AddKey(x, y));
+            }
+        }
+
+        public void Dispose() {
+            _verifier.Dispose();
+        }
+
+        public bool HasKey(KeyThumbprint thumbprint) => _keys.ContainsKey(thumbprint);
+
+        public SignatureBatch CreateBatch() => new SignatureBatch(this);
+
+        internal int GetKeyIndex(KeyThumbprint thumbprint) {
+            int index;
+            if (!_keys.TryGetValue(thumbprint, out index)) throw new MissingKeyException(thumbprint);
+            return index;
+        }
+
+        /// <summary>
+        /// The digest CNG signs for data: its SHA-256.
+        /// </summary>
+        internal static byte[] GetDigest(byte[] data, int offset, int count) {
+            using (var hasher = new SHA256Cng()) {
+                hasher.TransformFinalBlock(data, offset, count);
+                return hasher.Hash;
+            }
+        }
+
+        internal SignatureVerifier Verifier => _verifier;
+
+        private const int BlobHeaderLength = 2 * sizeof(int);
+
+        private SignatureVerifier _verifier;
+        private Dictionary<KeyThumbprint, int> _keys = new Dictionary<KeyThumbprint, int>();
+    }
+
+    /// <summary>
+    /// The signatures of clusters read with their signature checks deferred, to be verified together.
+    /// </summary>
+    public class SignatureBatch {
+
+        internal SignatureBatch(ClusterSignatureVerifier verifier) {
+            _verifier = verifier;
+        }
+
+        public int Count => _clusters.Count;
+
+        /// <summary>
+        /// Verifies every signature added since the last call, and returns the clusters whose signatures are not valid.
+        /// </summary>
+        public IList<Cluster> Verify() {
+            bool[] valid = _verifier.Verifier.VerifyMany(_keys, _digests, _signatures);
+
+            var invalid = new List<Cluster>();
+            for (int i = 0; i < valid.Length; i++) {
+                if (!valid[i]) invalid.Add(_clusters[i]);
+            }
+
+            _clusters.Clear();
+            _keys.Clear();
+            _digests.Clear();
+            _signatures.Clear();
+            return invalid;
+        }
+
+        /// <summary>
+        /// Defers the check of a cluster's signature over count bytes of data.  The data is only read during the call.
+        /// </summary>
+        internal void Add(Cluster cluster, KeyThumbprint thumbprint, Signature signature, byte[] data, int offset, int count) {
+            _keys.Add(_verifier.GetKeyIndex(thumbprint));
+            _clusters.Add(cluster);
+            _digests.Add(ClusterSignatureVerifier.GetDigest(data, offset, count));
+            _signatures.Add(signature.Bytes);
+        }
+
+        private ClusterSignatureVerifier _verifier;
+        private List<Cluster> _clusters = new List<Cluster>();
+        private List<int> _keys = new List<int>();
+        private List<byte[]> _digests = new List<byte[]>();
+        private List<byte[]> _signatures = new List<byte[]>();
+    }
+}
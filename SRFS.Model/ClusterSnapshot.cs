@@ -0,0 +1,87 @@
+﻿using System;
+using System.Collections.Generic;
+
+namespace SRFS.Model {
+
+    /// <summary>
+    /// A point-in-time view of the data clusters of one track, for refreshing its parity while the file system stays live.
+    /// 
+    /// It is taken by <see cref="SimpleClusterIO.BeginSnapshot"/> once the track is flushed.  From then until
+    /// <see cref="SimpleClusterIO.EndSnapshot"/>, a data cluster of the track that is about to be overwritten on the device has
+    /// its previous image copied here first, and every cluster saved is recorded as changed.  Reading through the snapshot gives
+    /// the track as it was when the snapshot began, however many writes have landed since.
+    /// </summary>
+    public class ClusterSnapshot {
+
+        // Public
+        #region Constructors
+
+        internal ClusterSnapshot(int trackNumber) {
+            _trackNumber = trackNumber;
+        }
+
+        #endregion
+        #region Properties
+
+        public int TrackNumber => _trackNumber;
+
+        /// <summary>
+        /// The root of the track hash tree when the snapshot began, which matches the clusters as the snapshot reads them.
+        /// </summary>
+        public byte[] TrackHashRoot { get; internal set; }
+
+        #endregion
+        #region Methods
+
+        /// <summary>
+        /// The state of a data cluster of the track when the snapshot began.
+        /// </summary>
+        public ClusterState GetState(int absoluteClusterNumber) {
+            lock (_lock) return _states[absoluteClusterNumber];
+        }
+
+        /// <summary>
+        /// Whether a data cluster of the track has been saved since the snapshot began.
+        /// </summary>
+        public bool IsChanged(int absoluteClusterNumber) {
+            lock (_lock) return _changed.Contains(absoluteClusterNumber);
+        }
+
+        internal void SetState(int absoluteClusterNumber, ClusterState state) {
+            lock (_lock) _states[absoluteClusterNumber] = state;
+        }
+
+        internal void SetChanged(int absoluteClusterNumber) {
+            lock (_lock) _changed.Add(absoluteClusterNumber);
+        }
+
+        internal bool HasImage(int absoluteClusterNumber) {
+            lock (_lock) return _images.ContainsKey(absoluteClusterNumber);
+        }
+
+        /// <summary>
+        /// Keeps the image a cluster had when the snapshot began.  Only the first image given for a cluster is kept.
+        /// </summary>
+        internal void SetImage(int absoluteClusterNumber, byte[] image) {
+            lock (_lock) if (!_images.ContainsKey(absoluteClusterNumber)) _images.Add(absoluteClusterNumber, image);
+        }
+
+        internal bool TryGetImage(int absoluteClusterNumber, out byte[] image) {
+            lock (_lock) return _images.TryGetValue(absoluteClusterNumber, out image);
+        }
+
+        #endregion
+
+        // Private
+        #region Fields
+
+        private readonly int _trackNumber;
+        private readonly Dictionary<int, ClusterState> _states = new Dictionary<int, ClusterState>();
+        private readonly HashSet<int> _changed = new HashSet<int>();
+        // The previous images of the clusters written to the device since the snapshot began
+        private readonly Dictionary<int, byte[]> _images = new Dictionary<int, byte[]>();
+        private readonly object _lock = new object();
+
+        #endregion
+    }
+}
@@ -10,10 +10,10 @@ namespace SRFS.Model.Clusters {
     /// 
     /// The header layout is:
     /// 
-    /// Data Cluster Header (223 bytes)
+    /// Data Cluster Header (227 bytes)
     /// Next Cluster Address (4 bytes)
     /// 
-    /// Total Length: 227 bytes.
+    /// Total Length: 231 bytes.
     /// </summary>
     public abstract class ArrayCluster : DataCluster {
 
@@ -82,11 +82,11 @@ namespace SRFS.Model.Clusters {
     /// 
     /// The header layout is:
     /// 
-    /// [Cluster Header (219 bytes)]
+    /// [Cluster Header (223 bytes)]
     /// [Data Cluster Header (4 bytes)]
     /// [Array Cluster Header (4 bytes)]
     /// 
-    /// Total Length: 227 bytes.
+    /// Total Length: 231 bytes.
     /// </summary>
     public abstract class ArrayCluster<T> : ArrayCluster, IEnumerable<T> {
 
@@ -7,6 +7,7 @@ using System.IO;
 using System.Linq;
 using System.Runtime.CompilerServices;
 using System.Security.Cryptography;
+using SRFS.ReedSolomon;
 
 namespace SRFS.Model.Clusters {
 
@@ -26,13 +27,14 @@ namespace SRFS.Model.Clusters {
     /// 
     /// Marker (4 bytes) - The four ASCII characters "SRFS"
     /// Version (2 bytes) - The version of SRFS, major then minor.
+    /// Checksum (4 bytes) - The CRC-32C of the remaining bytes in the cluster, for scrubs that skip the hash and signature
     /// Signature (132 bytes) - The signature of the hash
     /// Hash (32 bytes) - The SHA256 hash of the remaining bytes in the cluster
     /// Signing Key Thumbprint (32 bytes) - The thumbprint of the key used to sign the hash
     /// Volume ID (16 bytes) - A GUID identifying this specific filesystem instance
     /// Cluster Type (1 byte) - The type of cluster
     /// 
-    /// Total Length: 219 bytes
+    /// Total Length: 223 bytes
     /// </summary>
     public class Cluster : INotifyPropertyChanged {
 
@@ -88,7 +90,10 @@ namespace SRFS.Model.Clusters {
         /// <param name="offset"></param>
         /// <param name="signatureKeys"></param>
         /// <param name="options"></param>
-        public void Read(byte[] bytes, int offset, IDictionary<KeyThumbprint, PublicKey> signatureKeys, Options options) {
+        /// <param name="deferredSignatures">If not null, the signature is added to this batch to be verified later, instead of
+        /// being verified here</param>
+        public void Read(byte[] bytes, int offset, IDictionary<KeyThumbprint, PublicKey> signatureKeys, Options options,
+            SignatureBatch deferredSignatures = null) {
             if (bytes == null) throw new ArgumentNullException(nameof(bytes));
             if (signatureKeys == null) throw new ArgumentNullException(nameof(signatureKeys));
             if (offset < 0) throw new ArgumentOutOfRangeException(nameof(offset));
@@ -103,25 +108,32 @@ namespace SRFS.Model.Clusters {
                 if (!reader.ReadBytes(Constants.CurrentVersionLength).SequenceEqual(Constants.CurrentVersion))
                     throw new InvalidClusterException("Unsupported Version");
 
+                uint checksum = reader.ReadUInt32();
                 Signature signature = reader.ReadSignature();
                 byte[] hash = reader.ReadBytes(Constants.HashLength);
                 KeyThumbprint signatureThumbprint = reader.ReadKeyThumbprint();
 
-                if (options.VerifyClusterHashes() && !hash.SequenceEqual(calculateHash(bytes, offset)))
-                    throw new InvalidHashException();
-
-                if (options.VerifyClusterSignatures()) {
-                    PublicKey key = null;
-                    if (!signatureKeys.TryGetValue(signatureThumbprint, out key)) throw new MissingKeyException(signatureThumbprint);
-
-                    if (!signature.Verify(bytes, offset + HashPosition, Constants.HashLength, key.Key))
-                        throw new InvalidSignatureException();
+                if (!options.VerifyClusterChecksumsOnly()) {
+                    verify(bytes, offset, hash, signature, signatureThumbprint, signatureKeys, deferredSignatures,
+                        options.VerifyClusterHashes(), options.VerifyClusterSignatures());
+                    readContents(reader, bytes, offset, false);
+                    _isModified = false;
+                    return;
                 }
 
-                _volumeID = reader.ReadGuid();
-                _clusterType = reader.ReadClusterType();
-
-                Read(reader);
+                // A matching checksum stands in for the hash and signature.  A mismatch gets both, so that a cluster whose
+                // checksum alone is damaged still reads.  The checksum is taken as the contents are read, so encrypted contents
+                // are checksummed as they are decrypted rather than in a pass of their own.  Contents that fail to read are only
+                // reported as such if the checksum matches; otherwise the hash and signature say what is wrong.
+                bool isIntact;
+                try {
+                    readContents(reader, bytes, offset, true);
+                    isIntact = finishChecksum(bytes, offset) == checksum;
+                } catch (Exception) when (finishChecksum(bytes, offset) != checksum) {
+                    verify(bytes, offset, hash, signature, signatureThumbprint, signatureKeys, null, true, true);
+                    throw;
+                }
+                if (!isIntact) verify(bytes, offset, hash, signature, signatureThumbprint, signatureKeys, deferredSignatures, true, true);
 
                 _isModified = false;
             }
@@ -154,19 +166,146 @@ namespace SRFS.Model.Clusters {
 
                 Array.Clear(bytes, offset + (int)stream.Position, _clusterSizeBytes - (int)stream.Position);
 
-                stream.Position = HashPosition;
-                writer.Write(calculateHash(bytes, offset));
-
-                stream.Position = SignaturePosition;
-                writer.Write(calculateSignature(bytes, offset, signingKey));
+                sign(stream, writer, bytes, offset, signingKey);
             }
 
             _isModified = false;
         }
 
+        /// <summary>
+        /// Write the cluster as a cache image, for a <see cref="ClusterCache"/>.  The layout is the same as Write, but the checksum,
+        /// signature, hash and signing key thumbprint are left empty and encrypted contents are written as plain text, so an image
+        /// must never be written to a device.
+        /// </summary>
+        /// <param name="bytes"></param>
+        /// <param name="offset"></param>
+        internal void WriteCacheImage(byte[] bytes, int offset) {
+            if (bytes == null) throw new ArgumentNullException(nameof(bytes));
+            if (offset < 0) throw new ArgumentOutOfRangeException(nameof(offset));
+            if (offset + _clusterSizeBytes > bytes.Length) throw new ArgumentException();
+
+            using (var stream = new MemoryStream(bytes, offset, _clusterSizeBytes))
+            using (var writer = new BinaryWriter(stream)) {
+                Array.Clear(bytes, offset, CacheImageStartPosition);
+
+                stream.Position = CacheImageStartPosition;
+                writer.Write(_volumeID);
+                writer.Write(_clusterType);
+
+                _isCacheImage = true;
+                try {
+                    Write(writer);
+                } finally {
+                    _isCacheImage = false;
+                }
+
+                Array.Clear(bytes, offset + (int)stream.Position, _clusterSizeBytes - (int)stream.Position);
+            }
+        }
+
+        /// <summary>
+        /// Turn a cache image written by WriteCacheImage, of a cluster of this type and with these keys, into the bytes Write would
+        /// have produced, in place.  This lets a write-back buffer seal the last image of a cluster without the cluster object.
+        /// </summary>
+        /// <param name="bytes"></param>
+        /// <param name="offset"></param>
+        /// <param name="signingKey"></param>
+        internal void SealCacheImage(byte[] bytes, int offset, PrivateKey signingKey) {
+            if (bytes == null) throw new ArgumentNullException(nameof(bytes));
+            if (offset < 0) throw new ArgumentOutOfRangeException(nameof(offset));
+            if (offset + _clusterSizeBytes > bytes.Length) throw new ArgumentException();
+            if (signingKey == null) throw new ArgumentNullException(nameof(signingKey));
+
+            Seal(bytes, offset);
+            SignCacheImage(bytes, offset, signingKey);
+        }
+
+        /// <summary>
+        /// The part of SealCacheImage that follows the encryption, for an image whose contents have already been encrypted.
+        /// </summary>
+        /// <param name="bytes"></param>
+        /// <param name="offset"></param>
+        /// <param name="signingKey"></param>
+        internal void SignCacheImage(byte[] bytes, int offset, PrivateKey signingKey) {
+            if (bytes == null) throw new ArgumentNullException(nameof(bytes));
+            if (offset < 0) throw new ArgumentOutOfRangeException(nameof(offset));
+            if (offset + _clusterSizeBytes > bytes.Length) throw new ArgumentException();
+            if (signingKey == null) throw new ArgumentNullException(nameof(signingKey));
+
+            using (var stream = new MemoryStream(bytes, offset, _clusterSizeBytes))
+            using (var writer = new BinaryWriter(stream)) {
+                writer.Write(Constants.SrfsMarker);
+                writer.Write(Constants.CurrentVersion);
+
+                stream.Position = HashCalculationStartPosition;
+                writer.Write(signingKey.Thumbprint);
+
+                sign(stream, writer, bytes, offset, signingKey);
+            }
+        }
+
+        /// <summary>
+        /// Read the cluster from a cache image written by WriteCacheImage.  The image was verified when the cluster was first read,
+        /// so nothing is verified or decrypted here.
+        /// </summary>
+        /// <param name="stream"></param>
+        internal void ReadCacheImage(Stream stream) {
+            if (stream == null) throw new ArgumentNullException(nameof(stream));
+            if (stream.Length < _clusterSizeBytes) throw new ArgumentException("Not enough space in stream for cluster.");
+
+            using (var reader = new BinaryReader(stream)) {
+                stream.Position = CacheImageStartPosition;
+                _volumeID = reader.ReadGuid();
+                _clusterType = reader.ReadClusterType();
+
+                _isCacheImage = true;
+                try {
+                    Read(reader);
+                } finally {
+                    _isCacheImage = false;
+                }
+
+                _isModified = false;
+            }
+        }
+
+        /// <summary>
+        /// The hash stored in the header of a sealed cluster image, as the <see cref="TrackHashTree"/> takes it.
+        /// </summary>
+        /// <param name="bytes"></param>
+        /// <param name="offset"></param>
+        internal static byte[] ReadHash(byte[] bytes, int offset) {
+            byte[] hash = new byte[Constants.HashLength];
+            Buffer.BlockCopy(bytes, offset + HashPosition, hash, 0, Constants.HashLength);
+            return hash;
+        }
+
+        /// <summary>
+        /// The hash of a cluster image as it is on the device, calculated again, without reading the cluster.  It matches the
+        /// stored hash only if the contents are intact.
+        /// </summary>
+        /// <param name="bytes"></param>
+        /// <param name="offset"></param>
+        /// <param name="clusterSizeBytes"></param>
+        internal static byte[] CalculateHash(byte[] bytes, int offset, int clusterSizeBytes) {
+            using (var hasher = new SHA256Cng()) {
+                hasher.TransformFinalBlock(bytes, offset + HashCalculationStartPosition, clusterSizeBytes - HashCalculationStartPosition);
+                return hasher.Hash;
+            }
+        }
+
         #endregion
 
         // Protected
+        #region Properties
+
+        /// <summary>
+        /// True while the cluster is reading or writing a cache image.  Subclasses that encrypt their contents read and write
+        /// the plain text instead.
+        /// </summary>
+        protected bool IsCacheImage => _isCacheImage;
+
+        #endregion
         #region Methods
 
         protected void NotifyPropertyChanged([CallerMemberName] string propertyName = null) {
@@ -192,18 +331,114 @@ namespace SRFS.Model.Clusters {
         /// <param name="writer"></param>
         protected virtual void Write(BinaryWriter writer) { }
 
+        /// <summary>
+        /// Reads count bytes of cipher text, which decrypt turns into the plain text returned.  When the cluster is read with only
+        /// its checksum verified, decrypt is given the checksum of the cluster up to the cipher text and must extend it over the
+        /// cipher text, so the bytes are read once for both.
+        /// </summary>
+        /// <param name="reader"></param>
+        /// <param name="count"></param>
+        /// <param name="decrypt"></param>
+        /// <returns></returns>
+        protected byte[] ReadEncrypted(BinaryReader reader, int count, Decryptor decrypt) {
+            int position = (int)reader.BaseStream.Position;
+            if (position + count > _clusterSizeBytes) throw new EndOfStreamException();
+
+            uint checksum = 0;
+            if (_isChecksumDeferred) {
+                checksum = Crc32c.Update(_checksum, _readBytes, _readOffset + _checksumPosition, position - _checksumPosition);
+            }
+
+            byte[] plainText = decrypt(_readBytes, _readOffset + position, count, _isChecksumDeferred, ref checksum);
+
+            if (_isChecksumDeferred) {
+                _checksum = checksum;
+                _checksumPosition = position + count;
+            }
+            reader.BaseStream.Position = position + count;
+            return plainText;
+        }
+
+        protected delegate byte[] Decryptor(byte[] bytes, int offset, int count, bool extendChecksum, ref uint checksum);
+
+        /// <summary>
+        /// Encrypts, in place, the contents that a cache image holds as plain text.
+        /// 
+        /// This method is overridden by the child classes that encrypt their data.  The offset is that of the whole cluster.
+        /// </summary>
+        /// <param name="bytes"></param>
+        /// <param name="offset"></param>
+        protected virtual void Seal(byte[] bytes, int offset) { }
+
         #endregion
 
         // Private
         #region Methods
 
-        private byte[] calculateHash(byte[] bytes, int offset) {
-            using (var hasher = new SHA256Cng()) {
-                hasher.TransformFinalBlock(bytes, offset + HashCalculationStartPosition, _clusterSizeBytes - HashCalculationStartPosition);
-                return hasher.Hash;
+        private void verify(byte[] bytes, int offset, byte[] hash, Signature signature, KeyThumbprint signatureThumbprint,
+            IDictionary<KeyThumbprint, PublicKey> signatureKeys, SignatureBatch deferredSignatures, bool verifyHash, bool verifySignature) {
+
+            if (verifyHash && !hash.SequenceEqual(calculateHash(bytes, offset)))
+                throw new InvalidHashException();
+
+            if (verifySignature) {
+                PublicKey key = null;
+                if (!signatureKeys.TryGetValue(signatureThumbprint, out key)) throw new MissingKeyException(signatureThumbprint);
+
+                if (deferredSignatures != null) {
+                    deferredSignatures.Add(this, signatureThumbprint, signature, bytes, offset + HashPosition, Constants.HashLength);
+                    return;
+                }
+
+                if (!signature.Verify(bytes, offset + HashPosition, Constants.HashLength, key.Key))
+                    throw new InvalidSignatureException();
             }
         }
 
+        private void readContents(BinaryReader reader, byte[] bytes, int offset, bool deferChecksum) {
+            _readBytes = bytes;
+            _readOffset = offset;
+            _isChecksumDeferred = deferChecksum;
+            _checksum = 0;
+            _checksumPosition = SignaturePosition;
+
+            try {
+                _volumeID = reader.ReadGuid();
+                _clusterType = reader.ReadClusterType();
+
+                Read(reader);
+            } finally {
+                _readBytes = null;
+                _isChecksumDeferred = false;
+            }
+        }
+
+        /// <summary>
+        /// The checksum of the cluster, from the part taken while the contents were read.
+        /// </summary>
+        private uint finishChecksum(byte[] bytes, int offset) {
+            return Crc32c.Update(_checksum, bytes, offset + _checksumPosition, _clusterSizeBytes - _checksumPosition);
+        }
+
+        private void sign(MemoryStream stream, BinaryWriter writer, byte[] bytes, int offset, PrivateKey signingKey) {
+            stream.Position = HashPosition;
+            writer.Write(calculateHash(bytes, offset));
+
+            stream.Position = SignaturePosition;
+            writer.Write(calculateSignature(bytes, offset, signingKey));
+
+            stream.Position = ChecksumPosition;
+            writer.Write(calculateChecksum(bytes, offset));
+        }
+
+        private byte[] calculateHash(byte[] bytes, int offset) {
+            return CalculateHash(bytes, offset, _clusterSizeBytes);
+        }
+
+        private uint calculateChecksum(byte[] bytes, int offset) {
+            return Crc32c.Compute(bytes, offset + SignaturePosition, _clusterSizeBytes - SignaturePosition);
+        }
+
         private byte[] calculateSignature(byte[] bytes, int offset, PrivateKey signingKey) {
             return new Signature(signingKey.Key, bytes, offset + HashPosition, Constants.HashLength).Bytes;
         }
@@ -211,10 +446,14 @@ namespace SRFS.Model.Clusters {
         #endregion
         #region Fields
 
-        private const int SignaturePosition =
+        private const int ChecksumPosition =
             Constants.SrfsMarkerLength +
             Constants.CurrentVersionLength;
 
+        private const int SignaturePosition =
+            ChecksumPosition +
+            Constants.ChecksumLength;
+
         private const int HashPosition =
             SignaturePosition +
             Signature.Length;
@@ -223,9 +462,12 @@ namespace SRFS.Model.Clusters {
             HashPosition +
             Constants.HashLength;
 
-        private const int HeaderLength =
+        private const int CacheImageStartPosition =
             HashCalculationStartPosition +
-            KeyThumbprint.Length +
+            KeyThumbprint.Length;
+
+        private const int HeaderLength =
+            CacheImageStartPosition +
             Constants.GuidLength +
             sizeof(ClusterType);
 
@@ -234,6 +476,15 @@ namespace SRFS.Model.Clusters {
 
         private int _clusterSizeBytes;
         private bool _isModified;
+        private bool _isCacheImage;
+
+        // While the contents are read, the bytes they are read from, and with a deferred checksum, the checksum of the cluster
+        // from SignaturePosition up to _checksumPosition
+        private byte[] _readBytes;
+        private int _readOffset;
+        private bool _isChecksumDeferred;
+        private uint _checksum;
+        private int _checksumPosition;
 
         #endregion
     }
@@ -18,7 +18,8 @@ namespace SRFS.Model.Clusters {
         FileHeader,
         FileData,
         Parity,
-        Empty
+        Empty,
+        ClusterHashTable
     }
 
     public static class ClusterTypeExtensions {
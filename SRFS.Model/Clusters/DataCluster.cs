@@ -10,10 +10,10 @@ namespace SRFS.Model.Clusters {
     /// 
     /// The header layout is:
     /// 
-    /// [Cluster Header (219 bytes)]
+    /// [Cluster Header (223 bytes)]
     /// Address (4 bytes)
     /// 
-    /// Total Length: 223 bytes.
+    /// Total Length: 227 bytes.
     /// </summary>
     public class DataCluster : Cluster {
 
@@ -4,9 +4,9 @@ using System.ComponentModel;
 namespace SRFS.Model.Clusters {
 
     /// <summary>
-    /// An empty cluster with no data.  This cluster is used to initialize data clusters on disk to contain no data.  Typically, the filesystem does
-    /// not write to the disk until the clusters are needed, but when the parity is calculated uninitialized clusters will be written as empty clusters
-    /// so that the error-correcting methods will work correctly.
+    /// An empty cluster with no data.  The filesystem does not write to the disk until clusters are needed, and the parity is calculated as
+    /// if every unwritten data cluster were a slice of zeros, which adds nothing to it.  Empty clusters are not written to fill a track, and
+    /// anything that reconstructs a track from its parity substitutes zeros for each data cluster in the Unwritten state.
     /// </summary>
     public class EmptyCluster : DataCluster {
 
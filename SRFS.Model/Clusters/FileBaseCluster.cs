@@ -1,4 +1,7 @@
-﻿using System;
+﻿using SRFS.Model.Data;
+using SRFS.ReedSolomon;
+using System;
+using System.Collections.Generic;
 using System.ComponentModel;
 using System.Security.Cryptography;
 using System.IO;
@@ -99,34 +102,248 @@ namespace SRFS.Model.Clusters {
 
         #endregion
 
-        protected static byte[] Encrypt(ECDiffieHellmanCng ecc, CngKey publicKey, byte[] bytes, int offset, int length) {
-            using (AesCng aes = new AesCng()) {
+        // Protected
+        #region Properties
+
+        /// <summary>
+        /// The key the contents are encrypted for.
+        /// </summary>
+        protected abstract PublicKey EncryptionKey { get; }
+
+        /// <summary>
+        /// The position in the cluster of the source public key, which is followed by the IV, the padding and the encrypted data.
+        /// </summary>
+        protected abstract int SourceKeyPosition { get; }
+
+        /// <summary>
+        /// The position in the cluster of the encrypted data, which is Data.Length bytes long.
+        /// </summary>
+        protected abstract int EncryptedDataPosition { get; }
+
+        #endregion
+        #region Methods
+
+        /// <summary>
+        /// Writes the source public key, the IV, the padding and the encrypted data.  A cache image gets zeros for the key and IV
+        /// and the plain text.
+        /// </summary>
+        /// <param name="writer"></param>
+        /// <param name="paddingLength"></param>
+        protected void WriteEncrypted(BinaryWriter writer, int paddingLength) {
+            if (IsCacheImage) {
+                writer.Write(new byte[PublicKey.Length + IVLength + paddingLength]);
+                writer.Write(Data);
+                return;
+            }
+
+            byte[] cipherText = (byte[])Data.Clone();
+            byte[] sourceKey;
+            byte[] iv;
+            encrypt(EncryptionKey, cipherText, 0, cipherText.Length, out sourceKey, out iv);
+
+            writer.Write(sourceKey);
+            writer.Write(iv);
+            writer.Write(new byte[paddingLength]);
+            writer.Write(cipherText);
+        }
+
+        /// <summary>
+        /// Reads what WriteEncrypted wrote, and returns the plain text.
+        /// </summary>
+        /// <param name="reader"></param>
+        /// <param name="decryptionKey"></param>
+        /// <param name="paddingLength"></param>
+        /// <returns></returns>
+        protected byte[] ReadEncrypted(BinaryReader reader, PrivateKey decryptionKey, int paddingLength) {
+            if (IsCacheImage) {
+                reader.BaseStream.Seek(PublicKey.Length + IVLength + paddingLength, SeekOrigin.Current);
+                return reader.ReadBytes(Data.Length);
+            }
+
+            byte[] sourceKey = reader.ReadBytes(PublicKey.Length);
+            byte[] iv = reader.ReadBytes(IVLength);
+            reader.BaseStream.Seek(paddingLength, SeekOrigin.Current);
+
+            return ReadEncrypted(reader, Data.Length, (byte[] bytes, int offset, int count, bool extendChecksum, ref uint checksum) =>
+                decrypt(decryptionKey, sourceKey, iv, bytes, offset, count, extendChecksum, ref checksum));
+        }
+
+        protected sealed override void Seal(byte[] bytes, int offset) {
+            SealCacheImages(new FileBaseCluster[] { this }, new byte[][] { bytes }, new int[] { offset });
+        }
+
+        /// <summary>
+        /// Encrypts the contents of several cache images in place, as Seal does for one, but under one session key per
+        /// encryption key and with up to <see cref="ClusterCrypto.MaxLanes"/> clusters encrypted side by side.  Each image still
+        /// has to be signed with SignCacheImage.
+        /// </summary>
+        /// <param name="clusters"></param>
+        /// <param name="images"></param>
+        /// <param name="offsets"></param>
+        internal static void SealCacheImages(IList<FileBaseCluster> clusters, IList<byte[]> images, IList<int> offsets) {
+            var batches = new Dictionary<Tuple<KeyThumbprint, int>, List<int>>();
+            for (int i = 0; i < clusters.Count; i++) {
+                var batchKey = Tuple.Create(clusters[i].EncryptionKey.Thumbprint, clusters[i].Data.Length);
+                List<int> batch;
+                if (!batches.TryGetValue(batchKey, out batch)) batches.Add(batchKey, batch = new List<int>());
+                batch.Add(i);
+            }
+
+            foreach (List<int> batch in batches.Values) {
+                for (int first = 0; first < batch.Count; first += ClusterCrypto.MaxLanes) {
+                    int count = Math.Min(ClusterCrypto.MaxLanes, batch.Count - first);
+                    var lanes = batch.GetRange(first, count);
+
+                    FileBaseCluster leader = clusters[lanes[0]];
+                    SessionKey session = getSessionKey(leader.EncryptionKey);
+
+                    var ivs = new List<byte[]>(count);
+                    var buffers = new List<byte[]>(count);
+                    var dataOffsets = new List<int>(count);
+                    foreach (int i in lanes) {
+                        byte[] iv = createIV();
+                        int start = offsets[i] + clusters[i].SourceKeyPosition;
+                        Buffer.BlockCopy(session.PublicKey, 0, images[i], start, PublicKey.Length);
+                        Buffer.BlockCopy(iv, 0, images[i], start + PublicKey.Length, IVLength);
+
+                        ivs.Add(iv);
+                        buffers.Add(images[i]);
+                        dataOffsets.Add(offsets[i] + clusters[i].EncryptedDataPosition);
+                    }
+
+                    int length = leader.Data.Length;
+                    if (_crypto.EncryptMany(session.ID, ivs, buffers, dataOffsets, length)) continue;
+
+                    if (ClusterCrypto.IsSupported) {
+                        // Evicted from the cache
+                        _crypto.AddKey(session.ID, session.Key);
+                        if (_crypto.EncryptMany(session.ID, ivs, buffers, dataOffsets, length)) continue;
+                    }
+
+                    for (int lane = 0; lane < count; lane++) encryptWith(session, ivs[lane], buffers[lane], dataOffsets[lane], length);
+                }
+            }
+        }
+
+        #endregion
+
+        // Private
+        #region Methods
+
+        /// <summary>
+        /// The ephemeral ECDH key that this process encrypts clusters for an encryption key with, and the AES key derived from it.
+        /// One key serves every cluster the process writes for the encryption key, each with its own random IV, so the derived
+        /// key and its schedule are made once rather than for every cluster, and a reader finds them in its cache the same way.
+        /// </summary>
+        private sealed class SessionKey {
+            public byte[] PublicKey;
+            public byte[] ID;
+            public byte[] Key;
+        }
+
+        private static SessionKey getSessionKey(PublicKey encryptionKey) {
+            lock (_sessionKeys) {
+                SessionKey session;
+                if (_sessionKeys.TryGetValue(encryptionKey.Thumbprint, out session)) return session;
+
+                using (ECDiffieHellmanCng source = new ECDiffieHellmanCng()) {
+                    session = new SessionKey();
+                    session.PublicKey = source.PublicKey.ToByteArray();
+                    session.ID = getCryptoID(encryptionKey.Thumbprint, session.PublicKey);
+                    session.Key = source.DeriveKeyMaterial(encryptionKey.Key);
+                }
+
+                if (ClusterCrypto.IsSupported) _crypto.AddKey(session.ID, session.Key);
+                _sessionKeys.Add(encryptionKey.Thumbprint, session);
+                return session;
+            }
+        }
+
+        /// <summary>
+        /// The id of a derived key in the crypto cache: the thumbprint of the encryption key, then the source public key.  ECDH
+        /// derives the same key from either end, so a key cached when a cluster is written also serves when it is read.
+        /// </summary>
+        private static byte[] getCryptoID(KeyThumbprint encryptionKeyThumbprint, byte[] sourceKey) {
+            byte[] id = new byte[KeyThumbprint.Length + PublicKey.Length];
+            Buffer.BlockCopy(encryptionKeyThumbprint.Bytes, 0, id, 0, KeyThumbprint.Length);
+            Buffer.BlockCopy(sourceKey, 0, id, KeyThumbprint.Length, PublicKey.Length);
+            return id;
+        }
 
-                aes.KeySize = 256;
-                aes.BlockSize = 128;
-                aes.Mode = CipherMode.CBC;
-                aes.Padding = PaddingMode.None;
-                aes.Key = ecc.DeriveKeyMaterial(publicKey);
-                aes.IV = new byte[16];
+        private static byte[] createIV() {
+            byte[] iv = new byte[IVLength];
+            _random.GetBytes(iv);
+            return iv;
+        }
+
+        private static void encrypt(PublicKey encryptionKey, byte[] bytes, int offset, int length, out byte[] sourceKey, out byte[] iv) {
+            SessionKey session = getSessionKey(encryptionKey);
+            sourceKey = session.PublicKey;
+            iv = createIV();
+            encryptWith(session, iv, bytes, offset, length);
+        }
+
+        private static void encryptWith(SessionKey session, byte[] iv, byte[] bytes, int offset, int length) {
+            if (_crypto.Encrypt(session.ID, iv, bytes, offset, length)) return;
+
+            if (ClusterCrypto.IsSupported) {
+                // Evicted from the cache
+                _crypto.AddKey(session.ID, session.Key);
+                if (_crypto.Encrypt(session.ID, iv, bytes, offset, length)) return;
+            }
 
-                using (var decryptor = aes.CreateEncryptor()) return decryptor.TransformFinalBlock(bytes, offset, length);
+            using (AesCng aes = createAes(session.Key, iv))
+            using (var encryptor = aes.CreateEncryptor()) {
+                byte[] cipherText = encryptor.TransformFinalBlock(bytes, offset, length);
+                Buffer.BlockCopy(cipherText, 0, bytes, offset, length);
             }
         }
 
-        protected static byte[] Decrypt(ECDiffieHellmanCng ecc, CngKey publicKey, byte[] bytes, int offset, int length) {
-            using (AesCng aes = new AesCng()) {
+        private static byte[] decrypt(PrivateKey decryptionKey, byte[] sourceKey, byte[] iv, byte[] bytes, int offset, int length,
+            bool extendChecksum, ref uint checksum) {
+
+            byte[] id = getCryptoID(decryptionKey.Thumbprint, sourceKey);
+            byte[] plainText = new byte[length];
+
+            if (ClusterCrypto.IsSupported) {
+                for (int attempt = 0; attempt < 2; attempt++) {
+                    bool isDecrypted = extendChecksum ?
+                        _crypto.Decrypt(id, iv, bytes, offset, plainText, 0, length, ref checksum) :
+                        _crypto.Decrypt(id, iv, bytes, offset, plainText, 0, length);
+                    if (isDecrypted) return plainText;
+
+                    _crypto.AddKey(id, deriveKey(decryptionKey, sourceKey));
+                }
+            }
 
-                aes.KeySize = 256;
-                aes.BlockSize = 128;
-                aes.Mode = CipherMode.CBC;
-                aes.Padding = PaddingMode.None;
-                aes.Key = ecc.DeriveKeyMaterial(publicKey);
-                aes.IV = new byte[16];
+            if (extendChecksum) checksum = Crc32c.Update(checksum, bytes, offset, length);
+            using (AesCng aes = createAes(deriveKey(decryptionKey, sourceKey), iv))
+            using (var decryptor = aes.CreateDecryptor()) {
+                return decryptor.TransformFinalBlock(bytes, offset, length);
+            }
+        }
 
-                using (var decryptor = aes.CreateDecryptor()) return decryptor.TransformFinalBlock(bytes, offset, length);
+        private static byte[] deriveKey(PrivateKey decryptionKey, byte[] sourceKey) {
+            using (ECDiffieHellmanCng destination = new ECDiffieHellmanCng(decryptionKey.Key))
+            using (CngKey source = CngKey.Import(sourceKey, CngKeyBlobFormat.EccPublicBlob)) {
+                return destination.DeriveKeyMaterial(source);
             }
         }
 
+        private static AesCng createAes(byte[] key, byte[] iv) {
+            AesCng aes = new AesCng();
+
+            aes.KeySize = 256;
+            aes.BlockSize = 128;
+            aes.Mode = CipherMode.CBC;
+            aes.Padding = PaddingMode.None;
+            aes.Key = key;
+            aes.IV = iv;
+
+            return aes;
+        }
+
+        #endregion
 
         // Private
         #region Fields
@@ -144,6 +361,16 @@ namespace SRFS.Model.Clusters {
 
         private DataBlock _data;
 
+        protected const int IVLength = ClusterCrypto.BlockLength;
+
+        // Derived keys are small, so the cache holds many; a process writes with one per encryption key and reads with one per
+        // process that wrote
+        private const int CryptoCacheCapacity = 1024;
+
+        private static readonly ClusterCrypto _crypto = new ClusterCrypto(CryptoCacheCapacity);
+        private static readonly Dictionary<KeyThumbprint, SessionKey> _sessionKeys = new Dictionary<KeyThumbprint, SessionKey>();
+        private static readonly RandomNumberGenerator _random = RandomNumberGenerator.Create();
+
         #endregion
     }
 }
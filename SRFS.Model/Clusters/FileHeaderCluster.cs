@@ -60,6 +60,17 @@ namespace SRFS.Model.Clusters {
             }
         }
 
+        #endregion
+
+        // Protected
+        #region Properties
+
+        protected override PublicKey EncryptionKey => _encryptionKey;
+
+        protected override int SourceKeyPosition => FileBaseCluster_HeaderLength + PublicKeyOffset;
+
+        protected override int EncryptedDataPosition => FileBaseCluster_HeaderLength + DataOffset;
+
         #endregion
         #region Methods 
 
@@ -69,15 +80,9 @@ namespace SRFS.Model.Clusters {
             writer.Write(_parentID);
             writer.WriteSrfsString(_name);
             writer.Write(_encryptionKey.Thumbprint);
-
-            using (ECDiffieHellmanCng source = new ECDiffieHellmanCng()) {
-                writer.Write(source.PublicKey);
-                writer.Write(_padding);
-                writer.Write(Encrypt(source, _encryptionKey.Key, _plainTextData, 0, _plainTextData.Length));
-            }
+            WriteEncrypted(writer, PaddingLength);
         }
 
-
         protected override void Read(BinaryReader reader) {
             base.Read(reader);
 
@@ -87,13 +92,7 @@ namespace SRFS.Model.Clusters {
             KeyThumbprint encryptionKeyThumbprint = reader.ReadKeyThumbprint();
             if (!encryptionKeyThumbprint.Equals(_decryptionKey.Thumbprint)) throw new System.IO.IOException();
 
-            CngKey publicSourceKey = reader.ReadPublicKey().Key;
-            reader.ReadBytes(PaddingLength);
-            byte[] encryptedData = reader.ReadBytes(_plainTextData.Length);
-
-            using (ECDiffieHellmanCng destinationKey = new ECDiffieHellmanCng(_decryptionKey.Key)) {
-                _plainTextData = Decrypt(destinationKey, publicSourceKey, encryptedData, 0, encryptedData.Length);
-            }
+            _plainTextData = ReadEncrypted(reader, _decryptionKey, PaddingLength);
         }
 
 
@@ -108,6 +107,7 @@ namespace SRFS.Model.Clusters {
             MaximumNameLength * sizeof(char) +
             KeyThumbprint.Length +
             PublicKey.Length +
+            IVLength +
             PaddingLength;
 
         private const int ParentIDOffset = 0;
@@ -125,9 +125,10 @@ namespace SRFS.Model.Clusters {
         private const int PublicKeyOffset = KeyThumbprintOffset + KeyThumbprintLength;
         private const int PublicKeyLength = PublicKey.Length;
 
-        private const int PaddingOffset = PublicKeyOffset + PublicKeyLength;
+        private const int IVOffset = PublicKeyOffset + PublicKeyLength;
+
+        private const int PaddingOffset = IVOffset + IVLength;
         private const int PaddingLength = (16 - ((FileBaseCluster_HeaderLength + PaddingOffset) % 16)) % 16;
-        private static readonly byte[] _padding = new byte[PaddingLength];
 
         private const int DataOffset = PaddingOffset + PaddingLength;
 
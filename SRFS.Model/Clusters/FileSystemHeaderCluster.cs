@@ -11,14 +11,15 @@ namespace SRFS.Model.Clusters {
     /// 
     /// The header layout is:
     /// 
-    /// [Cluster Header (219 bytes)]
+    /// [Cluster Header (223 bytes)]
     /// Bytes Per Data Cluster (4 bytes)
     /// Clusters Per Track (4 bytes)
     /// Data Clusters Per Track (4 bytes)
     /// Total Tracks (4 bytes)
+    /// Local Group Count (4 bytes)
     /// Volume Name (511 bytes)
     /// 
-    /// Total Length: 746 bytes.
+    /// Total Length: 754 bytes.
     /// </summary>
     public sealed class FileSystemHeaderCluster : Cluster {
 
@@ -31,6 +32,7 @@ namespace SRFS.Model.Clusters {
             ClustersPerTrack = 0;
             DataClustersPerTrack = 0;
             TrackCount = 0;
+            LocalGroupCount = 0;
             VolumeName = string.Empty;
             _deviceBlockSize = deviceBlockSize;
         }
@@ -114,6 +116,23 @@ namespace SRFS.Model.Clusters {
             }
         }
 
+        /// <summary>
+        /// The number of locally repairable groups the data clusters of a track are split into, each with an XOR parity cluster
+        /// taken from the end of the track's parity clusters.  Zero if every parity cluster holds Reed-Solomon parity.
+        /// </summary>
+        public int LocalGroupCount {
+            get {
+                return _localGroupCount;
+            }
+            set {
+                if (value < 0) throw new ArgumentOutOfRangeException($"{nameof(LocalGroupCount)} must not be negative.");
+
+                if (_localGroupCount == value) return;
+                _localGroupCount = value;
+                NotifyPropertyChanged();
+            }
+        }
+
         public string VolumeName {
             get {
                 return _volumeName;
@@ -136,6 +155,7 @@ namespace SRFS.Model.Clusters {
             writer.Write(_clustersPerTrack);
             writer.Write(_dataClustersPerTrack);
             writer.Write(_totalTracks);
+            writer.Write(_localGroupCount);
 
             writer.WriteSrfsString(_volumeName);
         }
@@ -147,6 +167,7 @@ namespace SRFS.Model.Clusters {
             _clustersPerTrack = reader.ReadInt32();
             _dataClustersPerTrack = reader.ReadInt32();
             _totalTracks = reader.ReadInt32();
+            _localGroupCount = reader.ReadInt32();
 
             _volumeName = reader.ReadSrfsString();
         }
@@ -161,6 +182,7 @@ namespace SRFS.Model.Clusters {
             sizeof(int) +
             sizeof(int) +
             sizeof(int) +
+            sizeof(int) +
             sizeof(byte) +
             Constants.MaximumNameLength * sizeof(char);
 
@@ -168,6 +190,7 @@ namespace SRFS.Model.Clusters {
         private int _clustersPerTrack;
         private int _dataClustersPerTrack;
         private int _totalTracks;
+        private int _localGroupCount;
         private string _volumeName;
         private int _deviceBlockSize;
 
@@ -0,0 +1,36 @@
+﻿using System;
+using System.IO;
+
+namespace SRFS.Model.Clusters {
+
+    /// <summary>
+    /// A cluster of the cluster hash table, which holds the SHA256 of every data cluster as it was last written, the leaves of
+    /// the <see cref="TrackHashTree"/> of each track.  A hash never written reads as zero bytes.
+    /// </summary>
+    public sealed class HashArrayCluster : ArrayCluster<byte[]> {
+
+        // Public
+        #region Constructors
+
+        public HashArrayCluster(int address, int clusterSizeBytes, Guid volumeID)
+            : base(address, clusterSizeBytes, volumeID, ClusterType.ClusterHashTable, Constants.HashLength) { }
+
+        #endregion
+
+        public static int CalculateElementsPerCluster(int clusterSizeBytes) {
+            if (!_elementsPerCluster.HasValue) _elementsPerCluster = CalculateElementCount(Constants.HashLength, clusterSizeBytes);
+            return _elementsPerCluster.Value;
+        }
+
+        // Protected
+        #region Methods
+
+        protected override void WriteElement(BinaryWriter writer, byte[] value) => writer.Write(value ?? new byte[Constants.HashLength]);
+
+        protected override byte[] ReadElement(BinaryReader reader) => reader.ReadBytes(Constants.HashLength);
+
+        #endregion
+
+        private static int? _elementsPerCluster;
+    }
+}
@@ -15,6 +15,7 @@ namespace SRFS.Model.Clusters {
             : base(CalculateClusterSize(blockSize, bytesPerDataCluster), volumeID, ClusterType.Parity) {
             _trackNumber = trackNumber;
             _parityNumber = parityNumber;
+            _trackHashRoot = new byte[Constants.HashLength];
 
             _dataOffset = ClusterSizeBytes - bytesPerDataCluster;
             _paddingLength = _dataOffset - PaddingOffset;
@@ -34,6 +35,7 @@ namespace SRFS.Model.Clusters {
 
             writer.Write(_trackNumber);
             writer.Write(_parityNumber);
+            writer.Write(_trackHashRoot);
             writer.Write(new byte[_paddingLength]);
             writer.Write(_data);
         }
@@ -43,6 +45,7 @@ namespace SRFS.Model.Clusters {
 
             _trackNumber = reader.ReadInt32();
             _parityNumber = reader.ReadInt32();
+            _trackHashRoot = reader.ReadBytes(Constants.HashLength);
             reader.ReadBytes(_paddingLength);
             _data = reader.ReadBytes(_data.Length);
         }
@@ -58,6 +61,22 @@ namespace SRFS.Model.Clusters {
 
         public byte[] Data => _data;
 
+        /// <summary>
+        /// The root of the <see cref="TrackHashTree"/> of the track when its parity was written.  It is signed with the parity, so
+        /// a matching tree vouches for the hashes of every cluster that has not been modified since.
+        /// </summary>
+        public byte[] TrackHashRoot {
+            get {
+                return _trackHashRoot;
+            }
+            set {
+                if (value == null) throw new ArgumentNullException();
+                if (value.Length != Constants.HashLength) throw new ArgumentException();
+                _trackHashRoot = value;
+                NotifyPropertyChanged();
+            }
+        }
+
         #endregion
 
         // Private
@@ -69,7 +88,10 @@ namespace SRFS.Model.Clusters {
         private static readonly int ParityNumberOffset = TrackNumberOffset + TrackNumberLength;
         private static readonly int ParityNumberLength = sizeof(int);
 
-        private static readonly int PaddingOffset = ParityNumberOffset + ParityNumberLength;
+        private static readonly int TrackHashRootOffset = ParityNumberOffset + ParityNumberLength;
+        private static readonly int TrackHashRootLength = Constants.HashLength;
+
+        private static readonly int PaddingOffset = TrackHashRootOffset + TrackHashRootLength;
 
         private int _paddingLength;
 
@@ -78,6 +100,7 @@ namespace SRFS.Model.Clusters {
         private byte[] _data;
         private int _trackNumber;
         private int _parityNumber;
+        private byte[] _trackHashRoot;
 
         #endregion
     }
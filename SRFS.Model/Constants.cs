@@ -15,7 +15,7 @@ namespace SRFS.Model {
         /// A 2 byte sequence representing the version number of the code which wrote the sector. In order it is Major then Minor. The current version is "1.0".  This is always
         /// the fifth and sixth bytes of the header regardless of version.  The remaining fields may vary with different versions, however.
         /// </summary>
-        public static byte[] CurrentVersion { get; } = new byte[] { 3, 0 };
+        public static byte[] CurrentVersion { get; } = new byte[] { 3, 4 };
         public const int CurrentVersionLength = 2;
 
         public const int NoID = -1;
@@ -28,6 +28,8 @@ namespace SRFS.Model {
 
         public const int HashLength = 256 / 8;
 
+        public const int ChecksumLength = sizeof(uint);
+
         public const int SecurityIdentifierLength = 68;
 
         public const int MaximumNameLength = 255;
@@ -1,6 +1,7 @@
 ﻿using SRFS.IO;
 using SRFS.Model.Clusters;
 using SRFS.Model.Data;
+using SRFS.ReedSolomon;
 using System;
 using System.Collections.Generic;
 using System.Collections.ObjectModel;
@@ -41,6 +42,11 @@ namespace SRFS.Model {
             _clusterIO = new FileSystemClusterIO(this, _deviceIO);
             _disposeDeviceIO = true;
 
+            _clusterCache = new ClusterCache(ClusterCacheBytes);
+            _clusterIO.Cache = _clusterCache;
+            _writeBackBuffer = new WriteBackBuffer(WriteBackBytes);
+            _clusterIO.WriteBack = _writeBackBuffer;
+
             // Initialize Indices
             _freeClusterSearchStart = 0;
             _nextEntryID = 0;
@@ -68,10 +74,14 @@ namespace SRFS.Model {
                 fileSystemHeaderCluster.BytesPerDataCluster,
                 fileSystemHeaderCluster.ClustersPerTrack,
                 fileSystemHeaderCluster.DataClustersPerTrack,
-                fileSystemHeaderCluster.TrackCount);
+                fileSystemHeaderCluster.TrackCount,
+                fileSystemHeaderCluster.LocalGroupCount);
             _volumeName = fileSystemHeaderCluster.VolumeName;
             _volumeID = fileSystemHeaderCluster.VolumeID;
 
+            // Load or measure the fastest parity encoder for the geometry
+            tuneParity();
+
             // Initialize the Cluster State Table
             int entryCount = _geometry.ClustersPerTrack * _geometry.TrackCount;
             int clusterCount = (entryCount + ClusterStatesCluster.CalculateElementsPerCluster(_geometry.BytesPerCluster) - 1) / 
@@ -83,6 +93,9 @@ namespace SRFS.Model {
                 (address) => new ClusterStatesCluster(address, _geometry.BytesPerCluster, _volumeID));
             _clusterStateTable.Load(_clusterIO);
 
+            // Initialize the Track State Index
+            _trackStateIndex = createTrackStateIndex();
+
             // Initialize the Next Cluster Address Table
             entryCount = _geometry.DataClustersPerTrack * _geometry.TrackCount;
             clusterCount = (entryCount + Int32ArrayCluster.CalculateElementsPerCluster(_geometry.BytesPerCluster) - 1) / 
@@ -112,12 +125,24 @@ namespace SRFS.Model {
                  (address) => new VerifyTimesCluster(address, _geometry.BytesPerCluster, _volumeID));
             _verifyTimeTable.Load(_clusterIO);
 
-            int l = _verifyTimeTable.ClusterAddresses.Last() + 1;
+            entryCount = _geometry.DataClustersPerTrack * _geometry.TrackCount;
+            clusterCount = (entryCount + HashArrayCluster.CalculateElementsPerCluster(_geometry.BytesPerCluster) - 1) /
+                HashArrayCluster.CalculateElementsPerCluster(_geometry.BytesPerCluster);
+
+            // Initialize the Cluster Hash Table
+            _clusterHashTable = new ClusterTable<byte[]>(
+                Enumerable.Range(_verifyTimeTable.ClusterAddresses.Last() + 1, clusterCount),
+                Constants.HashLength,
+                (address) => new HashArrayCluster(address, _geometry.BytesPerCluster, _volumeID));
+            _clusterHashTable.Load(_clusterIO);
+            _trackHashTrees = new TrackHashTree[_geometry.TrackCount];
+
+            int l = _clusterHashTable.ClusterAddresses.Last() + 1;
             int[] cl = getClusterChain(l).ToArray();
 
             // Initialize the Directory Table
             _directoryTable = new MutableObjectClusterTable<Directory>(
-                getClusterChain(_verifyTimeTable.ClusterAddresses.Last() + 1),
+                getClusterChain(_clusterHashTable.ClusterAddresses.Last() + 1),
                 Directory.StorageLength,
                 (address) => Directory.CreateArrayCluster(address));
             _directoryTable.Load(_clusterIO);
@@ -191,6 +216,9 @@ namespace SRFS.Model {
                     Flush();
                     if (_disposeDeviceIO) _deviceIO.Dispose();
                 }
+                _trackStateIndex?.Dispose();
+                _clusterCache?.Dispose();
+                _writeBackBuffer?.Dispose();
                 _isDisposed = true;
             }
         }
@@ -214,6 +242,12 @@ namespace SRFS.Model {
 
         public IClusterIO ClusterIO => _clusterIO;
 
+        /// <summary>
+        /// The encoder configuration tuned for the geometry at mount.  Parity objects pick up its run length themselves; the
+        /// thread count is how many tracks are encoded at once.
+        /// </summary>
+        public ParityTuning ParityTuning => _parityTuning;
+
         public bool ReadOnly => _readOnly;
 
         #endregion
@@ -226,7 +260,45 @@ namespace SRFS.Model {
         public void SetClusterState(int absoluteClusterNumber, ClusterState value) {
             if (_readOnly) throw new NotSupportedException();
 
-            lock (_lock) _clusterStateTable[absoluteClusterNumber] = value;
+            lock (_lock) {
+                _trackStateIndex.Update(absoluteClusterNumber, (byte)_clusterStateTable[absoluteClusterNumber], (byte)value);
+                _clusterStateTable[absoluteClusterNumber] = value;
+            }
+        }
+
+        /// <summary>
+        /// The track a cluster belongs to, or -1 if it belongs to none.
+        /// </summary>
+        public int GetTrackNumber(int absoluteClusterNumber) => _clusterTracks[absoluteClusterNumber];
+
+        public bool IsTrackUsed(int trackNumber) {
+            lock (_lock) return _trackStateIndex.IsUsed(trackNumber);
+        }
+
+        public bool IsTrackDataModified(int trackNumber) {
+            lock (_lock) return _trackStateIndex.IsDataModified(trackNumber);
+        }
+
+        public bool IsTrackParityWritten(int trackNumber) {
+            lock (_lock) return _trackStateIndex.IsParityWritten(trackNumber);
+        }
+
+        public bool IsTrackUpToDate(int trackNumber) {
+            lock (_lock) return _trackStateIndex.IsUpToDate(trackNumber);
+        }
+
+        /// <summary>
+        /// The numbers of the tracks that have data clusters in use.
+        /// </summary>
+        public int[] GetUsedTracks() {
+            lock (_lock) return _trackStateIndex.GetUsedTracks();
+        }
+
+        /// <summary>
+        /// The numbers of the used tracks whose parity is not up to date.
+        /// </summary>
+        public int[] GetStaleTracks() {
+            lock (_lock) return _trackStateIndex.GetStaleTracks();
         }
 
         public int GetBytesUsed(int absoluteClusterNumber) {
@@ -259,6 +331,42 @@ namespace SRFS.Model {
             lock (_lock) _verifyTimeTable[absoluteClusterNumber] = value;
         }
 
+        /// <summary>
+        /// The hash of a data cluster as it was last written, or zero bytes if it has not been written since the table was made.
+        /// </summary>
+        public byte[] GetClusterHash(int absoluteClusterNumber) {
+            lock (_lock) return (byte[])_clusterHashTable[absoluteClusterNumber].Clone();
+        }
+
+        /// <summary>
+        /// Records the hash of a data cluster that was written, and updates the hash tree of its track if one is loaded.
+        /// </summary>
+        public void SetClusterHash(int absoluteClusterNumber, byte[] value) {
+            if (_readOnly) throw new NotSupportedException();
+
+            lock (_lock) {
+                _clusterHashTable[absoluteClusterNumber] = (byte[])value.Clone();
+                _trackHashTrees[_clusterTracks[absoluteClusterNumber]]?.SetLeaf(_clusterLeaves[absoluteClusterNumber], value);
+            }
+        }
+
+        /// <summary>
+        /// The hash tree of a track, whose leaves are the cluster hashes of its data clusters in track order.  It is built from the
+        /// cluster hash table the first time it is asked for, and kept up to date as clusters are written.
+        /// </summary>
+        public TrackHashTree GetTrackHashTree(int trackNumber) {
+            lock (_lock) {
+                TrackHashTree tree = _trackHashTrees[trackNumber];
+                if (tree != null) return tree;
+
+                Track track = new Track(this, trackNumber);
+                tree = new TrackHashTree(_geometry.DataClustersPerTrack);
+                foreach (var i in track.DataClusters) tree.SetLeaf(_clusterLeaves[i], _clusterHashTable[i]);
+                _trackHashTrees[trackNumber] = tree;
+                return tree;
+            }
+        }
+
         public int AllocateCluster() {
             if (_readOnly) throw new NotSupportedException();
 
@@ -266,7 +374,9 @@ namespace SRFS.Model {
                 for (int i = _freeClusterSearchStart; i < _geometry.DataClustersPerTrack * _geometry.TrackCount; i++) {
                     if (!_clusterStateTable[i].IsUsed()) {
                         _freeClusterSearchStart = i + 1;
-                        SetClusterState(i, ClusterState.Used | (_clusterStateTable[i].IsModified() ? ClusterState.Modified : 0));
+                        // An unwritten cluster does not hold the zeros the parity assumes, so it is modified once it is used
+                        ClusterState state = _clusterStateTable[i];
+                        SetClusterState(i, ClusterState.Used | (state.IsModified() || state.IsUnwritten() ? ClusterState.Modified : 0));
                         SetNextClusterAddress(i, Constants.NoAddress);
                         SetBytesUsed(i, 0);
                         return i;
@@ -323,8 +433,12 @@ namespace SRFS.Model {
             return dir;
         }
 
-        public void Flush() {
-            if (_readOnly) return;
+        /// <summary>
+        /// Writes the modified tables, then seals and writes every saved cluster, track by track.  Returns the tracks whose data
+        /// changed since the previous flush, so their parity can be refreshed once per flush.
+        /// </summary>
+        public int[] Flush() {
+            if (_readOnly) return new int[0];
 
             // These must be flushed first, since they can modify the nextCluster and bytesUsed tables below.
             _directoryTable.Flush(_clusterIO);
@@ -336,6 +450,12 @@ namespace SRFS.Model {
             _nextClusterAddressTable.Flush(_clusterIO);
             _bytesUsedTable.Flush(_clusterIO);
             _verifyTimeTable.Flush(_clusterIO);
+
+            // Writing the data clusters sets their hashes, so the hash table is written after them
+            int[] tracks = _clusterIO.FlushWriteBack();
+            _clusterHashTable.Flush(_clusterIO);
+            _clusterIO.FlushWriteBack();
+            return tracks;
         }
 
         public IDictionary<string, Directory> GetContainedDirectories(Directory dir) {
@@ -541,6 +661,7 @@ namespace SRFS.Model {
             fileSystemHeaderCluster.ClustersPerTrack = geometry.ClustersPerTrack;
             fileSystemHeaderCluster.DataClustersPerTrack = geometry.DataClustersPerTrack;
             fileSystemHeaderCluster.TrackCount = geometry.TrackCount;
+            fileSystemHeaderCluster.LocalGroupCount = geometry.LocalGroupCount;
             fileSystemHeaderCluster.VolumeName = volumeName;
             byte[] data = new byte[fileSystemHeaderCluster.ClusterSizeBytes];
             fileSystemHeaderCluster.Save(data, 0, signatureKey);
@@ -580,9 +701,19 @@ namespace SRFS.Model {
                 sizeof(long),
                  (address) => new VerifyTimesCluster(address, geometry.BytesPerCluster, volumeID));
 
+            entryCount = geometry.DataClustersPerTrack * geometry.TrackCount;
+            clusterCount = (entryCount + HashArrayCluster.CalculateElementsPerCluster(geometry.BytesPerCluster) - 1) /
+                HashArrayCluster.CalculateElementsPerCluster(geometry.BytesPerCluster);
+
+            // Cluster Hash Table
+            ClusterTable<byte[]> clusterHashTable = new ClusterTable<byte[]>(
+                Enumerable.Range(verifyTimeTable.ClusterAddresses.Last() + 1, clusterCount),
+                Constants.HashLength,
+                (address) => new HashArrayCluster(address, geometry.BytesPerCluster, volumeID));
+
             // Directory Table
             MutableObjectClusterTable<Directory> directoryTable = new MutableObjectClusterTable<Directory>(
-                new int[] { verifyTimeTable.ClusterAddresses.Last() + 1 },
+                new int[] { clusterHashTable.ClusterAddresses.Last() + 1 },
                 Directory.StorageLength,
                 (address) => Directory.CreateArrayCluster(address));
 
@@ -619,6 +750,7 @@ namespace SRFS.Model {
             for (int i = 0; i < nextClusterAddressTable.Count; i++) nextClusterAddressTable[i] = Constants.NoAddress;
             for (int i = 0; i < bytesUsedTable.Count; i++) bytesUsedTable[i] = 0;
             for (int i = 0; i < verifyTimeTable.Count; i++) verifyTimeTable[i] = DateTime.MinValue;
+            for (int i = 0; i < clusterHashTable.Count; i++) clusterHashTable[i] = new byte[Constants.HashLength];
             for (int i = 0; i < directoryTable.Count; i++) directoryTable[i] = null;
             for (int i = 0; i < fileTable.Count; i++) fileTable[i] = null;
             for (int i = 0; i < accessRules.Count; i++) accessRules[i] = null;
@@ -630,6 +762,7 @@ namespace SRFS.Model {
                 nextClusterAddressTable.ClusterAddresses,
                 bytesUsedTable.ClusterAddresses,
                 verifyTimeTable.ClusterAddresses,
+                clusterHashTable.ClusterAddresses,
                 directoryTable.ClusterAddresses,
                 fileTable.ClusterAddresses,
                 accessRules.ClusterAddresses,
@@ -658,6 +791,7 @@ namespace SRFS.Model {
             nextClusterAddressTable.Flush(clusterIO);
             bytesUsedTable.Flush(clusterIO);
             verifyTimeTable.Flush(clusterIO);
+            clusterHashTable.Flush(clusterIO);
             directoryTable.Flush(clusterIO);
             fileTable.Flush(clusterIO);
             accessRules.Flush(clusterIO);
@@ -707,12 +841,48 @@ namespace SRFS.Model {
 
         private int getNextFreeAuditRuleIndex() => getNextFreeIndex(ref _nextAuditRuleIndex, _auditRules);
 
+        private static string ParityProfilePath =>
+            Path.Combine(Environment.GetFolderPath(Environment.SpecialFolder.LocalApplicationData), "SRFS", "parity.profile");
+
+        private void tuneParity() {
+            ParityTuner.LoadProfile(ParityProfilePath);
+            if (ParityTuner.Tune(_geometry.DataClustersPerTrack, _geometry.GlobalParityClustersPerTrack, _geometry.BytesPerCluster / 2,
+                out _parityTuning)) {
+                System.IO.Directory.CreateDirectory(Path.GetDirectoryName(ParityProfilePath));
+                ParityTuner.SaveProfile(ParityProfilePath);
+            }
+        }
+
+        private TrackStateIndex createTrackStateIndex() {
+            int[] clusterTracks = new int[_clusterStateTable.Count];
+            int[] clusterLeaves = new int[_clusterStateTable.Count];
+            for (int i = 0; i < clusterTracks.Length; i++) clusterTracks[i] = -1;
+            for (int t = 0; t < _geometry.TrackCount; t++) {
+                Track track = new Track(this, t);
+                int leaf = 0;
+                foreach (var i in track.DataClusters) {
+                    clusterTracks[i] = t;
+                    clusterLeaves[i] = leaf++;
+                }
+                foreach (var i in track.ParityClusters) clusterTracks[i] = t;
+            }
+            _clusterTracks = clusterTracks;
+            _clusterLeaves = clusterLeaves;
+
+            byte[] states = new byte[_clusterStateTable.Count];
+            for (int i = 0; i < states.Length; i++) states[i] = (byte)_clusterStateTable[i];
+
+            TrackStateIndex index = new TrackStateIndex(_geometry.TrackCount, _geometry.DataClustersPerTrack * _geometry.TrackCount, clusterTracks);
+            index.Load(states);
+            return index;
+        }
+
         private int getNextFreeIndex<T>(ref int nextIndex, IClusterTable<T> table) {
             int i = nextIndex;
             while (true) {
                 if (i >= table.Count) {
                     int newClusterNumber = AllocateCluster();
-                    _clusterStateTable[newClusterNumber] |= ClusterState.System;
+                    SetClusterState(newClusterNumber, _clusterStateTable[newClusterNumber] | ClusterState.System);
                     table.AddCluster(newClusterNumber);
                 }
                 if (table[i] == null) {
@@ -732,6 +902,8 @@ namespace SRFS.Model {
 
         // Geometry
         private Geometry _geometry;
+        // The encoder configuration measured for the geometry on this machine
+        private ParityTuning _parityTuning;
 
         // Metadata
         private Guid _volumeID;
@@ -749,9 +921,13 @@ namespace SRFS.Model {
         private int _nextAuditRuleIndex;
 
         private ClusterTable<ClusterState> _clusterStateTable;
+        private TrackStateIndex _trackStateIndex;
         private ClusterTable<int> _nextClusterAddressTable;
         private ClusterTable<int> _bytesUsedTable;
         private ClusterTable<DateTime> _verifyTimeTable;
+        private ClusterTable<byte[]> _clusterHashTable;
+        // Loaded as they are asked for, by track
+        private TrackHashTree[] _trackHashTrees;
 
         private MutableObjectClusterTable<Directory> _directoryTable;
         private Dictionary<int, int> _directoryIndex;
@@ -772,6 +948,18 @@ namespace SRFS.Model {
         private IBlockIO _deviceIO;
         private FileSystemClusterIO _clusterIO;
 
+        // The budget for decrypted cluster images, so that repeated reads of hot files skip the device and the crypto
+        private const int ClusterCacheBytes = 64 * 1024 * 1024;
+        private ClusterCache _clusterCache;
+
+        // The budget for saved data clusters waiting to be sealed, past which they are flushed without waiting for Flush
+        private const int WriteBackBytes = 32 * 1024 * 1024;
+        private WriteBackBuffer _writeBackBuffer;
+
+        private int[] _clusterTracks;
+        // The index of each data cluster within its track, which is its leaf in the track hash tree
+        private int[] _clusterLeaves;
+
         private object _lock = new object();
 
         private bool _isDisposed = false;
@@ -37,6 +37,32 @@ namespace SRFS.Model {
             }
         }
 
+        protected override int GetTrackNumber(Cluster c) => c is DataCluster d ? _fileSystem.GetTrackNumber(d.Address) : -1;
+
+        // System clusters are outside the parity, and the hash table is one of them, so only the other data clusters are leaves
+        protected override void OnWritten(Cluster c, byte[] bytes, int offset) {
+            if (c is DataCluster d && !_fileSystem.GetClusterState(d.Address).IsSystem()) {
+                _fileSystem.SetClusterHash(d.Address, Cluster.ReadHash(bytes, offset));
+            }
+        }
+
+        protected override void OnSnapshotBegun(ClusterSnapshot snapshot) {
+            foreach (var i in new Track(_fileSystem, snapshot.TrackNumber).DataClusters) {
+                snapshot.SetState(i, _fileSystem.GetClusterState(i));
+            }
+            snapshot.TrackHashRoot = _fileSystem.GetTrackHashTree(snapshot.TrackNumber).Root;
+        }
+
+        // A cluster that was saved, or whose state changed, since the snapshot began is not what the parity was written from, so it
+        // stays modified
+        protected override void OnSnapshotEnded(ClusterSnapshot snapshot) {
+            foreach (var i in new Track(_fileSystem, snapshot.TrackNumber).DataClusters) {
+                ClusterState state = _fileSystem.GetClusterState(i);
+                if (snapshot.IsChanged(i) || (state & ~ClusterState.Modified) != (snapshot.GetState(i) & ~ClusterState.Modified)) continue;
+                _fileSystem.SetClusterState(i, state & ~ClusterState.Modified);
+            }
+        }
+
         private FileSystem _fileSystem;
     }
 }
@@ -15,21 +15,31 @@ namespace SRFS.Model {
                 return _bytesPerCluster == g._bytesPerCluster &&
                     _clustersPerTrack == g._clustersPerTrack &&
                     _dataClustersPerTrack == g._dataClustersPerTrack &&
-                    _trackCount == g._trackCount;
+                    _trackCount == g._trackCount &&
+                    _localGroupCount == g._localGroupCount;
             } else {
                 return false;
             }
         }
 
         public override int GetHashCode() {
-            return _bytesPerCluster + _clustersPerTrack + _dataClustersPerTrack + _trackCount;
+            return _bytesPerCluster + _clustersPerTrack + _dataClustersPerTrack + _trackCount + _localGroupCount;
         }
 
-        public Geometry(int bytesPerCluster, int clustersPerTrack, int dataClustersPerTrack, int trackCount) {
+        /// <summary>
+        /// Create a geometry.  If localGroupCount is nonzero, the data clusters of each track are split into that many groups, and
+        /// the last localGroupCount parity clusters of the track hold XOR parity for one group each (a locally repairable code).
+        /// The remaining parity clusters hold the global Reed-Solomon parity.
+        /// </summary>
+        public Geometry(int bytesPerCluster, int clustersPerTrack, int dataClustersPerTrack, int trackCount, int localGroupCount = 0) {
+            if (localGroupCount < 0 || localGroupCount > dataClustersPerTrack || localGroupCount >= clustersPerTrack - dataClustersPerTrack)
+                throw new ArgumentOutOfRangeException(nameof(localGroupCount));
+
             _bytesPerCluster = bytesPerCluster;
             _clustersPerTrack = clustersPerTrack;
             _dataClustersPerTrack = dataClustersPerTrack;
             _trackCount = trackCount;
+            _localGroupCount = localGroupCount;
         }
 
         public long CalculateFileSystemSize(int bytesPerBlock) {
@@ -54,9 +64,14 @@ namespace SRFS.Model {
 
         public int TrackCount => _trackCount;
 
+        public int LocalGroupCount => _localGroupCount;
+
+        public int GlobalParityClustersPerTrack => ParityClustersPerTrack - _localGroupCount;
+
         private readonly int _bytesPerCluster;
         private readonly int _clustersPerTrack;
         private readonly int _dataClustersPerTrack;
         private readonly int _trackCount;
+        private readonly int _localGroupCount;
     }
 }
@@ -4,12 +4,19 @@
 
         None = 0x00,
         DoNotVerifyClusterHashes = 0x01,
-        DoNotVerifyClusterSignatures = 0x02
+        DoNotVerifyClusterSignatures = 0x02,
+
+        /// <summary>
+        /// Check the CRC-32C of each cluster instead of its hash and signature, which are checked only if the CRC does not match.
+        /// For routine scrubs; a periodic deep scrub leaves this off.
+        /// </summary>
+        VerifyClusterChecksumsOnly = 0x04
     }
 
     public static class OptionsExtensions {
 
         public static bool VerifyClusterHashes(this Options o) => (o & Options.DoNotVerifyClusterHashes) == 0;
         public static bool VerifyClusterSignatures(this Options o) => (o & Options.DoNotVerifyClusterSignatures) == 0;
+        public static bool VerifyClusterChecksumsOnly(this Options o) => (o & Options.VerifyClusterChecksumsOnly) != 0;
     }
 }
@@ -1,8 +1,10 @@
 ﻿using SRFS.IO;
 using SRFS.Model.Clusters;
 using SRFS.Model.Data;
+using SRFS.ReedSolomon;
 using System;
 using System.Collections.Generic;
+using System.IO;
 
 namespace SRFS.Model {
 
@@ -23,11 +25,133 @@ namespace SRFS.Model {
             _options = options;
         }
 
+        /// <summary>
+        /// A cache of verified, decrypted cluster images keyed by device address, or null to read every cluster from the device.
+        /// Loads that hit the cache skip the device, the verification and the decryption, and do not take the device lock.
+        /// </summary>
+        public ClusterCache Cache { get; set; }
+
+        /// <summary>
+        /// A buffer that holds saved data clusters until <see cref="FlushWriteBack"/>, so a cluster saved several times is sealed
+        /// and written once, or null to write every cluster as it is saved.
+        /// </summary>
+        public WriteBackBuffer WriteBack { get; set; }
+
         public virtual void Load(Cluster c) {
+            long address = getAddress(c);
+
+            ClusterCache cache = Cache;
+            if (cache != null && cache.TryGet(address, out ClusterCacheHandle handle)) {
+                using (handle)
+                using (var stream = handle.OpenStream()) {
+                    c.ReadCacheImage(stream);
+                }
+                return;
+            }
+
             lock (_lock) {
-                long address = getAddress(c);
+                // A cluster waiting in the write-back buffer is newer than the one on the device
+                WriteBackBuffer writeBack = WriteBack;
+                if (writeBack != null && writeBack.TryRead(address, _buffer, 0, c.ClusterSizeBytes)) {
+                    using (var stream = new MemoryStream(_buffer, 0, c.ClusterSizeBytes)) c.ReadCacheImage(stream);
+                    return;
+                }
+
                 _io.Read(address, _buffer, 0, c.ClusterSizeBytes);
                 c.Load(_buffer, 0, _signatureKeys, _options);
+
+                if (cache != null) {
+                    c.WriteCacheImage(_buffer, 0);
+                    cache.Put(address, _buffer, 0, c.ClusterSizeBytes);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Loads several clusters as Load does, but verifies their signatures together, across all cores and with the tables for
+        /// each signing key built once for this mount.  Returns the clusters whose signatures are not valid; they are loaded but
+        /// must not be trusted.  Clusters found in the cache or the write-back buffer were verified before and are not again.
+        /// </summary>
+        public virtual IList<Cluster> LoadMany(IList<Cluster> clusters) {
+            var verified = new List<Cluster>(clusters.Count);
+            var invalid = new List<Cluster>();
+            ClusterCache cache = Cache;
+
+            lock (_lock) {
+                if (_signatureVerifier == null) _signatureVerifier = new ClusterSignatureVerifier(_signatureKeys);
+                SignatureBatch batch = _signatureVerifier.CreateBatch();
+
+                foreach (Cluster c in clusters) {
+                    long address = getAddress(c);
+                    if (cache != null && cache.TryGet(address, out ClusterCacheHandle handle)) {
+                        using (handle)
+                        using (var stream = handle.OpenStream()) {
+                            c.ReadCacheImage(stream);
+                        }
+                        continue;
+                    }
+
+                    WriteBackBuffer writeBack = WriteBack;
+                    if (writeBack != null && writeBack.TryRead(address, _buffer, 0, c.ClusterSizeBytes)) {
+                        using (var stream = new MemoryStream(_buffer, 0, c.ClusterSizeBytes)) c.ReadCacheImage(stream);
+                        continue;
+                    }
+
+                    _io.Read(address, _buffer, 0, c.ClusterSizeBytes);
+                    c.Read(_buffer, 0, _signatureKeys, _options, batch);
+                    verified.Add(c);
+                }
+
+                if (batch.Count > 0) invalid.AddRange(batch.Verify());
+
+                if (cache != null) {
+                    foreach (Cluster c in verified) {
+                        if (invalid.Contains(c)) continue;
+                        c.WriteCacheImage(_buffer, 0);
+                        cache.Put(getAddress(c), _buffer, 0, c.ClusterSizeBytes);
+                    }
+                }
+            }
+
+            return invalid;
+        }
+
+        /// <summary>
+        /// A batch for the signatures of clusters checked with <see cref="CheckImage"/>, verified with the tables of this mount.
+        /// </summary>
+        public SignatureBatch CreateSignatureBatch() {
+            lock (_lock) {
+                if (_signatureVerifier == null) _signatureVerifier = new ClusterSignatureVerifier(_signatureKeys);
+                return _signatureVerifier.CreateBatch();
+            }
+        }
+
+        /// <summary>
+        /// Checks an image of a cluster read with <see cref="ReadRaw"/> and loads it, as Load does, except that the signature is
+        /// added to batch.  The image is not changed, so a scrub that finds it damaged can repair it in place without reading it
+        /// again.
+        /// </summary>
+        public virtual void CheckImage(Cluster c, byte[] buffer, int offset, SignatureBatch batch) {
+            c.Read(buffer, offset, _signatureKeys, _options, batch);
+        }
+
+        /// <summary>
+        /// Reads count bytes at position within a cluster as they are on the device, without verifying or decrypting them, so that
+        /// a cluster that fails its checks can still be repaired in place.
+        /// </summary>
+        public virtual void ReadRaw(Cluster c, int position, byte[] buffer, int offset, int count) {
+            lock (_lock) _io.Read(getAddress(c) + position, buffer, offset, count);
+        }
+
+        /// <summary>
+        /// Writes count bytes at position within a cluster straight to the device, without sealing them, to put back the bytes a
+        /// repair has corrected.  The cached image of the cluster is dropped.
+        /// </summary>
+        public virtual void WriteRaw(Cluster c, int position, byte[] buffer, int offset, int count) {
+            lock (_lock) {
+                long address = getAddress(c);
+                _io.Write(address + position, buffer, offset, count);
+                Cache?.Remove(address);
             }
         }
 
@@ -48,22 +172,199 @@ namespace SRFS.Model {
         public virtual void Save(Cluster c) {
             lock (_lock) {
                 long address = getAddress(c);
+                ClusterCache cache = Cache;
+
+                // Data clusters wait in the write-back buffer as unsealed images until the next flush.  The header and parity
+                // clusters are written straight through.
+                WriteBackBuffer writeBack = WriteBack;
+                if (writeBack != null && c is DataCluster) {
+                    markChanged(c);
+                    c.WriteCacheImage(_buffer, 0);
+                    _pending[address] = c;
+                    bool isFull = writeBack.Put(address, GetTrackNumber(c), _buffer, 0, c.ClusterSizeBytes);
+                    cache?.Put(address, _buffer, 0, c.ClusterSizeBytes);
+                    if (isFull) flushWriteBack(writeBack);
+                    return;
+                }
+
+                markChanged(c);
+                copyOnWrite(c, address);
                 c.Save(_buffer, 0, _signingKey);
                 _io.Write(address, _buffer, 0, c.ClusterSizeBytes);
+                OnWritten(c, _buffer, 0);
+
+                if (cache != null) {
+                    c.WriteCacheImage(_buffer, 0);
+                    cache.Put(address, _buffer, 0, c.ClusterSizeBytes);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Seals and writes every cluster waiting in the write-back buffer, a track at a time and in device order within a track.
+        /// Returns the tracks whose data clusters were saved since the previous call, including those written by flushes the
+        /// buffer triggered itself when it ran over budget, so the parity of each can be refreshed once.
+        /// </summary>
+        public int[] FlushWriteBack() {
+            WriteBackBuffer writeBack = WriteBack;
+            if (writeBack == null) return new int[0];
+
+            lock (_lock) {
+                flushWriteBack(writeBack);
+                return writeBack.TakeDirtyTracks();
+            }
+        }
+
+        /// <summary>
+        /// Flushes the write-back buffer and takes a snapshot of the data clusters of a track as they then are on the device.  Saves
+        /// may continue while the snapshot is open; see <see cref="ClusterSnapshot"/>.  It must be ended with
+        /// <see cref="EndSnapshot"/>.
+        /// </summary>
+        public ClusterSnapshot BeginSnapshot(int trackNumber) {
+            lock (_lock) {
+                WriteBackBuffer writeBack = WriteBack;
+                if (writeBack != null) flushWriteBack(writeBack);
+
+                var snapshot = new ClusterSnapshot(trackNumber);
+                OnSnapshotBegun(snapshot);
+                _snapshots.Add(snapshot);
+                return snapshot;
+            }
+        }
+
+        /// <summary>
+        /// Reads a data cluster of the snapshot's track as it was when the snapshot began, without verifying it.
+        /// </summary>
+        public void ReadSnapshot(ClusterSnapshot snapshot, Cluster c, byte[] buffer, int offset) {
+            lock (_lock) {
+                if (snapshot.TryGetImage(((DataCluster)c).Address, out byte[] image)) {
+                    Buffer.BlockCopy(image, 0, buffer, offset, c.ClusterSizeBytes);
+                } else {
+                    _io.Read(getAddress(c), buffer, offset, c.ClusterSizeBytes);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Ends a snapshot.  If reconcile is set, the parity was written from the snapshot, and the state of the clusters is
+        /// brought up to date in the same step that ends it, so no save can fall between the two.
+        /// </summary>
+        public void EndSnapshot(ClusterSnapshot snapshot, bool reconcile) {
+            lock (_lock) {
+                _snapshots.Remove(snapshot);
+                if (reconcile) OnSnapshotEnded(snapshot);
+            }
+        }
+
+        /// <summary>
+        /// Called when a snapshot begins, while the device lock is held, to record what the snapshot needs of the file system.
+        /// </summary>
+        protected virtual void OnSnapshotBegun(ClusterSnapshot snapshot) { }
+
+        /// <summary>
+        /// Called when a snapshot is ended with reconcile set, while the device lock is held.
+        /// </summary>
+        protected virtual void OnSnapshotEnded(ClusterSnapshot snapshot) { }
+
+        /// <summary>
+        /// The track of a cluster, for the write-back flush order, or -1 if it belongs to no track.
+        /// </summary>
+        protected virtual int GetTrackNumber(Cluster c) => -1;
+
+        /// <summary>
+        /// Called with the sealed image of each cluster once it is written to the device, while the device lock is held.
+        /// </summary>
+        protected virtual void OnWritten(Cluster c, byte[] bytes, int offset) { }
+
+        private void markChanged(Cluster c) {
+            if (_snapshots.Count == 0 || !(c is DataCluster d)) return;
+
+            int trackNumber = GetTrackNumber(c);
+            foreach (var snapshot in _snapshots) {
+                if (snapshot.TrackNumber == trackNumber) snapshot.SetChanged(d.Address);
+            }
+        }
+
+        // Keeps the image a data cluster has on the device in each open snapshot of its track, before it is overwritten
+        private void copyOnWrite(Cluster c, long address) {
+            if (_snapshots.Count == 0 || !(c is DataCluster d)) return;
+
+            int trackNumber = GetTrackNumber(c);
+            byte[] image = null;
+            foreach (var snapshot in _snapshots) {
+                if (snapshot.TrackNumber != trackNumber || snapshot.HasImage(d.Address)) continue;
+                if (image == null) {
+                    image = new byte[c.ClusterSizeBytes];
+                    _io.Read(address, image, 0, image.Length);
+                }
+                snapshot.SetImage(d.Address, image);
+            }
+        }
+
+        private void flushWriteBack(WriteBackBuffer writeBack) {
+            var batch = new List<long>(ClusterCrypto.MaxLanes);
+            foreach (long address in writeBack.GetFlushOrder()) {
+                batch.Add(address);
+                if (batch.Count == ClusterCrypto.MaxLanes) {
+                    flushBatch(writeBack, batch);
+                    batch.Clear();
+                }
+            }
+            if (batch.Count > 0) flushBatch(writeBack, batch);
+        }
+
+        // Seals a batch of waiting clusters together, so that file clusters under the same key are encrypted side by side
+        private void flushBatch(WriteBackBuffer writeBack, List<long> addresses) {
+            var fileClusters = new List<FileBaseCluster>(addresses.Count);
+            var fileImages = new List<byte[]>(addresses.Count);
+
+            for (int i = 0; i < addresses.Count; i++) {
+                Cluster c = _pending[addresses[i]];
+                if (_sealBuffers[i] == null || _sealBuffers[i].Length < c.ClusterSizeBytes) _sealBuffers[i] = new byte[c.ClusterSizeBytes];
+                writeBack.TryRead(addresses[i], _sealBuffers[i], 0, c.ClusterSizeBytes);
+
+                if (c is FileBaseCluster fileCluster) {
+                    fileClusters.Add(fileCluster);
+                    fileImages.Add(_sealBuffers[i]);
+                }
+            }
+
+            FileBaseCluster.SealCacheImages(fileClusters, fileImages, new int[fileClusters.Count]);
+
+            for (int i = 0; i < addresses.Count; i++) {
+                long address = addresses[i];
+                Cluster c = _pending[address];
+                if (c is FileBaseCluster) c.SignCacheImage(_sealBuffers[i], 0, _signingKey);
+                else c.SealCacheImage(_sealBuffers[i], 0, _signingKey);
+                copyOnWrite(c, address);
+                _io.Write(address, _sealBuffers[i], 0, c.ClusterSizeBytes);
+                OnWritten(c, _sealBuffers[i], 0);
+
+                writeBack.Remove(address);
+                _pending.Remove(address);
             }
         }
 
         private object _lock = new object();
 
+        // The last cluster saved at each address waiting in the write-back buffer, which seals the image for its type and keys
+        private Dictionary<long, Cluster> _pending = new Dictionary<long, Cluster>();
+
+        // The open snapshots, which keep the previous images of the clusters of their tracks
+        private List<ClusterSnapshot> _snapshots = new List<ClusterSnapshot>();
+
         private int _fileSystemHeaderClusterSize;
         private int _parityClusterSize;
 
         private Geometry _geometry;
         private byte[] _buffer;
+        private byte[][] _sealBuffers = new byte[ClusterCrypto.MaxLanes][];
         private IBlockIO _io;
 
         private PrivateKey _signingKey;
         private IDictionary<KeyThumbprint, PublicKey> _signatureKeys;
+        // Created by the first LoadMany, so the key tables are only built for a mount that verifies in batches
+        private ClusterSignatureVerifier _signatureVerifier;
         private Options _options;
     }
 }
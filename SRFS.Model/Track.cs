@@ -1,10 +1,12 @@
 ﻿using System;
+using System.Collections.Concurrent;
 using System.Collections.Generic;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
 using SRFS.ReedSolomon;
 using SRFS.Model.Clusters;
+using SRFS.Model.Exceptions;
 using System.Threading;
 using System.ComponentModel;
 namespace SRFS.Model {
@@ -46,30 +48,17 @@ namespace SRFS.Model {
             }
         }
 
-        private bool IsClusterDirty(ClusterState s) => (!s.IsSystem()) && (s.IsModified() | s.IsUnwritten());
-        public bool DataModified {
-            get {
-                return DataClusters.Any(x => IsClusterDirty(_fileSystem.GetClusterState(x)));
-            }
-        }
+        public IEnumerable<int> GlobalParityClusters => ParityClusters.Take(Configuration.Geometry.GlobalParityClustersPerTrack);
 
-        public bool Used {
-            get {
-                return DataClusters.Any(x => (_fileSystem.GetClusterState(x) & ClusterState.Used) != 0);
-            }
-        }
+        public IEnumerable<int> LocalParityClusters => ParityClusters.Skip(Configuration.Geometry.GlobalParityClustersPerTrack);
 
-        public bool ParityWritten {
-            get {
-                return ParityClusters.All(x => (_fileSystem.GetClusterState(x) & ClusterState.Unwritten) == 0);
-            }
-        }
+        public bool DataModified => _fileSystem.IsTrackDataModified(_trackNumber);
 
-        public bool UpToDate {
-            get {
-                return (!Used) || ((!DataModified) && ParityWritten);
-            }
-        }
+        public bool Used => _fileSystem.IsTrackUsed(_trackNumber);
+
+        public bool ParityWritten => _fileSystem.IsTrackParityWritten(_trackNumber);
+
+        public bool UpToDate => _fileSystem.IsTrackUpToDate(_trackNumber);
 
         public class UpdateParityStatus : INotifyPropertyChanged {
 
@@ -89,67 +78,84 @@ namespace SRFS.Model {
             public event PropertyChangedEventHandler PropertyChanged;
         }
 
-        public Task UpdateParity(bool force, UpdateParityStatus status, CancellationToken token) {
-            return Task.Run(() => updateParityAsyncInternal(force,status,token), token);
+        /// <summary>
+        /// Recalculate the parity for this track.  If a checkpoint path is given, the accumulated parity is saved there when the
+        /// update is cancelled, and a later update resumes from it instead of starting from the first cluster.  The checkpoint records
+        /// the hash root of the track, and one saved before the track was written again is discarded.  Checkpoints are not used
+        /// when the geometry has local groups.
+        /// </summary>
+        public Task UpdateParity(bool force, UpdateParityStatus status, CancellationToken token, string checkpointPath = null) {
+            return Task.Run(() => updateParityAsyncInternal(force, status, token, checkpointPath), token);
         }
 
-        private void updateParityAsyncInternal(bool force, UpdateParityStatus status, CancellationToken token) {
+        private void updateParityAsyncInternal(bool force, UpdateParityStatus status, CancellationToken token, string checkpointPath) {
             if (!force && !DataModified && ParityWritten) return;
 
+            // Clusters still in the write-back buffer must reach the device before the parity reads them
+            _fileSystem.Flush();
+            ClusterSnapshot snapshot = _fileSystem.ClusterIO.BeginSnapshot(_trackNumber);
+            byte[] trackHashRoot = snapshot.TrackHashRoot;
+
             int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
-            int parityClustersPerTrack = Configuration.Geometry.ParityClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
+            int localGroupCount = Configuration.Geometry.LocalGroupCount;
             int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
 
-            using (var p = new Parity(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2)) {
-                int codewordExponent = dataClustersPerTrack + parityClustersPerTrack - 1;
-                byte[] emptyCluster = null;
-                int clustersComplete = -1;
-                foreach (var absoluteClusterNumber in DataClusters) {
-                    ClusterState state = _fileSystem.GetClusterState(absoluteClusterNumber);
-                    if (!state.IsSystem()) {
-                        if ((state & ClusterState.Unwritten) != 0) {
-                            if (emptyCluster == null) {
-                                EmptyCluster c = new EmptyCluster(absoluteClusterNumber);
-                                _fileSystem.ClusterIO.Save(c);
-                                emptyCluster = new byte[bytesPerCluster];
-                                c.Save(emptyCluster, 0);
-                            }
-                            p.Calculate(emptyCluster, 0, codewordExponent);
-                            state &= ~ClusterState.Unwritten;
-                            _fileSystem.SetClusterState(absoluteClusterNumber, state);
-                        } else {
-                            Cluster c = new Cluster(absoluteClusterNumber, bytesPerCluster);
-                            _fileSystem.ClusterIO.Load(c);
-                            byte[] bytes = new byte[bytesPerCluster];
-                            c.Save(bytes, 0);
-                            p.Calculate(bytes, 0, codewordExponent);
-                        }
+            bool isComplete = false;
+            try {
+                using (var p = new Parity(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2))
+                using (var lp = localGroupCount > 0 ? new LocalParity(dataClustersPerTrack, localGroupCount, bytesPerCluster / 2) : null) {
+                    byte[] bytes = new byte[bytesPerCluster];
+
+                    if (lp != null) checkpointPath = null;
+                    if (checkpointPath != null && !p.LoadCheckpoint(checkpointPath, trackHashRoot)) System.IO.File.Delete(checkpointPath);
+
+                    bool isEncoded = encodeDataClusters(snapshot, p, lp, cluster => {
+                        status.Cluster = cluster;
+                        return !token.IsCancellationRequested;
+                    });
+                    if (!isEncoded) {
+                        if (checkpointPath != null) p.SaveCheckpoint(checkpointPath, trackHashRoot);
+                        return;
                     }
 
-                    clustersComplete++;
-                    status.Cluster = clustersComplete;
-                    codewordExponent--;
-                    if (token.IsCancellationRequested) return;
-                }
+                    int clustersComplete = dataClustersPerTrack - 1;
 
-                for (int i = 0; i < parityClustersPerTrack; i++) {
-                    ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, i);
-                    byte[] bytes = new byte[bytesPerCluster];
-                    p.GetParity(bytes, 0, parityClustersPerTrack - 1 - i);
-                    c.Data.Set(0, bytes);
-                    _fileSystem.ClusterIO.Save(c);
-                    _fileSystem.SetClusterState(c.ClusterAddress, ClusterState.Parity);
+                    for (int i = 0; i < parityClustersPerTrack; i++) {
+                        ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, i);
+                        p.GetParity(bytes, 0, parityClustersPerTrack - 1 - i);
+                        c.Data.Set(0, bytes);
+                        c.TrackHashRoot = trackHashRoot;
+                        _fileSystem.ClusterIO.Save(c);
+                        _fileSystem.SetClusterState(c.ClusterAddress, ClusterState.Parity);
+
+                        clustersComplete++;
+                        status.Cluster = clustersComplete;
+                        if (token.IsCancellationRequested) {
+                            if (checkpointPath != null) p.SaveCheckpoint(checkpointPath, trackHashRoot);
+                            return;
+                        }
+                    }
 
-                    clustersComplete++;
-                    status.Cluster = clustersComplete;
-                    if (token.IsCancellationRequested) return;
+                    for (int i = 0; i < localGroupCount; i++) {
+                        ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, parityClustersPerTrack + i);
+                        lp.GetParity(bytes, 0, i);
+                        c.Data.Set(0, bytes);
+                        c.TrackHashRoot = trackHashRoot;
+                        _fileSystem.ClusterIO.Save(c);
+                        _fileSystem.SetClusterState(c.ClusterAddress, ClusterState.Parity);
+
+                        clustersComplete++;
+                        status.Cluster = clustersComplete;
+                        if (token.IsCancellationRequested) return;
+                    }
                 }
-            }
 
-            // Update states after the parity is modified in case there is an error
-            foreach (var i in DataClusters) {
-                ClusterState state = _fileSystem.GetClusterState(i) & (~ClusterState.Modified);
-                _fileSystem.SetClusterState(i, state);
+                if (checkpointPath != null) System.IO.File.Delete(checkpointPath);
+                isComplete = true;
+            } finally {
+                // Clusters saved while the parity was calculated stay modified, since the parity was written from the snapshot
+                _fileSystem.ClusterIO.EndSnapshot(snapshot, isComplete);
             }
             _fileSystem.Flush();
         }
@@ -157,55 +163,146 @@ namespace SRFS.Model {
         public void UpdateParity(bool force = false) {
             if (!force && !DataModified && ParityWritten) return;
 
+            // Clusters still in the write-back buffer must reach the device before the parity reads them
+            _fileSystem.Flush();
+            ClusterSnapshot snapshot = _fileSystem.ClusterIO.BeginSnapshot(_trackNumber);
+            byte[] trackHashRoot = snapshot.TrackHashRoot;
+
             int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
-            int parityClustersPerTrack = Configuration.Geometry.ParityClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
+            int localGroupCount = Configuration.Geometry.LocalGroupCount;
             int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
 
-            using (var p = new Parity(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2)) {
-                int codewordExponent = dataClustersPerTrack + parityClustersPerTrack - 1;
-                byte[] emptyCluster = null;
-                foreach (var absoluteClusterNumber in DataClusters) {
-                    ClusterState state = _fileSystem.GetClusterState(absoluteClusterNumber);
-                    if (!state.IsSystem()) {
-                        if ((state & ClusterState.Unwritten) != 0) {
-                            if (emptyCluster == null) {
-                                EmptyCluster c = new EmptyCluster(absoluteClusterNumber);
-                                Console.WriteLine($"Saving empty cluster {absoluteClusterNumber}");
-                                _fileSystem.ClusterIO.Save(c);
-                                emptyCluster = new byte[bytesPerCluster];
-                                c.Save(emptyCluster, 0);
-                            }
-                            p.Calculate(emptyCluster, 0, codewordExponent);
-                            state &= ~ClusterState.Unwritten;
-                            _fileSystem.SetClusterState(absoluteClusterNumber, state);
-                        } else {
-                            Cluster c = new Cluster(absoluteClusterNumber, bytesPerCluster);
-                            Console.WriteLine($"Loading cluster {absoluteClusterNumber}");
-                            _fileSystem.ClusterIO.Load(c);
-                            byte[] bytes = new byte[bytesPerCluster];
-                            c.Save(bytes, 0);
-                            p.Calculate(bytes, 0, codewordExponent);
-                        }
+            bool isComplete = false;
+            try {
+                using (var p = new Parity(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2))
+                using (var lp = localGroupCount > 0 ? new LocalParity(dataClustersPerTrack, localGroupCount, bytesPerCluster / 2) : null) {
+                    byte[] bytes = new byte[bytesPerCluster];
+                    encodeDataClusters(snapshot, p, lp);
+
+                    for (int i = 0; i < parityClustersPerTrack; i++) {
+                        ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, i);
+                        p.GetParity(bytes, 0, parityClustersPerTrack - 1 - i);
+                        c.Data.Set(0, bytes);
+                        c.TrackHashRoot = trackHashRoot;
+                        Console.WriteLine($"Saving Parity Cluster {c.ClusterAddress}");
+                        _fileSystem.ClusterIO.Save(c);
+                        _fileSystem.SetClusterState(c.ClusterAddress, ClusterState.Parity);
                     }
 
-                    codewordExponent--;
+                    for (int i = 0; i < localGroupCount; i++) {
+                        ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, parityClustersPerTrack + i);
+                        lp.GetParity(bytes, 0, i);
+                        c.Data.Set(0, bytes);
+                        c.TrackHashRoot = trackHashRoot;
+                        Console.WriteLine($"Saving Local Parity Cluster {c.ClusterAddress}");
+                        _fileSystem.ClusterIO.Save(c);
+                        _fileSystem.SetClusterState(c.ClusterAddress, ClusterState.Parity);
+                    }
                 }
+                isComplete = true;
+            } finally {
+                // Clusters saved while the parity was calculated stay modified, since the parity was written from the snapshot
+                _fileSystem.ClusterIO.EndSnapshot(snapshot, isComplete);
+            }
+        }
 
-                for (int i = 0; i < parityClustersPerTrack; i++) {
-                    ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, i);
-                    byte[] bytes = new byte[bytesPerCluster];
-                    p.GetParity(bytes, 0, parityClustersPerTrack - 1 - i);
-                    c.Data.Set(0, bytes);
-                    Console.WriteLine($"Saving Parity Cluster {c.ClusterAddress}");
-                    _fileSystem.ClusterIO.Save(c);
-                    _fileSystem.SetClusterState(c.ClusterAddress, ClusterState.Parity);
+        /// <summary>
+        /// Recalculate the parity for several tracks together.  Every track has the same geometry, so cluster j of each track is
+        /// added with the same coefficients, and each coefficient table is built once per batch instead of once per track.  When
+        /// the geometry has a run kernel, each track is encoded through it instead, a run of clusters at a time, with as many
+        /// tracks at once as the tuned thread count.
+        /// </summary>
+        public static void UpdateParity(FileSystem fileSystem, IList<Track> tracks, bool force = false) {
+            Track[] batch = (from t in tracks where force || t.DataModified || !t.ParityWritten select t).ToArray();
+            if (batch.Length == 0) return;
+
+            fileSystem.Flush();
+
+            int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
+            int localGroupCount = Configuration.Geometry.LocalGroupCount;
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+
+            ClusterSnapshot[] snapshots = new ClusterSnapshot[batch.Length];
+            bool[] isComplete = new bool[batch.Length];
+            int[][] dataClusters = (from t in batch select t.DataClusters.ToArray()).ToArray();
+            Parity[] parities = new Parity[batch.Length];
+            LocalParity[] localParities = new LocalParity[batch.Length];
+            PinnedBuffer[] buffers = new PinnedBuffer[batch.Length];
+
+            try {
+                for (int k = 0; k < batch.Length; k++) {
+                    snapshots[k] = fileSystem.ClusterIO.BeginSnapshot(batch[k]._trackNumber);
+                    parities[k] = new Parity(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2);
+                    if (localGroupCount > 0) localParities[k] = new LocalParity(dataClustersPerTrack, localGroupCount, bytesPerCluster / 2);
+                    buffers[k] = new PinnedBuffer(bytesPerCluster);
                 }
-            }
 
-            // Update states after the parity is modified in case there is an error
-            foreach (var i in DataClusters) {
-                ClusterState state = _fileSystem.GetClusterState(i) & (~ClusterState.Modified);
-                _fileSystem.SetClusterState(i, state);
+                byte[] bytes = new byte[bytesPerCluster];
+                if (parities[0].RunLength > 0) {
+                    // The run kernel holds the parity in registers across a run of clusters, which saves more than sharing the
+                    // tables of one cluster across the batch.  The tracks are independent, so they are spread over the threads the
+                    // tuner found worth using.
+                    var options = new ParallelOptions { MaxDegreeOfParallelism = Math.Max(1, fileSystem.ParityTuning.Threads) };
+                    Parallel.For(0, batch.Length, options, k => batch[k].encodeDataClusters(snapshots[k], parities[k], localParities[k]));
+                } else {
+                    List<Parity> slicesParity = new List<Parity>(batch.Length);
+                    List<PinnedBuffer> slicesData = new List<PinnedBuffer>(batch.Length);
+                    int codewordExponent = dataClustersPerTrack + parityClustersPerTrack - 1;
+                    for (int dataIndex = 0; dataIndex < dataClustersPerTrack; dataIndex++, codewordExponent--) {
+                        slicesParity.Clear();
+                        slicesData.Clear();
+                        for (int k = 0; k < batch.Length; k++) {
+                            int absoluteClusterNumber = dataClusters[k][dataIndex];
+                            ClusterState state = snapshots[k].GetState(absoluteClusterNumber);
+                            // Unwritten clusters are slices of zeros, which add nothing to the parity
+                            if (state.IsSystem() || state.IsUnwritten()) continue;
+
+                            batch[k].loadSnapshotCluster(snapshots[k], absoluteClusterNumber, bytes, 0);
+                            buffers[k].CopyFrom(bytes, 0, 0, bytesPerCluster);
+                            localParities[k]?.Calculate(bytes, 0, dataIndex);
+                            slicesParity.Add(parities[k]);
+                            slicesData.Add(buffers[k]);
+                        }
+
+                        // Cluster dataIndex of every track shares this exponent, so its tables are built once for the whole batch
+                        if (slicesParity.Count > 0) Parity.CalculateBatch(slicesParity.ToArray(), slicesData.ToArray(), 0, codewordExponent);
+                    }
+                }
+
+                for (int k = 0; k < batch.Length; k++) {
+                    Track t = batch[k];
+                    byte[] trackHashRoot = snapshots[k].TrackHashRoot;
+
+                    for (int i = 0; i < parityClustersPerTrack; i++) {
+                        ParityCluster c = new ParityCluster(fileSystem.BlockSize, t._trackNumber, i);
+                        parities[k].GetParity(bytes, 0, parityClustersPerTrack - 1 - i);
+                        c.Data.Set(0, bytes);
+                        c.TrackHashRoot = trackHashRoot;
+                        fileSystem.ClusterIO.Save(c);
+                        fileSystem.SetClusterState(c.ClusterAddress, ClusterState.Parity);
+                    }
+
+                    for (int i = 0; i < localGroupCount; i++) {
+                        ParityCluster c = new ParityCluster(fileSystem.BlockSize, t._trackNumber, parityClustersPerTrack + i);
+                        localParities[k].GetParity(bytes, 0, i);
+                        c.Data.Set(0, bytes);
+                        c.TrackHashRoot = trackHashRoot;
+                        fileSystem.ClusterIO.Save(c);
+                        fileSystem.SetClusterState(c.ClusterAddress, ClusterState.Parity);
+                    }
+
+                    isComplete[k] = true;
+                }
+            } finally {
+                for (int k = 0; k < batch.Length; k++) {
+                    // Clusters saved while the parity was calculated stay modified, since the parity was written from the snapshot
+                    if (snapshots[k] != null) fileSystem.ClusterIO.EndSnapshot(snapshots[k], isComplete[k]);
+                    parities[k]?.Dispose();
+                    localParities[k]?.Dispose();
+                    buffers[k]?.Dispose();
+                }
             }
         }
 
@@ -214,7 +311,7 @@ namespace SRFS.Model {
             if (DataModified || !ParityWritten) return false;
 
             int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
-            int parityClustersPerTrack = Configuration.Geometry.ParityClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
             int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
 
             List<int> errorExponents = new List<int>();
@@ -223,12 +320,8 @@ namespace SRFS.Model {
                 int codewordExponent = dataClustersPerTrack + parityClustersPerTrack - 1;
                 foreach (var absoluteClusterNumber in DataClusters) {
                     if (!_fileSystem.GetClusterState(absoluteClusterNumber).IsSystem()) {
-                        Cluster c = new Cluster(absoluteClusterNumber, bytesPerCluster);
-                        Console.WriteLine($"Loading cluster {absoluteClusterNumber}");
                         try {
-                            _fileSystem.ClusterIO.Load(c);
-                            byte[] bytes = new byte[bytesPerCluster];
-                            c.Save(bytes, 0);
+                            byte[] bytes = loadDataCluster(absoluteClusterNumber, bytesPerCluster);
                             p.AddCodewordSlice(bytes, 0, codewordExponent);
                         } catch (System.IO.IOException) {
                             // We need to catch something specific to a hash failure or something.  Or force no auto check, then check manually.
@@ -240,7 +333,7 @@ namespace SRFS.Model {
                 }
 
                 int parityNumber = 0;
-                foreach (var absoluteClusterNumber in ParityClusters) {
+                foreach (var absoluteClusterNumber in GlobalParityClusters) {
                     ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, parityNumber);
                     Console.WriteLine($"Loading parity cluster {absoluteClusterNumber}");
                     try {
@@ -274,51 +367,395 @@ namespace SRFS.Model {
                         int index = 0;
                         foreach (var e in errorExponents) {
                             r.Correction(index++, bytes, 0);
-                            if (e < parityClustersPerTrack) {
-                                // it is a parity cluster
-                                ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, parityClustersPerTrack - 1 - e);
-                                c.Data.Set(0, bytes);
-                                Console.WriteLine($"Repairing parity {c.ClusterAddress} at {c.AbsoluteAddress}");
-                                _fileSystem.ClusterIO.Save(c);
+                            saveRepairedCluster(e, bytes, dataClusters);
+                        }
+                    }
+
+                    return true;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Repairs clusters that are already known to be damaged, such as those found by a scrub.  Since the damage is known
+        /// before anything is read, the work follows it rather than the parity count: a single cluster is the XOR of the rest,
+        /// lost parity is encoded again from the data alone, and other damage needs only as many syndromes as damaged clusters.
+        /// If a cluster that is read turns out to be damaged as well, the whole track is repaired through <see cref="Repair()"/>.
+        /// </summary>
+        /// <param name="damagedClusters">The absolute cluster numbers of the damaged data and global parity clusters.</param>
+        public bool Repair(IEnumerable<int> damagedClusters) {
+            if (DataModified || !ParityWritten) return false;
+
+            int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+            int topExponent = dataClustersPerTrack + parityClustersPerTrack - 1;
+
+            int[] dataClusters = DataClusters.ToArray();
+            int[] parityClusters = GlobalParityClusters.ToArray();
+
+            List<int> errorExponents = new List<int>();
+            foreach (var absoluteClusterNumber in damagedClusters) {
+                int i = Array.IndexOf(dataClusters, absoluteClusterNumber);
+                int n = Array.IndexOf(parityClusters, absoluteClusterNumber);
+                if (i >= 0) errorExponents.Add(topExponent - i);
+                else if (n >= 0) errorExponents.Add(parityClustersPerTrack - 1 - n);
+                else throw new ArgumentOutOfRangeException(nameof(damagedClusters));
+            }
+
+            if (errorExponents.Count == 0) return true;
+            if (errorExponents.Count > parityClustersPerTrack) return false;
+
+            using (var r = new AdaptiveRepair(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2, errorExponents)) {
+                try {
+                    for (int i = 0; i < dataClusters.Length; i++) {
+                        if (!r.IsNeeded(topExponent - i) || _fileSystem.GetClusterState(dataClusters[i]).IsSystem()) continue;
+                        r.AddCodewordSlice(loadDataCluster(dataClusters[i], bytesPerCluster), 0, topExponent - i);
+                    }
+
+                    for (int n = 0; n < parityClusters.Length; n++) {
+                        if (!r.IsNeeded(parityClustersPerTrack - 1 - n)) continue;
+                        ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, n);
+                        Console.WriteLine($"Loading parity cluster {parityClusters[n]}");
+                        _fileSystem.ClusterIO.Load(c);
+                        r.AddCodewordSlice(c.Data.ToByteArray(0, bytesPerCluster), 0, parityClustersPerTrack - 1 - n);
+                    }
+                } catch (System.IO.IOException) {
+                    Console.WriteLine($"More damage in track {_trackNumber}, repairing the whole track");
+                    return Repair();
+                }
+
+                byte[] bytes = new byte[bytesPerCluster];
+                int index = 0;
+                foreach (var e in errorExponents) {
+                    r.GetCorrection(index++, bytes, 0);
+                    saveRepairedCluster(e, bytes, dataClusters);
+                }
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// Repairs damage in place, rewriting only the device blocks it touched.  Clusters that fail their checks are read again as
+        /// they are on the device and added to the syndrome with the rest, so the syndrome is nonzero only where they are damaged.
+        /// Only those ranges, rounded out to device blocks, are corrected and written back; bit rot usually touches a few sectors,
+        /// so this is a small part of the work and writes of <see cref="Repair()"/>.  Returns false if the track can't be
+        /// repaired this way, such as when the syndrome is nonzero with no cluster failing its checks.
+        /// </summary>
+        public bool RepairDamage() {
+            if (DataModified || !ParityWritten) return false;
+
+            int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+            int parityHeaderLength = ParityCluster.CalculateHeaderLength(_fileSystem.BlockSize);
+
+            int[] dataClusters = DataClusters.ToArray();
+            List<int> errorExponents = new List<int>();
+            List<byte[]> damaged = new List<byte[]>();
+
+            using (var p = new Syndrome(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2)) {
+                int codewordExponent = dataClustersPerTrack + parityClustersPerTrack - 1;
+                for (int i = 0; i < dataClusters.Length; i++, codewordExponent--) {
+                    if (_fileSystem.GetClusterState(dataClusters[i]).IsSystem()) continue;
+
+                    byte[] bytes;
+                    try {
+                        bytes = loadDataCluster(dataClusters[i], bytesPerCluster);
+                    } catch (System.IO.IOException) {
+                        Console.WriteLine($"Error in data cluster {dataClusters[i]}");
+                        bytes = new byte[bytesPerCluster];
+                        _fileSystem.ClusterIO.ReadRaw(new Cluster(dataClusters[i], bytesPerCluster), 0, bytes, 0, bytesPerCluster);
+                        errorExponents.Add(codewordExponent);
+                        damaged.Add(bytes);
+                    }
+                    p.AddCodewordSlice(bytes, 0, codewordExponent);
+                }
+
+                for (int n = 0; n < parityClustersPerTrack; n++, codewordExponent--) {
+                    ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, n);
+                    Console.WriteLine($"Loading parity cluster {c.ClusterAddress}");
+                    byte[] bytes;
+                    try {
+                        _fileSystem.ClusterIO.Load(c);
+                        bytes = c.Data.ToByteArray(0, bytesPerCluster);
+                    } catch (System.IO.IOException) {
+                        Console.WriteLine($"Error in parity cluster {c.ClusterAddress}");
+                        bytes = new byte[bytesPerCluster];
+                        _fileSystem.ClusterIO.ReadRaw(c, parityHeaderLength, bytes, 0, bytesPerCluster);
+                        errorExponents.Add(codewordExponent);
+                        damaged.Add(bytes);
+                    }
+                    p.AddCodewordSlice(bytes, 0, codewordExponent);
+                }
+
+                if (errorExponents.Count > parityClustersPerTrack) return false;
+
+                int[] ranges = p.GetDamagedRanges(_fileSystem.BlockSize / 2);
+                if (errorExponents.Count == 0) return ranges.Length == 0;
+
+                using (var r = new Repair(p, dataClustersPerTrack + parityClustersPerTrack, errorExponents)) {
+                    for (int k = 0; k < errorExponents.Count; k++) {
+                        r.CorrectRanges(k, damaged[k], 0, ranges);
+                        saveRepairedRanges(errorExponents[k], damaged[k], 0, ranges, dataClusters);
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// Verifies the track and repairs it in one pass, reading every cluster once.  Each data and global parity cluster is read
+        /// into a single track buffer as it is on the device and added to the syndrome whether or not it is intact, so clusters that
+        /// fail their hash or signature are known erasures and the syndrome is nonzero only where they are damaged.  Those ranges
+        /// are corrected in the buffer and only they are written back, as in <see cref="RepairDamage"/>, or the whole cluster if
+        /// the device could not read it.  Nothing is read twice, as it is when <see cref="VerifyParity()"/> is followed by
+        /// <see cref="Repair()"/>.  The verify time of every data cluster that passes, or is repaired, is updated.
+        /// 
+        /// Returns true if the track is intact or was repaired, and false if it is not up to date, has more damage than parity, or
+        /// its syndrome is nonzero with no cluster failing its checks.
+        /// </summary>
+        public bool Scrub() {
+            if (DataModified || !ParityWritten) return false;
+
+            // Clusters still in the write-back buffer must reach the device before they are read
+            _fileSystem.Flush();
+
+            int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
+            int localGroupCount = Configuration.Geometry.LocalGroupCount;
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+            int parityHeaderLength = ParityCluster.CalculateHeaderLength(_fileSystem.BlockSize);
+            int parityClusterSize = parityHeaderLength + bytesPerCluster;
+            int topExponent = dataClustersPerTrack + parityClustersPerTrack - 1;
+
+            // The data clusters come first in the buffer, then the parity clusters with their headers, so the slice of an
+            // exponent is found without copying
+            int dataBytes = dataClustersPerTrack * bytesPerCluster;
+            Func<int, int> sliceOffset = e => e >= parityClustersPerTrack ? (topExponent - e) * bytesPerCluster :
+                dataBytes + (parityClustersPerTrack - 1 - e) * parityClusterSize + parityHeaderLength;
+
+            int[] dataClusters = DataClusters.ToArray();
+            bool[] isRead = new bool[dataClusters.Length];
+            var clusterExponents = new Dictionary<Cluster, int>();
+            var errorExponents = new List<int>();
+            var unreadable = new HashSet<int>();
+            byte[] buffer = takeScrubBuffer(dataBytes + parityClustersPerTrack * parityClusterSize);
+
+            try {
+                using (var p = new Syndrome(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2))
+                using (var lp = localGroupCount > 0 ? new LocalParity(dataClustersPerTrack, localGroupCount, bytesPerCluster / 2) : null) {
+                    SignatureBatch batch = _fileSystem.ClusterIO.CreateSignatureBatch();
+
+                    for (int i = 0; i < dataClusters.Length; i++) {
+                        int exponent = topExponent - i;
+                        ClusterState state = _fileSystem.GetClusterState(dataClusters[i]);
+                        // Unwritten clusters are slices of zeros, which add nothing to the syndrome or the local parity
+                        if (state.IsSystem() || state.IsUnwritten()) continue;
+
+                        int offset = sliceOffset(exponent);
+                        Cluster c = new Cluster(dataClusters[i], bytesPerCluster);
+                        if (readImage(c, buffer, offset, bytesPerCluster, batch, out bool isUnreadable)) {
+                            clusterExponents[c] = exponent;
+                            isRead[i] = true;
+                        } else {
+                            errorExponents.Add(exponent);
+                            if (isUnreadable) unreadable.Add(exponent);
+                        }
+                        p.AddCodewordSlice(buffer, offset, exponent);
+                        lp?.Calculate(buffer, offset, i);
+                    }
+
+                    for (int n = 0; n < parityClustersPerTrack; n++) {
+                        int exponent = parityClustersPerTrack - 1 - n;
+                        int offset = sliceOffset(exponent);
+                        ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, n);
+                        if (readImage(c, buffer, offset - parityHeaderLength, parityClusterSize, batch, out _)) {
+                            clusterExponents[c] = exponent;
+                        } else {
+                            errorExponents.Add(exponent);
+                        }
+                        p.AddCodewordSlice(buffer, offset, exponent);
+                    }
+
+                    // The signatures are verified together once every cluster is read, and those that fail are erasures as well
+                    if (batch.Count > 0) {
+                        foreach (Cluster c in batch.Verify()) {
+                            int exponent = clusterExponents[c];
+                            errorExponents.Add(exponent);
+                            if (exponent >= parityClustersPerTrack) isRead[topExponent - exponent] = false;
+                        }
+                    }
+
+                    if (errorExponents.Count == 0) {
+                        if (!checkSyndrome(p, lp, bytesPerCluster)) return false;
+                        setVerifyTimes(dataClusters, isRead);
+                        return true;
+                    }
+                    if (errorExponents.Count > parityClustersPerTrack) return false;
+
+                    int[] ranges = p.GetDamagedRanges(_fileSystem.BlockSize / 2);
+                    using (var r = new Repair(p, dataClustersPerTrack + parityClustersPerTrack, errorExponents)) {
+                        for (int k = 0; k < errorExponents.Count; k++) {
+                            int exponent = errorExponents[k];
+                            int offset = sliceOffset(exponent);
+                            if (unreadable.Contains(exponent) || exponent < parityClustersPerTrack) r.Correction(k, buffer, offset);
+                            else r.CorrectRanges(k, buffer, offset, ranges);
+
+                            // A data cluster that still fails its hash was damaged before the parity was written, so the parity
+                            // cannot restore it
+                            if (exponent >= parityClustersPerTrack &&
+                                !Cluster.ReadHash(buffer, offset).SequenceEqual(Cluster.CalculateHash(buffer, offset, bytesPerCluster))) {
+                                return false;
+                            }
+                        }
+
+                        for (int k = 0; k < errorExponents.Count; k++) {
+                            int exponent = errorExponents[k];
+                            if (unreadable.Contains(exponent)) {
+                                Cluster c = new Cluster(dataClusters[topExponent - exponent], bytesPerCluster);
+                                _fileSystem.ClusterIO.WriteRaw(c, 0, buffer, sliceOffset(exponent), bytesPerCluster);
+                                isRead[topExponent - exponent] = true;
+                            } else if (exponent >= parityClustersPerTrack) {
+                                saveRepairedRanges(exponent, buffer, sliceOffset(exponent), ranges, dataClusters);
+                                isRead[topExponent - exponent] = true;
                             } else {
-                                // Need to do this without creating a cluster, since that will change the signature
-                                int i = dataClustersPerTrack + parityClustersPerTrack - 1 - e;
-                                Cluster c = new Cluster(dataClusters[i], bytesPerCluster);
-                                c.Load(bytes, 0);
-                                Console.WriteLine($"Repairing data {c.ClusterAddress} at {c.AbsoluteAddress}");
-                                _fileSystem.ClusterIO.Save(c);
+                                // The header of a parity cluster is not covered by the parity, so it is sealed again in full
+                                byte[] bytes = new byte[bytesPerCluster];
+                                Buffer.BlockCopy(buffer, sliceOffset(exponent), bytes, 0, bytesPerCluster);
+                                saveRepairedCluster(exponent, bytes, dataClusters);
                             }
                         }
                     }
 
+                    setVerifyTimes(dataClusters, isRead);
                     return true;
                 }
+            } finally {
+                returnScrubBuffer(buffer);
             }
         }
 
+        private void saveRepairedRanges(int exponent, byte[] bytes, int offset, int[] ranges, int[] dataClusters) {
+            int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+
+            Cluster c;
+            int position;
+            if (exponent < parityClustersPerTrack) {
+                c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, parityClustersPerTrack - 1 - exponent);
+                position = ParityCluster.CalculateHeaderLength(_fileSystem.BlockSize);
+            } else {
+                c = new Cluster(dataClusters[dataClustersPerTrack + parityClustersPerTrack - 1 - exponent], bytesPerCluster);
+                position = 0;
+            }
+
+            for (int i = 0; i < ranges.Length; i += 2) {
+                int start = 2 * ranges[i];
+                int count = 2 * (ranges[i + 1] - ranges[i]);
+                _fileSystem.ClusterIO.WriteRaw(c, position + start, bytes, offset + start, count);
+            }
+        }
+
+        private void saveRepairedCluster(int exponent, byte[] bytes, int[] dataClusters) {
+            int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+
+            if (exponent < parityClustersPerTrack) {
+                // it is a parity cluster
+                ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, parityClustersPerTrack - 1 - exponent);
+                c.Data.Set(0, bytes);
+                Console.WriteLine($"Repairing parity {c.ClusterAddress} at {c.AbsoluteAddress}");
+                _fileSystem.ClusterIO.Save(c);
+            } else {
+                // Need to do this without creating a cluster, since that will change the signature
+                int i = dataClustersPerTrack + parityClustersPerTrack - 1 - exponent;
+                Cluster c = new Cluster(dataClusters[i], bytesPerCluster);
+                c.Load(bytes, 0);
+                Console.WriteLine($"Repairing data {c.ClusterAddress} at {c.AbsoluteAddress}");
+                _fileSystem.ClusterIO.Save(c);
+            }
+        }
+
+        /// <summary>
+        /// Repairs a single data cluster.  When the geometry has local groups, the cluster is rebuilt from the rest of its group and
+        /// the group's local parity cluster, so only the group is read.  Otherwise it is rebuilt through the global code, which
+        /// for one cluster is the XOR of the rest of the track.  If another cluster in the group is also damaged, the whole track
+        /// is repaired.
+        /// </summary>
+        public bool RepairCluster(int absoluteClusterNumber) {
+            if (DataModified || !ParityWritten) return false;
+            if (_fileSystem.GetClusterState(absoluteClusterNumber).IsSystem()) return false;
+
+            int localGroupCount = Configuration.Geometry.LocalGroupCount;
+            if (localGroupCount == 0) return Repair(new int[] { absoluteClusterNumber });
+
+            int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+
+            int[] dataClusters = DataClusters.ToArray();
+            int lostIndex = Array.IndexOf(dataClusters, absoluteClusterNumber);
+            if (lostIndex < 0) throw new ArgumentOutOfRangeException(nameof(absoluteClusterNumber));
+
+            using (var lp = new LocalParity(dataClustersPerTrack, localGroupCount, bytesPerCluster / 2)) {
+                int group = lp.GetGroup(lostIndex);
+                try {
+                    for (int i = 0; i < dataClusters.Length; i++) {
+                        if (i == lostIndex || lp.GetGroup(i) != group) continue;
+                        if (_fileSystem.GetClusterState(dataClusters[i]).IsSystem()) continue;
+
+                        lp.Calculate(loadDataCluster(dataClusters[i], bytesPerCluster), 0, i);
+                    }
+
+                    ParityCluster pc = new ParityCluster(_fileSystem.BlockSize, _trackNumber, Configuration.Geometry.GlobalParityClustersPerTrack + group);
+                    Console.WriteLine($"Loading local parity cluster {pc.ClusterAddress}");
+                    _fileSystem.ClusterIO.Load(pc);
+                    lp.AddParity(pc.Data.ToByteArray(0, bytesPerCluster), 0, group);
+                } catch (System.IO.IOException) {
+                    Console.WriteLine($"Error in local group {group}, repairing through the global parity");
+                    return Repair();
+                }
+
+                byte[] repaired = new byte[bytesPerCluster];
+                lp.GetParity(repaired, 0, group);
+                Cluster r = new Cluster(absoluteClusterNumber, bytesPerCluster);
+                r.Load(repaired, 0);
+                Console.WriteLine($"Repairing data {r.ClusterAddress} at {r.AbsoluteAddress} from local group {group}");
+                _fileSystem.ClusterIO.Save(r);
+            }
+
+            return true;
+        }
+
         public bool VerifyParity() {
             if (DataModified || !ParityWritten) return false;
 
             int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
-            int parityClustersPerTrack = Configuration.Geometry.ParityClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
             int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
 
-            using (var p = new Syndrome(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2)) {
+            int localGroupCount = Configuration.Geometry.LocalGroupCount;
+
+            using (var p = new Syndrome(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2))
+            using (var lp = localGroupCount > 0 ? new LocalParity(dataClustersPerTrack, localGroupCount, bytesPerCluster / 2) : null) {
                 int codewordExponent = dataClustersPerTrack + parityClustersPerTrack - 1;
+                int dataIndex = 0;
                 foreach (var absoluteClusterNumber in DataClusters) {
                     if (!_fileSystem.GetClusterState(absoluteClusterNumber).IsSystem()) {
-                        Cluster c = new Cluster(absoluteClusterNumber, bytesPerCluster);
-                        Console.WriteLine($"Loading cluster {absoluteClusterNumber}");
-                        _fileSystem.ClusterIO.Load(c);
-                        byte[] bytes = new byte[bytesPerCluster];
-                        c.Save(bytes, 0);
+                        byte[] bytes = loadDataCluster(absoluteClusterNumber, bytesPerCluster);
                         p.AddCodewordSlice(bytes, 0, codewordExponent);
+                        lp?.Calculate(bytes, 0, dataIndex);
                     }
                     codewordExponent--;
+                    dataIndex++;
                 }
 
                 int parityNumber = 0;
-                foreach (var absoluteClusterNumber in ParityClusters) {
+                foreach (var absoluteClusterNumber in GlobalParityClusters) {
                     ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, parityNumber);
                     Console.WriteLine($"Loading parity cluster {absoluteClusterNumber}");
                     _fileSystem.ClusterIO.Load(c);
@@ -328,21 +765,284 @@ namespace SRFS.Model {
                     parityNumber++;
                 }
 
-                byte[] values = new byte[bytesPerCluster];
-                for (int i = 0; i < parityClustersPerTrack; i++) {
-                    p.GetSyndromeSlice(values, 0, i);
-                    for (int j = 0; j < bytesPerCluster; j++) {
-                        if (values[j] != 0) return false;
+                return checkSyndrome(p, lp, bytesPerCluster);
+            }
+        }
+
+        /// <summary>
+        /// Verify the parity of several tracks together, building each coefficient table once per batch as
+        /// <see cref="UpdateParity(FileSystem, IList{Track}, bool)"/> does.  Returns the result of <see cref="VerifyParity()"/> for
+        /// each track, in order.
+        /// </summary>
+        public static bool[] VerifyParity(FileSystem fileSystem, IList<Track> tracks) {
+            bool[] results = new bool[tracks.Count];
+            int[] indexes = (from k in Enumerable.Range(0, tracks.Count) where !tracks[k].DataModified && tracks[k].ParityWritten select k).ToArray();
+            if (indexes.Length == 0) return results;
+
+            int dataClustersPerTrack = Configuration.Geometry.DataClustersPerTrack;
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
+            int localGroupCount = Configuration.Geometry.LocalGroupCount;
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+
+            Track[] batch = (from k in indexes select tracks[k]).ToArray();
+            int[][] dataClusters = (from t in batch select t.DataClusters.ToArray()).ToArray();
+            Syndrome[] syndromes = new Syndrome[batch.Length];
+            LocalParity[] localParities = new LocalParity[batch.Length];
+            PinnedBuffer[] buffers = new PinnedBuffer[batch.Length];
+
+            try {
+                for (int k = 0; k < batch.Length; k++) {
+                    syndromes[k] = new Syndrome(dataClustersPerTrack, parityClustersPerTrack, bytesPerCluster / 2);
+                    if (localGroupCount > 0) localParities[k] = new LocalParity(dataClustersPerTrack, localGroupCount, bytesPerCluster / 2);
+                    buffers[k] = new PinnedBuffer(bytesPerCluster);
+                }
+
+                List<Syndrome> slicesSyndrome = new List<Syndrome>(batch.Length);
+                List<PinnedBuffer> slicesData = new List<PinnedBuffer>(batch.Length);
+                int codewordExponent = dataClustersPerTrack + parityClustersPerTrack - 1;
+                for (int dataIndex = 0; dataIndex < dataClustersPerTrack; dataIndex++, codewordExponent--) {
+                    slicesSyndrome.Clear();
+                    slicesData.Clear();
+                    for (int k = 0; k < batch.Length; k++) {
+                        if (fileSystem.GetClusterState(dataClusters[k][dataIndex]).IsSystem()) continue;
+                        byte[] bytes = batch[k].loadDataCluster(dataClusters[k][dataIndex], bytesPerCluster);
+                        buffers[k].CopyFrom(bytes, 0, 0, bytesPerCluster);
+                        localParities[k]?.Calculate(bytes, 0, dataIndex);
+                        slicesSyndrome.Add(syndromes[k]);
+                        slicesData.Add(buffers[k]);
                     }
+                    if (slicesSyndrome.Count > 0) Syndrome.AddCodewordSliceBatch(slicesSyndrome.ToArray(), slicesData.ToArray(), 0, codewordExponent);
+                }
+
+                for (int i = 0; i < parityClustersPerTrack; i++, codewordExponent--) {
+                    for (int k = 0; k < batch.Length; k++) {
+                        ParityCluster c = new ParityCluster(fileSystem.BlockSize, batch[k]._trackNumber, i);
+                        fileSystem.ClusterIO.Load(c);
+                        buffers[k].CopyFrom(c.Data.ToByteArray(0, bytesPerCluster), 0, 0, bytesPerCluster);
+                    }
+                    Syndrome.AddCodewordSliceBatch(syndromes, buffers, 0, codewordExponent);
+                }
+
+                for (int k = 0; k < batch.Length; k++) {
+                    results[indexes[k]] = batch[k].checkSyndrome(syndromes[k], localParities[k], bytesPerCluster);
+                }
+            } finally {
+                for (int k = 0; k < batch.Length; k++) {
+                    syndromes[k]?.Dispose();
+                    localParities[k]?.Dispose();
+                    buffers[k]?.Dispose();
                 }
             }
 
-            return true;
+            return results;
+        }
+
+        /// <summary>
+        /// Verifies the data clusters of the track against the track hash tree, and returns the absolute cluster numbers of those
+        /// whose contents no longer hash to their leaf.  The clusters are read as they are on the device and hashed, without
+        /// their signatures, since the leaves are what was written and the root of the leaves is signed with the parity.
+        /// 
+        /// When the signed root matches the tree, the clusters not modified since the parity was written are vouched for, so only
+        /// the clusters modified since, and those never verified, are read.  If the root does not match and no cluster was
+        /// modified, or deep is set, every written cluster is read; the leaves are split into subtrees that are hashed in parallel.
+        /// The verify time of each cluster that passes is updated.
+        /// </summary>
+        public IList<int> VerifyHashes(bool deep = false) {
+            // Clusters still in the write-back buffer must reach the device before they are read
+            _fileSystem.Flush();
+
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+            int[] dataClusters = DataClusters.ToArray();
+            TrackHashTree tree = _fileSystem.GetTrackHashTree(_trackNumber);
+
+            bool rootMatches = false;
+            if (ParityWritten) {
+                ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, 0);
+                try {
+                    _fileSystem.ClusterIO.Load(c);
+                    rootMatches = tree.HasRoot(c.TrackHashRoot);
+                } catch (System.IO.IOException) {
+                    // A parity cluster that cannot be read vouches for nothing, so the clusters are read as if the root differed
+                }
+            }
+            if (!rootMatches && !DataModified) deep = true;
+
+            bool[] isRead = new bool[dataClusters.Length];
+            IList<int> changed = tree.FindChangedLeaves(leaf => {
+                int absoluteClusterNumber = dataClusters[leaf];
+                ClusterState state = _fileSystem.GetClusterState(absoluteClusterNumber);
+                if (state.IsSystem() || state.IsUnwritten()) return null;
+                if (!deep && !state.IsModified() && _fileSystem.GetVerifyTime(absoluteClusterNumber) != DateTime.MinValue) return null;
+
+                byte[] bytes = new byte[bytesPerCluster];
+                _fileSystem.ClusterIO.ReadRaw(new Cluster(absoluteClusterNumber, bytesPerCluster), 0, bytes, 0, bytesPerCluster);
+                isRead[leaf] = true;
+                return Cluster.CalculateHash(bytes, 0, bytesPerCluster);
+            }, Environment.ProcessorCount);
+
+            if (!_fileSystem.ReadOnly) {
+                var failed = new HashSet<int>(changed);
+                DateTime now = DateTime.UtcNow;
+                for (int leaf = 0; leaf < dataClusters.Length; leaf++) {
+                    if (isRead[leaf] && !failed.Contains(leaf)) _fileSystem.SetVerifyTime(dataClusters[leaf], now);
+                }
+            }
+
+            return (from leaf in changed select dataClusters[leaf]).ToList();
         }
 
         public int Number => _trackNumber;
 
+        /// <summary>
+        /// Whether the syndrome of every data and parity cluster is zero, and the local parity clusters cancel their groups.
+        /// </summary>
+        private bool checkSyndrome(Syndrome p, LocalParity lp, int bytesPerCluster) {
+            int parityClustersPerTrack = Configuration.Geometry.GlobalParityClustersPerTrack;
+            int localGroupCount = Configuration.Geometry.LocalGroupCount;
+
+            byte[] values = new byte[bytesPerCluster];
+            for (int i = 0; i < parityClustersPerTrack; i++) {
+                p.GetSyndromeSlice(values, 0, i);
+                for (int j = 0; j < bytesPerCluster; j++) {
+                    if (values[j] != 0) return false;
+                }
+            }
+
+            // The local parity, added to the XOR of its group, must cancel to zero
+            for (int i = 0; i < localGroupCount; i++) {
+                ParityCluster c = new ParityCluster(_fileSystem.BlockSize, _trackNumber, parityClustersPerTrack + i);
+                Console.WriteLine($"Loading local parity cluster {c.ClusterAddress}");
+                _fileSystem.ClusterIO.Load(c);
+                lp.AddParity(c.Data.ToByteArray(0, bytesPerCluster), 0, i);
+                lp.GetParity(values, 0, i);
+                for (int j = 0; j < bytesPerCluster; j++) {
+                    if (values[j] != 0) return false;
+                }
+            }
+
+            return true;
+        }
+
+        private void setVerifyTimes(int[] dataClusters, bool[] isVerified) {
+            if (_fileSystem.ReadOnly) return;
+            DateTime now = DateTime.UtcNow;
+            for (int i = 0; i < dataClusters.Length; i++) {
+                if (isVerified[i]) _fileSystem.SetVerifyTime(dataClusters[i], now);
+            }
+        }
+
+        /// <summary>
+        /// Reads the image of a cluster as it is on the device into buffer and checks it, with the signature added to batch.
+        /// Returns false if the image fails its checks, or if the device could not read it, which sets isUnreadable and leaves
+        /// buffer as it was.
+        /// </summary>
+        private bool readImage(Cluster c, byte[] buffer, int offset, int count, SignatureBatch batch, out bool isUnreadable) {
+            isUnreadable = false;
+            try {
+                _fileSystem.ClusterIO.ReadRaw(c, 0, buffer, offset, count);
+            } catch (System.IO.IOException) {
+                isUnreadable = true;
+                return false;
+            }
+            try {
+                _fileSystem.ClusterIO.CheckImage(c, buffer, offset, batch);
+                return true;
+            } catch (Exception e) when (e is System.IO.IOException || e is InvalidClusterException || e is InvalidHashException ||
+                e is InvalidSignatureException) {
+                return false;
+            }
+        }
+
+        /// <summary>
+        /// Track buffers for <see cref="Scrub"/>, kept between scrubs since a scrub of the volume takes one per track
+        /// </summary>
+        private static byte[] takeScrubBuffer(int length) {
+            while (_scrubBuffers.TryTake(out byte[] buffer)) {
+                if (buffer.Length == length) return buffer;
+            }
+            return new byte[length];
+        }
+
+        private static void returnScrubBuffer(byte[] buffer) {
+            if (_scrubBuffers.Count < Environment.ProcessorCount) _scrubBuffers.Add(buffer);
+        }
+
+        /// <summary>
+        /// The bytes of a data cluster as they were when the snapshot began, which the parity is calculated from.  Saves made since
+        /// do not show, so the file system need not stop writing while the parity is calculated.  The contents are checked against
+        /// the hash, but the signature is not.
+        /// </summary>
+        private void loadSnapshotCluster(ClusterSnapshot snapshot, int absoluteClusterNumber, byte[] bytes, int offset) {
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+            _fileSystem.ClusterIO.ReadSnapshot(snapshot, new Cluster(absoluteClusterNumber, bytesPerCluster), bytes, offset);
+            if (!Cluster.ReadHash(bytes, offset).SequenceEqual(Cluster.CalculateHash(bytes, offset, bytesPerCluster))) {
+                throw new InvalidHashException();
+            }
+        }
+
+        /// <summary>
+        /// Adds the data clusters of the track, as they were when the snapshot began, to the parity and the local parity.  The
+        /// clusters are read a run at a time into one buffer and added in one call, so a geometry with a run kernel, template or
+        /// generated, is encoded through it.  Clusters the parity already holds, as after a checkpoint is loaded, are skipped.
+        /// progress, if given, is called with the index of each cluster once it is read, and returns false to stop; the clusters
+        /// read by then are added either way.  Returns false if progress stopped it.
+        /// </summary>
+        private bool encodeDataClusters(ClusterSnapshot snapshot, Parity p, LocalParity lp, Func<int, bool> progress = null) {
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+            int runLength = Math.Max(1, p.RunLength);
+            byte[] run = new byte[runLength * bytesPerCluster];
+            List<int> offsets = new List<int>(runLength);
+            List<int> exponents = new List<int>(runLength);
+
+            int codewordExponent = Configuration.Geometry.DataClustersPerTrack + Configuration.Geometry.GlobalParityClustersPerTrack - 1;
+            int dataIndex = 0;
+            bool isStopped = false;
+            foreach (var absoluteClusterNumber in DataClusters) {
+                ClusterState state = snapshot.GetState(absoluteClusterNumber);
+                // Unwritten clusters are slices of zeros, which add nothing to the parity
+                if (!state.IsSystem() && !state.IsUnwritten() && !p.IsCalculated(codewordExponent)) {
+                    int offset = offsets.Count * bytesPerCluster;
+                    loadSnapshotCluster(snapshot, absoluteClusterNumber, run, offset);
+                    lp?.Calculate(run, offset, dataIndex);
+                    offsets.Add(offset);
+                    exponents.Add(codewordExponent);
+
+                    if (offsets.Count == runLength) {
+                        p.CalculateRun(run, offsets.ToArray(), exponents.ToArray());
+                        offsets.Clear();
+                        exponents.Clear();
+                    }
+                }
+
+                if (progress != null && !progress(dataIndex)) {
+                    isStopped = true;
+                    break;
+                }
+                codewordExponent--;
+                dataIndex++;
+            }
+
+            if (offsets.Count > 0) p.CalculateRun(run, offsets.ToArray(), exponents.ToArray());
+            return !isStopped;
+        }
+
+        /// <summary>
+        /// The bytes of a data cluster as the parity sees them.  Unwritten clusters are not on the disk, and read as zeros.
+        /// </summary>
+        private byte[] loadDataCluster(int absoluteClusterNumber, int bytesPerCluster) {
+            byte[] bytes = new byte[bytesPerCluster];
+            if (!_fileSystem.GetClusterState(absoluteClusterNumber).IsUnwritten()) {
+                Cluster c = new Cluster(absoluteClusterNumber, bytesPerCluster);
+                Console.WriteLine($"Loading cluster {absoluteClusterNumber}");
+                _fileSystem.ClusterIO.Load(c);
+                c.Save(bytes, 0);
+            }
+            return bytes;
+        }
+
         private FileSystem _fileSystem;
         private int _trackNumber;
+
+        private static readonly ConcurrentBag<byte[]> _scrubBuffers = new ConcurrentBag<byte[]>();
     }
 }
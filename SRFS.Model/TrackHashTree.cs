@@ -0,0 +1,163 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Security.Cryptography;
+using System.Threading.Tasks;
+
+namespace SRFS.Model {
+
+    /// <summary>
+    /// A Merkle tree over the cluster hashes of one track, so that the hashes of a whole track are vouched for by one root.
+    /// 
+    /// The tree is kept as a heap: node 1 is the root, the children of node i are 2i and 2i+1, and the leaves start at the
+    /// first power of two at least the leaf count.  A leaf node is the SHA256 of a zero byte and the cluster hash, and an inner
+    /// node the SHA256 of a one byte and its two children, so a leaf can never pass for an inner node.  Leaves past the leaf
+    /// count, and leaves never set, are all zero bytes.  Setting a leaf hashes again only the nodes on its path to the root.
+    /// </summary>
+    public class TrackHashTree {
+
+        // Public
+        #region Constructors
+
+        public TrackHashTree(int leafCount) {
+            if (leafCount < 1) throw new ArgumentOutOfRangeException(nameof(leafCount));
+
+            _leafCount = leafCount;
+            _firstLeaf = 1;
+            while (_firstLeaf < leafCount) _firstLeaf *= 2;
+
+            _nodes = new byte[2 * _firstLeaf][];
+            _leaves = new byte[leafCount][];
+            for (int i = 0; i < leafCount; i++) _leaves[i] = new byte[Constants.HashLength];
+            for (int i = _firstLeaf; i < 2 * _firstLeaf; i++) _nodes[i] = new byte[Constants.HashLength];
+            for (int i = 0; i < leafCount; i++) _nodes[_firstLeaf + i] = hashLeaf(_hasher, _leaves[i]);
+            for (int i = _firstLeaf - 1; i >= 1; i--) _nodes[i] = hashNode(_hasher, _nodes[2 * i], _nodes[2 * i + 1]);
+        }
+
+        #endregion
+        #region Properties
+
+        public int LeafCount => _leafCount;
+
+        /// <summary>
+        /// The root of the tree, which is what the parity clusters of the track sign.
+        /// </summary>
+        public byte[] Root {
+            get {
+                lock (_lock) return (byte[])_nodes[1].Clone();
+            }
+        }
+
+        #endregion
+        #region Methods
+
+        public byte[] GetLeaf(int index) {
+            lock (_lock) return (byte[])_leaves[index].Clone();
+        }
+
+        /// <summary>
+        /// Sets the cluster hash of a leaf and updates the nodes above it.
+        /// </summary>
+        public void SetLeaf(int index, byte[] hash) {
+            if (index < 0 || index >= _leafCount) throw new ArgumentOutOfRangeException(nameof(index));
+            if (hash == null) throw new ArgumentNullException(nameof(hash));
+            if (hash.Length != Constants.HashLength) throw new ArgumentException();
+
+            lock (_lock) {
+                if (_leaves[index].SequenceEqual(hash)) return;
+                _leaves[index] = (byte[])hash.Clone();
+
+                int node = _firstLeaf + index;
+                _nodes[node] = hashLeaf(_hasher, hash);
+                for (node /= 2; node >= 1; node /= 2) _nodes[node] = hashNode(_hasher, _nodes[2 * node], _nodes[2 * node + 1]);
+            }
+        }
+
+        /// <summary>
+        /// Whether the tree has this root, so the leaves are the hashes that were signed with it.
+        /// </summary>
+        public bool HasRoot(byte[] root) {
+            lock (_lock) return root != null && _nodes[1].SequenceEqual(root);
+        }
+
+        /// <summary>
+        /// Compares the leaves with the hashes clusterHash gives for them, such as hashes computed again from the device, and
+        /// returns the indexes of the leaves that differ, in order.  clusterHash returns null for a cluster that is not to be
+        /// compared.  The leaves are split into the given number of subtrees, rounded down to a power of two, and each subtree is
+        /// rebuilt from the new hashes on a thread of its own; only a subtree whose root differs is compared leaf by leaf.
+        /// </summary>
+        public IList<int> FindChangedLeaves(Func<int, byte[]> clusterHash, int subtreeCount) {
+            if (clusterHash == null) throw new ArgumentNullException(nameof(clusterHash));
+
+            int subtrees = 1;
+            while (subtrees * 2 <= Math.Min(subtreeCount, _firstLeaf)) subtrees *= 2;
+            int subtreeLeaves = _firstLeaf / subtrees;
+
+            var changed = new List<int>[subtrees];
+            Parallel.For(0, subtrees, s => {
+                changed[s] = new List<int>();
+
+                int first = s * subtreeLeaves;
+                int count = Math.Max(0, Math.Min(subtreeLeaves, _leafCount - first));
+                if (count == 0) return;
+
+                byte[][] hashes = new byte[count][];
+                for (int i = 0; i < count; i++) hashes[i] = clusterHash(first + i) ?? GetLeaf(first + i);
+
+                using (var hasher = SHA256.Create()) {
+                    byte[][] level = new byte[subtreeLeaves][];
+                    for (int i = 0; i < subtreeLeaves; i++) {
+                        level[i] = i < count ? hashLeaf(hasher, hashes[i]) : _nodes[_firstLeaf + first + i];
+                    }
+                    for (int width = subtreeLeaves / 2; width >= 1; width /= 2) {
+                        for (int i = 0; i < width; i++) level[i] = hashNode(hasher, level[2 * i], level[2 * i + 1]);
+                    }
+
+                    lock (_lock) {
+                        if (_nodes[subtrees + s].SequenceEqual(level[0])) return;
+                        for (int i = 0; i < count; i++) {
+                            if (!_leaves[first + i].SequenceEqual(hashes[i])) changed[s].Add(first + i);
+                        }
+                    }
+                }
+            });
+
+            return changed.SelectMany(c => c).ToList();
+        }
+
+        #endregion
+
+        // Private
+        #region Methods
+
+        private static byte[] hashLeaf(HashAlgorithm hasher, byte[] hash) {
+            hasher.Initialize();
+            hasher.TransformBlock(_leafPrefix, 0, 1, null, 0);
+            hasher.TransformFinalBlock(hash, 0, hash.Length);
+            return hasher.Hash;
+        }
+
+        private static byte[] hashNode(HashAlgorithm hasher, byte[] left, byte[] right) {
+            hasher.Initialize();
+            hasher.TransformBlock(_nodePrefix, 0, 1, null, 0);
+            hasher.TransformBlock(left, 0, left.Length, null, 0);
+            hasher.TransformFinalBlock(right, 0, right.Length);
+            return hasher.Hash;
+        }
+
+        #endregion
+        #region Fields
+
+        private static readonly byte[] _leafPrefix = new byte[] { 0 };
+        private static readonly byte[] _nodePrefix = new byte[] { 1 };
+
+        private readonly int _leafCount;
+        private readonly int _firstLeaf;
+        private readonly byte[][] _nodes;
+        private readonly byte[][] _leaves;
+        private readonly HashAlgorithm _hasher = SHA256.Create();
+        private readonly object _lock = new object();
+
+        #endregion
+    }
+}
@@ -0,0 +1,66 @@
+﻿using System;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// Writes and reads the saved accumulator state of <see cref="Parity"/> and <see cref="Syndrome"/> through a memory-mapped
+    /// file, so the native code serializes straight into the mapping.  The state follows a tag chosen by the caller, such as the
+    /// hash root of the data it was accumulated from, and a checkpoint whose tag differs is not loaded.
+    /// </summary>
+    internal static unsafe class AccumulatorCheckpoint {
+
+        internal delegate void SaveState(byte* buffer);
+        internal delegate bool LoadState(byte* buffer, uint length);
+
+        public static void Save(string path, byte[] tag, long size, SaveState save) {
+            if (tag == null) tag = new byte[0];
+            long headerSize = sizeof(int) + tag.Length;
+
+            using (var file = MemoryMappedFile.CreateFromFile(path, FileMode.Create, null, headerSize + size))
+            using (var view = file.CreateViewAccessor(0, headerSize + size)) {
+                byte* p = null;
+                view.SafeMemoryMappedViewHandle.AcquirePointer(ref p);
+                try {
+                    p += view.PointerOffset;
+                    *(int*)p = tag.Length;
+                    Marshal.Copy(tag, 0, (IntPtr)(p + sizeof(int)), tag.Length);
+                    save(p + headerSize);
+                } finally {
+                    view.SafeMemoryMappedViewHandle.ReleasePointer();
+                }
+                view.Flush();
+            }
+        }
+
+        /// <summary>
+        /// Loads a checkpoint saved with the same tag.  Returns false without calling load if there is none or its tag differs.
+        /// </summary>
+        public static bool Load(string path, byte[] tag, LoadState load) {
+            if (!File.Exists(path)) return false;
+            if (tag == null) tag = new byte[0];
+
+            long size = new FileInfo(path).Length;
+            long headerSize = sizeof(int) + tag.Length;
+            if (size <= headerSize) return false;
+
+            using (var file = MemoryMappedFile.CreateFromFile(path, FileMode.Open, null, 0, MemoryMappedFileAccess.Read))
+            using (var view = file.CreateViewAccessor(0, size, MemoryMappedFileAccess.Read)) {
+                byte* p = null;
+                view.SafeMemoryMappedViewHandle.AcquirePointer(ref p);
+                try {
+                    p += view.PointerOffset;
+                    if (*(int*)p != tag.Length) return false;
+                    for (int i = 0; i < tag.Length; i++) {
+                        if (p[sizeof(int) + i] != tag[i]) return false;
+                    }
+                    return load(p + headerSize, (uint)(size - headerSize));
+                } finally {
+                    view.SafeMemoryMappedViewHandle.ReleasePointer();
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,98 @@
+﻿using System;
+using System.Runtime.InteropServices;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace SRFS.ReedSolomon {
+
+    public enum AdaptiveRepairStrategy {
+        /// <summary>One erasure, rebuilt as the XOR of the survivors.</summary>
+        Xor = 0,
+        /// <summary>Only parity erased, encoded again from the data.</summary>
+        Reencode = 1,
+        /// <summary>As many syndromes as there are erasures.</summary>
+        Decode = 2
+    }
+
+    /// <summary>
+    /// Rebuilds a known set of erased slices with work that scales with the number of erasures rather than the parity count.
+    /// Survivors for which <see cref="IsNeeded"/> returns false need not be read.
+    /// </summary>
+    public unsafe class AdaptiveRepair : IDisposable {
+
+        public AdaptiveRepair(int nDataCodewords, int nParityCodewords, int codewordsPerSlice, IEnumerable<int> errorExponents) {
+            int[] e = errorExponents.ToArray();
+            fixed (int* pE = e) {
+                _rsp = AdaptiveRepair_Construct((uint)nDataCodewords, (uint)nParityCodewords, (uint)codewordsPerSlice, pE, e.Length);
+            }
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                AdaptiveRepair_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~AdaptiveRepair() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        public void Reset() => AdaptiveRepair_Reset(_rsp);
+
+        public AdaptiveRepairStrategy Strategy => (AdaptiveRepairStrategy)AdaptiveRepair_GetStrategy(_rsp);
+
+        public bool IsNeeded(int exponent) => AdaptiveRepair_IsNeeded(_rsp, (uint)exponent);
+
+        public void AddCodewordSlice(byte[] data, int offset, int exponent) {
+            fixed (byte* pData = data) {
+                AdaptiveRepair_AddCodewordSlice(_rsp, (ushort*)(pData + offset), (uint)exponent);
+            }
+        }
+
+        public void AddCodewordSlice(ushort[] data, int offset, int exponent) {
+            fixed (ushort* pData = data) {
+                AdaptiveRepair_AddCodewordSlice(_rsp, pData + offset, (uint)exponent);
+            }
+        }
+
+        public void GetCorrection(int errorExponentIndex, byte[] data, int offset) {
+            fixed (byte* pData = data) AdaptiveRepair_GetCorrection(_rsp, errorExponentIndex, (ushort*)(pData + offset));
+        }
+
+        public void GetCorrection(int errorExponentIndex, ushort[] data, int offset) {
+            fixed (ushort* pData = data) AdaptiveRepair_GetCorrection(_rsp, errorExponentIndex, pData + offset);
+        }
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr AdaptiveRepair_Construct(uint nDataCodewords, uint nParityCodewords, uint codewordsPerSlice, int* errorLocations, int errorCount);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void AdaptiveRepair_Destruct(IntPtr repair);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void AdaptiveRepair_Reset(IntPtr repair);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int AdaptiveRepair_GetStrategy(IntPtr repair);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool AdaptiveRepair_IsNeeded(IntPtr repair, uint exponent);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void AdaptiveRepair_AddCodewordSlice(IntPtr repair, ushort* data, uint exponent);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void AdaptiveRepair_GetCorrection(IntPtr repair, int errorExponentIndex, ushort* data);
+    }
+}
@@ -0,0 +1,35 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// The native pool of 64-byte aligned buffers used by the codec and by <see cref="PinnedBuffer"/>.
+    /// </summary>
+    public static class BufferPool {
+
+        /// <summary>
+        /// Back new pool arenas with large pages.  Returns false if the process cannot use large pages, in which case the pool
+        /// continues to use normal pages.
+        /// </summary>
+        public static bool EnableLargePages(bool enable) => BufferPool_EnableLargePages(enable);
+
+        /// <summary>
+        /// Return free buffers of 2 MB and larger to the operating system.
+        /// </summary>
+        public static void Trim() => BufferPool_Trim();
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        internal static extern IntPtr BufferPool_Allocate(uint bytes);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        internal static extern void BufferPool_Free(IntPtr p, uint bytes);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void BufferPool_Trim();
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool BufferPool_EnableLargePages([MarshalAs(UnmanagedType.I1)] bool enable);
+    }
+}
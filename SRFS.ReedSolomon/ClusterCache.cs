@@ -0,0 +1,160 @@
+﻿using System;
+using System.IO;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ClusterCacheStats {
+        public ulong Hits;
+        public ulong Misses;
+        public ulong Evictions;
+        public ulong Entries;
+        public ulong Bytes;
+    }
+
+    /// <summary>
+    /// A native, byte-budgeted cache of cluster images, spread over independently locked shards and evicted with CLOCK.  Images are
+    /// copied in with <see cref="Put"/> and read back in place through a <see cref="ClusterCacheHandle"/>, which keeps the image
+    /// alive until it is disposed even if the entry is replaced or evicted.
+    /// </summary>
+    public unsafe class ClusterCache : IDisposable {
+
+        public ClusterCache(int capacityBytes, int shardCount = DefaultShardCount) {
+            if (capacityBytes < 0) throw new ArgumentOutOfRangeException(nameof(capacityBytes));
+            if (shardCount < 1) throw new ArgumentOutOfRangeException(nameof(shardCount));
+            _rsp = ClusterCache_Construct((uint)capacityBytes, (uint)shardCount);
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                ClusterCache_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~ClusterCache() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        public const int DefaultShardCount = 16;
+
+        /// <summary>
+        /// Copies an image into the cache, replacing the entry for the key.  Returns false if the image could not be cached, in
+        /// which case any older entry for the key has still been removed.
+        /// </summary>
+        public bool Put(long key, byte[] bytes, int offset, int count) {
+            if (offset < 0 || count < 0 || offset + count > bytes.Length) throw new ArgumentOutOfRangeException();
+            fixed (byte* p = bytes) return ClusterCache_Put(_rsp, key, p + offset, (uint)count);
+        }
+
+        /// <summary>
+        /// Pins the image for a key.  The handle must be disposed once the image has been read.
+        /// </summary>
+        public bool TryGet(long key, out ClusterCacheHandle handle) {
+            byte* data;
+            UIntPtr length;
+            IntPtr entry = ClusterCache_Acquire(_rsp, key, &data, &length);
+            handle = entry == IntPtr.Zero ? null : new ClusterCacheHandle(this, entry, data, (int)length.ToUInt32());
+            return handle != null;
+        }
+
+        public void Remove(long key) => ClusterCache_Remove(_rsp, key);
+
+        public void Clear() => ClusterCache_Clear(_rsp);
+
+        public ClusterCacheStats Stats {
+            get {
+                ClusterCacheStats stats;
+                ClusterCache_GetStats(_rsp, &stats);
+                return stats;
+            }
+        }
+
+        internal void Release(IntPtr entry) => ClusterCache_Release(_rsp, entry);
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr ClusterCache_Construct(uint capacityBytes, uint shardCount);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void ClusterCache_Destruct(IntPtr cache);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ClusterCache_Put(IntPtr cache, long key, byte* data, uint length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr ClusterCache_Acquire(IntPtr cache, long key, byte** data, UIntPtr* length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void ClusterCache_Release(IntPtr cache, IntPtr entry);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void ClusterCache_Remove(IntPtr cache, long key);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void ClusterCache_Clear(IntPtr cache);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void ClusterCache_GetStats(IntPtr cache, ClusterCacheStats* stats);
+    }
+
+    /// <summary>
+    /// A pinned image in a <see cref="ClusterCache"/>.  The memory is owned by the cache and is valid until the handle is disposed.
+    /// </summary>
+    public unsafe class ClusterCacheHandle : IDisposable {
+
+        internal ClusterCacheHandle(ClusterCache cache, IntPtr entry, byte* data, int length) {
+            _cache = cache;
+            _entry = entry;
+            _data = data;
+            _length = length;
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                _cache.Release(_entry);
+                isDisposed = true;
+            }
+        }
+
+        ~ClusterCacheHandle() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        public int Length => _length;
+
+        public byte* Pointer => _data;
+
+        /// <summary>
+        /// A read-only stream over the image, valid until the handle is disposed.
+        /// </summary>
+        public Stream OpenStream() => new UnmanagedMemoryStream(_data, _length);
+
+        public void CopyTo(int offset, byte[] destination, int destinationOffset, int count) {
+            if (offset < 0 || count < 0 || offset + count > _length) throw new ArgumentOutOfRangeException();
+            Marshal.Copy((IntPtr)(_data + offset), destination, destinationOffset, count);
+        }
+
+        private bool isDisposed = false;
+        private ClusterCache _cache;
+        private IntPtr _entry;
+        private byte* _data;
+        private int _length;
+    }
+}
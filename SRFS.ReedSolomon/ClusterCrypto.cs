@@ -0,0 +1,193 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ClusterCryptoStats {
+        public ulong Hits;
+        public ulong Misses;
+        public ulong Evictions;
+        public ulong Entries;
+    }
+
+    /// <summary>
+    /// Native AES-256-CBC with AES-NI, over a cache of derived keys and their expanded key schedules.  Keys are derived by the
+    /// caller and cached under an id of its choosing with <see cref="AddKey"/>.  Every call that needs a key returns false if it
+    /// is not cached, or if the processor has no AES-NI, so the caller derives it, adds it and tries again, or falls back to CNG.
+    /// All calls encrypt or decrypt in whole 16-byte blocks, with no padding.
+    /// </summary>
+    public unsafe class ClusterCrypto : IDisposable {
+
+        public ClusterCrypto(int capacity) {
+            if (capacity < 1) throw new ArgumentOutOfRangeException(nameof(capacity));
+            _rsp = ClusterCrypto_Construct((uint)capacity);
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                ClusterCrypto_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~ClusterCrypto() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        public const int KeyLength = 32;
+        public const int BlockLength = 16;
+
+        /// <summary>
+        /// The most buffers <see cref="EncryptMany"/> encrypts side by side.
+        /// </summary>
+        public const int MaxLanes = 8;
+
+        public static bool IsSupported => ClusterCrypto_IsSupported();
+
+        public void AddKey(byte[] id, byte[] key) {
+            if (id == null) throw new ArgumentNullException(nameof(id));
+            if (key == null) throw new ArgumentNullException(nameof(key));
+            if (key.Length != KeyLength) throw new ArgumentException();
+            fixed (byte* pi = id, pk = key) ClusterCrypto_AddKey(_rsp, pi, (uint)id.Length, pk);
+        }
+
+        public bool HasKey(byte[] id) {
+            if (id == null) throw new ArgumentNullException(nameof(id));
+            fixed (byte* pi = id) return ClusterCrypto_HasKey(_rsp, pi, (uint)id.Length);
+        }
+
+        /// <summary>
+        /// Encrypts count bytes in place.
+        /// </summary>
+        public bool Encrypt(byte[] id, byte[] iv, byte[] bytes, int offset, int count) {
+            if (id == null) throw new ArgumentNullException(nameof(id));
+            checkIV(iv);
+            checkRange(bytes, offset, count);
+            fixed (byte* pi = id, pv = iv, pb = bytes) return ClusterCrypto_Encrypt(_rsp, pi, (uint)id.Length, pv, pb + offset, pb + offset, (uint)count);
+        }
+
+        /// <summary>
+        /// Encrypts count bytes in place in each of several buffers, under the same key and each with its own IV.
+        /// </summary>
+        public bool EncryptMany(byte[] id, IList<byte[]> ivs, IList<byte[]> buffers, IList<int> offsets, int count) {
+            if (id == null) throw new ArgumentNullException(nameof(id));
+            if (ivs.Count != buffers.Count || offsets.Count != buffers.Count) throw new ArgumentException();
+            for (int i = 0; i < buffers.Count; i++) {
+                checkIV(ivs[i]);
+                checkRange(buffers[i], offsets[i], count);
+            }
+
+            var handles = new List<GCHandle>(2 * buffers.Count);
+            try {
+                byte** pivs = stackalloc byte*[buffers.Count];
+                byte** pbuffers = stackalloc byte*[buffers.Count];
+                for (int i = 0; i < buffers.Count; i++) {
+                    GCHandle iv = GCHandle.Alloc(ivs[i], GCHandleType.Pinned);
+                    handles.Add(iv);
+                    GCHandle buffer = GCHandle.Alloc(buffers[i], GCHandleType.Pinned);
+                    handles.Add(buffer);
+
+                    pivs[i] = (byte*)iv.AddrOfPinnedObject();
+                    pbuffers[i] = (byte*)buffer.AddrOfPinnedObject() + offsets[i];
+                }
+
+                fixed (byte* pi = id) {
+                    return ClusterCrypto_EncryptMany(_rsp, pi, (uint)id.Length, (uint)buffers.Count, pivs, pbuffers, pbuffers, (uint)count);
+                }
+            } finally {
+                foreach (var handle in handles) handle.Free();
+            }
+        }
+
+        public bool Decrypt(byte[] id, byte[] iv, byte[] source, int sourceOffset, byte[] destination, int destinationOffset, int count) {
+            if (id == null) throw new ArgumentNullException(nameof(id));
+            checkIV(iv);
+            checkRange(source, sourceOffset, count);
+            checkRange(destination, destinationOffset, count);
+            fixed (byte* pi = id, pv = iv, ps = source, pd = destination) {
+                return ClusterCrypto_Decrypt(_rsp, pi, (uint)id.Length, pv, ps + sourceOffset, pd + destinationOffset, (uint)count, null);
+            }
+        }
+
+        /// <summary>
+        /// Decrypts, and extends a checksum returned by <see cref="Crc32c"/> over the cipher text as it goes, so the bytes are
+        /// read once for both.  The checksum is unchanged if this returns false.
+        /// </summary>
+        public bool Decrypt(byte[] id, byte[] iv, byte[] source, int sourceOffset, byte[] destination, int destinationOffset, int count,
+            ref uint checksum) {
+
+            if (id == null) throw new ArgumentNullException(nameof(id));
+            checkIV(iv);
+            checkRange(source, sourceOffset, count);
+            checkRange(destination, destinationOffset, count);
+            fixed (byte* pi = id, pv = iv, ps = source, pd = destination)
+            fixed (uint* pc = &checksum) {
+                return ClusterCrypto_Decrypt(_rsp, pi, (uint)id.Length, pv, ps + sourceOffset, pd + destinationOffset, (uint)count, pc);
+            }
+        }
+
+        public ClusterCryptoStats Stats {
+            get {
+                ClusterCryptoStats stats;
+                ClusterCrypto_GetStats(_rsp, &stats);
+                return stats;
+            }
+        }
+
+        private static void checkIV(byte[] iv) {
+            if (iv == null) throw new ArgumentNullException(nameof(iv));
+            if (iv.Length != BlockLength) throw new ArgumentException();
+        }
+
+        private static void checkRange(byte[] bytes, int offset, int count) {
+            if (bytes == null) throw new ArgumentNullException(nameof(bytes));
+            if (offset < 0 || count < 0 || offset + count > bytes.Length) throw new ArgumentOutOfRangeException();
+            if (count % BlockLength != 0) throw new ArgumentException();
+        }
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr ClusterCrypto_Construct(uint capacity);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void ClusterCrypto_Destruct(IntPtr crypto);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ClusterCrypto_IsSupported();
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void ClusterCrypto_AddKey(IntPtr crypto, byte* id, uint idLength, byte* key);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ClusterCrypto_HasKey(IntPtr crypto, byte* id, uint idLength);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ClusterCrypto_Encrypt(IntPtr crypto, byte* id, uint idLength, byte* iv, byte* source, byte* dest, uint length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ClusterCrypto_EncryptMany(IntPtr crypto, byte* id, uint idLength, uint count, byte** ivs, byte** sources,
+            byte** dests, uint length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ClusterCrypto_Decrypt(IntPtr crypto, byte* id, uint idLength, byte* iv, byte* source, byte* dest, uint length,
+            uint* checksum);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void ClusterCrypto_GetStats(IntPtr crypto, ClusterCryptoStats* stats);
+    }
+}
@@ -0,0 +1,110 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    public enum CodecOperation : uint {
+        Encode = 1,
+        Verify = 2,
+        Repair = 3
+    }
+
+    public enum CodecResult : int {
+        OK = 0,
+        Damaged = 1,
+        Invalid = -1
+    }
+
+    /// <summary>
+    /// A client of a codec service, which runs the encode, verify and repair jobs of every volume mounted on the host on one shared
+    /// pool of threads.  The service is started by name, with rsprotect serve or a <see cref="CodecService"/>.  Jobs from several
+    /// threads may be in flight at once.
+    /// </summary>
+    public unsafe class CodecClient : IDisposable {
+
+        public CodecClient(string name) {
+            if (name == null) throw new ArgumentNullException(nameof(name));
+            _rsp = CodecClient_Construct(name);
+            if (_rsp == IntPtr.Zero) throw new InvalidOperationException($"Codec service {name} is not running or has no free queue");
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                CodecClient_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~CodecClient() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        /// <summary>
+        /// The most bytes of slices and erasures one job may have
+        /// </summary>
+        public int SlotBytes => (int)CodecClient_GetSlotBytes(_rsp);
+
+        /// <summary>
+        /// Runs a job on a track held in slices: nData data slices then nParity parity slices, each bytesPerSlice long.  Encode
+        /// writes the parity slices, and Repair rebuilds the slices whose exponents are in errors; slice i has exponent
+        /// nData + nParity - 1 - i.
+        /// </summary>
+        public CodecResult Run(CodecOperation operation, int nData, int nParity, int bytesPerSlice, byte[] slices, int[] errors = null) {
+            if (slices == null) throw new ArgumentNullException(nameof(slices));
+            if (nData <= 0 || nParity <= 0 || bytesPerSlice <= 0 || bytesPerSlice % 16 != 0) throw new ArgumentException();
+            int sliceBytes = (nData + nParity) * bytesPerSlice;
+            int errorCount = errors?.Length ?? 0;
+            if (slices.Length < sliceBytes) throw new ArgumentException();
+            if (sliceBytes + errorCount * sizeof(int) > SlotBytes) throw new ArgumentException("The job does not fit a slot of the codec service");
+
+            uint slot;
+            byte* payload = CodecClient_Acquire(_rsp, &slot);
+            try {
+                Marshal.Copy(slices, 0, (IntPtr)payload, sliceBytes);
+                if (errorCount > 0) Marshal.Copy(errors, 0, (IntPtr)(payload + sliceBytes), errorCount);
+
+                // The queue of a client has one producer, so submits from several threads take turns
+                lock (_submitLock) {
+                    CodecClient_Submit(_rsp, slot, (uint)operation, (uint)nData, (uint)nParity, (uint)bytesPerSlice, (uint)errorCount);
+                }
+                CodecResult result = (CodecResult)CodecClient_Wait(_rsp, slot);
+                if (result == CodecResult.OK && operation != CodecOperation.Verify) Marshal.Copy((IntPtr)payload, slices, 0, sliceBytes);
+                return result;
+            } finally {
+                CodecClient_Release(_rsp, slot);
+            }
+        }
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+        private readonly object _submitLock = new object();
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr CodecClient_Construct([MarshalAs(UnmanagedType.LPStr)] string name);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void CodecClient_Destruct(IntPtr client);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint CodecClient_GetSlotBytes(IntPtr client);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern byte* CodecClient_Acquire(IntPtr client, uint* slot);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void CodecClient_Submit(IntPtr client, uint slot, uint operation, uint nData, uint nParity, uint bytesPerSlice,
+            uint errorCount);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int CodecClient_Wait(IntPtr client, uint slot);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void CodecClient_Release(IntPtr client, uint slot);
+    }
+}
@@ -0,0 +1,58 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// A codec service hosted in this process, as rsprotect serve hosts one, for <see cref="CodecClient"/>s of this process or
+    /// others to attach to by name.
+    /// </summary>
+    public class CodecService : IDisposable {
+
+        /// <summary>
+        /// Creates the ring of the service and starts its workers.  A thread count of 0 uses every hardware thread.
+        /// </summary>
+        public CodecService(string name, int slotCount, int slotBytes, int maxClients, int threads = 0) {
+            if (name == null) throw new ArgumentNullException(nameof(name));
+            if (slotCount <= 0 || slotBytes <= 0 || maxClients <= 0 || threads < 0) throw new ArgumentException();
+            _rsp = CodecService_Construct(name, (uint)slotCount, (uint)slotBytes, (uint)maxClients, (uint)threads);
+            if (_rsp == IntPtr.Zero) throw new InvalidOperationException($"Codec service {name} could not be created");
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                CodecService_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~CodecService() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        /// <summary>
+        /// Stops the workers after the jobs they are running.  A client waiting on a job that has not run gets
+        /// <see cref="CodecResult.Invalid"/>.
+        /// </summary>
+        public void Stop() => CodecService_Stop(_rsp);
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr CodecService_Construct([MarshalAs(UnmanagedType.LPStr)] string name, uint slotCount, uint slotBytes,
+            uint maxClients, uint threads);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void CodecService_Destruct(IntPtr service);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void CodecService_Stop(IntPtr service);
+    }
+}
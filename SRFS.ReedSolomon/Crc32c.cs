@@ -0,0 +1,32 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// CRC-32C computed natively with the SSE4.2 CRC instruction.  It is far cheaper than a hash, and is used to tell intact data
+    /// from damaged data before paying for cryptographic verification.
+    /// </summary>
+    public static unsafe class Crc32c {
+
+        public static uint Compute(byte[] data, int offset, int count) {
+            if (offset < 0 || count < 0 || offset + count > data.Length) throw new ArgumentOutOfRangeException();
+            fixed (byte* p = data) return Crc32c_Compute(p + offset, (uint)count);
+        }
+
+        /// <summary>
+        /// Extends a checksum returned by <see cref="Compute"/> over more data, so that Update(Compute(a), b) == Compute(a + b).
+        /// The checksum of no data is zero.
+        /// </summary>
+        public static uint Update(uint crc, byte[] data, int offset, int count) {
+            if (offset < 0 || count < 0 || offset + count > data.Length) throw new ArgumentOutOfRangeException();
+            fixed (byte* p = data) return Crc32c_Update(crc, p + offset, (uint)count);
+        }
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint Crc32c_Compute(byte* data, uint length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint Crc32c_Update(uint crc, byte* data, uint length);
+    }
+}
@@ -0,0 +1,79 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// XOR parity over contiguous groups of data slices.  A single lost slice in a group is repaired by adding the surviving
+    /// slices of the group and the group parity, then reading the group parity back.
+    /// </summary>
+    public unsafe class LocalParity : IDisposable {
+
+        public LocalParity(int nDataCodewords, int nGroups, int codewordsPerSlice) {
+            _rsp = LocalParity_Construct((uint)nDataCodewords, (uint)nGroups, (uint)codewordsPerSlice);
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                LocalParity_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~LocalParity() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        public void Reset() => LocalParity_Reset(_rsp);
+
+        public int GetGroup(int dataIndex) => (int)LocalParity_GetGroup(_rsp, (uint)dataIndex);
+
+        public void Calculate(byte[] data, int offset, int dataIndex) {
+            fixed (byte* pData = data) {
+                LocalParity_Calculate(_rsp, (ushort*)(pData + offset), (uint)dataIndex);
+            }
+        }
+
+        public void AddParity(byte[] data, int offset, int group) {
+            fixed (byte* pData = data) {
+                LocalParity_AddParity(_rsp, (ushort*)(pData + offset), (uint)group);
+            }
+        }
+
+        public void GetParity(byte[] data, int offset, int group) {
+            fixed (byte* pData = data) {
+                LocalParity_GetParity(_rsp, (ushort*)(pData + offset), (uint)group);
+            }
+        }
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr LocalParity_Construct(uint nDataCodewords, uint nGroups, uint codewordsPerSlice);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void LocalParity_Destruct(IntPtr p);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void LocalParity_Reset(IntPtr p);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void LocalParity_Calculate(IntPtr p, ushort* data, uint dataIndex);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void LocalParity_AddParity(IntPtr p, ushort* data, uint group);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void LocalParity_GetParity(IntPtr p, ushort* data, uint group);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint LocalParity_GetGroup(IntPtr p, uint dataIndex);
+    }
+}
@@ -40,6 +40,75 @@ namespace SRFS.ReedSolomon {
             }
         }
 
+        public void Calculate(PinnedBuffer data, int offset, int exponent) {
+            Parity_Calculate(_rsp, (ushort*)(data.Pointer + offset), (uint)exponent);
+        }
+
+        /// <summary>
+        /// Add several data slices in one call.  Where the geometry has a run kernel, generated by <see cref="ParityJit"/> or
+        /// compiled for 4, 8, 16 and 32 parity codewords, the slices are combined a few at a time with the parity held in
+        /// registers, which is faster than calling <see cref="Calculate"/> for each.
+        /// </summary>
+        public void CalculateRun(PinnedBuffer[] data, int offset, int[] exponents) {
+            if (data.Length != exponents.Length) throw new ArgumentException("There must be one exponent per slice", nameof(exponents));
+
+            ushort** pData = stackalloc ushort*[data.Length];
+            UIntPtr* pExponents = stackalloc UIntPtr[data.Length];
+            for (int i = 0; i < data.Length; i++) {
+                pData[i] = (ushort*)(data[i].Pointer + offset);
+                pExponents[i] = (UIntPtr)exponents[i];
+            }
+            Parity_CalculateRun(_rsp, pData, pExponents, (uint)data.Length);
+        }
+
+        /// <summary>
+        /// Add several data slices held in one array, slice i starting at offsets[i], through the run kernel as the
+        /// <see cref="PinnedBuffer"/> overload does.  A run of clusters can be read into one array and encoded without copying them.
+        /// </summary>
+        public void CalculateRun(byte[] data, int[] offsets, int[] exponents) {
+            if (offsets.Length != exponents.Length) {
+                throw new ArgumentException("There must be one exponent per slice", nameof(exponents));
+            }
+
+            ushort** pData = stackalloc ushort*[offsets.Length];
+            UIntPtr* pExponents = stackalloc UIntPtr[offsets.Length];
+            fixed (byte* p = data) {
+                for (int i = 0; i < offsets.Length; i++) {
+                    pData[i] = (ushort*)(p + offsets[i]);
+                    pExponents[i] = (UIntPtr)exponents[i];
+                }
+                Parity_CalculateRun(_rsp, pData, pExponents, (uint)offsets.Length);
+            }
+        }
+
+        /// <summary>
+        /// Add the same data slice at each of the exponents, as for a run of clusters known to hold the same contents.  The cost is
+        /// that of a single <see cref="Calculate"/> however many exponents there are.
+        /// </summary>
+        public void CalculateConstant(byte[] data, int offset, int[] exponents) {
+            UIntPtr* pExponents = stackalloc UIntPtr[exponents.Length];
+            for (int i = 0; i < exponents.Length; i++) pExponents[i] = (UIntPtr)exponents[i];
+            fixed (byte* pData = data) {
+                Parity_CalculateConstant(_rsp, (ushort*)(pData + offset), pExponents, (uint)exponents.Length);
+            }
+        }
+
+        /// <summary>
+        /// Add data[i] at the same exponent to parities[i] for several tracks with the same geometry.  Each coefficient table is
+        /// built once and applied to every track, instead of once per track.  Returns false, adding nothing, if the geometries differ.
+        /// </summary>
+        public static bool CalculateBatch(Parity[] parities, PinnedBuffer[] data, int offset, int exponent) {
+            if (data.Length != parities.Length) throw new ArgumentException("There must be one data slice per parity", nameof(data));
+
+            IntPtr* pParities = stackalloc IntPtr[parities.Length];
+            ushort** pData = stackalloc ushort*[data.Length];
+            for (int i = 0; i < parities.Length; i++) {
+                pParities[i] = parities[i]._rsp;
+                pData[i] = (ushort*)(data[i].Pointer + offset);
+            }
+            return Parity_CalculateBatch(pParities, pData, (uint)parities.Length, (uint)exponent);
+        }
+
         public void GetParity(byte[] data, int offset, int exponent) {
             fixed (byte* pData = data) {
                 Parity_GetParity(_rsp, (ushort*)(pData + offset), (uint)exponent);
@@ -52,6 +121,51 @@ namespace SRFS.ReedSolomon {
             }
         }
 
+        public void GetParity(PinnedBuffer data, int offset, int exponent) {
+            Parity_GetParity(_rsp, (ushort*)(data.Pointer + offset), (uint)exponent);
+        }
+
+        /// <summary>
+        /// Whether the data slice with this exponent has been added since the parity was constructed or last restored.
+        /// </summary>
+        public bool IsCalculated(int exponent) => Parity_IsCalculated(_rsp, (uint)exponent);
+
+        /// <summary>
+        /// Save the accumulated parity and the set of exponents added, so that the calculation can be resumed later.
+        /// </summary>
+        public byte[] SaveState() {
+            byte[] state = new byte[Parity_GetStateSize(_rsp)];
+            fixed (byte* pState = state) Parity_SaveState(_rsp, pState);
+            return state;
+        }
+
+        /// <summary>
+        /// Restore state saved by <see cref="SaveState"/>.  Returns false if the state does not match this geometry.
+        /// </summary>
+        public bool LoadState(byte[] state) {
+            fixed (byte* pState = state) return Parity_LoadState(_rsp, pState, (uint)state.Length);
+        }
+
+        /// <summary>
+        /// Save the accumulated state to a file, after a tag that a later <see cref="LoadCheckpoint"/> must be given to load it.
+        /// </summary>
+        public void SaveCheckpoint(string path, byte[] tag = null) =>
+            AccumulatorCheckpoint.Save(path, tag, Parity_GetStateSize(_rsp), p => Parity_SaveState(_rsp, p));
+
+        /// <summary>
+        /// Restore state saved by <see cref="SaveCheckpoint"/>.  Returns false, leaving this instance as it was, if there is no
+        /// checkpoint, it was saved with a different tag, or it does not match this geometry.
+        /// </summary>
+        public bool LoadCheckpoint(string path, byte[] tag = null) =>
+            AccumulatorCheckpoint.Load(path, tag, (p, length) => Parity_LoadState(_rsp, p, length));
+
+        /// <summary>
+        /// Add the parity accumulated by another instance with the same geometry over a disjoint set of data slices, so that one
+        /// track can be split across threads and the partial results combined.  Returns false if the geometry differs or a
+        /// slice was added to both.
+        /// </summary>
+        public bool Merge(Parity other) => Parity_Merge(_rsp, other._rsp);
+
         public uint NParityCodeWords => Parity_GetNParityCodewords(_rsp);
 
         public uint NDataCodeWords => Parity_GetNDataCodewords(_rsp);
@@ -60,6 +174,12 @@ namespace SRFS.ReedSolomon {
 
         public uint CodewordsPerSlice => Parity_GetCodewordsPerSlice(_rsp);
 
+        /// <summary>
+        /// The number of data slices the encode kernel takes at a time, or 0 if each slice is added through the tables on its own.
+        /// Generated kernels count, so this is 0 for most parity counts only where <see cref="ParityJit"/> is off or unsupported.
+        /// </summary>
+        public int RunLength => (int)Parity_GetRunLength(_rsp);
+
         internal IntPtr InternalPointer => _rsp;
 
         private bool isDisposed = false;
@@ -74,6 +194,19 @@ namespace SRFS.ReedSolomon {
         [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
         private static extern void Parity_Calculate(IntPtr rsc, ushort* data, uint exponent);
 
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Parity_CalculateRun(IntPtr rsc, ushort** data, UIntPtr* exponents, uint count);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint Parity_GetRunLength(IntPtr rsc);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Parity_CalculateConstant(IntPtr rsc, ushort* data, UIntPtr* exponents, uint count);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool Parity_CalculateBatch(IntPtr* parities, ushort** data, uint count, uint exponent);
+
         [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
         private static extern void Parity_GetParity(IntPtr rsc, ushort* data, uint exponent);
 
@@ -94,5 +227,23 @@ namespace SRFS.ReedSolomon {
 
         [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
         private static extern byte* Parity_GetFirstParityBlock(IntPtr rsc);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool Parity_IsCalculated(IntPtr rsc, uint exponent);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint Parity_GetStateSize(IntPtr rsc);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Parity_SaveState(IntPtr rsc, byte* buffer);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool Parity_LoadState(IntPtr rsc, byte* buffer, uint length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool Parity_Merge(IntPtr rsc, IntPtr other);
     }
 }
@@ -0,0 +1,47 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// Machine code generated for the geometry of a volume.  The first <see cref="Parity"/> or <see cref="Syndrome"/> for a geometry,
+    /// which at mount is the one <see cref="ParityTuner"/> times, has its encode kernel generated with the parity count and cluster
+    /// size built in; later ones reuse it.  The kernel runs wherever slices are added a run at a time through
+    /// <see cref="Parity.CalculateRun(byte[], int[], int[])"/>, which is how a track encodes its clusters.  Where code can't be
+    /// generated the compiled kernels are used instead.
+    /// </summary>
+    public static class ParityJit {
+
+        /// <summary>
+        /// Whether this process can run generated code.
+        /// </summary>
+        public static bool IsSupported => ParityJit_IsSupported();
+
+        /// <summary>
+        /// Whether new codec objects use generated kernels.  Turning it off only affects objects created afterwards.
+        /// </summary>
+        public static bool Enabled {
+            get => ParityJit_IsEnabled();
+            set => ParityJit_SetEnabled(value);
+        }
+
+        /// <summary>
+        /// The number of kernels generated so far.
+        /// </summary>
+        public static int KernelCount => (int)ParityJit_GetKernelCount();
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ParityJit_IsSupported();
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void ParityJit_SetEnabled([MarshalAs(UnmanagedType.I1)] bool enabled);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ParityJit_IsEnabled();
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint ParityJit_GetKernelCount();
+    }
+}
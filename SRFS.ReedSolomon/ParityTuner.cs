@@ -0,0 +1,73 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// The encode configuration chosen for one geometry on one CPU.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ParityTuning {
+
+        /// <summary>
+        /// Data slices per call of the register-blocked kernel, or 0 for the table kernel.
+        /// </summary>
+        public int RunLength;
+
+        /// <summary>
+        /// Encoding threads past which the throughput stops improving.
+        /// </summary>
+        public int Threads;
+    }
+
+    /// <summary>
+    /// Times the encoder variants for a geometry on this machine and remembers the fastest, keyed by CPU model and geometry, in a
+    /// profile file.  <see cref="Parity"/> objects created afterwards with a known geometry use the tuned configuration.
+    /// </summary>
+    public static unsafe class ParityTuner {
+
+        /// <summary>
+        /// Adds the entries of a profile file to the known tunings.  Returns false if the file cannot be read.
+        /// </summary>
+        public static bool LoadProfile(string path) => ParityTuner_LoadProfile(path);
+
+        /// <summary>
+        /// Writes every known tuning to a profile file.  Returns false if the file cannot be written.
+        /// </summary>
+        public static bool SaveProfile(string path) => ParityTuner_SaveProfile(path);
+
+        public static bool Find(int nDataCodewords, int nParityCodewords, int codewordsPerSlice, out ParityTuning tuning) {
+            tuning = new ParityTuning();
+            fixed (ParityTuning* p = &tuning) {
+                return ParityTuner_Find((uint)nDataCodewords, (uint)nParityCodewords, (uint)codewordsPerSlice, p);
+            }
+        }
+
+        /// <summary>
+        /// The tuning for a geometry, timing the encoder first if it is not known.  Returns true if it was timed, in which case
+        /// the profile should be saved.
+        /// </summary>
+        public static bool Tune(int nDataCodewords, int nParityCodewords, int codewordsPerSlice, out ParityTuning tuning) {
+            tuning = new ParityTuning();
+            fixed (ParityTuning* p = &tuning) {
+                return ParityTuner_Tune((uint)nDataCodewords, (uint)nParityCodewords, (uint)codewordsPerSlice, p);
+            }
+        }
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ParityTuner_LoadProfile([MarshalAs(UnmanagedType.LPStr)] string path);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ParityTuner_SaveProfile([MarshalAs(UnmanagedType.LPStr)] string path);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ParityTuner_Find(uint nDataCodewords, uint nParityCodewords, uint codewordsPerSlice, ParityTuning* tuning);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool ParityTuner_Tune(uint nDataCodewords, uint nParityCodewords, uint codewordsPerSlice, ParityTuning* tuning);
+    }
+}
@@ -0,0 +1,57 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// A buffer taken from the native <see cref="BufferPool"/>.  The memory never moves, so it can be handed to the codec without
+    /// pinning, and it goes back to the pool on dispose so that encode and verify loops can reuse it.
+    /// </summary>
+    public unsafe class PinnedBuffer : IDisposable {
+
+        public PinnedBuffer(int length) {
+            if (length < 0) throw new ArgumentOutOfRangeException(nameof(length));
+            _length = length;
+            _pointer = BufferPool.BufferPool_Allocate((uint)length);
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                BufferPool.BufferPool_Free(_pointer, (uint)_length);
+                isDisposed = true;
+            }
+        }
+
+        ~PinnedBuffer() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        public int Length => _length;
+
+        public byte* Pointer => (byte*)_pointer;
+
+        public void Clear() {
+            for (byte* p = Pointer, end = p + _length; p < end; p++) *p = 0;
+        }
+
+        public void CopyFrom(byte[] source, int sourceOffset, int offset, int count) {
+            if (offset < 0 || count < 0 || offset + count > _length) throw new ArgumentOutOfRangeException();
+            Marshal.Copy(source, sourceOffset, _pointer + offset, count);
+        }
+
+        public void CopyTo(int offset, byte[] destination, int destinationOffset, int count) {
+            if (offset < 0 || count < 0 || offset + count > _length) throw new ArgumentOutOfRangeException();
+            Marshal.Copy(_pointer + offset, destination, destinationOffset, count);
+        }
+
+        private bool isDisposed = false;
+        private IntPtr _pointer;
+        private int _length;
+    }
+}
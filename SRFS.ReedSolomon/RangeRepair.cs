@@ -0,0 +1,78 @@
+﻿using System;
+using System.Runtime.InteropServices;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// Reconstructs a range of codewords of erased slices from the same range of the surviving slices, without reading the
+    /// rest of the track.  Slices that should not be read may be listed as erasures as well.
+    /// </summary>
+    public unsafe class RangeRepair : IDisposable {
+
+        public RangeRepair(int nDataCodewords, int nParityCodewords, int codewordsPerRange, IEnumerable<int> errorExponents) {
+            int[] e = errorExponents.ToArray();
+            fixed (int* pE = e) {
+                _rsp = RangeRepair_Construct((uint)nDataCodewords, (uint)nParityCodewords, (uint)codewordsPerRange, pE, e.Length);
+            }
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                RangeRepair_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~RangeRepair() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        public void Reset() => RangeRepair_Reset(_rsp);
+
+        public void AddCodewordSlice(byte[] data, int offset, int exponent) {
+            fixed (byte* pData = data) {
+                RangeRepair_AddCodewordSlice(_rsp, (ushort*)(pData + offset), (uint)exponent);
+            }
+        }
+
+        public void AddCodewordSlice(ushort[] data, int offset, int exponent) {
+            fixed (ushort* pData = data) {
+                RangeRepair_AddCodewordSlice(_rsp, pData + offset, (uint)exponent);
+            }
+        }
+
+        public void GetCorrection(int errorExponentIndex, byte[] data, int offset) {
+            fixed (byte* pData = data) RangeRepair_GetCorrection(_rsp, errorExponentIndex, (ushort*)(pData + offset));
+        }
+
+        public void GetCorrection(int errorExponentIndex, ushort[] data, int offset) {
+            fixed (ushort* pData = data) RangeRepair_GetCorrection(_rsp, errorExponentIndex, pData + offset);
+        }
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr RangeRepair_Construct(uint nDataCodewords, uint nParityCodewords, uint codewordsPerRange, int* errorLocations, int errorCount);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void RangeRepair_Destruct(IntPtr repair);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void RangeRepair_Reset(IntPtr repair);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void RangeRepair_AddCodewordSlice(IntPtr repair, ushort* data, uint exponent);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void RangeRepair_GetCorrection(IntPtr repair, int errorExponentIndex, ushort* data);
+    }
+}
@@ -31,6 +31,17 @@ namespace SRFS.ReedSolomon {
             fixed (byte* pData = data) Repair_Correction(_rsp, errorExponentIndex, (ushort*)(pData + offset));
         }
 
+        /// <summary>
+        /// Corrects only the codeword ranges given by <see cref="Syndrome.GetDamagedRanges(int)"/>.  If the damaged slice was added
+        /// to the syndrome as it was read, data holds those bytes and is corrected in place.
+        /// </summary>
+        public void CorrectRanges(int errorExponentIndex, byte[] data, int offset, int[] ranges) {
+            fixed (byte* pData = data)
+            fixed (int* pRanges = ranges) {
+                Repair_CorrectRanges(_rsp, errorExponentIndex, (ushort*)(pData + offset), pRanges, (uint)ranges.Length / 2);
+            }
+        }
+
 
         ~Repair() {
             Dispose(false);
@@ -52,5 +63,8 @@ namespace SRFS.ReedSolomon {
 
         [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
         private static extern void Repair_Correction(IntPtr repair, int errorExponentIndex, ushort* data);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Repair_CorrectRanges(IntPtr repair, int errorExponentIndex, ushort* data, int* ranges, uint rangeCount);
     }
 }
@@ -0,0 +1,135 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// Native ECDSA verification on the NIST P-521 curve.  Each key is added once and gets precomputed tables of its multiples,
+    /// which make every later verification with it cheaper; batches are verified across all cores.  Keys must all be added before
+    /// the first verification.
+    /// </summary>
+    public unsafe class SignatureVerifier : IDisposable {
+
+        public SignatureVerifier() {
+            _rsp = SignatureVerifier_Construct();
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                SignatureVerifier_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~SignatureVerifier() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        public const int CoordinateLength = 66;
+        public const int SignatureLength = 2 * CoordinateLength;
+        public const int MaxDigestLength = 65;
+
+        /// <summary>
+        /// Adds a public key, given by its big-endian coordinates, and returns the index that verifies with it.
+        /// </summary>
+        public int AddKey(byte[] x, byte[] y) {
+            if (x == null || y == null) throw new ArgumentNullException();
+            if (x.Length != CoordinateLength || y.Length != CoordinateLength) throw new ArgumentException();
+            fixed (byte* px = x, py = y) return (int)SignatureVerifier_AddKey(_rsp, px, py);
+        }
+
+        /// <summary>
+        /// Whether signature is valid for the digest, which is the hash of the signed data.  The signature is r then s, big-endian.
+        /// </summary>
+        public bool Verify(int key, byte[] digest, byte[] signature) {
+            checkDigest(digest);
+            checkSignature(signature);
+            fixed (byte* pd = digest, ps = signature) return SignatureVerifier_Verify(_rsp, (uint)key, pd, (uint)digest.Length, ps);
+        }
+
+        /// <summary>
+        /// Verifies many signatures, each with its own key, across the given number of threads, or one per core if it is 0.  The
+        /// digests must all have the same length.
+        /// </summary>
+        public bool[] VerifyMany(IList<int> keys, IList<byte[]> digests, IList<byte[]> signatures, int threads = 0) {
+            int count = keys.Count;
+            if (digests.Count != count || signatures.Count != count) throw new ArgumentException();
+            if (threads < 0) throw new ArgumentOutOfRangeException(nameof(threads));
+            if (count == 0) return new bool[0];
+
+            uint[] keyIndexes = new uint[count];
+            int digestLength = digests[0].Length;
+            for (int i = 0; i < count; i++) {
+                keyIndexes[i] = (uint)keys[i];
+                checkDigest(digests[i]);
+                checkSignature(signatures[i]);
+                if (digests[i].Length != digestLength) throw new ArgumentException();
+            }
+
+            var handles = new List<GCHandle>(2 * count);
+            byte[] results = new byte[count];
+            try {
+                IntPtr[] pdigests = new IntPtr[count];
+                IntPtr[] psignatures = new IntPtr[count];
+                for (int i = 0; i < count; i++) {
+                    GCHandle digest = GCHandle.Alloc(digests[i], GCHandleType.Pinned);
+                    handles.Add(digest);
+                    GCHandle signature = GCHandle.Alloc(signatures[i], GCHandleType.Pinned);
+                    handles.Add(signature);
+
+                    pdigests[i] = digest.AddrOfPinnedObject();
+                    psignatures[i] = signature.AddrOfPinnedObject();
+                }
+
+                fixed (uint* pk = keyIndexes)
+                fixed (IntPtr* pd = pdigests, ps = psignatures)
+                fixed (byte* pr = results) {
+                    SignatureVerifier_VerifyMany(_rsp, (uint)count, pk, (byte**)pd, (uint)digestLength, (byte**)ps, pr, (uint)threads);
+                }
+            } finally {
+                foreach (var handle in handles) handle.Free();
+            }
+
+            bool[] valid = new bool[count];
+            for (int i = 0; i < count; i++) valid[i] = results[i] != 0;
+            return valid;
+        }
+
+        private static void checkDigest(byte[] digest) {
+            if (digest == null) throw new ArgumentNullException(nameof(digest));
+            if (digest.Length > MaxDigestLength) throw new ArgumentException();
+        }
+
+        private static void checkSignature(byte[] signature) {
+            if (signature == null) throw new ArgumentNullException(nameof(signature));
+            if (signature.Length != SignatureLength) throw new ArgumentException();
+        }
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr SignatureVerifier_Construct();
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void SignatureVerifier_Destruct(IntPtr verifier);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint SignatureVerifier_AddKey(IntPtr verifier, byte* x, byte* y);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool SignatureVerifier_Verify(IntPtr verifier, uint key, byte* digest, uint digestLength, byte* signature);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void SignatureVerifier_VerifyMany(IntPtr verifier, uint count, uint* keys, byte** digests, uint digestLength,
+            byte** signatures, byte* results, uint threads);
+    }
+}
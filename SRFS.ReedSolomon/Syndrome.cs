@@ -38,6 +38,26 @@ namespace SRFS.ReedSolomon {
             }
         }
 
+        public void AddCodewordSlice(PinnedBuffer data, int offset, int exponent) {
+            Syndrome_AddCodewordSlice(_rsp, (ushort*)(data.Pointer + offset), (uint)exponent);
+        }
+
+        /// <summary>
+        /// Add data[i] at the same exponent to syndromes[i] for several tracks with the same geometry, building each coefficient
+        /// table once for all of them.  Returns false, adding nothing, if the geometries differ.
+        /// </summary>
+        public static bool AddCodewordSliceBatch(Syndrome[] syndromes, PinnedBuffer[] data, int offset, int exponent) {
+            if (data.Length != syndromes.Length) throw new ArgumentException("There must be one data slice per syndrome", nameof(data));
+
+            IntPtr* pSyndromes = stackalloc IntPtr[syndromes.Length];
+            ushort** pData = stackalloc ushort*[data.Length];
+            for (int i = 0; i < syndromes.Length; i++) {
+                pSyndromes[i] = syndromes[i]._rsp;
+                pData[i] = (ushort*)(data[i].Pointer + offset);
+            }
+            return Syndrome_AddCodewordSliceBatch(pSyndromes, pData, (uint)syndromes.Length, (uint)exponent);
+        }
+
         public void GetSyndromeSlice(byte[] data, int offset, int exponent) {
             fixed (byte* pData = data) {
                 Syndrome_GetSyndromeSlice(_rsp, (ushort*)(pData + offset), (uint)exponent);
@@ -50,6 +70,63 @@ namespace SRFS.ReedSolomon {
             }
         }
 
+        public void GetSyndromeSlice(PinnedBuffer data, int offset, int exponent) {
+            Syndrome_GetSyndromeSlice(_rsp, (ushort*)(data.Pointer + offset), (uint)exponent);
+        }
+
+        /// <summary>
+        /// The ranges of codewords in which any syndrome is nonzero, as [start, end) pairs widened to whole multiples of
+        /// granularity codewords, so that a repair can rebuild and rewrite only those.  Empty if the slices are consistent.
+        /// </summary>
+        public int[] GetDamagedRanges(int granularity) {
+            int[] ranges = new int[2 * Syndrome_GetMaxDamagedRanges(_rsp, (uint)granularity)];
+            uint count;
+            fixed (int* pRanges = ranges) count = Syndrome_GetDamagedRanges(_rsp, (uint)granularity, pRanges, (uint)ranges.Length / 2);
+            Array.Resize(ref ranges, 2 * (int)count);
+            return ranges;
+        }
+
+        /// <summary>
+        /// Whether the slice with this exponent has been added since the syndrome was constructed or last restored.
+        /// </summary>
+        public bool IsAdded(int exponent) => Syndrome_IsAdded(_rsp, (uint)exponent);
+
+        /// <summary>
+        /// Save the accumulated syndromes and the set of exponents added, so that a verify can be resumed later.
+        /// </summary>
+        public byte[] SaveState() {
+            byte[] state = new byte[Syndrome_GetStateSize(_rsp)];
+            fixed (byte* pState = state) Syndrome_SaveState(_rsp, pState);
+            return state;
+        }
+
+        /// <summary>
+        /// Restore state saved by <see cref="SaveState"/>.  Returns false if the state does not match this geometry.
+        /// </summary>
+        public bool LoadState(byte[] state) {
+            fixed (byte* pState = state) return Syndrome_LoadState(_rsp, pState, (uint)state.Length);
+        }
+
+        /// <summary>
+        /// Save the accumulated state to a file, after a tag that a later <see cref="LoadCheckpoint"/> must be given to load it.
+        /// </summary>
+        public void SaveCheckpoint(string path, byte[] tag = null) =>
+            AccumulatorCheckpoint.Save(path, tag, Syndrome_GetStateSize(_rsp), p => Syndrome_SaveState(_rsp, p));
+
+        /// <summary>
+        /// Restore state saved by <see cref="SaveCheckpoint"/>.  Returns false, leaving this instance as it was, if there is no
+        /// checkpoint, it was saved with a different tag, or it does not match this geometry.
+        /// </summary>
+        public bool LoadCheckpoint(string path, byte[] tag = null) =>
+            AccumulatorCheckpoint.Load(path, tag, (p, length) => Syndrome_LoadState(_rsp, p, length));
+
+        /// <summary>
+        /// Add the syndrome accumulated by another instance with the same geometry over a disjoint set of slices, so that one
+        /// track can be split across threads and the partial results combined.  Returns false if the geometry differs or a
+        /// slice was added to both.
+        /// </summary>
+        public bool Merge(Syndrome other) => Syndrome_Merge(_rsp, other._rsp);
+
         internal IntPtr InternalPointer => _rsp;
 
         private bool isDisposed = false;
@@ -64,7 +141,35 @@ namespace SRFS.ReedSolomon {
         [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
         private static extern void Syndrome_AddCodewordSlice(IntPtr syndrome, ushort* data, uint exponent);
 
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool Syndrome_AddCodewordSliceBatch(IntPtr* syndromes, ushort** data, uint count, uint exponent);
+
         [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
         private static extern void Syndrome_GetSyndromeSlice(IntPtr syndrome, ushort* data, uint exponent);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint Syndrome_GetDamagedRanges(IntPtr syndrome, uint granularity, int* ranges, uint maxRanges);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint Syndrome_GetMaxDamagedRanges(IntPtr syndrome, uint granularity);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool Syndrome_IsAdded(IntPtr syndrome, uint exponent);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint Syndrome_GetStateSize(IntPtr syndrome);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Syndrome_SaveState(IntPtr syndrome, byte* buffer);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool Syndrome_LoadState(IntPtr syndrome, byte* buffer, uint length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool Syndrome_Merge(IntPtr syndrome, IntPtr other);
     }
 }
@@ -0,0 +1,113 @@
+﻿using System;
+using System.Runtime.InteropServices;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// Per-track counts of dirty data, used data and unwritten parity clusters, updated as cluster states change, so track
+    /// status queries do not read the cluster state table.  States are passed as the raw ClusterState bytes.
+    /// </summary>
+    public unsafe class TrackStateIndex : IDisposable {
+
+        /// <param name="dataClusterCount">Clusters below this number are data clusters, the rest are parity clusters.</param>
+        /// <param name="clusterTracks">The track of each cluster, or -1 if it belongs to no track.</param>
+        public TrackStateIndex(int trackCount, int dataClusterCount, int[] clusterTracks) {
+            _trackCount = trackCount;
+            fixed (int* p = clusterTracks) {
+                _rsp = TrackStateIndex_Construct((uint)trackCount, (uint)dataClusterCount, (uint)clusterTracks.Length, p);
+            }
+            if (_rsp == IntPtr.Zero) throw new ArgumentException("More data clusters than clusters, or a track out of range");
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                TrackStateIndex_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~TrackStateIndex() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        public void Load(byte[] states) {
+            fixed (byte* p = states) TrackStateIndex_Load(_rsp, p);
+        }
+
+        public void Update(int cluster, byte oldState, byte newState) {
+            if (!TrackStateIndex_Update(_rsp, (uint)cluster, oldState, newState)) throw new ArgumentOutOfRangeException(nameof(cluster));
+        }
+
+        public bool IsUsed(int track) => TrackStateIndex_IsUsed(_rsp, (uint)track);
+
+        public bool IsDataModified(int track) => TrackStateIndex_IsDataModified(_rsp, (uint)track);
+
+        public bool IsParityWritten(int track) => TrackStateIndex_IsParityWritten(_rsp, (uint)track);
+
+        public bool IsUpToDate(int track) => TrackStateIndex_IsUpToDate(_rsp, (uint)track);
+
+        public int[] GetUsedTracks() => getTracks(TrackStateIndex_GetUsedTracks);
+
+        /// <summary>
+        /// The tracks that are used and have modified or unwritten data, or unwritten parity.
+        /// </summary>
+        public int[] GetStaleTracks() => getTracks(TrackStateIndex_GetStaleTracks);
+
+        private delegate uint TrackScan(IntPtr index, int* tracks, uint capacity);
+
+        private int[] getTracks(TrackScan scan) {
+            int[] tracks = new int[_trackCount];
+            uint count;
+            fixed (int* p = tracks) count = scan(_rsp, p, (uint)tracks.Length);
+            Array.Resize(ref tracks, (int)count);
+            return tracks;
+        }
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+        private int _trackCount;
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr TrackStateIndex_Construct(uint trackCount, uint dataClusterCount, uint clusterCount, int* clusterTracks);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void TrackStateIndex_Destruct(IntPtr index);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void TrackStateIndex_Load(IntPtr index, byte* states);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool TrackStateIndex_Update(IntPtr index, uint cluster, byte oldState, byte newState);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool TrackStateIndex_IsUsed(IntPtr index, uint track);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool TrackStateIndex_IsDataModified(IntPtr index, uint track);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool TrackStateIndex_IsParityWritten(IntPtr index, uint track);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool TrackStateIndex_IsUpToDate(IntPtr index, uint track);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint TrackStateIndex_GetUsedTracks(IntPtr index, int* tracks, uint capacity);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint TrackStateIndex_GetStaleTracks(IntPtr index, int* tracks, uint capacity);
+    }
+}
@@ -0,0 +1,124 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace SRFS.ReedSolomon {
+
+    /// <summary>
+    /// Unsealed cluster images waiting to be written, keyed by device offset.  Repeated writes to a cluster keep only the last
+    /// image, and <see cref="GetFlushOrder"/> groups the pending images by track and sorts each group by offset.  The tracks
+    /// written since the last <see cref="TakeDirtyTracks"/> are remembered so that parity can be refreshed once per track.
+    /// </summary>
+    public unsafe class WriteBackBuffer : IDisposable {
+
+        public WriteBackBuffer(int capacityBytes) {
+            if (capacityBytes < 0) throw new ArgumentOutOfRangeException(nameof(capacityBytes));
+            _rsp = WriteBackBuffer_Construct((uint)capacityBytes);
+        }
+
+        protected virtual void Dispose(bool disposing) {
+            if (!isDisposed) {
+                if (disposing) { }
+                WriteBackBuffer_Destruct(_rsp);
+                isDisposed = true;
+            }
+        }
+
+        ~WriteBackBuffer() {
+            Dispose(false);
+        }
+
+        public void Dispose() {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        /// <summary>
+        /// Copies an image in, replacing the pending image at the same offset.  Returns true if the pending images are over
+        /// budget and should be flushed.
+        /// </summary>
+        /// <param name="track">The track the cluster belongs to, or -1 if it belongs to none.</param>
+        public bool Put(long offset, int track, byte[] bytes, int bytesOffset, int count) {
+            if (bytesOffset < 0 || count < 0 || bytesOffset + count > bytes.Length) throw new ArgumentOutOfRangeException();
+            fixed (byte* p = bytes) return WriteBackBuffer_Put(_rsp, offset, track, p + bytesOffset, (uint)count);
+        }
+
+        /// <summary>
+        /// Copies the pending image at an offset.  Returns false if there is none.
+        /// </summary>
+        public bool TryRead(long offset, byte[] bytes, int bytesOffset, int count) {
+            if (bytesOffset < 0 || count < 0 || bytesOffset + count > bytes.Length) throw new ArgumentOutOfRangeException();
+            fixed (byte* p = bytes) return WriteBackBuffer_Read(_rsp, offset, p + bytesOffset, (uint)count);
+        }
+
+        public void Remove(long offset) => WriteBackBuffer_Remove(_rsp, offset);
+
+        public long[] GetFlushOrder() {
+            long[] offsets = new long[PendingCount];
+            uint count;
+            fixed (long* p = offsets) count = WriteBackBuffer_GetFlushOrder(_rsp, p, (uint)offsets.Length);
+            Array.Resize(ref offsets, (int)count);
+            return offsets;
+        }
+
+        /// <summary>
+        /// The tracks written since the last call, in order.
+        /// </summary>
+        public int[] TakeDirtyTracks() {
+            int[] tracks = new int[64];
+            int total = 0;
+            while (true) {
+                uint count;
+                fixed (int* p = tracks) count = WriteBackBuffer_TakeDirtyTracks(_rsp, p + total, (uint)(tracks.Length - total));
+                total += (int)count;
+                if (total < tracks.Length) break;
+                Array.Resize(ref tracks, tracks.Length * 2);
+            }
+            Array.Resize(ref tracks, total);
+            return tracks;
+        }
+
+        public int PendingCount => (int)WriteBackBuffer_GetPendingCount(_rsp);
+
+        public long PendingBytes => WriteBackBuffer_GetPendingBytes(_rsp);
+
+        /// <summary>
+        /// The number of writes that replaced a pending image instead of adding one.
+        /// </summary>
+        public long CoalescedWrites => (long)WriteBackBuffer_GetCoalescedWrites(_rsp);
+
+        private bool isDisposed = false;
+        private IntPtr _rsp;
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr WriteBackBuffer_Construct(uint capacityBytes);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void WriteBackBuffer_Destruct(IntPtr buffer);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool WriteBackBuffer_Put(IntPtr buffer, long offset, int track, byte* data, uint length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool WriteBackBuffer_Read(IntPtr buffer, long offset, byte* data, uint length);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void WriteBackBuffer_Remove(IntPtr buffer, long offset);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint WriteBackBuffer_GetFlushOrder(IntPtr buffer, long* offsets, uint capacity);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint WriteBackBuffer_TakeDirtyTracks(IntPtr buffer, int* tracks, uint capacity);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint WriteBackBuffer_GetPendingCount(IntPtr buffer);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint WriteBackBuffer_GetPendingBytes(IntPtr buffer);
+
+        [DllImport("ReedSolomon.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern ulong WriteBackBuffer_GetCoalescedWrites(IntPtr buffer);
+    }
+}
@@ -109,6 +109,50 @@ namespace SRFS.Tests.Model {
             }
         }
 
+        [TestMethod]
+        public void FileSystemLocalGroupsTest() {
+            ConfigurationTest.Initialize();
+
+            string volumeName = Configuration.VolumeName;
+            Geometry geometry = Configuration.Geometry;
+            CryptoSettings cryptoSettings = Configuration.CryptoSettings;
+            Options options = Configuration.Options;
+            Guid guid = Configuration.FileSystemID;
+
+            Geometry localGeometry = new Geometry(geometry.BytesPerCluster, geometry.ClustersPerTrack, geometry.DataClustersPerTrack,
+                geometry.TrackCount, 4);
+            Configuration.Reset();
+            Configuration.Geometry = localGeometry;
+            Configuration.VolumeName = volumeName;
+            Configuration.CryptoSettings = cryptoSettings;
+            Configuration.Options = options;
+            Configuration.FileSystemID = guid;
+
+            try {
+                using (var io = ConfigurationTest.CreateMemoryIO()) {
+                    FileSystem fs = FileSystem.Create(io);
+                    fs.Dispose();
+
+                    Configuration.Reset();
+                    Configuration.CryptoSettings = cryptoSettings;
+                    Configuration.Options = options;
+
+                    // The local group count is read back from the header, so the local parity clusters are not taken for global parity
+                    fs = FileSystem.Mount(io);
+                    Assert.AreEqual(localGeometry, Configuration.Geometry);
+                    Assert.AreEqual(4, Configuration.Geometry.LocalGroupCount);
+                    fs.Dispose();
+                }
+            } finally {
+                Configuration.Reset();
+                Configuration.Geometry = geometry;
+                Configuration.VolumeName = volumeName;
+                Configuration.CryptoSettings = cryptoSettings;
+                Configuration.Options = options;
+                Configuration.FileSystemID = guid;
+            }
+        }
+
         private static int nextID = 0;
 
         [TestMethod]
@@ -0,0 +1,61 @@
+﻿using System;
+using System.Linq;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+using SRFS.Model;
+
+namespace SRFS.Tests.Model {
+
+    [TestClass]
+    public class TrackHashTreeTests {
+
+        [TestMethod]
+        public void TrackHashTreeIncrementalRootTest() {
+            Random r = new Random();
+            byte[][] hashes = new byte[leafCount][];
+            for (int i = 0; i < leafCount; i++) {
+                hashes[i] = new byte[Constants.HashLength];
+                r.NextBytes(hashes[i]);
+            }
+
+            TrackHashTree t1 = new TrackHashTree(leafCount);
+            for (int i = 0; i < leafCount; i++) t1.SetLeaf(i, hashes[i]);
+            byte[] root = t1.Root;
+
+            // Changing a leaf changes the root, and changing it back restores it
+            byte[] changed = (byte[])hashes[7].Clone();
+            changed[0] ^= 1;
+            t1.SetLeaf(7, changed);
+            Assert.IsFalse(t1.HasRoot(root));
+            t1.SetLeaf(7, hashes[7]);
+            Assert.IsTrue(t1.HasRoot(root));
+
+            // The root does not depend on the order the leaves were set in
+            TrackHashTree t2 = new TrackHashTree(leafCount);
+            for (int i = leafCount - 1; i >= 0; i--) t2.SetLeaf(i, hashes[i]);
+            Assert.IsTrue(t2.Root.SequenceEqual(root));
+        }
+
+        [TestMethod]
+        public void TrackHashTreeFindChangedLeavesTest() {
+            Random r = new Random();
+            byte[][] hashes = new byte[leafCount][];
+            TrackHashTree t = new TrackHashTree(leafCount);
+            for (int i = 0; i < leafCount; i++) {
+                hashes[i] = new byte[Constants.HashLength];
+                r.NextBytes(hashes[i]);
+                t.SetLeaf(i, hashes[i]);
+            }
+
+            int[] damaged = new int[] { 0, 18, 19, leafCount - 1 };
+            foreach (var i in damaged) hashes[i] = new byte[Constants.HashLength];
+
+            foreach (var subtrees in new int[] { 1, 2, 8, 64 }) {
+                Assert.IsTrue(t.FindChangedLeaves(i => hashes[i], subtrees).SequenceEqual(damaged));
+                Assert.AreEqual(0, t.FindChangedLeaves(i => null, subtrees).Count);
+            }
+        }
+
+        // Not a power of two, so the tree has padding leaves
+        private const int leafCount = 45;
+    }
+}
@@ -0,0 +1,323 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Threading;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+using SRFS.IO;
+using SRFS.Model;
+using SRFS.Model.Clusters;
+using SRFS.Model.Data;
+
+namespace SRFS.Tests.Model {
+
+    [TestClass]
+    public class TrackTests {
+
+        [TestMethod]
+        public void UpdateParityStaleCheckpointTest() {
+            ConfigurationTest.Initialize();
+            Random r = new Random(1234);
+            string checkpointPath = Path.Combine(Path.GetTempPath(), Guid.NewGuid().ToString() + ".checkpoint");
+
+            using (var io = ConfigurationTest.CreateMemoryIO()) {
+                FileSystem fs = FileSystem.Create(io);
+                byte[] data = new byte[1024 * 1024];
+                r.NextBytes(data);
+                File f = writeFile(fs, data);
+                Track t = new Track(fs, fs.GetTrackNumber(f.FirstCluster));
+
+                // Cancel once every data cluster is in the checkpoint, so a write to any of them makes it stale
+                var cancel = new CancellationTokenSource();
+                var status = new Track.UpdateParityStatus();
+                status.PropertyChanged += (s, e) => {
+                    if (status.Cluster == Configuration.Geometry.DataClustersPerTrack - 1) cancel.Cancel();
+                };
+                t.UpdateParity(true, status, cancel.Token, checkpointPath).Wait();
+                Assert.IsTrue(System.IO.File.Exists(checkpointPath));
+
+                data[0] ^= 1;
+                using (FileIO fio = new FileIO(fs, f)) fio.WriteFile(data, 0);
+
+                t.UpdateParity(false, new Track.UpdateParityStatus(), CancellationToken.None, checkpointPath).Wait();
+                Assert.IsFalse(System.IO.File.Exists(checkpointPath));
+                Assert.IsTrue(t.VerifyParity());
+
+                fs.Dispose();
+            }
+        }
+
+        [TestMethod]
+        public void UpdateParityConcurrentWriteTest() {
+            ConfigurationTest.Initialize();
+            Random r = new Random(1234);
+
+            using (var io = ConfigurationTest.CreateMemoryIO()) {
+                FileSystem fs = FileSystem.Create(io);
+                byte[] data = new byte[1024 * 1024];
+                r.NextBytes(data);
+                File f = writeFile(fs, data);
+                Track t = new Track(fs, fs.GetTrackNumber(f.FirstCluster));
+                Dictionary<int, byte[]> before = readDataClusters(fs, t);
+
+                // The file is written again while the first data cluster of the track is being encoded
+                var status = new Track.UpdateParityStatus();
+                bool isWritten = false;
+                status.PropertyChanged += (s, e) => {
+                    if (isWritten) return;
+                    isWritten = true;
+                    data[0] ^= 1;
+                    using (FileIO fio = new FileIO(fs, f)) fio.WriteFile(data, 0);
+                };
+                t.UpdateParity(true, status, CancellationToken.None).Wait();
+                fs.Flush();
+
+                Assert.IsTrue(isWritten);
+                Assert.IsTrue(t.DataModified);
+
+                // The parity was written from the snapshot, so it verifies once the clusters written since are put back as they were
+                foreach (int i in t.DataClusters) {
+                    ClusterState state = fs.GetClusterState(i);
+                    if (!state.IsModified()) continue;
+                    fs.ClusterIO.WriteRaw(new Cluster(i, Configuration.Geometry.BytesPerCluster), 0, before[i], 0, before[i].Length);
+                    fs.SetClusterState(i, state & ~ClusterState.Modified);
+                }
+                Assert.IsFalse(t.DataModified);
+                Assert.IsTrue(t.VerifyParity());
+
+                fs.Dispose();
+            }
+        }
+
+        [TestMethod]
+        public void UpdateParityPartialTrackTest() {
+            ConfigurationTest.Initialize();
+
+            using (var io = ConfigurationTest.CreateMemoryIO()) {
+                FileSystem fs = FileSystem.Create(io);
+                Track t = createTrack(fs, out File f);
+
+                // The file fills part of the track, and each unwritten cluster after it has a different address
+                Assert.IsTrue(t.DataClusters.Count(i => fs.GetClusterState(i).IsUnwritten()) >= 2);
+                Assert.IsTrue(t.VerifyParity());
+
+                t.UpdateParity(true, new Track.UpdateParityStatus(), CancellationToken.None).Wait();
+                Assert.IsTrue(t.VerifyParity());
+
+                Track.UpdateParity(fs, new Track[] { t }, true);
+                Assert.IsTrue(Track.VerifyParity(fs, new Track[] { t })[0]);
+
+                fs.Dispose();
+            }
+        }
+
+        [TestMethod]
+        public void ScrubCleanTrackTest() {
+            ConfigurationTest.Initialize();
+
+            using (var io = ConfigurationTest.CreateMemoryIO()) {
+                FileSystem fs = FileSystem.Create(io);
+                Track t = createTrack(fs, out File f);
+                byte[][] before = readTrack(fs, t, true);
+
+                Assert.IsTrue(t.Scrub());
+                assertTrackEqual(before, readTrack(fs, t, true));
+
+                fs.Dispose();
+            }
+        }
+
+        [TestMethod]
+        public void ScrubDataClusterTest() {
+            ConfigurationTest.Initialize();
+
+            using (var io = ConfigurationTest.CreateMemoryIO()) {
+                FileSystem fs = FileSystem.Create(io);
+                Track t = createTrack(fs, out File f);
+                byte[][] before = readTrack(fs, t, false);
+
+                corrupt(fs, new Cluster(f.FirstCluster, Configuration.Geometry.BytesPerCluster), Cluster.Cluster_HeaderLength + 100);
+
+                Assert.IsTrue(t.Scrub());
+                assertTrackEqual(before, readTrack(fs, t, false));
+                Assert.IsTrue(t.VerifyParity());
+
+                fs.Dispose();
+            }
+        }
+
+        [TestMethod]
+        public void ScrubParityClusterTest() {
+            ConfigurationTest.Initialize();
+
+            using (var io = ConfigurationTest.CreateMemoryIO()) {
+                FileSystem fs = FileSystem.Create(io);
+                Track t = createTrack(fs, out File f);
+                byte[][] before = readTrack(fs, t, false);
+
+                corrupt(fs, new ParityCluster(fs.BlockSize, t.Number, 0), ParityCluster.CalculateHeaderLength(fs.BlockSize) + 100);
+
+                Assert.IsTrue(t.Scrub());
+                assertTrackEqual(before, readTrack(fs, t, false));
+                Assert.IsTrue(t.VerifyParity());
+
+                fs.Dispose();
+            }
+        }
+
+        [TestMethod]
+        public void ScrubSignatureTest() {
+            ConfigurationTest.Initialize();
+
+            using (var io = ConfigurationTest.CreateMemoryIO()) {
+                FileSystem fs = FileSystem.Create(io);
+                Track t = createTrack(fs, out File f);
+                byte[][] before = readTrack(fs, t, false);
+
+                // The signature follows the marker, version and checksum in the header
+                corrupt(fs, new Cluster(f.FirstCluster, Configuration.Geometry.BytesPerCluster),
+                    Constants.SrfsMarkerLength + Constants.CurrentVersionLength + Constants.ChecksumLength + 10);
+
+                Assert.IsTrue(t.Scrub());
+                assertTrackEqual(before, readTrack(fs, t, false));
+                Assert.IsTrue(t.VerifyParity());
+
+                fs.Dispose();
+            }
+        }
+
+        [TestMethod]
+        public void VerifyHashesSkipTest() {
+            ConfigurationTest.Initialize();
+
+            using (var io = ConfigurationTest.CreateMemoryIO()) {
+                FileSystem fs = FileSystem.Create(io);
+                Track t = createTrack(fs, out File f);
+                Assert.AreEqual(0, t.VerifyHashes(true).Count);
+                DateTime verifyTime = fs.GetVerifyTime(f.FirstCluster);
+
+                // The signed root matches and the cluster was verified and not modified since, so it is not read again
+                corrupt(fs, new Cluster(f.FirstCluster, Configuration.Geometry.BytesPerCluster), Cluster.Cluster_HeaderLength + 100);
+                Assert.AreEqual(0, t.VerifyHashes().Count);
+                Assert.AreEqual(verifyTime, fs.GetVerifyTime(f.FirstCluster));
+
+                fs.Dispose();
+            }
+        }
+
+        [TestMethod]
+        public void VerifyHashesRootMismatchTest() {
+            ConfigurationTest.Initialize();
+
+            using (var io = ConfigurationTest.CreateMemoryIO()) {
+                FileSystem fs = FileSystem.Create(io);
+                Track t = createTrack(fs, out File f);
+                Assert.AreEqual(0, t.VerifyHashes(true).Count);
+
+                corrupt(fs, new Cluster(f.FirstCluster, Configuration.Geometry.BytesPerCluster), Cluster.Cluster_HeaderLength + 100);
+
+                // A leaf that no longer matches its cluster changes the root without marking the track modified, so every cluster
+                // is read, including the corrupted one that a scan trusting the root would skip
+                int other = t.DataClusters.First(i => i != f.FirstCluster && !fs.GetClusterState(i).IsSystem() &&
+                    !fs.GetClusterState(i).IsUnwritten());
+                byte[] hash = fs.GetClusterHash(other);
+                hash[0] ^= 1;
+                fs.SetClusterHash(other, hash);
+                Assert.IsFalse(t.DataModified);
+
+                IList<int> changed = t.VerifyHashes();
+                Assert.AreEqual(2, changed.Count);
+                Assert.IsTrue(changed.Contains(f.FirstCluster));
+                Assert.IsTrue(changed.Contains(other));
+
+                fs.Dispose();
+            }
+        }
+
+        [TestMethod]
+        public void VerifyHashesCorruptClusterTest() {
+            ConfigurationTest.Initialize();
+
+            using (var io = ConfigurationTest.CreateMemoryIO()) {
+                FileSystem fs = FileSystem.Create(io);
+                Track t = createTrack(fs, out File f);
+                Assert.AreEqual(0, t.VerifyHashes(true).Count);
+                DateTime verifyTime = fs.GetVerifyTime(f.FirstCluster);
+
+                corrupt(fs, new Cluster(f.FirstCluster, Configuration.Geometry.BytesPerCluster), Cluster.Cluster_HeaderLength + 100);
+
+                IList<int> changed = t.VerifyHashes(true);
+                Assert.AreEqual(1, changed.Count);
+                Assert.AreEqual(f.FirstCluster, changed[0]);
+                Assert.AreEqual(verifyTime, fs.GetVerifyTime(f.FirstCluster));
+
+                fs.Dispose();
+            }
+        }
+
+        // A track holding the start of a 1 MB file, with its parity written
+        private static Track createTrack(FileSystem fs, out File f) {
+            Random r = new Random(1234);
+            byte[] data = new byte[1024 * 1024];
+            r.NextBytes(data);
+            f = writeFile(fs, data);
+
+            Track t = new Track(fs, fs.GetTrackNumber(f.FirstCluster));
+            t.UpdateParity();
+            return t;
+        }
+
+        // The written data clusters of a track as they are on the device, by absolute cluster number
+        private static Dictionary<int, byte[]> readDataClusters(FileSystem fs, Track t) {
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+            var clusters = new Dictionary<int, byte[]>();
+            foreach (int i in t.DataClusters) {
+                ClusterState state = fs.GetClusterState(i);
+                if (state.IsSystem() || state.IsUnwritten()) continue;
+                byte[] bytes = new byte[bytesPerCluster];
+                fs.ClusterIO.ReadRaw(new Cluster(i, bytesPerCluster), 0, bytes, 0, bytesPerCluster);
+                clusters[i] = bytes;
+            }
+            return clusters;
+        }
+
+        // The written data clusters of a track as they are on the device, then its parity clusters.  A repaired parity cluster is
+        // sealed again with a new signature, so its header is only included when withParityHeaders is set.
+        private static byte[][] readTrack(FileSystem fs, Track t, bool withParityHeaders) {
+            int bytesPerCluster = Configuration.Geometry.BytesPerCluster;
+            int parityHeaderLength = ParityCluster.CalculateHeaderLength(fs.BlockSize);
+            var clusters = (from x in readDataClusters(fs, t) orderby x.Key select x.Value).ToList();
+
+            for (int n = 0; n < Configuration.Geometry.GlobalParityClustersPerTrack; n++) {
+                int position = withParityHeaders ? 0 : parityHeaderLength;
+                byte[] bytes = new byte[parityHeaderLength + bytesPerCluster - position];
+                fs.ClusterIO.ReadRaw(new ParityCluster(fs.BlockSize, t.Number, n), position, bytes, 0, bytes.Length);
+                clusters.Add(bytes);
+            }
+
+            return clusters.ToArray();
+        }
+
+        private static void assertTrackEqual(byte[][] expected, byte[][] actual) {
+            Assert.AreEqual(expected.Length, actual.Length);
+            for (int i = 0; i < expected.Length; i++) Assert.IsTrue(expected[i].SequenceEqual(actual[i]));
+        }
+
+        // Flips a byte of a cluster on the device, without sealing the cluster again as a save would
+        private static void corrupt(FileSystem fs, Cluster c, int position) {
+            byte[] b = new byte[1];
+            fs.ClusterIO.ReadRaw(c, position, b, 0, 1);
+            b[0] ^= 0x5A;
+            fs.ClusterIO.WriteRaw(c, position, b, 0, 1);
+        }
+
+        private static File writeFile(FileSystem fs, byte[] data) {
+            File f = fs.CreateFile(fs.RootDirectory, "TEST");
+            using (FileIO fio = new FileIO(fs, f)) {
+                Assert.AreEqual(data.Length, fio.WriteFile(data, 0));
+            }
+            fs.Flush();
+            return f;
+        }
+    }
+}
@@ -0,0 +1,161 @@
+﻿using System;
+using System.Linq;
+using System.Threading;
+using System.Threading.Tasks;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+using SRFS.ReedSolomon;
+
+namespace SRFS.Tests.ReedSolomon {
+
+    [TestClass]
+    public class CodecServiceTests {
+
+        [TestMethod]
+        public void CodecServiceEncodeTest() {
+            string name = createName();
+            using (var service = new CodecService(name, 4, (nData + 8) * bytesPerSlice, 4, 2))
+            using (var client = new CodecClient(name)) {
+                Random r = new Random(1234);
+                foreach (int nParity in new int[] { 3, 4, 8 }) {
+                    byte[] slices = createTrack(r, nParity);
+                    byte[] expected = (byte[])slices.Clone();
+                    encode(expected, nParity);
+
+                    Assert.AreEqual(CodecResult.OK, client.Run(CodecOperation.Encode, nData, nParity, bytesPerSlice, slices));
+                    Assert.IsTrue(expected.SequenceEqual(slices));
+                }
+            }
+        }
+
+        [TestMethod]
+        public void CodecServiceVerifyTest() {
+            string name = createName();
+            using (var service = new CodecService(name, 4, (nData + 8) * bytesPerSlice, 4, 2))
+            using (var client = new CodecClient(name)) {
+                Random r = new Random(1234);
+                foreach (int nParity in new int[] { 3, 4, 8 }) {
+                    byte[] slices = createTrack(r, nParity);
+                    encode(slices, nParity);
+                    Assert.IsFalse(isDamaged(slices, nParity));
+                    Assert.AreEqual(CodecResult.OK, client.Run(CodecOperation.Verify, nData, nParity, bytesPerSlice, slices));
+
+                    slices[5 * bytesPerSlice + 100] ^= 1;
+                    Assert.IsTrue(isDamaged(slices, nParity));
+                    Assert.AreEqual(CodecResult.Damaged, client.Run(CodecOperation.Verify, nData, nParity, bytesPerSlice, slices));
+                }
+            }
+        }
+
+        [TestMethod]
+        public void CodecServiceFullRingTest() {
+            int nParity = 4;
+            int clientCount = 8;
+            int jobsPerClient = 50;
+
+            // Far more jobs are in flight than there are slots, so clients wait for slots to be freed
+            string name = createName();
+            using (var service = new CodecService(name, 2, (nData + nParity) * bytesPerSlice, clientCount, 2)) {
+                Task<bool>[] clients = new Task<bool>[clientCount];
+                for (int k = 0; k < clientCount; k++) {
+                    int seed = k;
+                    clients[k] = Task.Run(() => {
+                        Random r = new Random(seed);
+                        using (var client = new CodecClient(name)) {
+                            for (int j = 0; j < jobsPerClient; j++) {
+                                byte[] slices = createTrack(r, nParity);
+                                byte[] expected = (byte[])slices.Clone();
+                                encode(expected, nParity);
+                                if (client.Run(CodecOperation.Encode, nData, nParity, bytesPerSlice, slices) != CodecResult.OK) return false;
+                                if (!expected.SequenceEqual(slices)) return false;
+                            }
+                        }
+                        return true;
+                    });
+                }
+
+                Assert.IsTrue(Task.WaitAll(clients, TimeSpan.FromMinutes(1)));
+                Assert.IsTrue(clients.All(t => t.Result));
+            }
+        }
+
+        [TestMethod]
+        public void CodecServiceStopTest() {
+            int nParity = 4;
+            int clientCount = 8;
+            int jobsPerClient = 200;
+
+            string name = createName();
+            using (var service = new CodecService(name, 4, (nData + nParity) * bytesPerSlice, clientCount, 1)) {
+                CodecClient[] clients = (from k in Enumerable.Range(0, clientCount) select new CodecClient(name)).ToArray();
+                int completed = 0;
+                int stopped = 0;
+
+                Task<bool>[] tasks = new Task<bool>[clientCount];
+                for (int k = 0; k < clientCount; k++) {
+                    CodecClient client = clients[k];
+                    int seed = k;
+                    tasks[k] = Task.Run(() => {
+                        Random r = new Random(seed);
+                        for (int j = 0; j < jobsPerClient; j++) {
+                            byte[] slices = createTrack(r, nParity);
+                            byte[] expected = (byte[])slices.Clone();
+                            encode(expected, nParity);
+                            switch (client.Run(CodecOperation.Encode, nData, nParity, bytesPerSlice, slices)) {
+                                case CodecResult.OK:
+                                    if (!expected.SequenceEqual(slices)) return false;
+                                    Interlocked.Increment(ref completed);
+                                    break;
+                                case CodecResult.Invalid:
+                                    Interlocked.Increment(ref stopped);
+                                    break;
+                                default:
+                                    return false;
+                            }
+                        }
+                        return true;
+                    });
+                }
+
+                // The one worker stops with jobs queued and running.  The jobs it finished are right, and every client waiting
+                // on one it did not run is told so rather than left waiting.
+                while (Volatile.Read(ref completed) == 0) Task.Delay(1).Wait();
+                service.Stop();
+
+                Assert.IsTrue(Task.WaitAll(tasks, TimeSpan.FromMinutes(1)));
+                Assert.IsTrue(tasks.All(t => t.Result));
+                Assert.IsTrue(stopped > 0);
+                Assert.AreEqual(clientCount * jobsPerClient, completed + stopped);
+
+                foreach (var client in clients) client.Dispose();
+            }
+        }
+
+        private static string createName() => $"SRFS.Tests.{Guid.NewGuid():N}";
+
+        // nData random data slices followed by nParity empty parity slices
+        private static byte[] createTrack(Random r, int nParity) {
+            byte[] slices = new byte[(nData + nParity) * bytesPerSlice];
+            byte[] data = new byte[nData * bytesPerSlice];
+            r.NextBytes(data);
+            Buffer.BlockCopy(data, 0, slices, 0, data.Length);
+            return slices;
+        }
+
+        private static void encode(byte[] slices, int nParity) {
+            using (Parity p = new Parity(nData, nParity, bytesPerSlice / 2)) {
+                for (int i = 0; i < nData; i++) p.Calculate(slices, i * bytesPerSlice, nData + nParity - 1 - i);
+                for (int i = nData; i < nData + nParity; i++) p.GetParity(slices, i * bytesPerSlice, nData + nParity - 1 - i);
+            }
+        }
+
+        private static bool isDamaged(byte[] slices, int nParity) {
+            using (Syndrome s = new Syndrome(nData, nParity, bytesPerSlice / 2)) {
+                for (int i = 0; i < nData + nParity; i++) s.AddCodewordSlice(slices, i * bytesPerSlice, nData + nParity - 1 - i);
+                return s.GetDamagedRanges(bytesPerSlice / 2).Length > 0;
+            }
+        }
+
+        private const int nData = 20;
+        private const int bytesPerSlice = 4096;
+    }
+}
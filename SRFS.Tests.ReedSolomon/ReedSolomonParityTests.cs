@@ -3,6 +3,7 @@ using Microsoft.VisualStudio.TestTools.UnitTesting;
 using SRFS.ReedSolomon;
 using System.Collections.Generic;
 using System.Linq;
+using System.Threading.Tasks;
 
 namespace SRFS.Tests.ReedSolomon {
 
@@ -68,5 +69,937 @@ namespace SRFS.Tests.ReedSolomon {
                 Assert.IsTrue(data[i].SequenceEqual(original[i]));
             }
         }
+
+        [TestMethod]
+        public void ReedSolomonRangeRepairTest() {
+            int nData = 100;
+            int nParity = 25;
+            int nMessages = 1000;
+            int rangeOffset = 200;
+            int rangeLength = 300;
+
+            Random r = new Random(1234);
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                data[i] = new byte[nMessages];
+                r.NextBytes(data[i]);
+            }
+
+            byte[][] parity = new byte[nParity][];
+            for (int i = 0; i < nParity; i++) parity[i] = new byte[nMessages];
+
+            using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                for (int i = 0; i < nData; i++) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                for (int i = 0; i < nParity; i++) p.GetParity(parity[i], 0, nParity - 1 - i);
+            }
+
+            // One damaged data cluster, plus every parity cluster but one left unread, so only nData clusters are read.
+            int damagedExponent = nData + nParity - 1 - 17;
+            List<int> errorExponents = new List<int>() { damagedExponent };
+            for (int i = 1; i < nParity; i++) errorExponents.Add(i);
+
+            byte[] reconstructed = new byte[rangeLength];
+            using (RangeRepair repair = new RangeRepair(nData, nParity, rangeLength / 2, errorExponents)) {
+                for (int i = 0; i < nData; i++) repair.AddCodewordSlice(data[i], rangeOffset, nData + nParity - 1 - i);
+                repair.AddCodewordSlice(parity[nParity - 1], rangeOffset, 0);
+                repair.GetCorrection(0, reconstructed, 0);
+            }
+
+            Assert.IsTrue(reconstructed.SequenceEqual(data[17].Skip(rangeOffset).Take(rangeLength)));
+        }
+
+        [TestMethod]
+        public void ReedSolomonLocalParityTest() {
+            int nData = 100;
+            int nGroups = 8;
+            int nMessages = 1000;
+
+            Random r = new Random(1234);
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                data[i] = new byte[nMessages];
+                r.NextBytes(data[i]);
+            }
+
+            byte[][] parity = new byte[nGroups][];
+            for (int i = 0; i < nGroups; i++) parity[i] = new byte[nMessages];
+
+            using (LocalParity p = new LocalParity(nData, nGroups, nMessages / 2)) {
+                for (int i = 0; i < nData; i++) p.Calculate(data[i], 0, i);
+                for (int i = 0; i < nGroups; i++) p.GetParity(parity[i], 0, i);
+            }
+
+            int lost = 42;
+            byte[] repaired = new byte[nMessages];
+            using (LocalParity p = new LocalParity(nData, nGroups, nMessages / 2)) {
+                int group = p.GetGroup(lost);
+                for (int i = 0; i < nData; i++) {
+                    if (i != lost && p.GetGroup(i) == group) p.Calculate(data[i], 0, i);
+                }
+                p.AddParity(parity[group], 0, group);
+                p.GetParity(repaired, 0, group);
+            }
+
+            Assert.IsTrue(repaired.SequenceEqual(data[lost]));
+        }
+
+        [TestMethod]
+        public void ReedSolomonPinnedBufferParityTest() {
+            int nData = 20;
+            int nParity = 5;
+            int nMessages = 1000;
+
+            Random r = new Random(1234);
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                data[i] = new byte[nMessages];
+                r.NextBytes(data[i]);
+            }
+
+            byte[] expected = new byte[nMessages];
+            byte[] actual = new byte[nMessages];
+
+            using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                for (int i = 0; i < nData; i++) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                p.GetParity(expected, 0, 0);
+            }
+
+            using (Parity p = new Parity(nData, nParity, nMessages / 2))
+            using (PinnedBuffer buffer = new PinnedBuffer(nMessages)) {
+                for (int i = 0; i < nData; i++) {
+                    buffer.CopyFrom(data[i], 0, 0, nMessages);
+                    p.Calculate(buffer, 0, nData + nParity - 1 - i);
+                }
+                buffer.Clear();
+                p.GetParity(buffer, 0, 0);
+                buffer.CopyTo(0, actual, 0, nMessages);
+            }
+
+            Assert.IsTrue(actual.SequenceEqual(expected));
+        }
+
+        [TestMethod]
+        public void ReedSolomonParityStateTest() {
+            int nData = 30;
+            int nParity = 10;
+            int nMessages = 1000;
+
+            Random r = new Random(1234);
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                data[i] = new byte[nMessages];
+                r.NextBytes(data[i]);
+            }
+
+            byte[] expected = new byte[nMessages];
+            using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                for (int i = 0; i < nData; i++) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                p.GetParity(expected, 0, 3);
+            }
+
+            byte[] state;
+            using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                for (int i = 0; i < nData / 2; i++) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                state = p.SaveState();
+            }
+
+            byte[] actual = new byte[nMessages];
+            using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                Assert.IsTrue(p.LoadState(state));
+                for (int i = 0; i < nData; i++) {
+                    if (!p.IsCalculated(nData + nParity - 1 - i)) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                }
+                p.GetParity(actual, 0, 3);
+            }
+
+            Assert.IsTrue(actual.SequenceEqual(expected));
+
+            using (Parity p = new Parity(nData + 1, nParity, nMessages / 2)) {
+                Assert.IsFalse(p.LoadState(state));
+            }
+        }
+
+        [TestMethod]
+        public void ReedSolomonParityMergeTest() {
+            int nData = 30;
+            int nParity = 10;
+            int nMessages = 1000;
+
+            Random r = new Random(1234);
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                data[i] = new byte[nMessages];
+                r.NextBytes(data[i]);
+            }
+
+            byte[] expected = new byte[nMessages];
+            using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                for (int i = 0; i < nData; i++) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                p.GetParity(expected, 0, 3);
+            }
+
+            byte[] actual = new byte[nMessages];
+            using (Parity even = new Parity(nData, nParity, nMessages / 2))
+            using (Parity odd = new Parity(nData, nParity, nMessages / 2)) {
+                Parallel.Invoke(
+                    () => { for (int i = 0; i < nData; i += 2) even.Calculate(data[i], 0, nData + nParity - 1 - i); },
+                    () => { for (int i = 1; i < nData; i += 2) odd.Calculate(data[i], 0, nData + nParity - 1 - i); });
+
+                Assert.IsTrue(even.Merge(odd));
+                Assert.IsFalse(even.Merge(odd));
+                even.GetParity(actual, 0, 3);
+            }
+
+            Assert.IsTrue(actual.SequenceEqual(expected));
+        }
+
+        [TestMethod]
+        public void ReedSolomonParityRunTest() {
+            int nData = 30;
+            int nMessages = 1000;
+
+            Random r = new Random(1234);
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                data[i] = new byte[nMessages];
+                r.NextBytes(data[i]);
+            }
+
+            foreach (int nParity in new int[] { 3, 4, 8, 16, 32 }) {
+                byte[] expected = new byte[nMessages];
+                byte[] actual = new byte[nMessages];
+
+                using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                    for (int i = 0; i < nData; i++) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                    p.GetParity(expected, 0, nParity - 1);
+                }
+
+                PinnedBuffer[] buffers = new PinnedBuffer[nData];
+                int[] exponents = new int[nData];
+                try {
+                    for (int i = 0; i < nData; i++) {
+                        buffers[i] = new PinnedBuffer(nMessages);
+                        buffers[i].CopyFrom(data[i], 0, 0, nMessages);
+                        exponents[i] = nData + nParity - 1 - i;
+                    }
+
+                    using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                        p.CalculateRun(buffers, 0, exponents);
+                        for (int i = 0; i < nData; i++) Assert.IsTrue(p.IsCalculated(exponents[i]));
+                        p.GetParity(actual, 0, nParity - 1);
+                    }
+                } finally {
+                    foreach (var b in buffers) b?.Dispose();
+                }
+
+                Assert.IsTrue(actual.SequenceEqual(expected));
+            }
+        }
+
+        [TestMethod]
+        public void ReedSolomonParityRunArrayTest() {
+            int nData = 30;
+            int nMessages = 1000;
+
+            Random r = new Random(1234);
+
+            // The slices are read into one array, as a track reads a run of clusters
+            byte[] data = new byte[nData * nMessages];
+            r.NextBytes(data);
+            int[] offsets = new int[nData];
+            for (int i = 0; i < nData; i++) offsets[i] = i * nMessages;
+
+            foreach (int nParity in new int[] { 3, 8, 12, 32 }) {
+                byte[] expected = new byte[nMessages];
+                byte[] actual = new byte[nMessages];
+                int[] exponents = new int[nData];
+                for (int i = 0; i < nData; i++) exponents[i] = nData + nParity - 1 - i;
+
+                using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                    for (int i = 0; i < nData; i++) p.Calculate(data, offsets[i], exponents[i]);
+                    p.GetParity(expected, 0, nParity - 1);
+                }
+
+                using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                    if (nParity == 8) Assert.IsTrue(p.RunLength > 0);
+                    p.CalculateRun(data, offsets, exponents);
+                    for (int i = 0; i < nData; i++) Assert.IsTrue(p.IsCalculated(exponents[i]));
+                    p.GetParity(actual, 0, nParity - 1);
+                }
+
+                Assert.IsTrue(actual.SequenceEqual(expected));
+            }
+        }
+
+        [TestMethod]
+        public void ReedSolomonSyndromeSliceTest() {
+            int nData = 30;
+            int nMessages = 1000;
+
+            Random r = new Random(1234);
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                data[i] = new byte[nMessages];
+                r.NextBytes(data[i]);
+            }
+
+            // One parity block, and enough parity blocks for the syndromes to span several segments
+            foreach (int nParity in new int[] { 1, 20 }) {
+                byte[][] parity = new byte[nParity][];
+                using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                    for (int i = 0; i < nData; i++) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                    for (int i = 0; i < nParity; i++) {
+                        parity[i] = new byte[nMessages];
+                        p.GetParity(parity[i], 0, nParity - 1 - i);
+                    }
+                }
+
+                using (Syndrome s = new Syndrome(nData, nParity, nMessages / 2)) {
+                    for (int i = 0; i < nData; i++) s.AddCodewordSlice(data[i], 0, nData + nParity - 1 - i);
+                    for (int i = 0; i < nParity; i++) s.AddCodewordSlice(parity[i], 0, nParity - 1 - i);
+
+                    byte[] values = new byte[nMessages];
+                    for (int i = 0; i < nParity; i++) {
+                        s.GetSyndromeSlice(values, 0, i);
+                        Assert.IsTrue(values.All(v => v == 0));
+                    }
+                }
+            }
+        }
+
+        [TestMethod]
+        public void TrackStateIndexTest() {
+            const byte used = 0x20, modified = 0x10, unwritten = 0x08, system = 0x04;
+            int nTracks = 300;
+            int nData = 4;
+            int nParity = 2;
+
+            Random r = new Random(1234);
+
+            // Interleave the data clusters of the tracks, and put the parity clusters after them
+            int dataClusterCount = nTracks * nData;
+            int[] clusterTracks = new int[nTracks * (nData + nParity)];
+            for (int i = 0; i < dataClusterCount; i++) clusterTracks[i] = i % nTracks;
+            for (int i = dataClusterCount; i < clusterTracks.Length; i++) clusterTracks[i] = (i - dataClusterCount) / nParity;
+
+            byte[] states = new byte[clusterTracks.Length];
+            for (int i = 0; i < states.Length; i++) states[i] = (byte)(r.Next(16) << 2);
+
+            using (TrackStateIndex index = new TrackStateIndex(nTracks, dataClusterCount, clusterTracks)) {
+                index.Load(states);
+
+                for (int step = 0; step < 2000; step++) {
+                    int cluster = r.Next(states.Length);
+                    byte state = (byte)(r.Next(16) << 2);
+                    index.Update(cluster, states[cluster], state);
+                    states[cluster] = state;
+
+                    if (step % 200 != 0) continue;
+
+                    List<int> usedTracks = new List<int>();
+                    List<int> staleTracks = new List<int>();
+                    for (int t = 0; t < nTracks; t++) {
+                        var data = Enumerable.Range(0, dataClusterCount).Where(i => clusterTracks[i] == t).Select(i => states[i]);
+                        var parity = Enumerable.Range(dataClusterCount, nTracks * nParity).Where(i => clusterTracks[i] == t).Select(i => states[i]);
+
+                        bool isUsed = data.Any(s => (s & used) != 0);
+                        bool isModified = data.Any(s => (s & system) == 0 && (s & modified) != 0);
+                        bool isParityWritten = parity.All(s => (s & unwritten) == 0);
+                        bool isUpToDate = !isUsed || (!isModified && isParityWritten);
+
+                        Assert.AreEqual(isUsed, index.IsUsed(t));
+                        Assert.AreEqual(isModified, index.IsDataModified(t));
+                        Assert.AreEqual(isParityWritten, index.IsParityWritten(t));
+                        Assert.AreEqual(isUpToDate, index.IsUpToDate(t));
+
+                        if (isUsed) usedTracks.Add(t);
+                        if (!isUpToDate) staleTracks.Add(t);
+                    }
+
+                    CollectionAssert.AreEqual(usedTracks, index.GetUsedTracks());
+                    CollectionAssert.AreEqual(staleTracks, index.GetStaleTracks());
+                }
+            }
+        }
+
+        [TestMethod]
+        public void ReedSolomonParityConstantTest() {
+            int nData = 30;
+            int nParity = 8;
+            int nMessages = 4000;
+
+            Random r = new Random(1234);
+
+            // Half of the template is zero so the zero spans are skipped as well
+            byte[] template = new byte[nMessages];
+            r.NextBytes(template);
+            for (int i = 0; i < nMessages / 2; i++) template[i] = 0;
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                if (i % 3 == 0) {
+                    data[i] = template;
+                } else {
+                    data[i] = new byte[nMessages];
+                    r.NextBytes(data[i]);
+                }
+            }
+
+            using (Parity p1 = new Parity(nData, nParity, nMessages / 2))
+            using (Parity p2 = new Parity(nData, nParity, nMessages / 2)) {
+                for (int i = 0; i < nData; i++) p1.Calculate(data[i], 0, nData + nParity - 1 - i);
+
+                for (int i = 0; i < nData; i++) {
+                    if (data[i] != template) p2.Calculate(data[i], 0, nData + nParity - 1 - i);
+                }
+                int[] exponents = (from i in Enumerable.Range(0, nData) where data[i] == template select nData + nParity - 1 - i).ToArray();
+                p2.CalculateConstant(template, 0, exponents);
+
+                for (int i = 0; i < nData; i++) Assert.IsTrue(p2.IsCalculated(nData + nParity - 1 - i));
+
+                byte[] parity1 = new byte[nMessages];
+                byte[] parity2 = new byte[nMessages];
+                for (int i = 0; i < nParity; i++) {
+                    p1.GetParity(parity1, 0, i);
+                    p2.GetParity(parity2, 0, i);
+                    CollectionAssert.AreEqual(parity1, parity2);
+                }
+            }
+        }
+
+        [TestMethod]
+        public void ParityTunerProfileTest() {
+            string path = System.IO.Path.GetTempFileName();
+            try {
+                Assert.IsTrue(ParityTuner.Tune(20, 8, 512, out ParityTuning tuning));
+                Assert.IsTrue(tuning.Threads >= 1);
+                Assert.IsFalse(ParityTuner.Tune(20, 8, 512, out ParityTuning again));
+                Assert.AreEqual(tuning.RunLength, again.RunLength);
+                Assert.IsTrue(ParityTuner.SaveProfile(path));
+
+                Assert.IsTrue(ParityTuner.LoadProfile(path));
+                Assert.IsTrue(ParityTuner.Find(20, 8, 512, out ParityTuning loaded));
+                Assert.AreEqual(tuning.RunLength, loaded.RunLength);
+                Assert.AreEqual(tuning.Threads, loaded.Threads);
+                Assert.IsFalse(ParityTuner.Find(21, 8, 512, out loaded));
+            } finally {
+                System.IO.File.Delete(path);
+            }
+        }
+
+        [TestMethod]
+        public void ReedSolomonParityBatchTest() {
+            int nData = 20;
+            int nParity = 6;
+            int nMessages = 2000;
+            int nTracks = 4;
+
+            Random r = new Random(4321);
+
+            Parity[] single = new Parity[nTracks];
+            Parity[] batch = new Parity[nTracks];
+            Syndrome[] syndromes = new Syndrome[nTracks];
+            PinnedBuffer[] buffers = new PinnedBuffer[nTracks];
+            byte[][][] codewords = new byte[nTracks][][];
+            try {
+                for (int k = 0; k < nTracks; k++) {
+                    single[k] = new Parity(nData, nParity, nMessages / 2);
+                    batch[k] = new Parity(nData, nParity, nMessages / 2);
+                    syndromes[k] = new Syndrome(nData, nParity, nMessages / 2);
+                    buffers[k] = new PinnedBuffer(nMessages);
+                    codewords[k] = new byte[nData + nParity][];
+                    for (int e = nParity; e < nData + nParity; e++) {
+                        codewords[k][e] = new byte[nMessages];
+                        r.NextBytes(codewords[k][e]);
+                    }
+                }
+
+                for (int e = nParity; e < nData + nParity; e++) {
+                    for (int k = 0; k < nTracks; k++) {
+                        single[k].Calculate(codewords[k][e], 0, e);
+                        buffers[k].CopyFrom(codewords[k][e], 0, 0, nMessages);
+                    }
+                    Assert.IsTrue(Parity.CalculateBatch(batch, buffers, 0, e));
+                }
+
+                byte[] expected = new byte[nMessages];
+                for (int k = 0; k < nTracks; k++) {
+                    for (int e = 0; e < nParity; e++) {
+                        single[k].GetParity(expected, 0, e);
+                        codewords[k][e] = new byte[nMessages];
+                        batch[k].GetParity(codewords[k][e], 0, e);
+                        CollectionAssert.AreEqual(expected, codewords[k][e]);
+                    }
+                }
+
+                // Corrupt one track; only its syndrome is non-zero
+                codewords[1][nParity + 2][5] ^= 0x40;
+                for (int e = 0; e < nData + nParity; e++) {
+                    for (int k = 0; k < nTracks; k++) buffers[k].CopyFrom(codewords[k][e], 0, 0, nMessages);
+                    Assert.IsTrue(Syndrome.AddCodewordSliceBatch(syndromes, buffers, 0, e));
+                }
+
+                byte[] values = new byte[nMessages];
+                for (int k = 0; k < nTracks; k++) {
+                    bool zero = true;
+                    for (int i = 0; i < nParity; i++) {
+                        syndromes[k].GetSyndromeSlice(values, 0, i);
+                        if (values.Any(v => v != 0)) zero = false;
+                    }
+                    Assert.AreEqual(k != 1, zero);
+                }
+
+                using (Parity other = new Parity(nData + 1, nParity, nMessages / 2)) {
+                    Assert.IsFalse(Parity.CalculateBatch(new Parity[] { batch[0], other }, new PinnedBuffer[] { buffers[0], buffers[1] }, 0, nParity));
+                }
+            } finally {
+                for (int k = 0; k < nTracks; k++) {
+                    single[k]?.Dispose();
+                    batch[k]?.Dispose();
+                    syndromes[k]?.Dispose();
+                    buffers[k]?.Dispose();
+                }
+            }
+        }
+
+        [TestMethod]
+        public void ReedSolomonParityHornerTest() {
+            int nData = 40;
+            int nMessages = 2002;
+
+            Random r = new Random(5678);
+
+            for (int nParity = 1; nParity <= 3; nParity++) {
+                byte[][] data = new byte[nData + nParity][];
+                for (int e = nParity; e < nData + nParity; e++) {
+                    data[e] = new byte[nMessages];
+                    if (e % 5 != 0) r.NextBytes(data[e]);
+                }
+
+                // Descending exponents take the table-free path, ascending ones the table path; the parity must agree
+                using (Parity descending = new Parity(nData, nParity, nMessages / 2))
+                using (Parity ascending = new Parity(nData, nParity, nMessages / 2))
+                using (Syndrome s = new Syndrome(nData, nParity, nMessages / 2)) {
+                    for (int e = nData + nParity - 1; e >= nParity; e--) descending.Calculate(data[e], 0, e);
+                    for (int e = nParity; e < nData + nParity; e++) ascending.Calculate(data[e], 0, e);
+
+                    byte[] expected = new byte[nMessages];
+                    for (int i = 0; i < nParity; i++) {
+                        ascending.GetParity(expected, 0, i);
+                        data[i] = new byte[nMessages];
+                        descending.GetParity(data[i], 0, i);
+                        CollectionAssert.AreEqual(expected, data[i]);
+                    }
+
+                    for (int e = nData + nParity - 1; e >= 0; e--) s.AddCodewordSlice(data[e], 0, e);
+                    byte[] values = new byte[nMessages];
+                    for (int i = 0; i < nParity; i++) {
+                        s.GetSyndromeSlice(values, 0, i);
+                        Assert.IsTrue(values.All(v => v == 0));
+                    }
+                }
+            }
+        }
+
+        [TestMethod]
+        public void Crc32cTest() {
+            byte[] check = System.Text.Encoding.ASCII.GetBytes("123456789");
+            Assert.AreEqual(0xE3069283u, Crc32c.Compute(check, 0, check.Length));
+
+            // Long enough for the three-lane path, with an unaligned start; compare with a bitwise CRC
+            Random r = new Random(99);
+            byte[] data = new byte[10000];
+            r.NextBytes(data);
+            uint crc = 0xFFFFFFFF;
+            for (int i = 3; i < data.Length; i++) {
+                crc ^= data[i];
+                for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ ((crc & 1) != 0 ? 0x82F63B78u : 0);
+            }
+            Assert.AreEqual(~crc, Crc32c.Compute(data, 3, data.Length - 3));
+        }
+
+        [TestMethod]
+        public void ClusterCacheTest() {
+            // One shard with room for four 1000-byte images
+            using (ClusterCache cache = new ClusterCache(4000, 1)) {
+                byte[] image = new byte[1000];
+                for (int key = 0; key < 4; key++) {
+                    for (int i = 0; i < image.Length; i++) image[i] = (byte)key;
+                    Assert.IsTrue(cache.Put(key, image, 0, image.Length));
+                }
+
+                // A pinned image survives both its eviction and its removal until the handle is disposed
+                ClusterCacheHandle handle;
+                Assert.IsTrue(cache.TryGet(0, out handle));
+                Assert.IsTrue(cache.Put(4, image, 0, image.Length));
+                Assert.IsFalse(cache.TryGet(1, out _));
+                cache.Remove(0);
+
+                byte[] copy = new byte[1000];
+                handle.CopyTo(0, copy, 0, copy.Length);
+                Assert.IsTrue(copy.All(b => b == 0));
+                handle.Dispose();
+                Assert.IsFalse(cache.TryGet(0, out _));
+
+                ClusterCacheStats stats = cache.Stats;
+                Assert.AreEqual(1ul, stats.Evictions);
+                Assert.AreEqual(3ul, stats.Entries);
+                Assert.AreEqual(3000ul, stats.Bytes);
+            }
+        }
+
+        [TestMethod]
+        public void WriteBackBufferTest() {
+            using (WriteBackBuffer buffer = new WriteBackBuffer(3000)) {
+                byte[] image = new byte[1000];
+
+                // A second write to the same offset replaces the pending image
+                Assert.IsFalse(buffer.Put(5000, 2, image, 0, image.Length));
+                image[0] = 7;
+                Assert.IsFalse(buffer.Put(5000, 2, image, 0, image.Length));
+                Assert.AreEqual(1, buffer.CoalescedWrites);
+
+                Assert.IsFalse(buffer.Put(1000, 2, image, 0, image.Length));
+                Assert.IsFalse(buffer.Put(9000, 0, image, 0, image.Length));
+                Assert.IsTrue(buffer.Put(0, -1, image, 0, 500));
+
+                // Untracked clusters first, then by track, then by offset
+                CollectionAssert.AreEqual(new long[] { 0, 9000, 1000, 5000 }, buffer.GetFlushOrder());
+
+                byte[] pending = new byte[1000];
+                Assert.IsTrue(buffer.TryRead(5000, pending, 0, pending.Length));
+                Assert.AreEqual(7, pending[0]);
+
+                CollectionAssert.AreEqual(new int[] { 0, 2 }, buffer.TakeDirtyTracks());
+                Assert.AreEqual(0, buffer.TakeDirtyTracks().Length);
+
+                buffer.Remove(5000);
+                Assert.IsFalse(buffer.TryRead(5000, pending, 0, pending.Length));
+                Assert.AreEqual(3, buffer.PendingCount);
+                Assert.AreEqual(2500, buffer.PendingBytes);
+            }
+        }
+
+        [TestMethod]
+        public void AdaptiveRepairTest() {
+            int nData = 100;
+            int nParity = 25;
+            int nMessages = 1000;
+
+            Random r = new Random(1234);
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                data[i] = new byte[nMessages];
+                r.NextBytes(data[i]);
+            }
+
+            byte[][] parity = new byte[nParity][];
+            for (int i = 0; i < nParity; i++) parity[i] = new byte[nMessages];
+
+            using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                for (int i = 0; i < nData; i++) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                for (int i = 0; i < nParity; i++) p.GetParity(parity[i], 0, nParity - 1 - i);
+            }
+
+            Func<int, byte[]> slice = e => e < nParity ? parity[nParity - 1 - e] : data[nData + nParity - 1 - e];
+
+            // One data cluster, two parity clusters, and a data and a parity cluster
+            int[][] erasureSets = new int[][] {
+                new int[] { nData + nParity - 1 - 17 },
+                new int[] { 3, 11 },
+                new int[] { nData + nParity - 1 - 42, 5 }
+            };
+            AdaptiveRepairStrategy[] strategies = new AdaptiveRepairStrategy[] {
+                AdaptiveRepairStrategy.Xor, AdaptiveRepairStrategy.Reencode, AdaptiveRepairStrategy.Decode
+            };
+
+            byte[] reconstructed = new byte[nMessages];
+            for (int k = 0; k < erasureSets.Length; k++) {
+                using (AdaptiveRepair repair = new AdaptiveRepair(nData, nParity, nMessages / 2, erasureSets[k])) {
+                    Assert.AreEqual(strategies[k], repair.Strategy);
+
+                    for (int e = 0; e < nData + nParity; e++) {
+                        if (repair.IsNeeded(e)) repair.AddCodewordSlice(slice(e), 0, e);
+                    }
+
+                    for (int i = 0; i < erasureSets[k].Length; i++) {
+                        repair.GetCorrection(i, reconstructed, 0);
+                        Assert.IsTrue(reconstructed.SequenceEqual(slice(erasureSets[k][i])));
+                    }
+                }
+            }
+        }
+
+        [TestMethod]
+        public void ClusterCryptoTest() {
+            if (!ClusterCrypto.IsSupported) return;
+
+            Func<string, byte[]> hex = s => Enumerable.Range(0, s.Length / 2).Select(i => Convert.ToByte(s.Substring(2 * i, 2), 16)).ToArray();
+
+            using (ClusterCrypto crypto = new ClusterCrypto(2)) {
+                byte[] id = { 1, 2, 3 };
+                byte[] iv = hex("000102030405060708090a0b0c0d0e0f");
+                byte[] block = hex("6bc1bee22e409f96e93d7e117393172a");
+
+                // Nothing is encrypted until the key is cached
+                Assert.IsFalse(crypto.Encrypt(id, iv, block, 0, block.Length));
+
+                // The CBC-AES256 vector of NIST SP 800-38A
+                crypto.AddKey(id, hex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4"));
+                Assert.IsTrue(crypto.Encrypt(id, iv, block, 0, block.Length));
+                CollectionAssert.AreEqual(hex("f58c4c04d6e5f1ba779eabfb5f7bfbd6"), block);
+
+                // Side by side encryption matches one buffer at a time, and decryption extends the checksum over the cipher text
+                Random r = new Random(43);
+                var ivs = new List<byte[]>();
+                var buffers = new List<byte[]>();
+                for (int i = 0; i < ClusterCrypto.MaxLanes + 3; i++) {
+                    ivs.Add(new byte[ClusterCrypto.BlockLength]);
+                    buffers.Add(new byte[4096 + 48]);
+                    r.NextBytes(ivs[i]);
+                    r.NextBytes(buffers[i]);
+                }
+                var plainTexts = buffers.Select(b => (byte[])b.Clone()).ToList();
+
+                Assert.IsTrue(crypto.EncryptMany(id, ivs, buffers, Enumerable.Repeat(16, buffers.Count).ToList(), 4096 + 32));
+                for (int i = 0; i < buffers.Count; i++) {
+                    byte[] single = (byte[])plainTexts[i].Clone();
+                    Assert.IsTrue(crypto.Encrypt(id, ivs[i], single, 16, 4096 + 32));
+                    CollectionAssert.AreEqual(single, buffers[i]);
+
+                    uint checksum = Crc32c.Compute(buffers[i], 0, 16);
+                    byte[] decrypted = new byte[4096 + 32];
+                    Assert.IsTrue(crypto.Decrypt(id, ivs[i], buffers[i], 16, decrypted, 0, decrypted.Length, ref checksum));
+                    Assert.AreEqual(Crc32c.Compute(buffers[i], 0, 16 + 4096 + 32), checksum);
+                    CollectionAssert.AreEqual(plainTexts[i].Skip(16).Take(4096 + 32).ToArray(), decrypted);
+                }
+
+                // The least recently used key is evicted
+                crypto.AddKey(new byte[] { 4 }, new byte[ClusterCrypto.KeyLength]);
+                crypto.AddKey(new byte[] { 5 }, new byte[ClusterCrypto.KeyLength]);
+                Assert.IsFalse(crypto.HasKey(id));
+                Assert.AreEqual(1ul, crypto.Stats.Evictions);
+            }
+        }
+
+        [TestMethod]
+        public void SignatureVerifierTest() {
+            using (var dsa = new System.Security.Cryptography.ECDsaCng(521))
+            using (var sha = new System.Security.Cryptography.SHA256Cng())
+            using (SignatureVerifier verifier = new SignatureVerifier()) {
+                // An ECC public blob is the magic and the coordinate length, then the coordinates
+                byte[] blob = dsa.Key.Export(System.Security.Cryptography.CngKeyBlobFormat.EccPublicBlob);
+                byte[] x = blob.Skip(8).Take(SignatureVerifier.CoordinateLength).ToArray();
+                byte[] y = blob.Skip(8 + SignatureVerifier.CoordinateLength).ToArray();
+                int key = verifier.AddKey(x, y);
+
+                // Signatures made by CNG over SHA-256 digests, one of them spoiled
+                Random r = new Random(44);
+                var keys = new List<int>();
+                var digests = new List<byte[]>();
+                var signatures = new List<byte[]>();
+                for (int i = 0; i < 40; i++) {
+                    byte[] data = new byte[32];
+                    r.NextBytes(data);
+                    keys.Add(key);
+                    digests.Add(sha.ComputeHash(data));
+                    signatures.Add(dsa.SignData(data));
+                }
+                signatures[17][100] ^= 1;
+
+                bool[] valid = verifier.VerifyMany(keys, digests, signatures);
+                for (int i = 0; i < valid.Length; i++) Assert.AreEqual(i != 17, valid[i]);
+                Assert.IsTrue(verifier.Verify(key, digests[3], signatures[3]));
+                Assert.IsFalse(verifier.Verify(key, digests[4], signatures[3]));
+            }
+        }
+
+        [TestMethod]
+        public void DamagedRangesTest() {
+            int nData = 20;
+            int nParity = 4;
+            int nMessages = 8192;
+            int blockCodewords = 256;
+
+            Random r = new Random(1234);
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                data[i] = new byte[nMessages];
+                r.NextBytes(data[i]);
+            }
+
+            byte[][] parity = new byte[nParity][];
+            for (int i = 0; i < nParity; i++) parity[i] = new byte[nMessages];
+
+            using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                for (int i = 0; i < nData; i++) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                for (int i = 0; i < nParity; i++) p.GetParity(parity[i], 0, nParity - 1 - i);
+            }
+
+            // A few bytes of two clusters rot, in the second and last blocks
+            byte[] good3 = (byte[])data[3].Clone();
+            byte[] good9 = (byte[])data[9].Clone();
+            data[3][600] ^= 0x55;
+            data[3][601] ^= 0x01;
+            data[9][nMessages - 1] ^= 0x80;
+
+            using (Syndrome s = new Syndrome(nData, nParity, nMessages / 2)) {
+                for (int i = 0; i < nData; i++) s.AddCodewordSlice(data[i], 0, nData + nParity - 1 - i);
+                for (int i = 0; i < nParity; i++) s.AddCodewordSlice(parity[i], 0, nParity - 1 - i);
+
+                int[] ranges = s.GetDamagedRanges(blockCodewords);
+                Assert.IsTrue(ranges.SequenceEqual(new int[] { 256, 512, 3840, 4096 }));
+
+                int[] errorExponents = new int[] { nData + nParity - 1 - 3, nData + nParity - 1 - 9 };
+                using (Repair repair = new Repair(s, nData + nParity, errorExponents)) {
+                    repair.CorrectRanges(0, data[3], 0, ranges);
+                    repair.CorrectRanges(1, data[9], 0, ranges);
+                }
+            }
+
+            Assert.IsTrue(data[3].SequenceEqual(good3));
+            Assert.IsTrue(data[9].SequenceEqual(good9));
+        }
+
+        [TestMethod]
+        public void DamagedRangesRecycledBufferTest() {
+            int nData = 20;
+            int nMessages = 4096;
+
+            // Parity counts that leave lanes of the syndrome vectors unused, so those lanes come from the pool as they were left
+            foreach (int nParity in new int[] { 3, 4 }) {
+                int vectorBytes = 8 * sizeof(ushort) * (nData + nParity);
+                PinnedBuffer[] dirty = new PinnedBuffer[16];
+                for (int k = 0; k < dirty.Length; k++) {
+                    dirty[k] = new PinnedBuffer(vectorBytes);
+                    byte[] bytes = new byte[vectorBytes];
+                    for (int j = 0; j < bytes.Length; j++) bytes[j] = (byte)(j * 131 + k + 7);
+                    dirty[k].CopyFrom(bytes, 0, 0, vectorBytes);
+                }
+                foreach (var b in dirty) b.Dispose();
+
+                Random r = new Random(1234);
+                byte[][] data = new byte[nData][];
+                for (int i = 0; i < nData; i++) {
+                    data[i] = new byte[nMessages];
+                    r.NextBytes(data[i]);
+                }
+
+                byte[][] parity = new byte[nParity][];
+                using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                    for (int i = 0; i < nData; i++) p.Calculate(data[i], 0, nData + nParity - 1 - i);
+                    for (int i = 0; i < nParity; i++) {
+                        parity[i] = new byte[nMessages];
+                        p.GetParity(parity[i], 0, nParity - 1 - i);
+                    }
+                }
+
+                // The slices are added from the lowest exponent up, so every parity count goes through the syndrome vectors
+                using (Syndrome s = new Syndrome(nData, nParity, nMessages / 2)) {
+                    for (int i = nParity - 1; i >= 0; i--) s.AddCodewordSlice(parity[i], 0, nParity - 1 - i);
+                    for (int i = nData - 1; i >= 0; i--) s.AddCodewordSlice(data[i], 0, nData + nParity - 1 - i);
+                    Assert.AreEqual(0, s.GetDamagedRanges(256).Length);
+                }
+            }
+        }
+
+        [TestMethod]
+        public void ParityJitTest() {
+            int nData = 20;
+            int nParity = 12;
+            int nMessages = 2002;
+
+            Random r = new Random(1234);
+
+            byte[][] data = new byte[nData][];
+            for (int i = 0; i < nData; i++) {
+                data[i] = new byte[nMessages];
+                r.NextBytes(data[i]);
+            }
+
+            // The same parity with generated kernels and without
+            byte[][][] parity = new byte[2][][];
+            bool enabled = ParityJit.Enabled;
+            try {
+                for (int k = 0; k < 2; k++) {
+                    ParityJit.Enabled = k == 0;
+                    parity[k] = new byte[nParity][];
+                    using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                        PinnedBuffer[] buffers = new PinnedBuffer[nData];
+                        int[] exponents = new int[nData];
+                        for (int i = 0; i < nData; i++) {
+                            buffers[i] = new PinnedBuffer(nMessages);
+                            buffers[i].CopyFrom(data[i], 0, 0, nMessages);
+                            exponents[i] = nData + nParity - 1 - i;
+                        }
+                        p.CalculateRun(buffers, 0, exponents);
+                        foreach (var b in buffers) b.Dispose();
+
+                        for (int i = 0; i < nParity; i++) {
+                            parity[k][i] = new byte[nMessages];
+                            p.GetParity(parity[k][i], 0, nParity - 1 - i);
+                        }
+                    }
+                }
+            } finally {
+                ParityJit.Enabled = enabled;
+            }
+
+            for (int i = 0; i < nParity; i++) Assert.IsTrue(parity[0][i].SequenceEqual(parity[1][i]));
+            if (ParityJit.IsSupported) Assert.IsTrue(ParityJit.KernelCount > 0);
+        }
+
+        [TestMethod]
+        public void ParityJitRunArrayTest() {
+            int nData = 20;
+            int nParity = 12;
+            int nMessages = 2002;
+
+            Random r = new Random(1234);
+
+            // A track reads a run of clusters into one array; twelve parity codewords have no template kernel, so a run kernel
+            // for them is always generated
+            byte[] data = new byte[nData * nMessages];
+            r.NextBytes(data);
+            int[] offsets = new int[nData];
+            int[] exponents = new int[nData];
+            for (int i = 0; i < nData; i++) {
+                offsets[i] = i * nMessages;
+                exponents[i] = nData + nParity - 1 - i;
+            }
+
+            byte[] expected = new byte[nMessages];
+            byte[] actual = new byte[nMessages];
+            bool enabled = ParityJit.Enabled;
+            try {
+                ParityJit.Enabled = false;
+                using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                    Assert.AreEqual(0, p.RunLength);
+                    for (int i = 0; i < nData; i++) p.Calculate(data, offsets[i], exponents[i]);
+                    p.GetParity(expected, 0, nParity - 1);
+                }
+
+                ParityJit.Enabled = true;
+                using (Parity p = new Parity(nData, nParity, nMessages / 2)) {
+                    Assert.AreEqual(ParityJit.IsSupported, p.RunLength > 0);
+                    p.CalculateRun(data, offsets, exponents);
+                    p.GetParity(actual, 0, nParity - 1);
+                }
+            } finally {
+                ParityJit.Enabled = enabled;
+            }
+
+            Assert.IsTrue(actual.SequenceEqual(expected));
+            if (ParityJit.IsSupported) Assert.IsTrue(ParityJit.KernelCount > 0);
+        }
     }
 }
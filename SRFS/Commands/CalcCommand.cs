@@ -23,6 +23,9 @@ namespace SRFS.Commands {
         [Parameter(ShortForm = 'r', LongForm = "reedsolomon", Type = "n,k", IsRequired = true, Description = "Reed-Solomon parameters")]
         public ReedSolomon ReedSolomon { get; private set; }
 
+        [Parameter(ShortForm = 'l', LongForm = "localGroups", Type = "INT", Description = "Locally repairable groups per track, each taking one of the n - k parity clusters")]
+        public int LocalGroupCount { get; private set; } = 0;
+
         [Invoke]
         public void Invoke() {
 
@@ -30,6 +33,8 @@ namespace SRFS.Commands {
 
             if (BytesPerSlice > int.MaxValue) throw new CommandLineArgumentException("Argument to -s is too large.");
             int bytesPerSlice = (int)BytesPerSlice;
+            if (LocalGroupCount < 0 || LocalGroupCount > ReedSolomon.K || LocalGroupCount >= ReedSolomon.N - ReedSolomon.K)
+                throw new CommandLineArgumentException("Argument to -l must leave at least one of the n - k parity clusters for Reed-Solomon parity.");
 
             int fileSystemHeaderClusterSize = FileSystemHeaderCluster.CalculateClusterSize(p.BytesPerBlock);
             long bytesAvailable = p.SizeBytes - fileSystemHeaderClusterSize;
@@ -37,12 +42,16 @@ namespace SRFS.Commands {
             long totalTracks = bytesAvailable / g.CalculateTrackSizeBytes(p.BytesPerBlock);
             if (totalTracks > int.MaxValue)
                 throw new CommandLineArgumentException("Too many tracks, please use a larger value of Reed Solomon N and/or bytesPerCluster.");
-            g = new Geometry(bytesPerSlice, ReedSolomon.N, ReedSolomon.K, (int)totalTracks);
+            g = new Geometry(bytesPerSlice, ReedSolomon.N, ReedSolomon.K, (int)totalTracks, LocalGroupCount);
             Configuration.Geometry = g;
 
             Console.WriteLine($"Bytes per Cluster: {g.BytesPerCluster.ToFileSize()}");
             Console.WriteLine($"Data Clusters per Track: {g.DataClustersPerTrack}");
             Console.WriteLine($"Parity Clusters per Track: {g.ParityClustersPerTrack}");
+            if (g.LocalGroupCount > 0) {
+                Console.WriteLine($"  Reed-Solomon: {g.GlobalParityClustersPerTrack}");
+                Console.WriteLine($"  Local Groups: {g.LocalGroupCount}");
+            }
             Console.WriteLine($"Total Clusters per Track: {g.ClustersPerTrack}");
             Console.WriteLine($"Resiliency: {(double)g.ParityClustersPerTrack / g.ClustersPerTrack:%#0.00}");
             Console.WriteLine($"Total Tracks: {g.TrackCount}");
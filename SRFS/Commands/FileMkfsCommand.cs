@@ -30,6 +30,9 @@ namespace SRFS.Commands {
         [Parameter(ShortForm = 'r', LongForm = "reedsolomon", Type = "n,k", IsRequired = true, Description = "Reed-Solomon parameters")]
         public ReedSolomon ReedSolomon { get; private set; }
 
+        [Parameter(ShortForm = 'l', LongForm = "localGroups", Type = "INT", Description = "Locally repairable groups per track, each taking one of the n - k parity clusters")]
+        public int LocalGroupCount { get; private set; } = 0;
+
         [Parameter(ShortForm = 'n', LongForm = "volumeName", Type = "STRING", IsRequired = true, Description = "Volume name")]
         public string VolumeName { get; private set; }
 
@@ -48,8 +51,10 @@ namespace SRFS.Commands {
 
             if (BytesPerSlice > int.MaxValue) throw new CommandLineArgumentException("Argument to -s is too large.");
             int bytesPerSlice = (int)BytesPerSlice;
+            if (LocalGroupCount < 0 || LocalGroupCount > ReedSolomon.K || LocalGroupCount >= ReedSolomon.N - ReedSolomon.K)
+                throw new CommandLineArgumentException("Argument to -l must leave at least one of the n - k parity clusters for Reed-Solomon parity.");
 
-            Geometry g = new Geometry(bytesPerSlice, ReedSolomon.N, ReedSolomon.K, TrackCount);
+            Geometry g = new Geometry(bytesPerSlice, ReedSolomon.N, ReedSolomon.K, TrackCount, LocalGroupCount);
             Configuration.Geometry = g;
 
             Configuration.FileSystemID = Guid.NewGuid();
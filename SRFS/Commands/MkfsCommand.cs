@@ -26,6 +26,9 @@ namespace SRFS.Commands {
         [Parameter(ShortForm = 'r', LongForm = "reedsolomon", Type = "n,k", IsRequired = true, Description = "Reed-Solomon parameters")]
         public ReedSolomon ReedSolomon { get; private set; }
 
+        [Parameter(ShortForm = 'l', LongForm = "localGroups", Type = "INT", Description = "Locally repairable groups per track, each taking one of the n - k parity clusters")]
+        public int LocalGroupCount { get; private set; } = 0;
+
         [Parameter(ShortForm = 'n', LongForm = "volumeName", Type = "STRING", IsRequired = true, Description = "Volume name")]
         public string VolumeName { get; private set; }
 
@@ -42,6 +45,8 @@ namespace SRFS.Commands {
 
             if (BytesPerSlice > int.MaxValue) throw new CommandLineArgumentException("Argument to -s is too large.");
             int bytesPerSlice = (int)BytesPerSlice;
+            if (LocalGroupCount < 0 || LocalGroupCount > ReedSolomon.K || LocalGroupCount >= ReedSolomon.N - ReedSolomon.K)
+                throw new CommandLineArgumentException("Argument to -l must leave at least one of the n - k parity clusters for Reed-Solomon parity.");
 
             long bytesAvailable = p.SizeBytes - FileSystemHeaderCluster.CalculateClusterSize(p.BytesPerBlock);
             Geometry g = new Geometry(bytesPerSlice, ReedSolomon.N, ReedSolomon.K, 1);
@@ -49,7 +54,7 @@ namespace SRFS.Commands {
             long totalTracks = bytesAvailable / g.CalculateTrackSizeBytes(p.BytesPerBlock);
 
             if (totalTracks > int.MaxValue) throw new CommandLineArgumentException("Too many chains, please use a larger value of n (Reed Solomon parameter) and/or bytesPerSlice.");
-            g = new Geometry(bytesPerSlice, ReedSolomon.N, ReedSolomon.K, (int)totalTracks);
+            g = new Geometry(bytesPerSlice, ReedSolomon.N, ReedSolomon.K, (int)totalTracks, LocalGroupCount);
 
             Configuration.Geometry = g;
             Configuration.VolumeName = VolumeName;
@@ -31,6 +31,9 @@ namespace SRFS.Commands {
         [Switch(ShortForm = 'g', LongForm = "skipSignatureVerify", Description = "Skip verification of cluster signatures")]
         public bool doNotVerifySignatures { get; private set; } = false;
 
+        [Switch(ShortForm = 'k', LongForm = "checksumOnly", Description = "Verify cluster checksums, and hashes and signatures only on a mismatch")]
+        public bool verifyChecksumsOnly { get; private set; } = false;
+
         [Parameter(ShortForm = 't', LongForm = "track", Type = "INT", Description = "track number", IsRequired = true)]
         public int Track { get; private set; }
 
@@ -55,6 +58,7 @@ namespace SRFS.Commands {
             Options options = Options.None;
             if (doNotVerifyHashes) options |= Options.DoNotVerifyClusterHashes;
             if (doNotVerifySignatures) options |= Options.DoNotVerifyClusterSignatures;
+            if (verifyChecksumsOnly) options |= Options.VerifyClusterChecksumsOnly;
             Configuration.Options = options;
 
             CngKey encryptionKey = CryptoSettingsOptions.GetEncryptionKey();
@@ -64,8 +68,10 @@ namespace SRFS.Commands {
 
             using (var pio = new PartitionIO(PartitionOptions.GetPartition()))
             using (var fs = FileSystem.Mount(pio)) {
+                List<Track> tracks = new List<Track>();
                 for (int tn = Track; tn < Track + TrackCount; tn++) {
                     Track t = new Track(fs, tn);
+                    tracks.Add(t);
 
                     Console.WriteLine($"Track Number: {t.Number}");
                     Console.WriteLine($"Used: {t.Used}");
@@ -88,18 +94,26 @@ namespace SRFS.Commands {
                     c = from i in t.ParityClusters where fs.GetClusterState(i).IsUnwritten() select i;
                     Console.WriteLine($"  Unwritten ({c.Count()}): {c.ToRanges()}");
 
-                    if (CalculateParity) t.UpdateParity(Force);
-                    if (VerifyParity) {
-                        Console.WriteLine("Verifying Parity");
-                        if (t.VerifyParity()) Console.WriteLine("Verified OK");
-                        else Console.WriteLine("Corrupt");
-                    } else if (Repair) {
-                        Console.WriteLine("Repairing");
-                        if (t.Repair()) Console.WriteLine("Repair OK");
+                    Console.WriteLine();
+                }
+
+                // The tracks are encoded and verified as one batch, so each coefficient table is built once for all of them
+                if (CalculateParity) SRFS.Model.Track.UpdateParity(fs, tracks, Force);
+                if (VerifyParity) {
+                    Console.WriteLine("Verifying Parity");
+                    bool[] verified = SRFS.Model.Track.VerifyParity(fs, tracks);
+                    for (int i = 0; i < tracks.Count; i++) {
+                        Console.WriteLine($"Track {tracks[i].Number}: {(verified[i] ? "Verified OK" : "Corrupt")}");
+                    }
+                } else if (Repair) {
+                    foreach (var t in tracks) {
+                        Console.WriteLine($"Repairing track {t.Number}");
+                        // The track is read once, and damage the cluster checks catch is rewritten a device block at a time
+                        if (t.Scrub()) Console.WriteLine("Repair OK");
                         else Console.WriteLine("Repair Failed");
                     }
-                    if (CalculateParity || Repair) fs.Flush();
                 }
+                if (CalculateParity || Repair) fs.Flush();
             }
         }
     }
@@ -30,6 +30,9 @@ namespace SRFS.Commands {
         [Switch(ShortForm = 'g', LongForm = "skipSignatureVerify", Description = "Skip verification of cluster signatures")]
         public bool doNotVerifySignatures { get; private set; } = false;
 
+        [Switch(ShortForm = 'k', LongForm = "checksumOnly", Description = "Verify cluster checksums, and hashes and signatures only on a mismatch")]
+        public bool verifyChecksumsOnly { get; private set; } = false;
+
         private IEnumerable<int> getFileSequence(FileSystem fs, File f) {
             int i = f.FirstCluster;
             while (i != Constants.NoAddress) {
@@ -50,6 +53,7 @@ namespace SRFS.Commands {
             Options options = Options.None;
             if (doNotVerifyHashes) options |= Options.DoNotVerifyClusterHashes;
             if (doNotVerifySignatures) options |= Options.DoNotVerifyClusterSignatures;
+            if (verifyChecksumsOnly) options |= Options.VerifyClusterChecksumsOnly;
             Configuration.Options = options;
 
             CngKey encryptionKey = CryptoSettingsOptions.GetEncryptionKey();
@@ -138,20 +142,9 @@ namespace SRFS.Commands {
 
                 Console.WriteLine();
 
-                var usedTracks =
-                    from t in
-                        from x in Enumerable.Range(0, Configuration.Geometry.TrackCount)
-                        select new Track(fs, x)
-                    where t.Used
-                    select t.Number;
-                Console.WriteLine($"Used Tracks: {usedTracks.ToRanges()}");
-
-                var upToDateTracks =
-                    from t in
-                        from x in Enumerable.Range(0, Configuration.Geometry.TrackCount)
-                        select new Track(fs, x)
-                    where t.UpToDate
-                    select t.Number;
+                Console.WriteLine($"Used Tracks: {fs.GetUsedTracks().ToRanges()}");
+
+                var upToDateTracks = Enumerable.Range(0, Configuration.Geometry.TrackCount).Except(fs.GetStaleTracks());
                 Console.WriteLine($"Up-to-date Tracks: {upToDateTracks.ToRanges()}");
 
             }
@@ -13,10 +13,8 @@ namespace TrackUtility.Model {
         public TrackStatusWindowModel(FileSystem fileSystem) {
             _fileSystem = fileSystem;
 
-            UsedTrackCount = (from a in (from t in Enumerable.Range(0, Configuration.Geometry.TrackCount) select new Track(_fileSystem, t))
-                              where a.Used select a).Count();
-            ProtectedTrackCount = (from a in (from t in Enumerable.Range(0, Configuration.Geometry.TrackCount) select new Track(_fileSystem, t))
-                                   where a.Used && a.UpToDate select a).Count();
+            UsedTrackCount = _fileSystem.GetUsedTracks().Length;
+            ProtectedTrackCount = UsedTrackCount - _fileSystem.GetStaleTracks().Length;
             TrackCount = Configuration.Geometry.TrackCount;
         }
 